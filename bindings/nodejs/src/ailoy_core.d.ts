@@ -56,6 +56,9 @@ export declare class EmbeddingModel {
     config?: LocalEmbeddingModelConfig | undefined | null
   ): Promise<EmbeddingModel>;
   infer(text: string): Promise<Embedding>;
+  inferBatch(texts: Array<string>): Promise<Array<Embedding>>;
+  enableCache(config?: EmbeddingCacheConfig | undefined | null): void;
+  cacheMetrics(): EmbeddingCacheMetrics | null;
   static download(
     modelName: string,
     config?: LocalEmbeddingModelConfig | undefined | null
@@ -72,6 +75,10 @@ export declare class Knowledge {
     query: string,
     config?: KnowledgeConfig | undefined | null
   ): Promise<Array<Document>>;
+  ingest(
+    documents: Array<Document>,
+    config?: IngestConfig | undefined | null
+  ): Promise<Array<string>>;
   asTool(): Tool;
 }
 
@@ -129,27 +136,50 @@ export declare class Tool {
 }
 
 export declare class VectorStore {
-  static newFaiss(dim: number): Promise<VectorStore>;
+  static newFaiss(
+    dim: number,
+    config?: FaissStoreConfig | undefined | null
+  ): Promise<VectorStore>;
   static newChroma(
     url: string,
     collectionName?: string | undefined | null
   ): Promise<VectorStore>;
+  static load(
+    path: string,
+    config?: FaissStoreConfig | undefined | null
+  ): Promise<VectorStore>;
+  save(path: string): Promise<void>;
   addVector(input: VectorStoreAddInput): Promise<string>;
   addVectors(inputs: Array<VectorStoreAddInput>): Promise<Array<string>>;
   getById(id: string): Promise<VectorStoreGetResult | null>;
   getByIds(ids: Array<string>): Promise<Array<VectorStoreGetResult>>;
   retrieve(
     queryEmbedding: Embedding,
-    topK: number
+    topK: number,
+    filter?: VectorStoreMetadata | undefined | null,
+    searchParams?: VectorStoreSearchParams | undefined | null
   ): Promise<Array<VectorStoreRetrieveResult>>;
   batchRetrieve(
     queryEmbeddings: Array<Embedding>,
-    topK: number
+    topK: number,
+    filter?: VectorStoreMetadata | undefined | null,
+    searchParams?: VectorStoreSearchParams | undefined | null
   ): Promise<Array<Array<VectorStoreRetrieveResult>>>;
+  retrieveWithin(
+    queryEmbedding: Embedding,
+    radius: number
+  ): Promise<Array<VectorStoreRetrieveResult>>;
+  retrieveLexical(
+    query: string,
+    topK: number
+  ): Promise<Array<VectorStoreRetrieveResult>>;
   removeVector(id: string): Promise<void>;
   removeVectors(ids: Array<string>): Promise<void>;
   clear(): Promise<void>;
   count(): Promise<number>;
+  trainingError(): Promise<string | null>;
+  computePoolMetrics(): ComputePoolMetrics | null;
+  retrieveBatchMetrics(): RetrieveBatchMetrics | null;
 }
 
 export declare function accumulateMessageDelta(
@@ -188,6 +218,18 @@ export interface CacheProgress {
   total: number;
 }
 
+/** Snapshot of the load of a compute pool. */
+export interface ComputePoolMetrics {
+  /** Number of worker threads. */
+  threads: number;
+  /** Jobs waiting for a free worker. */
+  queued: number;
+  /** Jobs currently running. */
+  running: number;
+  /** Jobs finished since the pool was created, including failed ones. */
+  completed: number;
+}
+
 export interface Document {
   id: string;
   title?: string;
@@ -204,6 +246,108 @@ export type DocumentPolyfillKind = "Qwen3";
 
 export type Embedding = Float32Array;
 
+export interface EmbeddingCacheConfig {
+  /**
+   * Embeddings kept in memory; beyond it the least recently used one is
+   * evicted. Defaults to 4096.
+   */
+  maxEntries?: number;
+  /**
+   * File that evicted embeddings spill to and that memory misses are looked
+   * up in. It is reused across runs of the same model. Ignored on the web.
+   */
+  spillPath?: string;
+  /**
+   * The spill file starts over once it would grow past this many megabytes.
+   * Defaults to 256.
+   */
+  maxSpillMb?: number;
+}
+
+/** Lookups served by an embedding cache since it was enabled. */
+export interface EmbeddingCacheMetrics {
+  /** Lookups answered from memory. */
+  hits: number;
+  /** Lookups answered from the spill file. */
+  spillHits: number;
+  /** Lookups that had to run the model. */
+  misses: number;
+  /** Entries evicted from memory. */
+  evictions: number;
+  /** Entries currently in memory. */
+  entries: number;
+}
+
+export interface FaissStoreConfig {
+  /**
+   * FAISS index factory string such as `"Flat"`, `"IVF1024,Flat"`, `"HNSW32"`,
+   * `"IVF1024,PQ16"` or `"SQ8"`. Defaults to `"Flat"`.
+   *
+   * Indexes that need training (IVF, PQ, ...) serve from a flat staging index
+   * until `training_samples` vectors were added, then get trained in the
+   * background and replace it. HNSW indexes do not support removal.
+   */
+  indexDescription?: string;
+  metric?: FaissStoreMetric;
+  /**
+   * Number of vectors to collect before training the index. Defaults to 10000;
+   * IVF indexes want at least `39 * nlist`. A failed training run doubles it
+   * before the next attempt.
+   */
+  trainingSamples?: number;
+  /**
+   * Threads of a compute pool dedicated to this store's FAISS calls. Unset
+   * stores share one pool sized to half of the cores. Ignored on the web.
+   */
+  computeThreads?: number;
+  /**
+   * Unfiltered retrieve calls arriving within this many microseconds of each
+   * other are searched as one batch, which makes flat search several times
+   * cheaper per query. Off when unset. Ignored on the web.
+   */
+  batchWindowMicros?: number;
+  /** Searches a batch as soon as it holds this many queries. Defaults to 64. */
+  maxBatchSize?: number;
+  /**
+   * Splits the store into this many independent indexes, which entries are
+   * spread over round-robin. Queries search every shard in parallel and merge
+   * the results. Defaults to 1.
+   */
+  shards?: number;
+  /**
+   * Keeps full-precision embeddings beside the index so that a compressed
+   * index such as `"SQ8"`, `"SQfp16"` or `"PQ32"` only serves the candidate
+   * pass. Searches fetch `top_k * k_factor` candidates (4 unless the search
+   * params set `k_factor`) and re-rank them exactly, and `get_by_ids` returns
+   * the original embeddings. The embeddings are kept in a temporary file, or in
+   * memory on the web.
+   */
+  exactRerank?: boolean;
+  /**
+   * FAISS binary index factory string such as `"BFlat"`, `"BIVF1024"` or
+   * `"BHNSW32"`. When set, the sign bits of every embedding are also kept in
+   * this index, and unfiltered searches take their `top_k * k_factor`
+   * candidates (10 unless the search params set `k_factor`) by Hamming
+   * distance before re-scoring them with the float embeddings. A binary index
+   * that needs training serves once `training_samples` vectors were added.
+   */
+  binaryIndex?: string;
+  /**
+   * Also keeps a BM25 index over the documents, which serves
+   * `retrieve_lexical` and the lexical and hybrid modes of knowledge
+   * retrieval. It is updated on every add and removal, and rebuilt from the
+   * documents when a saved store is loaded.
+   */
+  lexicalIndex?: boolean;
+}
+
+/** Distance used to compare embeddings. */
+export type FaissStoreMetric =
+  /** Squared euclidean distance; smaller is closer. */
+  | "L2"
+  /** Dot product; larger is closer. Use with normalized embeddings for cosine similarity. */
+  | "InnerProduct";
+
 export declare function finishMessageDelta(delta: MessageDelta): Message;
 
 /** Explains why a language model's streamed generation finished. */
@@ -230,10 +374,42 @@ export declare function imageFromBytes(data: Uint8Array): Part;
 
 export declare function imageFromUrl(url: string): Part;
 
+export interface IngestConfig {
+  chunkSize?: number;
+  chunkOverlap?: number;
+  batchSize?: number;
+  progressCallback?: (arg: CacheProgress) => void;
+}
+
 export interface KnowledgeConfig {
   topK?: number;
+  /**
+   * If set, retrieves every document within this distance of the query
+   * instead of a fixed number; `top_k` then caps the number of documents.
+   */
+  radius?: number;
+  /** Number of inverted lists probed when the store uses an IVF index. */
+  nprobe?: number;
+  /** Candidate list size when the store uses an HNSW index. */
+  efSearch?: number;
+  /** Candidates re-ranked per document when the store uses a refine index. */
+  kFactor?: number;
+  /** Dense when unset. `radius` only applies to the dense ranking. */
+  mode?: KnowledgeRetrievalMode;
 }
 
+/** How a vector-store knowledge ranks documents for a query. */
+export type KnowledgeRetrievalMode =
+  /** Nearest embeddings of the query. */
+  | "Dense"
+  /** Best BM25 scores of the query's terms. Needs a store with a lexical index. */
+  | "Lexical"
+  /**
+   * Dense and lexical rankings merged by reciprocal-rank fusion. Needs a store
+   * with a lexical index.
+   */
+  | "Hybrid";
+
 export interface KVCacheConfig {
   contextWindowSize?: number;
   prefillChunkSize?: number;
@@ -281,6 +457,8 @@ export interface LangModelInferConfig {
 export interface LocalEmbeddingModelConfig {
   deviceId?: number;
   validateChecksum?: boolean;
+  batchWindowMicros?: number;
+  maxBatchSize?: number;
   progressCallback?: (arg: CacheProgress) => void;
 }
 
@@ -541,6 +719,23 @@ export type PartImageColorspace =
   | "rgba";
 
 /** The author of a message (or streaming delta) in a chat. */
+/**
+ * Batch sizes and queueing delays achieved by retrieve batching.
+ *
+ * Histograms are log2-bucketed: bucket `i` counts samples from `2^i` to
+ * `2^(i+1) - 1`, and bucket 0 also counts zeros.
+ */
+export interface RetrieveBatchMetrics {
+  /** Number of batches searched. */
+  batches: number;
+  /** Number of retrieve calls served by those batches. */
+  queries: number;
+  /** Histogram of queries per batch. */
+  batchSizes: Array<number>;
+  /** Histogram of microseconds a query waited for its batch to be searched. */
+  waitMicros: Array<number>;
+}
+
 export type Role =
   /** System instructions and constraints provided to the assistant. */
   | "system"
@@ -660,3 +855,17 @@ export interface VectorStoreRetrieveResult {
   metadata?: VectorStoreMetadata;
   distance: number;
 }
+
+/**
+ * Per-query settings of approximate indexes, trading recall for latency without
+ * rebuilding the index. Unset fields keep the value the index was built with,
+ * and settings that don't apply to the index type are ignored, as they are by Chroma.
+ */
+export interface VectorStoreSearchParams {
+  /** Number of inverted lists an IVF index probes. */
+  nprobe?: number;
+  /** Size of the candidate list an HNSW index explores. */
+  efSearch?: number;
+  /** A refine index re-ranks `top_k * k_factor` candidates of its base index. */
+  kFactor?: number;
+}
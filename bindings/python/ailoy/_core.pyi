@@ -81,6 +81,32 @@ class CacheProgress:
     def total(self) -> builtins.int: ...
     def __repr__(self) -> builtins.str: ...
 
+@typing.final
+class ComputePoolMetrics:
+    r"""
+    Snapshot of the load of a compute pool.
+    """
+    @property
+    def threads(self) -> builtins.int:
+        r"""
+        Number of worker threads.
+        """
+    @property
+    def queued(self) -> builtins.int:
+        r"""
+        Jobs waiting for a free worker.
+        """
+    @property
+    def running(self) -> builtins.int:
+        r"""
+        Jobs currently running.
+        """
+    @property
+    def completed(self) -> builtins.int:
+        r"""
+        Jobs finished since the pool was created, including failed ones.
+        """
+
 @typing.final
 class Document:
     @property
@@ -109,18 +135,53 @@ class DocumentPolyfill:
     @classmethod
     def get(cls, kind: typing.Literal["Qwen3"]) -> DocumentPolyfill: ...
 
+@typing.final
+class EmbeddingCacheMetrics:
+    r"""
+    Lookups served by an embedding cache since it was enabled.
+    """
+    @property
+    def hits(self) -> builtins.int:
+        r"""
+        Lookups answered from memory.
+        """
+    @property
+    def spill_hits(self) -> builtins.int:
+        r"""
+        Lookups answered from the spill file.
+        """
+    @property
+    def misses(self) -> builtins.int:
+        r"""
+        Lookups that had to run the model.
+        """
+    @property
+    def evictions(self) -> builtins.int:
+        r"""
+        Entries evicted from memory.
+        """
+    @property
+    def entries(self) -> builtins.int:
+        r"""
+        Entries currently in memory.
+        """
+
 @typing.final
 class EmbeddingModel:
     @classmethod
-    def new_local(cls, model_name: builtins.str, device_id: typing.Optional[builtins.int] = None, validate_checksum: typing.Optional[builtins.bool] = None, progress_callback: typing.Callable[[CacheProgress], None] = None) -> typing.Awaitable[EmbeddingModel]: ...
+    def new_local(cls, model_name: builtins.str, device_id: typing.Optional[builtins.int] = None, validate_checksum: typing.Optional[builtins.bool] = None, batch_window_micros: typing.Optional[builtins.int] = None, max_batch_size: typing.Optional[builtins.int] = None, progress_callback: typing.Callable[[CacheProgress], None] = None) -> typing.Awaitable[EmbeddingModel]: ...
     @classmethod
-    def new_local_sync(cls, model_name: builtins.str, device_id: typing.Optional[builtins.int] = None, validate_checksum: typing.Optional[builtins.bool] = None, progress_callback: typing.Callable[[CacheProgress], None] = None) -> EmbeddingModel: ...
+    def new_local_sync(cls, model_name: builtins.str, device_id: typing.Optional[builtins.int] = None, validate_checksum: typing.Optional[builtins.bool] = None, batch_window_micros: typing.Optional[builtins.int] = None, max_batch_size: typing.Optional[builtins.int] = None, progress_callback: typing.Callable[[CacheProgress], None] = None) -> EmbeddingModel: ...
     @classmethod
     def download(cls, model_name: builtins.str, progress_callback: typing.Callable[[CacheProgress], None] = None) -> None: ...
     @classmethod
     def remove(cls, model_name: builtins.str) -> None: ...
     async def infer(self, text: builtins.str) -> builtins.list[float]: ...
     def infer_sync(self, text: builtins.str) -> builtins.list[float]: ...
+    async def infer_batch(self, texts: typing.Sequence[builtins.str]) -> builtins.list[builtins.list[float]]: ...
+    def infer_batch_sync(self, texts: typing.Sequence[builtins.str]) -> builtins.list[builtins.list[float]]: ...
+    def enable_cache(self, max_entries: typing.Optional[builtins.int] = None, spill_path: typing.Optional[builtins.str] = None, max_spill_mb: typing.Optional[builtins.int] = None) -> None: ...
+    def cache_metrics(self) -> typing.Optional[EmbeddingCacheMetrics]: ...
 
 class Grammar:
     @typing.final
@@ -177,6 +238,8 @@ class Knowledge:
     @classmethod
     def new_vector_store(cls, store: VectorStore, embedding_model: EmbeddingModel) -> Knowledge: ...
     async def retrieve(self, query: builtins.str, config: KnowledgeConfig) -> builtins.list[Document]: ...
+    def ingest(self, documents: typing.Sequence[Document], chunk_size: typing.Optional[builtins.int] = None, chunk_overlap: typing.Optional[builtins.int] = None, batch_size: typing.Optional[builtins.int] = None, progress_callback: typing.Callable[[CacheProgress], None] = None) -> typing.Awaitable[builtins.list[builtins.str]]: ...
+    def ingest_sync(self, documents: typing.Sequence[Document], chunk_size: typing.Optional[builtins.int] = None, chunk_overlap: typing.Optional[builtins.int] = None, batch_size: typing.Optional[builtins.int] = None, progress_callback: typing.Callable[[CacheProgress], None] = None) -> builtins.list[builtins.str]: ...
     def as_tool(self) -> Tool: ...
 
 @typing.final
@@ -185,7 +248,59 @@ class KnowledgeConfig:
     def top_k(self) -> typing.Optional[builtins.int]: ...
     @top_k.setter
     def top_k(self, value: typing.Optional[builtins.int]) -> None: ...
-    def __new__(cls, top_k: typing.Optional[builtins.int] = None) -> KnowledgeConfig: ...
+    @property
+    def radius(self) -> typing.Optional[builtins.float]:
+        r"""
+        If set, retrieves every document within this distance of the query
+        instead of a fixed number; `top_k` then caps the number of documents.
+        """
+    @radius.setter
+    def radius(self, value: typing.Optional[builtins.float]) -> None:
+        r"""
+        If set, retrieves every document within this distance of the query
+        instead of a fixed number; `top_k` then caps the number of documents.
+        """
+    @property
+    def nprobe(self) -> typing.Optional[builtins.int]:
+        r"""
+        Number of inverted lists probed when the store uses an IVF index.
+        """
+    @nprobe.setter
+    def nprobe(self, value: typing.Optional[builtins.int]) -> None:
+        r"""
+        Number of inverted lists probed when the store uses an IVF index.
+        """
+    @property
+    def ef_search(self) -> typing.Optional[builtins.int]:
+        r"""
+        Candidate list size when the store uses an HNSW index.
+        """
+    @ef_search.setter
+    def ef_search(self, value: typing.Optional[builtins.int]) -> None:
+        r"""
+        Candidate list size when the store uses an HNSW index.
+        """
+    @property
+    def k_factor(self) -> typing.Optional[builtins.float]:
+        r"""
+        Candidates re-ranked per document when the store uses a refine index.
+        """
+    @k_factor.setter
+    def k_factor(self, value: typing.Optional[builtins.float]) -> None:
+        r"""
+        Candidates re-ranked per document when the store uses a refine index.
+        """
+    @property
+    def mode(self) -> typing.Optional[typing.Literal["Dense", "Lexical", "Hybrid"]]:
+        r"""
+        Dense when unset. `radius` only applies to the dense ranking.
+        """
+    @mode.setter
+    def mode(self, value: typing.Optional[typing.Literal["Dense", "Lexical", "Hybrid"]]) -> None:
+        r"""
+        Dense when unset. `radius` only applies to the dense ranking.
+        """
+    def __new__(cls, top_k: typing.Optional[builtins.int] = None, radius: typing.Optional[builtins.float] = None, nprobe: typing.Optional[builtins.int] = None, ef_search: typing.Optional[builtins.int] = None, k_factor: typing.Optional[builtins.float] = None, mode: typing.Optional[typing.Literal["Dense", "Lexical", "Hybrid"]] = None) -> KnowledgeConfig: ...
     @classmethod
     def from_dict(cls, config: dict) -> KnowledgeConfig: ...
 
@@ -743,6 +858,35 @@ class PartImage:
     
     ...
 
+@typing.final
+class RetrieveBatchMetrics:
+    r"""
+    Batch sizes and queueing delays achieved by retrieve batching.
+    
+    Histograms are log2-bucketed: bucket `i` counts samples from `2^i` to
+    `2^(i+1) - 1`, and bucket 0 also counts zeros.
+    """
+    @property
+    def batches(self) -> builtins.int:
+        r"""
+        Number of batches searched.
+        """
+    @property
+    def queries(self) -> builtins.int:
+        r"""
+        Number of retrieve calls served by those batches.
+        """
+    @property
+    def batch_sizes(self) -> builtins.list[builtins.int]:
+        r"""
+        Histogram of queries per batch.
+        """
+    @property
+    def wait_micros(self) -> builtins.list[builtins.int]:
+        r"""
+        Histogram of microseconds a query waited for its batch to be searched.
+        """
+
 class Tool:
     @classmethod
     def new_builtin(cls, kind: typing.Literal["terminal", "web_search_duckduckgo", "web_fetch"], **kwargs: typing.Any) -> Tool: ...
@@ -815,19 +959,27 @@ class ToolDesc:
 @typing.final
 class VectorStore:
     @classmethod
-    def new_faiss(cls, dim: builtins.int) -> VectorStore: ...
+    def new_faiss(cls, dim: builtins.int, index_description: typing.Optional[builtins.str] = None, metric: typing.Optional[typing.Literal["L2", "InnerProduct"]] = None, training_samples: typing.Optional[builtins.int] = None, compute_threads: typing.Optional[builtins.int] = None, batch_window_micros: typing.Optional[builtins.int] = None, max_batch_size: typing.Optional[builtins.int] = None, shards: typing.Optional[builtins.int] = None, exact_rerank: typing.Optional[builtins.bool] = None, binary_index: typing.Optional[builtins.str] = None, lexical_index: typing.Optional[builtins.bool] = None) -> VectorStore: ...
     @classmethod
     def new_chroma(cls, url: builtins.str, collection_name: typing.Optional[builtins.str]) -> VectorStore: ...
+    @classmethod
+    def load(cls, path: builtins.str, compute_threads: typing.Optional[builtins.int] = None, batch_window_micros: typing.Optional[builtins.int] = None, max_batch_size: typing.Optional[builtins.int] = None) -> VectorStore: ...
+    def save(self, path: builtins.str) -> None: ...
     def add_vector(self, input: VectorStoreAddInput) -> builtins.str: ...
     def add_vectors(self, inputs: typing.Sequence[VectorStoreAddInput]) -> builtins.list[builtins.str]: ...
     def get_by_id(self, id: builtins.str) -> typing.Optional[VectorStoreGetResult]: ...
     def get_by_ids(self, ids: typing.Sequence[builtins.str]) -> builtins.list[VectorStoreGetResult]: ...
-    def retrieve(self, query_embedding: builtins.list[float], top_k: builtins.int) -> builtins.list[VectorStoreRetrieveResult]: ...
-    def batch_retrieve(self, query_embeddings: typing.Sequence[builtins.list[float]], top_k: builtins.int) -> builtins.list[builtins.list[VectorStoreRetrieveResult]]: ...
+    def retrieve(self, query_embedding: builtins.list[float], top_k: builtins.int, filter: typing.Optional[typing.Mapping[builtins.str, typing.Any]] = None, nprobe: typing.Optional[builtins.int] = None, ef_search: typing.Optional[builtins.int] = None, k_factor: typing.Optional[builtins.float] = None) -> builtins.list[VectorStoreRetrieveResult]: ...
+    def batch_retrieve(self, query_embeddings: typing.Sequence[builtins.list[float]], top_k: builtins.int, filter: typing.Optional[typing.Mapping[builtins.str, typing.Any]] = None, nprobe: typing.Optional[builtins.int] = None, ef_search: typing.Optional[builtins.int] = None, k_factor: typing.Optional[builtins.float] = None) -> builtins.list[builtins.list[VectorStoreRetrieveResult]]: ...
+    def retrieve_within(self, query_embedding: builtins.list[float], radius: builtins.float) -> builtins.list[VectorStoreRetrieveResult]: ...
+    def retrieve_lexical(self, query: builtins.str, top_k: builtins.int) -> builtins.list[VectorStoreRetrieveResult]: ...
     def remove_vector(self, id: builtins.str) -> None: ...
     def remove_vectors(self, ids: typing.Sequence[builtins.str]) -> None: ...
     def clear(self) -> None: ...
     def count(self) -> builtins.int: ...
+    def training_error(self) -> typing.Optional[builtins.str]: ...
+    def compute_pool_metrics(self) -> typing.Optional[ComputePoolMetrics]: ...
+    def retrieve_batch_metrics(self) -> typing.Optional[RetrieveBatchMetrics]: ...
 
 @typing.final
 class VectorStoreAddInput:
@@ -1,25 +1,115 @@
 #include "ailoy-faiss-sys/src/bridge.hpp"
 #include "ailoy-faiss-sys/src/lib.rs.h"
 
+#include <cstring>
 #include <filesystem>
-#include <fstream>
 #include <stdexcept>
-
+#include <type_traits>
+
+#include <faiss/IVFlib.h>
+#include <faiss/IndexBinaryIVF.h>
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/impl/AuxIndexStructures.h>
 #include <faiss/impl/IDSelector.h>
+#include <faiss/impl/io.h>
 #include <faiss/index_factory.h>
 #include <faiss/index_io.h>
 
 namespace faiss_bridge {
 
-FaissIndexInner::FaissIndexInner(std::unique_ptr<faiss::Index> index)
-    : index_(std::move(index)) {
+namespace {
+
+// IVF indexes hold their own ids, but can only reconstruct or remove them by
+// id through a hashtable direct map.
+void enable_id_lookup(faiss::Index *index) {
+  if (faiss::IndexIVF *ivf = faiss::ivflib::try_extract_index_ivf(index)) {
+    ivf->set_direct_map_type(faiss::DirectMap::Hashtable);
+  }
+}
+
+// Owns the parameter objects built for one search call.
+struct SearchParamsChain {
+  std::vector<std::unique_ptr<faiss::SearchParameters>> params;
+  std::vector<std::unique_ptr<faiss::IDSelector>> selectors;
+};
+
+// Builds the SearchParameters subclass `index` expects, taking the knobs set
+// in `knobs` and the index's own settings for the rest. Returns nullptr when
+// neither knobs nor a selector apply, so the plain search path is kept.
+faiss::SearchParameters *make_search_params(const faiss::Index *index,
+                                            const FaissSearchParams &knobs,
+                                            faiss::IDSelector *selector,
+                                            SearchParamsChain &chain) {
+  if (auto *idmap = dynamic_cast<const faiss::IndexIDMap *>(index)) {
+    // IndexIDMap only translates the top-level selector, not the ones nested
+    // in the parameters of a wrapped index, so translate it here.
+    if (selector) {
+      chain.selectors.push_back(std::make_unique<faiss::IDSelectorTranslated>(
+          idmap->id_map, selector));
+      selector = chain.selectors.back().get();
+    }
+    return make_search_params(idmap->index, knobs, selector, chain);
+  }
+
+  std::unique_ptr<faiss::SearchParameters> params;
+  if (auto *refine = dynamic_cast<const faiss::IndexRefine *>(index)) {
+    auto refine_params =
+        std::make_unique<faiss::IndexRefineSearchParameters>();
+    refine_params->k_factor =
+        knobs.k_factor > 0 ? knobs.k_factor : refine->k_factor;
+    // The base index does the filtering; refinement only re-ranks its hits.
+    refine_params->base_index_params =
+        make_search_params(refine->base_index, knobs, selector, chain);
+    chain.params.push_back(std::move(refine_params));
+    return chain.params.back().get();
+  }
+
+  if (auto *hnsw = dynamic_cast<const faiss::IndexHNSW *>(index)) {
+    auto hnsw_params = std::make_unique<faiss::SearchParametersHNSW>();
+    hnsw_params->efSearch = knobs.ef_search > 0
+                                ? static_cast<int>(knobs.ef_search)
+                                : hnsw->hnsw.efSearch;
+    params = std::move(hnsw_params);
+  } else if (auto *ivf = dynamic_cast<const faiss::IndexIVF *>(index)) {
+    auto ivf_params = std::make_unique<faiss::SearchParametersIVF>();
+    ivf_params->nprobe = knobs.nprobe > 0 ? knobs.nprobe : ivf->nprobe;
+    ivf_params->max_codes = ivf->max_codes;
+    params = std::move(ivf_params);
+  } else if (selector) {
+    params = std::make_unique<faiss::SearchParameters>();
+  } else {
+    return nullptr;
+  }
+  params->sel = selector;
+  chain.params.push_back(std::move(params));
+  return chain.params.back().get();
+}
+
+} // namespace
+
+FaissIndexInner::FaissIndexInner(std::unique_ptr<faiss::Index> index,
+                                 bool read_only)
+    : index_(std::move(index)), read_only_(read_only) {
   if (!index_) {
     throw std::runtime_error("FaissIndexInner: null index provided");
   }
 }
 
+void FaissIndexInner::ensure_writable(const char *operation) const {
+  if (read_only_) {
+    throw std::runtime_error(std::string(operation) +
+                             ": index is memory-mapped read-only");
+  }
+}
+
 bool FaissIndexInner::is_trained() const { return index_->is_trained; }
 
+bool FaissIndexInner::is_read_only() const { return read_only_; }
+
 int64_t FaissIndexInner::get_ntotal() const { return index_->ntotal; }
 
 int32_t FaissIndexInner::get_dimension() const {
@@ -34,6 +124,7 @@ void FaissIndexInner::train_index(rust::Slice<const float> training_vectors,
                                   size_t num_training_vectors) {
   if (index_->is_trained)
     return; // skip training
+  ensure_writable("train_index");
   index_->train(static_cast<faiss::idx_t>(num_training_vectors),
                 training_vectors.data());
 }
@@ -41,6 +132,7 @@ void FaissIndexInner::train_index(rust::Slice<const float> training_vectors,
 void FaissIndexInner::add_vectors_with_ids(rust::Slice<const float> vectors,
                                            size_t num_vectors,
                                            rust::Slice<const int64_t> ids) {
+  ensure_writable("add_vectors_with_ids");
   std::vector<faiss::idx_t> faiss_ids(ids.begin(), ids.end());
   index_->add_with_ids(static_cast<faiss::idx_t>(num_vectors), vectors.data(),
                        faiss_ids.data());
@@ -72,29 +164,127 @@ FaissIndexInner::search_vectors(rust::Slice<const float> query_vectors,
                                 std::move(rust_indexes)};
 }
 
-rust::Vec<float>
-FaissIndexInner::get_by_ids(rust::Slice<const int64_t> ids) const {
-  if (ids.empty()) {
-    return rust::Vec<float>();
+void FaissIndexInner::search_with_params(
+    rust::Slice<const float> query_vectors, size_t k,
+    rust::Slice<float> distances, rust::Slice<int64_t> indexes,
+    const FaissSearchParams &params, faiss::IDSelector *selector) const {
+  static_assert(std::is_same_v<faiss::idx_t, int64_t>,
+                "faiss::idx_t must be int64_t to share the label buffer");
+
+  faiss::idx_t num_queries = query_vectors.size() / index_->d;
+  size_t expected_len = static_cast<size_t>(num_queries) * k;
+  if (distances.size() != expected_len || indexes.size() != expected_len) {
+    throw std::runtime_error(
+        "search: output buffers must hold num_queries * k "
+        "elements");
   }
 
-  try {
-    size_t num_ids = ids.size();
-    size_t dimension = index_->d;
-    std::vector<float> reconstructed_vectors(num_ids * dimension);
+  SearchParamsChain chain;
+  faiss::SearchParameters *search_params =
+      make_search_params(index_.get(), params, selector, chain);
+  index_->search(num_queries, query_vectors.data(),
+                 static_cast<faiss::idx_t>(k), distances.data(),
+                 indexes.data(), search_params);
+}
+
+void FaissIndexInner::search_vectors_into(
+    rust::Slice<const float> query_vectors, size_t k,
+    rust::Slice<float> distances, rust::Slice<int64_t> indexes,
+    const FaissSearchParams &params) const {
+  search_with_params(query_vectors, k, distances, indexes, params, nullptr);
+}
+
+void FaissIndexInner::search_vectors_with_bitmap(
+    rust::Slice<const float> query_vectors, size_t k,
+    rust::Slice<const uint8_t> id_bitmap, rust::Slice<float> distances,
+    rust::Slice<int64_t> indexes, const FaissSearchParams &params) const {
+  faiss::IDSelectorBitmap selector(id_bitmap.size(), id_bitmap.data());
+  search_with_params(query_vectors, k, distances, indexes, params, &selector);
+}
+
+void FaissIndexInner::search_vectors_with_ids(
+    rust::Slice<const float> query_vectors, size_t k,
+    rust::Slice<const int64_t> ids, rust::Slice<float> distances,
+    rust::Slice<int64_t> indexes, const FaissSearchParams &params) const {
+  faiss::IDSelectorBatch selector(ids.size(), ids.data());
+  search_with_params(query_vectors, k, distances, indexes, params, &selector);
+}
+
+FaissIndexRangeSearchResult
+FaissIndexInner::range_search_vectors(rust::Slice<const float> query_vectors,
+                                      float radius) const {
+  faiss::idx_t num_queries = query_vectors.size() / index_->d;
+  faiss::RangeSearchResult result(num_queries);
+
+  index_->range_search(num_queries, query_vectors.data(), radius, &result);
+
+  size_t num_results = result.lims[num_queries];
+
+  rust::Vec<size_t> rust_lims;
+  rust_lims.reserve(num_queries + 1);
+  std::copy(result.lims, result.lims + num_queries + 1,
+            std::back_inserter(rust_lims));
+
+  rust::Vec<int64_t> rust_labels;
+  rust_labels.reserve(num_results);
+  std::copy(result.labels, result.labels + num_results,
+            std::back_inserter(rust_labels));
+
+  rust::Vec<float> rust_distances;
+  rust_distances.reserve(num_results);
+  std::copy(result.distances, result.distances + num_results,
+            std::back_inserter(rust_distances));
 
-    for (size_t i = 0; i < num_ids; ++i) {
-      faiss::idx_t current_id = static_cast<faiss::idx_t>(ids[i]);
-      float *destination = reconstructed_vectors.data() + (i * dimension);
-      index_->reconstruct(current_id, destination);
+  return FaissIndexRangeSearchResult{std::move(rust_lims),
+                                     std::move(rust_labels),
+                                     std::move(rust_distances)};
+}
+
+void FaissIndexInner::get_by_ids_into(rust::Slice<const int64_t> ids,
+                                      rust::Slice<float> out) const {
+  size_t dimension = index_->d;
+  if (out.size() != ids.size() * dimension) {
+    throw std::runtime_error(
+        "get_by_ids: output buffer must hold num_ids * dimension elements");
+  }
+  if (ids.empty()) {
+    return;
+  }
+
+  const faiss::Index *index = index_.get();
+  std::vector<faiss::idx_t> keys(ids.begin(), ids.end());
+
+  // Resolve IDMap2 ids up front so that flat storage can be copied directly
+  if (auto *idmap = dynamic_cast<const faiss::IndexIDMap2 *>(index)) {
+    for (faiss::idx_t &key : keys) {
+      auto it = idmap->rev_map.find(key);
+      if (it == idmap->rev_map.end()) {
+        throw std::runtime_error("get_by_ids: unknown id " +
+                                 std::to_string(key));
+      }
+      key = it->second;
     }
+    index = idmap->index;
+  }
 
-    rust::Vec<float> result;
-    result.reserve(reconstructed_vectors.size());
-    std::copy(reconstructed_vectors.begin(), reconstructed_vectors.end(),
-              std::back_inserter(result));
+  if (auto *flat = dynamic_cast<const faiss::IndexFlat *>(index)) {
+    // Rows are contiguous floats; a strided memcpy skips the per-id virtual
+    // reconstruct call and the decode step.
+    const float *xb = flat->get_xb();
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] < 0 || keys[i] >= flat->ntotal) {
+        throw std::runtime_error("get_by_ids: id out of range");
+      }
+      std::memcpy(out.data() + i * dimension, xb + keys[i] * dimension,
+                  dimension * sizeof(float));
+    }
+    return;
+  }
 
-    return result;
+  try {
+    // faiss spreads large batches across its OpenMP threads
+    index->reconstruct_batch(static_cast<faiss::idx_t>(keys.size()),
+                             keys.data(), out.data());
   } catch (const std::exception &e) {
     throw std::runtime_error("FAISS reconstruct failed: " +
                              std::string(e.what()));
@@ -105,6 +295,7 @@ size_t FaissIndexInner::remove_vectors(rust::Slice<const int64_t> ids) {
   if (ids.empty()) {
     return 0;
   }
+  ensure_writable("remove_vectors");
 
   try {
     faiss::IDSelectorBatch selector(ids.size(), ids.data());
@@ -119,6 +310,7 @@ size_t FaissIndexInner::remove_vectors(rust::Slice<const int64_t> ids) {
 }
 
 void FaissIndexInner::clear() {
+  ensure_writable("clear");
   try {
     if (index_->ntotal > 0) {
       faiss::IDSelectorAll all_selector;
@@ -160,6 +352,136 @@ void FaissIndexInner::write_index(rust::Str filename) const {
   }
 }
 
+rust::Vec<uint8_t> FaissIndexInner::serialize() const {
+  try {
+    faiss::VectorIOWriter writer;
+    faiss::write_index(index_.get(), &writer);
+
+    rust::Vec<uint8_t> bytes;
+    bytes.reserve(writer.data.size());
+    std::copy(writer.data.begin(), writer.data.end(),
+              std::back_inserter(bytes));
+    return bytes;
+  } catch (const std::exception &e) {
+    throw std::runtime_error("Failed to serialize index: " +
+                             std::string(e.what()));
+  }
+}
+
+FaissBinaryIndexInner::FaissBinaryIndexInner(
+    std::unique_ptr<faiss::IndexBinary> index)
+    : index_(std::move(index)) {
+  if (!index_) {
+    throw std::runtime_error("FaissBinaryIndexInner: null index provided");
+  }
+}
+
+bool FaissBinaryIndexInner::is_trained() const { return index_->is_trained; }
+
+int64_t FaissBinaryIndexInner::get_ntotal() const { return index_->ntotal; }
+
+int32_t FaissBinaryIndexInner::get_dimension() const {
+  return static_cast<int32_t>(index_->d);
+}
+
+void FaissBinaryIndexInner::train_index(
+    rust::Slice<const uint8_t> training_codes, size_t num_training_codes) {
+  if (index_->is_trained)
+    return; // skip training
+  if (training_codes.size() != num_training_codes * index_->code_size) {
+    throw std::runtime_error("train_index: codes must hold num_codes * "
+                             "code_size bytes");
+  }
+  index_->train(static_cast<faiss::idx_t>(num_training_codes),
+                training_codes.data());
+}
+
+void FaissBinaryIndexInner::add_codes_with_ids(
+    rust::Slice<const uint8_t> codes, size_t num_codes,
+    rust::Slice<const int64_t> ids) {
+  if (codes.size() != num_codes * index_->code_size ||
+      ids.size() != num_codes) {
+    throw std::runtime_error("add_codes_with_ids: codes and ids must hold "
+                             "num_codes entries");
+  }
+  std::vector<faiss::idx_t> faiss_ids(ids.begin(), ids.end());
+  index_->add_with_ids(static_cast<faiss::idx_t>(num_codes), codes.data(),
+                       faiss_ids.data());
+}
+
+FaissBinaryIndexSearchResult
+FaissBinaryIndexInner::search_codes(rust::Slice<const uint8_t> codes,
+                                    size_t k) const {
+  faiss::idx_t num_queries = codes.size() / index_->code_size;
+  std::vector<int32_t> distances_vec(num_queries * k);
+  std::vector<faiss::idx_t> indexes_vec(num_queries * k);
+
+  if (num_queries > 0 && k > 0) {
+    index_->search(num_queries, codes.data(), static_cast<faiss::idx_t>(k),
+                   distances_vec.data(), indexes_vec.data());
+  }
+
+  rust::Vec<int32_t> rust_distances;
+  rust_distances.reserve(distances_vec.size());
+  std::copy(distances_vec.begin(), distances_vec.end(),
+            std::back_inserter(rust_distances));
+
+  rust::Vec<int64_t> rust_indexes;
+  rust_indexes.reserve(indexes_vec.size());
+  std::copy(indexes_vec.begin(), indexes_vec.end(),
+            std::back_inserter(rust_indexes));
+
+  return FaissBinaryIndexSearchResult{std::move(rust_distances),
+                                      std::move(rust_indexes)};
+}
+
+size_t FaissBinaryIndexInner::remove_codes(rust::Slice<const int64_t> ids) {
+  if (ids.empty()) {
+    return 0;
+  }
+  try {
+    faiss::IDSelectorBatch selector(ids.size(), ids.data());
+    return index_->remove_ids(selector);
+  } catch (const std::exception &e) {
+    throw std::runtime_error("Failed to remove codes: " +
+                             std::string(e.what()));
+  }
+}
+
+void FaissBinaryIndexInner::clear() {
+  try {
+    if (index_->ntotal > 0) {
+      faiss::IDSelectorAll all_selector;
+      index_->remove_ids(all_selector);
+    }
+  } catch (const std::exception &e) {
+    // call faiss::IndexBinary::reset() if index doesn't support remove_ids()
+    try {
+      index_->reset();
+    } catch (const std::exception &reset_error) {
+      throw std::runtime_error(
+          "Failed to clear binary index: " + std::string(e.what()) +
+          ". Reset also failed: " + std::string(reset_error.what()));
+    }
+  }
+}
+
+rust::Vec<uint8_t> FaissBinaryIndexInner::serialize() const {
+  try {
+    faiss::VectorIOWriter writer;
+    faiss::write_index_binary(index_.get(), &writer);
+
+    rust::Vec<uint8_t> bytes;
+    bytes.reserve(writer.data.size());
+    std::copy(writer.data.begin(), writer.data.end(),
+              std::back_inserter(bytes));
+    return bytes;
+  } catch (const std::exception &e) {
+    throw std::runtime_error("Failed to serialize binary index: " +
+                             std::string(e.what()));
+  }
+}
+
 std::unique_ptr<FaissIndexInner>
 create_index(int32_t dimension, rust::Str description, FaissMetricType metric) {
   try {
@@ -168,6 +490,7 @@ create_index(int32_t dimension, rust::Str description, FaissMetricType metric) {
     std::string desc_str(description);
     auto faiss_index = std::unique_ptr<faiss::Index>(
         faiss::index_factory(dimension, desc_str.c_str(), faiss_metric));
+    enable_id_lookup(faiss_index.get());
 
     return std::make_unique<FaissIndexInner>(std::move(faiss_index));
   } catch (const std::exception &e) {
@@ -176,7 +499,7 @@ create_index(int32_t dimension, rust::Str description, FaissMetricType metric) {
   }
 }
 
-std::unique_ptr<FaissIndexInner> read_index(rust::Str filename) {
+std::unique_ptr<FaissIndexInner> read_index(rust::Str filename, bool mmap) {
   try {
     std::string filename_str(filename);
 
@@ -184,21 +507,25 @@ std::unique_ptr<FaissIndexInner> read_index(rust::Str filename) {
       throw std::runtime_error("File does not exist: " + filename_str);
     }
 
-    std::ifstream file_check(filename_str, std::ios::binary);
-    if (!file_check.is_open()) {
-      throw std::runtime_error("Cannot open file for reading: " + filename_str);
+    int io_flags = 0;
+    if (mmap) {
+      io_flags = faiss::IO_FLAG_MMAP | faiss::IO_FLAG_READ_ONLY;
+#if FAISS_VERSION_MAJOR > 1 ||                                                 \
+    (FAISS_VERSION_MAJOR == 1 && FAISS_VERSION_MINOR >= 11)
+      // Also map the codes of flat indexes, not only IVF inverted lists
+      io_flags |= faiss::IO_FLAG_MMAP_IFC;
+#endif
     }
-    file_check.close();
 
     std::unique_ptr<faiss::Index> loaded_index(
-        faiss::read_index(filename_str.c_str()));
+        faiss::read_index(filename_str.c_str(), io_flags));
 
     if (!loaded_index) {
       throw std::runtime_error(
           "Failed to load index: read_index returned null");
     }
 
-    return std::make_unique<FaissIndexInner>(std::move(loaded_index));
+    return std::make_unique<FaissIndexInner>(std::move(loaded_index), mmap);
 
   } catch (const std::exception &e) {
     throw std::runtime_error("Failed to read index from file '" +
@@ -206,4 +533,71 @@ std::unique_ptr<FaissIndexInner> read_index(rust::Str filename) {
   }
 }
 
+std::unique_ptr<FaissIndexInner>
+deserialize_index(rust::Slice<const uint8_t> bytes) {
+  try {
+    faiss::VectorIOReader reader;
+    reader.data.assign(bytes.begin(), bytes.end());
+
+    std::unique_ptr<faiss::Index> loaded_index(faiss::read_index(&reader));
+    if (!loaded_index) {
+      throw std::runtime_error("read_index returned null");
+    }
+
+    return std::make_unique<FaissIndexInner>(std::move(loaded_index));
+  } catch (const std::exception &e) {
+    throw std::runtime_error("Failed to deserialize index: " +
+                             std::string(e.what()));
+  }
+}
+
+std::unique_ptr<FaissBinaryIndexInner>
+create_binary_index(int32_t dimension, rust::Str description) {
+  try {
+    std::string desc_str(description);
+    // index_binary_factory has no IDMap2 prefix; wrap the index here
+    const std::string id_map_prefix = "IDMap2,";
+    bool id_map = desc_str.rfind(id_map_prefix, 0) == 0;
+    if (id_map) {
+      desc_str = desc_str.substr(id_map_prefix.size());
+    }
+
+    std::unique_ptr<faiss::IndexBinary> index(
+        faiss::index_binary_factory(dimension, desc_str.c_str()));
+    if (auto *ivf = dynamic_cast<faiss::IndexBinaryIVF *>(index.get())) {
+      ivf->set_direct_map_type(faiss::DirectMap::Hashtable);
+    }
+    if (id_map) {
+      auto wrapped = std::make_unique<faiss::IndexBinaryIDMap2>(index.get());
+      wrapped->own_fields = true;
+      index.release();
+      index = std::move(wrapped);
+    }
+
+    return std::make_unique<FaissBinaryIndexInner>(std::move(index));
+  } catch (const std::exception &e) {
+    throw std::runtime_error("Failed to create FAISS binary index: " +
+                             std::string(e.what()));
+  }
+}
+
+std::unique_ptr<FaissBinaryIndexInner>
+deserialize_binary_index(rust::Slice<const uint8_t> bytes) {
+  try {
+    faiss::VectorIOReader reader;
+    reader.data.assign(bytes.begin(), bytes.end());
+
+    std::unique_ptr<faiss::IndexBinary> loaded_index(
+        faiss::read_index_binary(&reader));
+    if (!loaded_index) {
+      throw std::runtime_error("read_index_binary returned null");
+    }
+
+    return std::make_unique<FaissBinaryIndexInner>(std::move(loaded_index));
+  } catch (const std::exception &e) {
+    throw std::runtime_error("Failed to deserialize binary index: " +
+                             std::string(e.what()));
+  }
+}
+
 } // namespace faiss_bridge
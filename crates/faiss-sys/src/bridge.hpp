@@ -5,6 +5,7 @@
 #include <vector>
 
 #include <faiss/Index.h>
+#include <faiss/IndexBinary.h>
 #include <faiss/MetricType.h>
 #include <faiss/index_factory.h>
 #include <rust/cxx.h>
@@ -14,13 +15,27 @@ namespace faiss_bridge {
 // Forward Declaration for cxx_bridge.rs.h
 enum class FaissMetricType : uint8_t;
 struct FaissIndexSearchResult;
+struct FaissIndexRangeSearchResult;
+struct FaissSearchParams;
+struct FaissBinaryIndexSearchResult;
 
 class FaissIndexInner {
 private:
   std::unique_ptr<faiss::Index> index_;
+  // Set when the index data is memory-mapped read-only; writes would fault.
+  bool read_only_;
+
+  void ensure_writable(const char *operation) const;
+
+  void search_with_params(rust::Slice<const float> query_vectors, size_t k,
+                          rust::Slice<float> distances,
+                          rust::Slice<int64_t> indexes,
+                          const FaissSearchParams &params,
+                          faiss::IDSelector *selector) const;
 
 public:
-  explicit FaissIndexInner(std::unique_ptr<faiss::Index> index);
+  explicit FaissIndexInner(std::unique_ptr<faiss::Index> index,
+                           bool read_only = false);
   ~FaissIndexInner() = default;
 
   // No copy constructors
@@ -32,6 +47,7 @@ public:
   FaissIndexInner &operator=(FaissIndexInner &&) = default;
 
   bool is_trained() const;
+  bool is_read_only() const;
   int64_t get_ntotal() const;
   int32_t get_dimension() const;
   FaissMetricType get_metric_type() const;
@@ -40,13 +56,47 @@ public:
                             size_t num_vectors, rust::Slice<const int64_t> ids);
   FaissIndexSearchResult search_vectors(rust::Slice<const float> query_vectors,
                                         size_t k) const;
+
+  // Writes the results straight into caller-provided buffers, each of which
+  // must hold exactly (num_queries * k) elements. Non-zero fields of `params`
+  // override nprobe (IVF), efSearch (HNSW) and k_factor (refine) of the index
+  // for this call only.
+  void search_vectors_into(rust::Slice<const float> query_vectors, size_t k,
+                           rust::Slice<float> distances,
+                           rust::Slice<int64_t> indexes,
+                           const FaissSearchParams &params) const;
+
+  // Same as search_vectors_into, but only ids whose bit is set in `id_bitmap`
+  // (bit `id % 8` of byte `id / 8`) are considered.
+  void search_vectors_with_bitmap(rust::Slice<const float> query_vectors,
+                                  size_t k,
+                                  rust::Slice<const uint8_t> id_bitmap,
+                                  rust::Slice<float> distances,
+                                  rust::Slice<int64_t> indexes,
+                                  const FaissSearchParams &params) const;
+
+  // Same as search_vectors_into, but only the given ids are considered.
+  void search_vectors_with_ids(rust::Slice<const float> query_vectors,
+                               size_t k, rust::Slice<const int64_t> ids,
+                               rust::Slice<float> distances,
+                               rust::Slice<int64_t> indexes,
+                               const FaissSearchParams &params) const;
+
+  // Returns every vector within `radius` of each query, in CSR layout: hits of
+  // query i are at [lims[i], lims[i + 1]) of labels and distances. The radius
+  // is compared with the index metric (squared distance for L2).
+  FaissIndexRangeSearchResult
+  range_search_vectors(rust::Slice<const float> query_vectors,
+                       float radius) const;
+
   void train_index(rust::Slice<const float> training_vectors,
                    size_t num_training_vectors);
   rust::Vec<float> get_by_id(int64_t id) const;
 
-  // assume that for every id, there is a vector corresponding to that id.
-  // This should be guaranteed before call this function.
-  rust::Vec<float> get_by_ids(rust::Slice<const int64_t> ids) const;
+  // Reconstructs the vectors of `ids` straight into `out`, which must hold
+  // exactly (ids.size() * dimension) elements. Throws on an unknown id.
+  void get_by_ids_into(rust::Slice<const int64_t> ids,
+                       rust::Slice<float> out) const;
 
   // assume that for every id, there is a vector corresponding to that id.
   // This should be guaranteed before call this function.
@@ -54,12 +104,72 @@ public:
   void clear();
 
   void write_index(rust::Str filename) const;
+
+  // Serializes the index in the same format as write_index, without touching
+  // the filesystem.
+  rust::Vec<uint8_t> serialize() const;
+};
+
+// Wraps faiss::IndexBinary, whose vectors are packed bits compared by Hamming
+// distance. Dimensions are in bits and every code is dimension / 8 bytes.
+class FaissBinaryIndexInner {
+private:
+  std::unique_ptr<faiss::IndexBinary> index_;
+
+public:
+  explicit FaissBinaryIndexInner(std::unique_ptr<faiss::IndexBinary> index);
+  ~FaissBinaryIndexInner() = default;
+
+  // No copy constructors
+  FaissBinaryIndexInner(const FaissBinaryIndexInner &) = delete;
+  FaissBinaryIndexInner &operator=(const FaissBinaryIndexInner &) = delete;
+
+  // Move constructors
+  FaissBinaryIndexInner(FaissBinaryIndexInner &&) = default;
+  FaissBinaryIndexInner &operator=(FaissBinaryIndexInner &&) = default;
+
+  bool is_trained() const;
+  int64_t get_ntotal() const;
+  int32_t get_dimension() const;
+
+  void train_index(rust::Slice<const uint8_t> training_codes,
+                   size_t num_training_codes);
+  void add_codes_with_ids(rust::Slice<const uint8_t> codes, size_t num_codes,
+                          rust::Slice<const int64_t> ids);
+
+  // Returns the `k` nearest codes of each query, row by row, with their
+  // Hamming distances. Missing neighbors have an index of -1.
+  FaissBinaryIndexSearchResult search_codes(rust::Slice<const uint8_t> codes,
+                                            size_t k) const;
+
+  size_t remove_codes(rust::Slice<const int64_t> ids);
+  void clear();
+
+  // Serializes the index in the format of faiss::write_index_binary.
+  rust::Vec<uint8_t> serialize() const;
 };
 
 // FaissIndexInner factory
 std::unique_ptr<FaissIndexInner>
 create_index(int32_t dimension, rust::Str description, FaissMetricType metric);
 
-std::unique_ptr<FaissIndexInner> read_index(rust::Str filename);
+// With `mmap`, the index data is memory-mapped read-only instead of being
+// copied to the heap, so processes opening the same file share its page cache.
+// The returned index rejects add/remove/train/clear.
+std::unique_ptr<FaissIndexInner> read_index(rust::Str filename, bool mmap);
+
+// Inverse of FaissIndexInner::serialize.
+std::unique_ptr<FaissIndexInner>
+deserialize_index(rust::Slice<const uint8_t> bytes);
+
+// FaissBinaryIndexInner factory. `description` is a binary index factory
+// string ("BFlat", "BIVF1024", "BHNSW32", ...), optionally prefixed with
+// "IDMap2," to keep caller-assigned ids for indexes that have none.
+std::unique_ptr<FaissBinaryIndexInner>
+create_binary_index(int32_t dimension, rust::Str description);
+
+// Inverse of FaissBinaryIndexInner::serialize.
+std::unique_ptr<FaissBinaryIndexInner>
+deserialize_binary_index(rust::Slice<const uint8_t> bytes);
 
 } // namespace faiss_bridge
@@ -30,6 +30,34 @@ mod ffi {
         pub indexes: Vec<i64>,
     }
 
+    /// Hits of query `i` are `labels[lims[i]..lims[i + 1]]` with the matching
+    /// `distances`, in no particular order.
+    #[derive(Debug, Clone)]
+    struct FaissIndexRangeSearchResult {
+        pub lims: Vec<usize>,
+        pub labels: Vec<i64>,
+        pub distances: Vec<f32>,
+    }
+
+    /// `k` Hamming nearest neighbors of every query, row by row.
+    #[derive(Debug, Clone)]
+    struct FaissBinaryIndexSearchResult {
+        pub distances: Vec<i32>,
+        pub indexes: Vec<i64>,
+    }
+
+    /// Per-call search knobs. Zero keeps the setting the index was built with;
+    /// knobs that don't apply to the index type are ignored.
+    #[derive(Debug, Clone, Copy, Default, PartialEq)]
+    struct FaissSearchParams {
+        /// Number of inverted lists probed by IVF indexes.
+        pub nprobe: usize,
+        /// Candidate list size of HNSW indexes.
+        pub ef_search: usize,
+        /// Refine indexes re-rank `k * k_factor` candidates of the base index.
+        pub k_factor: f32,
+    }
+
     unsafe extern "C++" {
         include!("ailoy-faiss-sys/src/bridge.hpp");
 
@@ -42,10 +70,13 @@ mod ffi {
             metric: FaissMetricType,
         ) -> Result<UniquePtr<FaissIndexInner>>;
 
-        unsafe fn read_index(filename: &str) -> Result<UniquePtr<FaissIndexInner>>;
+        unsafe fn read_index(filename: &str, mmap: bool) -> Result<UniquePtr<FaissIndexInner>>;
+
+        unsafe fn deserialize_index(bytes: &[u8]) -> Result<UniquePtr<FaissIndexInner>>;
 
         // Methods
         fn is_trained(self: &FaissIndexInner) -> bool;
+        fn is_read_only(self: &FaissIndexInner) -> bool;
         fn get_ntotal(self: &FaissIndexInner) -> i64;
         fn get_dimension(self: &FaissIndexInner) -> i32;
         fn get_metric_type(self: &FaissIndexInner) -> FaissMetricType;
@@ -69,13 +100,97 @@ mod ffi {
             k: usize,
         ) -> Result<FaissIndexSearchResult>;
 
-        unsafe fn get_by_ids(self: &FaissIndexInner, ids: &[i64]) -> Result<Vec<f32>>;
+        unsafe fn search_vectors_into(
+            self: &FaissIndexInner,
+            query_vectors: &[f32],
+            k: usize,
+            distances: &mut [f32],
+            indexes: &mut [i64],
+            params: &FaissSearchParams,
+        ) -> Result<()>;
+
+        unsafe fn search_vectors_with_bitmap(
+            self: &FaissIndexInner,
+            query_vectors: &[f32],
+            k: usize,
+            id_bitmap: &[u8],
+            distances: &mut [f32],
+            indexes: &mut [i64],
+            params: &FaissSearchParams,
+        ) -> Result<()>;
+
+        unsafe fn search_vectors_with_ids(
+            self: &FaissIndexInner,
+            query_vectors: &[f32],
+            k: usize,
+            ids: &[i64],
+            distances: &mut [f32],
+            indexes: &mut [i64],
+            params: &FaissSearchParams,
+        ) -> Result<()>;
+
+        unsafe fn range_search_vectors(
+            self: &FaissIndexInner,
+            query_vectors: &[f32],
+            radius: f32,
+        ) -> Result<FaissIndexRangeSearchResult>;
+
+        unsafe fn get_by_ids_into(
+            self: &FaissIndexInner,
+            ids: &[i64],
+            out: &mut [f32],
+        ) -> Result<()>;
 
         unsafe fn remove_vectors(self: Pin<&mut FaissIndexInner>, ids: &[i64]) -> Result<usize>;
 
         unsafe fn clear(self: Pin<&mut FaissIndexInner>) -> Result<()>;
 
         unsafe fn write_index(self: &FaissIndexInner, filename: &str) -> Result<()>;
+
+        unsafe fn serialize(self: &FaissIndexInner) -> Result<Vec<u8>>;
+
+        type FaissBinaryIndexInner;
+
+        unsafe fn create_binary_index(
+            dimension: i32,
+            description: &str,
+        ) -> Result<UniquePtr<FaissBinaryIndexInner>>;
+
+        unsafe fn deserialize_binary_index(
+            bytes: &[u8],
+        ) -> Result<UniquePtr<FaissBinaryIndexInner>>;
+
+        fn is_trained(self: &FaissBinaryIndexInner) -> bool;
+        fn get_ntotal(self: &FaissBinaryIndexInner) -> i64;
+        fn get_dimension(self: &FaissBinaryIndexInner) -> i32;
+
+        unsafe fn train_index(
+            self: Pin<&mut FaissBinaryIndexInner>,
+            training_codes: &[u8],
+            num_training_codes: usize,
+        ) -> Result<()>;
+
+        unsafe fn add_codes_with_ids(
+            self: Pin<&mut FaissBinaryIndexInner>,
+            codes: &[u8],
+            num_codes: usize,
+            ids: &[i64],
+        ) -> Result<()>;
+
+        unsafe fn search_codes(
+            self: &FaissBinaryIndexInner,
+            codes: &[u8],
+            k: usize,
+        ) -> Result<FaissBinaryIndexSearchResult>;
+
+        unsafe fn remove_codes(
+            self: Pin<&mut FaissBinaryIndexInner>,
+            ids: &[i64],
+        ) -> Result<usize>;
+
+        unsafe fn clear(self: Pin<&mut FaissBinaryIndexInner>) -> Result<()>;
+
+        unsafe fn serialize(self: &FaissBinaryIndexInner) -> Result<Vec<u8>>;
     }
 }
 
@@ -126,6 +241,10 @@ mod lib {
     unsafe impl Send for FaissIndexInner {}
 
     unsafe impl Sync for FaissIndexInner {}
+
+    unsafe impl Send for FaissBinaryIndexInner {}
+
+    unsafe impl Sync for FaissBinaryIndexInner {}
 }
 
 #[cfg(not(target_arch = "wasm32"))]
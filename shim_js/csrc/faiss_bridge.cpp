@@ -1,10 +1,22 @@
+#include <cstring>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
 #include <emscripten/bind.h>
 #include <emscripten/val.h>
 
+#include <faiss/IVFlib.h>
+#include <faiss/IndexBinary.h>
+#include <faiss/IndexBinaryIVF.h>
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/impl/AuxIndexStructures.h>
 #include <faiss/impl/IDSelector.h>
+#include <faiss/impl/io.h>
 #include <faiss/index_factory.h>
 #include <faiss/index_io.h>
 
@@ -12,6 +24,8 @@ using namespace emscripten;
 
 EMSCRIPTEN_DECLARE_VAL_TYPE(Float32Array);
 EMSCRIPTEN_DECLARE_VAL_TYPE(BigInt64Array);
+EMSCRIPTEN_DECLARE_VAL_TYPE(Int32Array);
+EMSCRIPTEN_DECLARE_VAL_TYPE(Uint8Array);
 
 enum class FaissMetricType : uint8_t {
   InnerProduct = 0,
@@ -40,6 +54,106 @@ struct FaissIndexSearchResult {
       : distances(distances), indexes(indexes) {}
 };
 
+// Hits of query i are at [lims[i], lims[i + 1]) of labels and distances.
+struct FaissIndexRangeSearchResult {
+  BigInt64Array lims;
+  BigInt64Array labels;
+  Float32Array distances;
+
+  FaissIndexRangeSearchResult()
+      : lims(val::global("BigInt64Array").new_()),
+        labels(val::global("BigInt64Array").new_()),
+        distances(val::global("Float32Array").new_()) {}
+
+  FaissIndexRangeSearchResult(const BigInt64Array &lims,
+                              const BigInt64Array &labels,
+                              const Float32Array &distances)
+      : lims(lims), labels(labels), distances(distances) {}
+};
+
+// `k` Hamming nearest neighbors of every query, row by row.
+struct FaissBinaryIndexSearchResult {
+  Int32Array distances;
+  BigInt64Array indexes;
+
+  FaissBinaryIndexSearchResult()
+      : distances(val::global("Int32Array").new_()),
+        indexes(val::global("BigInt64Array").new_()) {}
+
+  FaissBinaryIndexSearchResult(const Int32Array &distances,
+                               const BigInt64Array &indexes)
+      : distances(distances), indexes(indexes) {}
+};
+
+// Per-call search knobs. Zero keeps the setting the index was built with.
+struct FaissSearchParams {
+  size_t nprobe = 0;    // IVF
+  size_t ef_search = 0; // HNSW
+  float k_factor = 0;   // refine
+};
+
+namespace {
+
+// Owns the parameter objects built for one search call.
+struct SearchParamsChain {
+  std::vector<std::unique_ptr<faiss::SearchParameters>> params;
+  std::vector<std::unique_ptr<faiss::IDSelector>> selectors;
+};
+
+// Builds the SearchParameters subclass `index` expects, taking the knobs set
+// in `knobs` and the index's own settings for the rest. Returns nullptr when
+// neither knobs nor a selector apply, so the plain search path is kept.
+faiss::SearchParameters *make_search_params(const faiss::Index *index,
+                                            const FaissSearchParams &knobs,
+                                            faiss::IDSelector *selector,
+                                            SearchParamsChain &chain) {
+  if (auto *idmap = dynamic_cast<const faiss::IndexIDMap *>(index)) {
+    // IndexIDMap only translates the top-level selector, not the ones nested
+    // in the parameters of a wrapped index, so translate it here.
+    if (selector) {
+      chain.selectors.push_back(std::make_unique<faiss::IDSelectorTranslated>(
+          idmap->id_map, selector));
+      selector = chain.selectors.back().get();
+    }
+    return make_search_params(idmap->index, knobs, selector, chain);
+  }
+
+  std::unique_ptr<faiss::SearchParameters> params;
+  if (auto *refine = dynamic_cast<const faiss::IndexRefine *>(index)) {
+    auto refine_params =
+        std::make_unique<faiss::IndexRefineSearchParameters>();
+    refine_params->k_factor =
+        knobs.k_factor > 0 ? knobs.k_factor : refine->k_factor;
+    // The base index does the filtering; refinement only re-ranks its hits.
+    refine_params->base_index_params =
+        make_search_params(refine->base_index, knobs, selector, chain);
+    chain.params.push_back(std::move(refine_params));
+    return chain.params.back().get();
+  }
+
+  if (auto *hnsw = dynamic_cast<const faiss::IndexHNSW *>(index)) {
+    auto hnsw_params = std::make_unique<faiss::SearchParametersHNSW>();
+    hnsw_params->efSearch = knobs.ef_search > 0
+                                ? static_cast<int>(knobs.ef_search)
+                                : hnsw->hnsw.efSearch;
+    params = std::move(hnsw_params);
+  } else if (auto *ivf = dynamic_cast<const faiss::IndexIVF *>(index)) {
+    auto ivf_params = std::make_unique<faiss::SearchParametersIVF>();
+    ivf_params->nprobe = knobs.nprobe > 0 ? knobs.nprobe : ivf->nprobe;
+    ivf_params->max_codes = ivf->max_codes;
+    params = std::move(ivf_params);
+  } else if (selector) {
+    params = std::make_unique<faiss::SearchParameters>();
+  } else {
+    return nullptr;
+  }
+  params->sel = selector;
+  chain.params.push_back(std::move(params));
+  return chain.params.back().get();
+}
+
+} // namespace
+
 class FaissIndexInner {
 private:
   std::unique_ptr<faiss::Index> index_;
@@ -57,6 +171,12 @@ public:
     try {
       auto faiss_index = std::unique_ptr<faiss::Index>(faiss::index_factory(
           dimension, description.c_str(), faiss::MetricType(metric)));
+      // IVF indexes hold their own ids, but can only reconstruct or remove
+      // them by id through a hashtable direct map.
+      if (faiss::IndexIVF *ivf =
+              faiss::ivflib::try_extract_index_ivf(faiss_index.get())) {
+        ivf->set_direct_map_type(faiss::DirectMap::Hashtable);
+      }
       index_ = std::move(faiss_index);
     } catch (const std::exception &e) {
       throw std::runtime_error("Failed to create FAISS index: " +
@@ -108,53 +228,108 @@ public:
                          faiss_ids.data());
   }
 
-  FaissIndexSearchResult search_vectors(const val &query_vectors_js,
-                                        size_t k) const {
+  FaissIndexSearchResult search_vectors(const val &query_vectors_js, size_t k,
+                                        const FaissSearchParams &params) const {
+    return search_with_params(query_vectors_js, k, params, nullptr);
+  }
+
+  // Only ids whose bit is set in `id_bitmap_js` (a Uint8Array, bit `id % 8`
+  // of byte `id / 8`) are considered.
+  FaissIndexSearchResult
+  search_vectors_with_bitmap(const val &query_vectors_js, size_t k,
+                             const val &id_bitmap_js,
+                             const FaissSearchParams &params) const {
+    std::vector<uint8_t> id_bitmap = convertTypedArray<uint8_t>(id_bitmap_js);
+    faiss::IDSelectorBitmap selector(id_bitmap.size(), id_bitmap.data());
+    return search_with_params(query_vectors_js, k, params, &selector);
+  }
+
+  // Only the ids in `ids_js` (a BigInt64Array) are considered.
+  FaissIndexSearchResult
+  search_vectors_with_ids(const val &query_vectors_js, size_t k,
+                          const val &ids_js,
+                          const FaissSearchParams &params) const {
+    std::vector<int64_t> ids_temp = convertTypedArray<int64_t>(ids_js);
+    std::vector<faiss::idx_t> faiss_ids(ids_temp.begin(), ids_temp.end());
+    faiss::IDSelectorBatch selector(faiss_ids.size(), faiss_ids.data());
+    return search_with_params(query_vectors_js, k, params, &selector);
+  }
+
+  // Returns every vector within `radius` of each query (squared distance for
+  // L2).
+  FaissIndexRangeSearchResult range_search_vectors(const val &query_vectors_js,
+                                                   float radius) const {
     std::vector<float> query_vectors =
         convertTypedArray<float>(query_vectors_js);
 
     faiss::idx_t num_queries = query_vectors.size() / index_->d;
-    std::vector<float> distances_vec(num_queries * k);
-    std::vector<faiss::idx_t> indexes_vec(num_queries * k);
+    faiss::RangeSearchResult result(num_queries);
 
-    index_->search(num_queries, query_vectors.data(),
-                   static_cast<faiss::idx_t>(k), distances_vec.data(),
-                   indexes_vec.data());
+    index_->range_search(num_queries, query_vectors.data(), radius, &result);
 
-    // Convert to JavaScript typed arrays
-    Float32Array distances_js =
-        createTypedArray<float>(distances_vec).as<Float32Array>();
-    BigInt64Array indexes_js =
-        createTypedArray<int64_t>(indexes_vec).as<BigInt64Array>();
+    size_t num_results = result.lims[num_queries];
+    std::vector<int64_t> lims_vec(result.lims, result.lims + num_queries + 1);
+    std::vector<int64_t> labels_vec(result.labels,
+                                    result.labels + num_results);
+    std::vector<float> distances_vec(result.distances,
+                                     result.distances + num_results);
 
-    return FaissIndexSearchResult(distances_js, indexes_js);
+    return FaissIndexRangeSearchResult(
+        createTypedArray<int64_t>(lims_vec).as<BigInt64Array>(),
+        createTypedArray<int64_t>(labels_vec).as<BigInt64Array>(),
+        createTypedArray<float>(distances_vec).as<Float32Array>());
   }
 
+  // Throws on an unknown id.
   Float32Array get_by_ids(const val &ids_js) const {
-    std::vector<int64_t> ids = convertTypedArray<int64_t>(ids_js);
-
-    if (ids.empty()) {
-      return createTypedArray<float>(std::vector<float>()).as<Float32Array>();
+    std::vector<faiss::idx_t> keys = convertTypedArray<int64_t>(ids_js);
+    size_t dimension = index_->d;
+    std::vector<float> reconstructed_vectors(keys.size() * dimension);
+    if (keys.empty()) {
+      return createTypedArray<float>(reconstructed_vectors).as<Float32Array>();
     }
 
-    try {
-      size_t num_ids = ids.size();
-      size_t dimension = index_->d;
-      std::vector<float> reconstructed_vectors(num_ids * dimension);
-
-      for (size_t i = 0; i < num_ids; ++i) {
-        faiss::idx_t current_id = static_cast<faiss::idx_t>(ids[i]);
-        float *destination = reconstructed_vectors.data() + (i * dimension);
-        index_->reconstruct(current_id, destination);
+    const faiss::Index *index = index_.get();
+    // Resolve IDMap2 ids up front so that flat storage can be copied directly
+    if (auto *idmap = dynamic_cast<const faiss::IndexIDMap2 *>(index)) {
+      for (faiss::idx_t &key : keys) {
+        auto it = idmap->rev_map.find(key);
+        if (it == idmap->rev_map.end()) {
+          throw std::runtime_error("get_by_ids: unknown id " +
+                                   std::to_string(key));
+        }
+        key = it->second;
       }
+      index = idmap->index;
+    }
 
-      return createTypedArray<float>(reconstructed_vectors).as<Float32Array>();
-    } catch (const std::exception &e) {
-      throw std::runtime_error("FAISS reconstruct failed: " +
-                               std::string(e.what()));
+    if (auto *flat = dynamic_cast<const faiss::IndexFlat *>(index)) {
+      const float *xb = flat->get_xb();
+      for (size_t i = 0; i < keys.size(); ++i) {
+        if (keys[i] < 0 || keys[i] >= flat->ntotal) {
+          throw std::runtime_error("get_by_ids: id out of range");
+        }
+        std::memcpy(reconstructed_vectors.data() + i * dimension,
+                    xb + keys[i] * dimension, dimension * sizeof(float));
+      }
+    } else {
+      try {
+        index->reconstruct_batch(static_cast<faiss::idx_t>(keys.size()),
+                                 keys.data(), reconstructed_vectors.data());
+      } catch (const std::exception &e) {
+        throw std::runtime_error("FAISS reconstruct failed: " +
+                                 std::string(e.what()));
+      }
     }
+
+    // One bulk copy out of the wasm heap instead of a JS call per element
+    return val(typed_memory_view(reconstructed_vectors.size(),
+                                 reconstructed_vectors.data()))
+        .call<val>("slice")
+        .as<Float32Array>();
   }
 
+
   size_t remove_vectors(const val &ids_js) {
     std::vector<int64_t> ids = convertTypedArray<int64_t>(ids_js);
 
@@ -193,6 +368,36 @@ public:
     }
   }
 
+  // Serializes the index in the same format as faiss::write_index.
+  Uint8Array serialize() const {
+    try {
+      faiss::VectorIOWriter writer;
+      faiss::write_index(index_.get(), &writer);
+
+      // Copy out of the wasm heap, which may move on the next allocation
+      return val(typed_memory_view(writer.data.size(), writer.data.data()))
+          .call<val>("slice")
+          .as<Uint8Array>();
+    } catch (const std::exception &e) {
+      throw std::runtime_error("Failed to serialize index: " +
+                               std::string(e.what()));
+    }
+  }
+
+  // Inverse of serialize.
+  static FaissIndexInner deserialize(const val &bytes_js) {
+    try {
+      faiss::VectorIOReader reader;
+      reader.data = convertJSArrayToNumberVector<uint8_t>(bytes_js);
+
+      std::unique_ptr<faiss::Index> loaded_index(faiss::read_index(&reader));
+      return FaissIndexInner(std::move(loaded_index));
+    } catch (const std::exception &e) {
+      throw std::runtime_error("Failed to deserialize index: " +
+                               std::string(e.what()));
+    }
+  }
+
   // TODO: Handle write_index (filesystem should be determined)
   //   void write_index(const std::string &filename) const {
   //     try {
@@ -216,6 +421,33 @@ public:
   //   }
 
 private:
+  FaissIndexSearchResult
+  search_with_params(const val &query_vectors_js, size_t k,
+                     const FaissSearchParams &params,
+                     faiss::IDSelector *selector) const {
+    std::vector<float> query_vectors =
+        convertTypedArray<float>(query_vectors_js);
+
+    faiss::idx_t num_queries = query_vectors.size() / index_->d;
+    std::vector<float> distances_vec(num_queries * k);
+    std::vector<faiss::idx_t> indexes_vec(num_queries * k);
+
+    SearchParamsChain chain;
+    faiss::SearchParameters *search_params =
+        make_search_params(index_.get(), params, selector, chain);
+    index_->search(num_queries, query_vectors.data(),
+                   static_cast<faiss::idx_t>(k), distances_vec.data(),
+                   indexes_vec.data(), search_params);
+
+    // Convert to JavaScript typed arrays
+    Float32Array distances_js =
+        createTypedArray<float>(distances_vec).as<Float32Array>();
+    BigInt64Array indexes_js =
+        createTypedArray<int64_t>(indexes_vec).as<BigInt64Array>();
+
+    return FaissIndexSearchResult(distances_js, indexes_js);
+  }
+
   // Helper function to convert JavaScript typed arrays to C++ vectors
   template <typename T>
   std::vector<T> convertTypedArray(const val &js_array) const {
@@ -254,6 +486,196 @@ private:
   }
 };
 
+// Wraps faiss::IndexBinary, whose vectors are packed bits compared by Hamming
+// distance. Dimensions are in bits and every code is dimension / 8 bytes.
+class FaissBinaryIndexInner {
+private:
+  std::unique_ptr<faiss::IndexBinary> index_;
+
+public:
+  explicit FaissBinaryIndexInner(std::unique_ptr<faiss::IndexBinary> index)
+      : index_(std::move(index)) {
+    if (!index_) {
+      throw std::runtime_error("FaissBinaryIndexInner: null index provided");
+    }
+  }
+
+  // `description` is a binary index factory string ("BFlat", "BIVF1024",
+  // "BHNSW32", ...), optionally prefixed with "IDMap2," to keep
+  // caller-assigned ids for indexes that have none.
+  FaissBinaryIndexInner(int32_t dimension, const std::string &description) {
+    try {
+      // index_binary_factory has no IDMap2 prefix; wrap the index here
+      const std::string id_map_prefix = "IDMap2,";
+      bool id_map = description.rfind(id_map_prefix, 0) == 0;
+      std::string desc_str =
+          id_map ? description.substr(id_map_prefix.size()) : description;
+
+      std::unique_ptr<faiss::IndexBinary> index(
+          faiss::index_binary_factory(dimension, desc_str.c_str()));
+      if (auto *ivf = dynamic_cast<faiss::IndexBinaryIVF *>(index.get())) {
+        ivf->set_direct_map_type(faiss::DirectMap::Hashtable);
+      }
+      if (id_map) {
+        auto wrapped =
+            std::make_unique<faiss::IndexBinaryIDMap2>(index.get());
+        wrapped->own_fields = true;
+        index.release();
+        index = std::move(wrapped);
+      }
+      index_ = std::move(index);
+    } catch (const std::exception &e) {
+      throw std::runtime_error("Failed to create FAISS binary index: " +
+                               std::string(e.what()));
+    }
+  }
+
+  ~FaissBinaryIndexInner() = default;
+
+  // No copy constructors
+  FaissBinaryIndexInner(const FaissBinaryIndexInner &) = delete;
+  FaissBinaryIndexInner &operator=(const FaissBinaryIndexInner &) = delete;
+
+  // Move constructors
+  FaissBinaryIndexInner(FaissBinaryIndexInner &&) = default;
+  FaissBinaryIndexInner &operator=(FaissBinaryIndexInner &&) = default;
+
+  bool is_trained() const { return index_->is_trained; }
+
+  int64_t get_ntotal() const { return index_->ntotal; }
+
+  int32_t get_dimension() const { return static_cast<int32_t>(index_->d); }
+
+  void train_index(const val &training_codes_js, size_t num_training_codes) {
+    if (index_->is_trained)
+      return; // skip training
+
+    std::vector<uint8_t> training_codes =
+        convertJSArrayToNumberVector<uint8_t>(training_codes_js);
+    if (training_codes.size() != num_training_codes * index_->code_size) {
+      throw std::runtime_error("train_index: codes must hold num_codes * "
+                               "code_size bytes");
+    }
+    index_->train(static_cast<faiss::idx_t>(num_training_codes),
+                  training_codes.data());
+  }
+
+  void add_codes_with_ids(const val &codes_js, size_t num_codes,
+                          const val &ids_js) {
+    std::vector<uint8_t> codes =
+        convertJSArrayToNumberVector<uint8_t>(codes_js);
+    std::vector<faiss::idx_t> ids = convertIds(ids_js);
+    if (codes.size() != num_codes * index_->code_size ||
+        ids.size() != num_codes) {
+      throw std::runtime_error("add_codes_with_ids: codes and ids must hold "
+                               "num_codes entries");
+    }
+    index_->add_with_ids(static_cast<faiss::idx_t>(num_codes), codes.data(),
+                         ids.data());
+  }
+
+  // Returns the `k` nearest codes of each query, row by row, with their
+  // Hamming distances. Missing neighbors have an index of -1.
+  FaissBinaryIndexSearchResult search_codes(const val &codes_js,
+                                            size_t k) const {
+    std::vector<uint8_t> codes =
+        convertJSArrayToNumberVector<uint8_t>(codes_js);
+    faiss::idx_t num_queries = codes.size() / index_->code_size;
+    std::vector<int32_t> distances_vec(num_queries * k);
+    std::vector<faiss::idx_t> indexes_vec(num_queries * k);
+
+    if (num_queries > 0 && k > 0) {
+      index_->search(num_queries, codes.data(), static_cast<faiss::idx_t>(k),
+                     distances_vec.data(), indexes_vec.data());
+    }
+
+    val indexes_js = val::global("BigInt64Array").new_(indexes_vec.size());
+    for (size_t i = 0; i < indexes_vec.size(); ++i) {
+      indexes_js.set(i, val(static_cast<int64_t>(indexes_vec[i])));
+    }
+    return FaissBinaryIndexSearchResult(
+        val(typed_memory_view(distances_vec.size(), distances_vec.data()))
+            .call<val>("slice")
+            .as<Int32Array>(),
+        indexes_js.as<BigInt64Array>());
+  }
+
+  size_t remove_codes(const val &ids_js) {
+    std::vector<faiss::idx_t> ids = convertIds(ids_js);
+    if (ids.empty()) {
+      return 0;
+    }
+    try {
+      faiss::IDSelectorBatch selector(ids.size(), ids.data());
+      return index_->remove_ids(selector);
+    } catch (const std::exception &e) {
+      throw std::runtime_error("Failed to remove codes: " +
+                               std::string(e.what()));
+    }
+  }
+
+  void clear() {
+    try {
+      if (index_->ntotal > 0) {
+        faiss::IDSelectorAll all_selector;
+        index_->remove_ids(all_selector);
+      }
+    } catch (const std::exception &e) {
+      // call faiss::IndexBinary::reset() if index doesn't support remove_ids()
+      try {
+        index_->reset();
+      } catch (const std::exception &reset_error) {
+        throw std::runtime_error(
+            "Failed to clear binary index: " + std::string(e.what()) +
+            ". Reset also failed: " + std::string(reset_error.what()));
+      }
+    }
+  }
+
+  // Serializes the index in the same format as faiss::write_index_binary.
+  Uint8Array serialize() const {
+    try {
+      faiss::VectorIOWriter writer;
+      faiss::write_index_binary(index_.get(), &writer);
+
+      // Copy out of the wasm heap, which may move on the next allocation
+      return val(typed_memory_view(writer.data.size(), writer.data.data()))
+          .call<val>("slice")
+          .as<Uint8Array>();
+    } catch (const std::exception &e) {
+      throw std::runtime_error("Failed to serialize binary index: " +
+                               std::string(e.what()));
+    }
+  }
+
+  // Inverse of serialize.
+  static FaissBinaryIndexInner deserialize(const val &bytes_js) {
+    try {
+      faiss::VectorIOReader reader;
+      reader.data = convertJSArrayToNumberVector<uint8_t>(bytes_js);
+
+      std::unique_ptr<faiss::IndexBinary> loaded_index(
+          faiss::read_index_binary(&reader));
+      return FaissBinaryIndexInner(std::move(loaded_index));
+    } catch (const std::exception &e) {
+      throw std::runtime_error("Failed to deserialize binary index: " +
+                               std::string(e.what()));
+    }
+  }
+
+private:
+  // BigInt64Array elements have to be read one by one as BigInts
+  static std::vector<faiss::idx_t> convertIds(const val &ids_js) {
+    int length = ids_js["length"].as<int>();
+    std::vector<faiss::idx_t> ids;
+    ids.reserve(length);
+    for (int i = 0; i < length; ++i) {
+      ids.push_back(ids_js[i].as<int64_t>());
+    }
+    return ids;
+  }
+};
+
 // TODO: Handle read_index (filesystem should be determined)
 // std::unique_ptr<FaissIndexHandle> read_index(const std::string &filename) {
 //   try {
@@ -287,6 +709,8 @@ private:
 EMSCRIPTEN_BINDINGS(faiss_bridge) {
   register_type<Float32Array>("Float32Array");
   register_type<BigInt64Array>("BigInt64Array");
+  register_type<Uint8Array>("Uint8Array");
+  register_type<Int32Array>("Int32Array");
 
   // Bind the FaissMetricType enum
   enum_<FaissMetricType>("FaissMetricType")
@@ -305,6 +729,20 @@ EMSCRIPTEN_BINDINGS(faiss_bridge) {
       .field("distances", &FaissIndexSearchResult::distances)
       .field("indexes", &FaissIndexSearchResult::indexes);
 
+  value_object<FaissSearchParams>("FaissSearchParams")
+      .field("nprobe", &FaissSearchParams::nprobe)
+      .field("ef_search", &FaissSearchParams::ef_search)
+      .field("k_factor", &FaissSearchParams::k_factor);
+
+  value_object<FaissBinaryIndexSearchResult>("FaissBinaryIndexSearchResult")
+      .field("distances", &FaissBinaryIndexSearchResult::distances)
+      .field("indexes", &FaissBinaryIndexSearchResult::indexes);
+
+  value_object<FaissIndexRangeSearchResult>("FaissIndexRangeSearchResult")
+      .field("lims", &FaissIndexRangeSearchResult::lims)
+      .field("labels", &FaissIndexRangeSearchResult::labels)
+      .field("distances", &FaissIndexRangeSearchResult::distances);
+
   // Bind the main FaissIndex class
   class_<FaissIndexInner>("FaissIndexInner")
       .constructor<int32_t, const std::string &, FaissMetricType>()
@@ -315,9 +753,31 @@ EMSCRIPTEN_BINDINGS(faiss_bridge) {
       .function("train_index", &FaissIndexInner::train_index)
       .function("add_vectors_with_ids", &FaissIndexInner::add_vectors_with_ids)
       .function("search_vectors", &FaissIndexInner::search_vectors)
+      .function("search_vectors_with_bitmap",
+                &FaissIndexInner::search_vectors_with_bitmap)
+      .function("search_vectors_with_ids",
+                &FaissIndexInner::search_vectors_with_ids)
+      .function("range_search_vectors", &FaissIndexInner::range_search_vectors)
       .function("get_by_ids", &FaissIndexInner::get_by_ids)
       .function("remove_vectors", &FaissIndexInner::remove_vectors)
-      .function("clear", &FaissIndexInner::clear);
+      .function("clear", &FaissIndexInner::clear)
+      .function("serialize", &FaissIndexInner::serialize)
+      .class_function("deserialize", &FaissIndexInner::deserialize);
+
+  // Bind the binary index class
+  class_<FaissBinaryIndexInner>("FaissBinaryIndexInner")
+      .constructor<int32_t, const std::string &>()
+      .function("is_trained", &FaissBinaryIndexInner::is_trained)
+      .function("get_ntotal", &FaissBinaryIndexInner::get_ntotal)
+      .function("get_dimension", &FaissBinaryIndexInner::get_dimension)
+      .function("train_index", &FaissBinaryIndexInner::train_index)
+      .function("add_codes_with_ids",
+                &FaissBinaryIndexInner::add_codes_with_ids)
+      .function("search_codes", &FaissBinaryIndexInner::search_codes)
+      .function("remove_codes", &FaissBinaryIndexInner::remove_codes)
+      .function("clear", &FaissBinaryIndexInner::clear)
+      .function("serialize", &FaissBinaryIndexInner::serialize)
+      .class_function("deserialize", &FaissBinaryIndexInner::deserialize);
 
   // Bind factory functions
   // function("create_index", &create_index, allow_raw_pointers());
@@ -20,6 +20,23 @@ export type FaissIndexSearchResult = {
   indexes: BigInt64Array
 };
 
+export type FaissSearchParams = {
+  nprobe: number,
+  ef_search: number,
+  k_factor: number
+};
+
+export type FaissBinaryIndexSearchResult = {
+  distances: Int32Array,
+  indexes: BigInt64Array
+};
+
+export type FaissIndexRangeSearchResult = {
+  lims: BigInt64Array,
+  labels: BigInt64Array,
+  distances: Float32Array
+};
+
 export interface FaissIndexInner extends ClassHandle {
   get_metric_type(): FaissMetricType;
   clear(): void;
@@ -28,15 +45,36 @@ export interface FaissIndexInner extends ClassHandle {
   get_ntotal(): bigint;
   train_index(_0: any, _1: number): void;
   add_vectors_with_ids(_0: any, _1: number, _2: any): void;
-  search_vectors(_0: any, _1: number): FaissIndexSearchResult;
+  search_vectors(_0: any, _1: number, _2: FaissSearchParams): FaissIndexSearchResult;
+  search_vectors_with_bitmap(_0: any, _1: number, _2: any, _3: FaissSearchParams): FaissIndexSearchResult;
+  search_vectors_with_ids(_0: any, _1: number, _2: any, _3: FaissSearchParams): FaissIndexSearchResult;
+  range_search_vectors(_0: any, _1: number): FaissIndexRangeSearchResult;
   get_by_ids(_0: any): Float32Array;
   remove_vectors(_0: any): number;
+  serialize(): Uint8Array;
+}
+
+export interface FaissBinaryIndexInner extends ClassHandle {
+  clear(): void;
+  is_trained(): boolean;
+  get_dimension(): number;
+  get_ntotal(): bigint;
+  train_index(_0: any, _1: number): void;
+  add_codes_with_ids(_0: any, _1: number, _2: any): void;
+  search_codes(_0: any, _1: number): FaissBinaryIndexSearchResult;
+  remove_codes(_0: any): number;
+  serialize(): Uint8Array;
 }
 
 interface EmbindModule {
   FaissMetricType: {InnerProduct: FaissMetricTypeValue<0>, L2: FaissMetricTypeValue<1>, L1: FaissMetricTypeValue<2>, Linf: FaissMetricTypeValue<3>, Lp: FaissMetricTypeValue<4>, Canberra: FaissMetricTypeValue<20>, BrayCurtis: FaissMetricTypeValue<21>, JensenShannon: FaissMetricTypeValue<22>, Jaccard: FaissMetricTypeValue<23>};
   FaissIndexInner: {
     new(_0: number, _1: EmbindString, _2: FaissMetricType): FaissIndexInner;
+    deserialize(_0: any): FaissIndexInner;
+  };
+  FaissBinaryIndexInner: {
+    new(_0: number, _1: EmbindString): FaissBinaryIndexInner;
+    deserialize(_0: any): FaissBinaryIndexInner;
   };
 }
 
@@ -1,5 +1,12 @@
 import FaissModule from "./faiss_bridge";
-import type { FaissIndexSearchResult, FaissIndexInner } from "./faiss_bridge";
+import type {
+  FaissBinaryIndexInner,
+  FaissBinaryIndexSearchResult,
+  FaissIndexSearchResult,
+  FaissIndexRangeSearchResult,
+  FaissSearchParams,
+  FaissIndexInner,
+} from "./faiss_bridge";
 
 type FaissWASM = Awaited<ReturnType<typeof FaissModule>>;
 type FaissMetricType = FaissWASM["FaissMetricType"];
@@ -30,6 +37,39 @@ export async function create_faiss_index(
   return vectorstore;
 }
 
+export async function deserialize_faiss_index(bytes: Uint8Array) {
+  // Load Faiss WASM module
+  if (window.__faiss_module__ == undefined) {
+    window.__faiss_module__ = await FaissModule();
+  }
+  const module = window.__faiss_module__;
+
+  return module.FaissIndexInner.deserialize(bytes);
+}
+
+export async function create_faiss_binary_index(
+  dimension: number,
+  description: string
+) {
+  // Load Faiss WASM module
+  if (window.__faiss_module__ == undefined) {
+    window.__faiss_module__ = await FaissModule();
+  }
+  const module = window.__faiss_module__;
+
+  return new module.FaissBinaryIndexInner(dimension, description);
+}
+
+export async function deserialize_faiss_binary_index(bytes: Uint8Array) {
+  // Load Faiss WASM module
+  if (window.__faiss_module__ == undefined) {
+    window.__faiss_module__ = await FaissModule();
+  }
+  const module = window.__faiss_module__;
+
+  return module.FaissBinaryIndexInner.deserialize(bytes);
+}
+
 export async function get_metric_type(type: keyof FaissMetricType) {
   // Load Faiss WASM module
   if (window.__faiss_module__ == undefined) {
@@ -40,4 +80,12 @@ export async function get_metric_type(type: keyof FaissMetricType) {
   return module.FaissMetricType[type];
 }
 
-export type { FaissMetricType, FaissIndexSearchResult, FaissIndexInner };
+export type {
+  FaissBinaryIndexInner,
+  FaissBinaryIndexSearchResult,
+  FaissMetricType,
+  FaissIndexSearchResult,
+  FaissIndexRangeSearchResult,
+  FaissSearchParams,
+  FaissIndexInner,
+};
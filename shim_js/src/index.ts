@@ -1,7 +1,17 @@
-export { create_faiss_index, get_metric_type } from "./faiss";
+export {
+  create_faiss_binary_index,
+  create_faiss_index,
+  deserialize_faiss_binary_index,
+  deserialize_faiss_index,
+  get_metric_type,
+} from "./faiss";
 export type {
+  FaissBinaryIndexInner,
+  FaissBinaryIndexSearchResult,
   FaissIndexInner,
   FaissIndexSearchResult,
+  FaissIndexRangeSearchResult,
+  FaissSearchParams,
   FaissMetricType,
 } from "./faiss";
 
@@ -4,8 +4,9 @@ mod native {
 
     use anyhow::{Context, bail};
     use tokio::fs::{
-        create_dir_all as tokio_create_dir_all, read as tokio_read,
-        remove_dir_all as tokio_remove_dir, remove_file as tokio_remove_file, write as tokio_write,
+        OpenOptions, create_dir_all as tokio_create_dir_all, read as tokio_read,
+        remove_dir_all as tokio_remove_dir, remove_file as tokio_remove_file,
+        rename as tokio_rename, write as tokio_write,
     };
 
     pub async fn _exists<P: AsRef<Path>>(path: P) -> bool {
@@ -32,6 +33,62 @@ mod native {
             .context("tokio::fs::write failed")
     }
 
+    /// Writes `data` to a sibling temp file and renames it over `path`, so readers
+    /// observe either the previous or the new contents, never a partial write.
+    /// Each call gets its own temp file, so concurrent writers of one path never
+    /// interleave into the same file.
+    pub async fn write_atomic(
+        path: impl AsRef<Path>,
+        data: impl AsRef<[u8]>,
+        create_parent: bool,
+    ) -> anyhow::Result<()> {
+        let path = path.as_ref();
+        let mut tmp_name = path
+            .file_name()
+            .context("Path has no file name")?
+            .to_os_string();
+        tmp_name.push(format!(".{}.tmp", uuid::Uuid::new_v4()));
+        let tmp_path = path.with_file_name(tmp_name);
+
+        let result = async {
+            write(&tmp_path, data, create_parent).await?;
+            // Make the contents durable before the rename publishes them
+            OpenOptions::new()
+                .write(true)
+                .open(&tmp_path)
+                .await
+                .context("tokio::fs::OpenOptions::open failed")?
+                .sync_all()
+                .await
+                .context("tokio::fs::File::sync_all failed")?;
+            tokio_rename(&tmp_path, path)
+                .await
+                .context("tokio::fs::rename failed")
+        }
+        .await;
+        if result.is_err() {
+            let _ = tokio_remove_file(&tmp_path).await;
+            return result;
+        }
+
+        // The rename lives in the directory entry, which needs its own sync to
+        // survive a crash. Windows cannot open directories for syncing.
+        #[cfg(target_family = "unix")]
+        {
+            let parent_dir = match path.parent() {
+                Some(parent) if !parent.as_os_str().is_empty() => parent,
+                _ => Path::new("."),
+            };
+            tokio::fs::File::open(parent_dir)
+                .await
+                .context("tokio::fs::File::open failed")?
+                .sync_all()
+                .await
+                .context("tokio::fs::File::sync_all failed")?;
+        }
+        Ok(())
+    }
+
     pub async fn remove(path: impl AsRef<Path>) -> anyhow::Result<()> {
         if path.as_ref().is_dir() {
             tokio_remove_dir(path)
@@ -204,6 +261,16 @@ mod opfs {
         Ok(())
     }
 
+    /// OPFS writable streams write to a swap file and only replace the target on
+    /// `close()`, so a plain write is already atomic.
+    pub async fn write_atomic(
+        path: impl AsRef<Path>,
+        data: impl AsRef<[u8]>,
+        create_parent: bool,
+    ) -> anyhow::Result<()> {
+        write(path, data, create_parent).await
+    }
+
     pub async fn remove(path: impl AsRef<Path>) -> anyhow::Result<()> {
         let handle = get_dir_handle(path.as_ref(), false).await?;
 
@@ -1,13 +1,29 @@
-use std::sync::atomic::{AtomicI64, Ordering};
+use std::{
+    cell::RefCell,
+    sync::atomic::{AtomicI64, Ordering},
+};
 
 #[cfg(any(target_family = "unix", target_family = "windows"))]
-use ailoy_faiss_sys::{FaissIndexSearchResult, FaissMetricType};
-use anyhow::{Context, bail};
+pub use ailoy_faiss_sys::FaissBinaryIndexSearchResult;
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub use ailoy_faiss_sys::FaissIndexRangeSearchResult;
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub use ailoy_faiss_sys::{FaissMetricType, FaissSearchParams};
+use anyhow::bail;
 
+#[cfg(target_arch = "wasm32")]
+pub use crate::ffi::web::faiss_bridge::FaissBinaryIndexSearchResult;
+#[cfg(target_arch = "wasm32")]
+pub use crate::ffi::web::faiss_bridge::FaissIndexRangeSearchResult;
 #[cfg(target_arch = "wasm32")]
 use crate::ffi::web::faiss_bridge::{
-    FaissIndexInner, FaissIndexSearchResult, FaissMetricType, create_faiss_index,
+    FaissBinaryIndexInner, create_faiss_binary_index, deserialize_faiss_binary_index,
 };
+#[cfg(target_arch = "wasm32")]
+use crate::ffi::web::faiss_bridge::{FaissIndexInner, create_faiss_index, deserialize_faiss_index};
+#[cfg(target_arch = "wasm32")]
+pub use crate::ffi::web::faiss_bridge::{FaissMetricType, FaissSearchParams};
+use crate::value::EmbeddingBatch;
 
 #[derive(Debug)]
 pub struct FaissIndexBuilder {
@@ -41,6 +57,69 @@ impl FaissIndexBuilder {
     }
 }
 
+/// Restricts a search to a subset of ids (pushed down as a `faiss::IDSelector`).
+#[derive(Debug, Clone, Copy)]
+pub enum FaissIdSelector<'a> {
+    /// Bit `id % 8` of byte `id / 8` is set for every allowed id.
+    Bitmap(&'a [u8]),
+    /// Explicit list of allowed ids.
+    Ids(&'a [i64]),
+}
+
+/// Reusable output buffers for [`FaissIndex::search_into`].
+///
+/// Buffers are resized in place, so once an arena has served a query batch of
+/// a given shape, later batches of the same or smaller shape allocate nothing.
+#[derive(Debug, Default)]
+pub struct FaissSearchArena {
+    distances: Vec<f32>,
+    indexes: Vec<i64>,
+    k: usize,
+}
+
+#[allow(dead_code)]
+impl FaissSearchArena {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Sizes the buffers for `num_queries` rows of `k` results and returns them.
+    /// Previous contents are left in place and must be overwritten.
+    pub(crate) fn prepare(&mut self, num_queries: usize, k: usize) -> (&mut [f32], &mut [i64]) {
+        let len = num_queries * k;
+        self.distances.resize(len, f32::NAN);
+        self.indexes.resize(len, -1);
+        self.k = k;
+        (&mut self.distances, &mut self.indexes)
+    }
+
+    pub fn num_queries(&self) -> usize {
+        if self.k == 0 {
+            0
+        } else {
+            self.indexes.len() / self.k
+        }
+    }
+
+    /// Results of the `i`-th query as `(distances, indexes)`.
+    /// Missing neighbors are reported with an index of `-1`.
+    pub fn get(&self, i: usize) -> (&[f32], &[i64]) {
+        let range = i * self.k..(i + 1) * self.k;
+        (&self.distances[range.clone()], &self.indexes[range])
+    }
+
+    pub fn iter(&self) -> impl Iterator<Item = (&[f32], &[i64])> {
+        (0..self.num_queries()).map(|i| self.get(i))
+    }
+}
+
+thread_local! {
+    // Search output buffers are reused across queries on the same thread,
+    // so steady-state retrievals don't allocate on the FFI path.
+    pub(crate) static SEARCH_ARENA: RefCell<FaissSearchArena> =
+        RefCell::new(FaissSearchArena::new());
+}
+
 /// Rust wrapper of faiss::Index
 pub struct FaissIndex {
     #[cfg(any(target_family = "unix", target_family = "windows"))]
@@ -89,6 +168,18 @@ impl FaissIndex {
         self.inner().is_trained()
     }
 
+    pub fn is_read_only(&self) -> bool {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        {
+            self.inner().is_read_only()
+        }
+
+        #[cfg(target_family = "wasm")]
+        {
+            false
+        }
+    }
+
     pub fn ntotal(&self) -> i64 {
         self.inner().get_ntotal()
     }
@@ -114,212 +205,298 @@ impl FaissIndex {
         }
     }
 
-    pub fn train(&mut self, training_vectors: &[Vec<f32>]) -> anyhow::Result<()> {
+    /// Number of whole rows in the row-major `vectors`.
+    fn num_rows(&self, vectors: &[f32]) -> anyhow::Result<usize> {
+        let dimension = self.dimension() as usize;
+        if vectors.len() % dimension != 0 {
+            bail!(
+                "Cannot split {} values into vectors of dimension {}",
+                vectors.len(),
+                dimension
+            );
+        }
+        Ok(vectors.len() / dimension)
+    }
+
+    /// Trains the index on the row-major `training_vectors`.
+    pub fn train(&mut self, training_vectors: &[f32]) -> anyhow::Result<()> {
         if self.is_trained() {
             return Ok(());
         }
 
-        let flattened: Vec<f32> = training_vectors.iter().flatten().cloned().collect();
-        let num_vectors = training_vectors.len();
+        let num_vectors = self.num_rows(training_vectors)?;
 
         #[cfg(any(target_family = "unix", target_family = "windows"))]
         unsafe {
-            Ok(self.inner.pin_mut().train_index(&flattened, num_vectors)?)
+            Ok(self
+                .inner
+                .pin_mut()
+                .train_index(training_vectors, num_vectors)?)
         }
 
         #[cfg(target_family = "wasm")]
         {
-            let arr = js_sys::Float32Array::new_with_length(flattened.len() as u32);
-            for (i, &val) in flattened.iter().enumerate() {
-                arr.set_index(i as u32, val);
-            }
-            self.inner().train_index(&arr, num_vectors).unwrap();
+            let arr = js_sys::Float32Array::from(training_vectors);
+            self.inner()
+                .train_index(&arr, num_vectors)
+                .map_err(|e| anyhow::anyhow!("Failed to train index: {:?}", e))?;
             Ok(())
         }
     }
 
-    pub fn add_vector(&mut self, vector: &Vec<f32>) -> anyhow::Result<String> {
-        let ids = self.add_vectors(&[vector.clone()])?;
-        Ok(ids.first().unwrap().to_string())
+    pub fn add_vector(&mut self, vector: &[f32]) -> anyhow::Result<i64> {
+        let ids = self.add_vectors(vector)?;
+        Ok(ids[0])
     }
 
-    pub fn add_vectors(&mut self, vectors: &[Vec<f32>]) -> anyhow::Result<Vec<String>> {
-        if vectors.is_empty() {
+    /// Adds the row-major `vectors` under newly allocated ids.
+    pub fn add_vectors(&mut self, vectors: &[f32]) -> anyhow::Result<Vec<i64>> {
+        let num_vectors = self.num_rows(vectors)?;
+        if num_vectors == 0 {
             return Ok(vec![]);
         }
 
-        let flattened: Vec<f32> = vectors.iter().flatten().cloned().collect();
-        let num_vectors = vectors.len();
-
         let start_id = self.next_id.fetch_add(num_vectors as i64, Ordering::SeqCst);
         let ids: Vec<i64> = (start_id..start_id + num_vectors as i64).collect();
 
+        self.add_vectors_with_ids(vectors, &ids)?;
+
+        Ok(ids)
+    }
+
+    /// Adds vectors under ids allocated elsewhere, e.g. when moving them between
+    /// indexes. The id counter is left untouched.
+    pub fn add_vectors_with_ids(&mut self, vectors: &[f32], ids: &[i64]) -> anyhow::Result<()> {
+        let num_vectors = self.num_rows(vectors)?;
+        if num_vectors != ids.len() {
+            bail!(
+                "Number of vectors ({}) and ids ({}) differ",
+                num_vectors,
+                ids.len()
+            );
+        }
+        if num_vectors == 0 {
+            return Ok(());
+        }
+
         #[cfg(any(target_family = "unix", target_family = "windows"))]
         unsafe {
             self.inner
                 .pin_mut()
-                .add_vectors_with_ids(&flattened, num_vectors, &ids)?;
+                .add_vectors_with_ids(vectors, num_vectors, ids)?;
         }
 
         #[cfg(target_family = "wasm")]
         {
-            let vector_arr = js_sys::Float32Array::new_with_length(flattened.len() as u32);
-            for (i, &val) in flattened.iter().enumerate() {
-                vector_arr.set_index(i as u32, val);
-            }
-            let ids_arr = js_sys::BigInt64Array::new_with_length(ids.len() as u32);
-            for (i, &val) in ids.iter().enumerate() {
-                ids_arr.set_index(i as u32, val);
-            }
+            let vector_arr = js_sys::Float32Array::from(vectors);
+            let ids_arr = js_sys::BigInt64Array::from(ids);
 
             self.inner()
-                .add_vectors_with_ids(&vector_arr, ids.len(), &ids_arr)
-                .unwrap();
+                .add_vectors_with_ids(&vector_arr, num_vectors, &ids_arr)
+                .map_err(|e| anyhow::anyhow!("Failed to add vectors: {:?}", e))?;
         }
 
-        Ok(ids.into_iter().map(|id| id.to_string()).collect())
+        Ok(())
     }
 
-    pub fn search(
+    /// Searches `k` nearest neighbors of row-major `query_vectors` and writes the
+    /// results into `arena`, reusing its buffers from previous calls.
+    /// If `selector` is given, only the ids it allows are considered; `params`
+    /// overrides the index's search settings for this call only.
+    pub fn search_into(
         &self,
-        query_vectors: &[Vec<f32>],
+        query_vectors: &[f32],
         k: usize,
-    ) -> anyhow::Result<Vec<FaissIndexSearchResult>> {
-        if query_vectors.is_empty() {
-            return Ok(vec![]);
+        selector: Option<FaissIdSelector<'_>>,
+        params: &FaissSearchParams,
+        arena: &mut FaissSearchArena,
+    ) -> anyhow::Result<()> {
+        let dimension = self.dimension() as usize;
+        if query_vectors.len() % dimension != 0 {
+            bail!(
+                "Query length {} is not a multiple of the index dimension {}",
+                query_vectors.len(),
+                dimension
+            );
         }
 
-        let num_queries = query_vectors.len();
-        let flattened: Vec<f32> = query_vectors.iter().flatten().cloned().collect();
+        let num_queries = query_vectors.len() / dimension;
+        let (distances, indexes) = arena.prepare(num_queries, k);
+        if num_queries == 0 || k == 0 {
+            return Ok(());
+        }
 
-        let search_result: FaissIndexSearchResult = {
-            #[cfg(any(target_family = "unix", target_family = "windows"))]
-            unsafe {
-                FaissIndexSearchResult::from(self.inner().search_vectors(&flattened, k)?)
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        unsafe {
+            let inner = self.inner();
+            match selector {
+                None => inner.search_vectors_into(query_vectors, k, distances, indexes, params)?,
+                Some(FaissIdSelector::Bitmap(bitmap)) => inner.search_vectors_with_bitmap(
+                    query_vectors,
+                    k,
+                    bitmap,
+                    distances,
+                    indexes,
+                    params,
+                )?,
+                Some(FaissIdSelector::Ids(ids)) => inner.search_vectors_with_ids(
+                    query_vectors,
+                    k,
+                    ids,
+                    distances,
+                    indexes,
+                    params,
+                )?,
             }
+        }
 
-            #[cfg(target_family = "wasm")]
+        #[cfg(target_family = "wasm")]
+        {
+            let query_vectors_arr = js_sys::Float32Array::from(query_vectors);
+            let params = params.to_js();
+            let inner = self.inner();
+            let search_result = match selector {
+                None => inner.search_vectors(&query_vectors_arr, k, &params),
+                Some(FaissIdSelector::Bitmap(bitmap)) => inner.search_vectors_with_bitmap(
+                    &query_vectors_arr,
+                    k,
+                    &js_sys::Uint8Array::from(bitmap),
+                    &params,
+                ),
+                Some(FaissIdSelector::Ids(ids)) => inner.search_vectors_with_ids(
+                    &query_vectors_arr,
+                    k,
+                    &js_sys::BigInt64Array::from(ids),
+                    &params,
+                ),
+            }
+            .map_err(|e| anyhow::anyhow!("Failed to search vectors: {:?}", e))?;
+            let (distances_arr, indexes_arr) = (search_result.distances(), search_result.indexes());
+            if distances_arr.length() as usize != distances.len()
+                || indexes_arr.length() as usize != indexes.len()
             {
-                let query_vectors_arr =
-                    js_sys::Float32Array::new_with_length(flattened.len() as u32);
-                for (i, val) in flattened.into_iter().enumerate() {
-                    query_vectors_arr.set_index(i as u32, val);
-                }
-                self.inner()
-                    .search_vectors(&query_vectors_arr, k)
-                    .expect("Failed to search vector store with query vector")
-                    .into()
+                bail!(
+                    "FFI returned mismatched result length. Expected: {}, Got: (indexes: {}, distances: {})",
+                    distances.len(),
+                    indexes_arr.length(),
+                    distances_arr.length()
+                );
             }
-        };
-
-        let expected_len = num_queries * k;
-        if search_result.indexes.len() != expected_len
-            || search_result.distances.len() != expected_len
-        {
-            bail!(
-                "C++ FFI returned mismatched result length. Expected: {}, Got: (indexes: {}, distances: {})",
-                expected_len,
-                search_result.indexes.len(),
-                search_result.distances.len()
-            );
+            distances_arr.copy_to(distances);
+            indexes_arr.copy_to(indexes);
         }
 
-        let results: Vec<FaissIndexSearchResult> = search_result
-            .distances
-            .chunks_exact(k)
-            .zip(search_result.indexes.chunks_exact(k))
-            .map(|(distances_chunk, indexes_chunk)| FaissIndexSearchResult {
-                distances: distances_chunk.into(),
-                indexes: indexes_chunk.into(),
-            })
-            .collect();
+        Ok(())
+    }
 
-        if results.len() != num_queries {
+    /// Finds every vector within `radius` of each row of `query_vectors`.
+    /// `radius` is in the unit of the index metric (squared distance for L2).
+    pub fn range_search(
+        &self,
+        query_vectors: &[f32],
+        radius: f32,
+    ) -> anyhow::Result<FaissIndexRangeSearchResult> {
+        let dimension = self.dimension() as usize;
+        if query_vectors.len() % dimension != 0 {
             bail!(
-                "Internal logic error: Failed to group search results correctly. Expected {} groups, got {}.",
-                num_queries,
-                results.len()
+                "Query length {} is not a multiple of the index dimension {}",
+                query_vectors.len(),
+                dimension
             );
         }
 
-        Ok(results)
-    }
-
-    /// assume that for every id, there is a vector corresponding to that id.
-    /// This should be guaranteed before call this function.
-    pub fn get_by_ids(&self, ids: &[&str]) -> anyhow::Result<Vec<Vec<f32>>> {
-        if ids.is_empty() {
-            return Ok(vec![]);
-        }
-
-        let numeric_ids: Vec<i64> = ids
-            .iter()
-            .map(|s| s.parse::<i64>())
-            .collect::<Result<Vec<i64>, _>>()
-            .context("Failed to parse one or more string IDs to integer")?;
-
-        let dimension = self.inner().get_dimension() as usize;
-        let expected_len = ids.len() * dimension;
-
-        let flat_results: Vec<f32> = {
+        let result: FaissIndexRangeSearchResult = {
             #[cfg(any(target_family = "unix", target_family = "windows"))]
             unsafe {
-                self.inner().get_by_ids(&numeric_ids)?
+                self.inner().range_search_vectors(query_vectors, radius)?
             }
 
             #[cfg(target_family = "wasm")]
             {
-                let ids_arr = js_sys::BigInt64Array::new_with_length(numeric_ids.len() as u32);
-                for (i, val) in numeric_ids.into_iter().enumerate() {
-                    ids_arr.set_index(i as u32, val);
-                }
-                let flat_vectors = self.inner().get_by_ids(&ids_arr).unwrap();
-                flat_vectors.to_vec()
+                self.inner()
+                    .range_search_vectors(&js_sys::Float32Array::from(query_vectors), radius)
+                    .map_err(|e| anyhow::anyhow!("Failed to range search vectors: {:?}", e))?
+                    .into()
             }
         };
 
-        if flat_results.len() != expected_len {
+        let num_queries = query_vectors.len() / dimension;
+        let num_results = result.lims.last().copied().unwrap_or_default();
+        if result.lims.len() != num_queries + 1
+            || result.labels.len() != num_results
+            || result.distances.len() != num_results
+        {
             bail!(
-                "FFI returned mismatched result length. Expected: {}, Got: {}",
-                expected_len,
-                flat_results.len()
+                "FFI returned malformed range search result. Expected {} queries, Got: (lims: {}, labels: {}, distances: {})",
+                num_queries,
+                result.lims.len(),
+                result.labels.len(),
+                result.distances.len()
             );
         }
-        let results: Vec<Vec<f32>> = flat_results
-            .chunks_exact(dimension)
-            .map(|chunk| chunk.to_vec())
-            .collect();
 
-        if results.len() != ids.len() {
+        Ok(result)
+    }
+
+    /// assume that for every id, there is a vector corresponding to that id.
+    /// This should be guaranteed before call this function.
+    pub fn get_by_ids(&self, ids: &[i64]) -> anyhow::Result<EmbeddingBatch> {
+        let dimension = self.dimension() as usize;
+        let mut flat_results = vec![0f32; ids.len() * dimension];
+        self.get_by_ids_into(ids, &mut flat_results)?;
+        EmbeddingBatch::from_flat(dimension, flat_results)
+    }
+
+    /// Writes the vectors of `ids` row by row into `out`, which must hold exactly
+    /// `ids.len() * dimension` elements. Fails if any id is not in the index.
+    pub fn get_by_ids_into(&self, ids: &[i64], out: &mut [f32]) -> anyhow::Result<()> {
+        let expected_len = ids.len() * self.dimension() as usize;
+        if out.len() != expected_len {
             bail!(
-                "Internal logic error: Failed to group get results correctly. Expected {} groups, got {}.",
-                ids.len(),
-                results.len()
+                "Output buffer holds {} elements, expected {}",
+                out.len(),
+                expected_len
             );
         }
+        if ids.is_empty() {
+            return Ok(());
+        }
+
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        unsafe {
+            self.inner().get_by_ids_into(ids, out)?;
+        }
 
-        Ok(results)
+        #[cfg(target_family = "wasm")]
+        {
+            let flat_vectors = self
+                .inner()
+                .get_by_ids(&js_sys::BigInt64Array::from(ids))
+                .map_err(|e| anyhow::anyhow!("Failed to get vectors: {:?}", e))?;
+            if flat_vectors.length() as usize != expected_len {
+                bail!(
+                    "FFI returned mismatched result length. Expected: {}, Got: {}",
+                    expected_len,
+                    flat_vectors.length()
+                );
+            }
+            flat_vectors.copy_to(out);
+        }
+
+        Ok(())
     }
 
     /// assume that for every id, there is a vector corresponding to that id.
     /// This should be guaranteed before call this function.
-    pub fn remove_vectors(&mut self, ids: &[&str]) -> anyhow::Result<usize> {
-        let numeric_ids: Vec<i64> = ids
-            .iter()
-            .map(|s| s.parse::<i64>())
-            .collect::<Result<Vec<i64>, _>>()?;
-
+    pub fn remove_vectors(&mut self, ids: &[i64]) -> anyhow::Result<usize> {
         #[cfg(any(target_family = "unix", target_family = "windows"))]
         unsafe {
-            Ok(self.inner.pin_mut().remove_vectors(&numeric_ids)?)
+            Ok(self.inner.pin_mut().remove_vectors(ids)?)
         }
 
         #[cfg(target_family = "wasm")]
         {
-            let arr = js_sys::BigInt64Array::new_with_length(numeric_ids.len() as u32);
-            for (i, val) in numeric_ids.into_iter().enumerate() {
-                arr.set_index(i as u32, val);
-            }
+            let arr = js_sys::BigInt64Array::from(ids);
             Ok(self.inner().remove_vectors(&arr).unwrap() as usize)
         }
     }
@@ -344,7 +521,73 @@ impl FaissIndex {
 
     #[cfg(any(target_family = "unix", target_family = "windows"))]
     pub fn read_index(filename: &str) -> anyhow::Result<Self> {
-        let wrapper = unsafe { ailoy_faiss_sys::read_index(filename)? };
+        Self::read_index_with_mode(filename, false)
+    }
+
+    /// Opens the index memory-mapped and read-only. Loading is nearly instant and
+    /// processes opening the same file share its page cache, but any attempt to
+    /// add, remove, train or clear fails.
+    ///
+    /// Only files written by [`FaissIndex::write_index`] can be mapped. Store
+    /// snapshots from `VectorStore::save` embed their indexes next to the
+    /// documents and are always read into memory.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    pub fn read_index_mmap(filename: &str) -> anyhow::Result<Self> {
+        Self::read_index_with_mode(filename, true)
+    }
+
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    fn read_index_with_mode(filename: &str, mmap: bool) -> anyhow::Result<Self> {
+        let wrapper = unsafe { ailoy_faiss_sys::read_index(filename, mmap)? };
+        let current_total = wrapper.get_ntotal();
+        Ok(Self {
+            inner: wrapper,
+            next_id: AtomicI64::new(current_total),
+        })
+    }
+
+    /// Serializes the index in the same format as [`FaissIndex::write_index`].
+    pub fn serialize(&self) -> anyhow::Result<Vec<u8>> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        unsafe {
+            Ok(self.inner().serialize()?)
+        }
+
+        #[cfg(target_family = "wasm")]
+        {
+            let bytes = self
+                .inner()
+                .serialize()
+                .map_err(|e| anyhow::anyhow!("Failed to serialize index: {:?}", e))?;
+            Ok(bytes.to_vec())
+        }
+    }
+
+    /// Rebuilds an index from the output of [`FaissIndex::serialize`].
+    pub async fn deserialize(bytes: &[u8]) -> anyhow::Result<Self> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        {
+            Self::deserialize_blocking(bytes)
+        }
+
+        #[cfg(target_family = "wasm")]
+        {
+            let wrapper = deserialize_faiss_index(js_sys::Uint8Array::from(bytes))
+                .await
+                .map_err(|e| anyhow::anyhow!("Failed to deserialize index: {:?}", e))?;
+            let current_total = wrapper.get_ntotal();
+            Ok(Self {
+                inner: wrapper,
+                next_id: AtomicI64::new(current_total),
+            })
+        }
+    }
+
+    /// [`FaissIndex::deserialize`] for callers that cannot await, such as
+    /// training on a blocking thread. Only the web needs to wait for it.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    pub fn deserialize_blocking(bytes: &[u8]) -> anyhow::Result<Self> {
+        let wrapper = unsafe { ailoy_faiss_sys::deserialize_index(bytes)? };
         let current_total = wrapper.get_ntotal();
         Ok(Self {
             inner: wrapper,
@@ -352,8 +595,397 @@ impl FaissIndex {
         })
     }
 
+    /// Continues id allocation from `next_id`, e.g. after restoring a snapshot
+    /// whose highest ids were removed.
+    pub fn restore_id_counter(&self, next_id: i64) {
+        self.next_id.store(next_id, Ordering::SeqCst);
+    }
+
     // Debug
     pub fn current_id_counter(&self) -> i64 {
         self.next_id.load(Ordering::SeqCst)
     }
 }
+
+/// Rust wrapper of faiss::IndexBinary.
+///
+/// Vectors are packed bits compared by Hamming distance: the dimension is in
+/// bits and every code takes [`FaissBinaryIndex::code_size`] bytes. Ids are
+/// always assigned by the caller.
+pub struct FaissBinaryIndex {
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    inner: cxx::UniquePtr<ailoy_faiss_sys::FaissBinaryIndexInner>,
+    #[cfg(target_family = "wasm")]
+    inner: FaissBinaryIndexInner,
+}
+
+#[allow(dead_code)]
+impl FaissBinaryIndex {
+    /// `description` is a binary index factory string such as `"BFlat"`,
+    /// `"BIVF1024"` or `"BHNSW32"`, optionally prefixed with `"IDMap2,"` for
+    /// indexes that don't keep ids of their own. `dimension` must be a multiple
+    /// of 8.
+    pub async fn new(dimension: i32, description: &str) -> anyhow::Result<Self> {
+        if dimension <= 0 || dimension % 8 != 0 {
+            bail!(
+                "Binary index dimension must be a positive multiple of 8, got {}",
+                dimension
+            );
+        }
+
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        let wrapper = unsafe { ailoy_faiss_sys::create_binary_index(dimension, description)? };
+
+        #[cfg(target_family = "wasm")]
+        let wrapper = create_faiss_binary_index(dimension, description.into())
+            .await
+            .map_err(|e| anyhow::anyhow!("Failed to create binary index: {:?}", e))?;
+
+        Ok(Self { inner: wrapper })
+    }
+
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    fn inner(&self) -> &ailoy_faiss_sys::FaissBinaryIndexInner {
+        self.inner.as_ref().unwrap()
+    }
+
+    #[cfg(target_family = "wasm")]
+    fn inner(&self) -> &FaissBinaryIndexInner {
+        &self.inner
+    }
+
+    pub fn is_trained(&self) -> bool {
+        self.inner().is_trained()
+    }
+
+    pub fn ntotal(&self) -> i64 {
+        self.inner().get_ntotal()
+    }
+
+    /// Dimension in bits.
+    pub fn dimension(&self) -> i32 {
+        self.inner().get_dimension()
+    }
+
+    /// Bytes per code.
+    pub fn code_size(&self) -> usize {
+        self.dimension() as usize / 8
+    }
+
+    fn check_codes(&self, codes: &[u8]) -> anyhow::Result<usize> {
+        let code_size = self.code_size();
+        if codes.len() % code_size != 0 {
+            bail!(
+                "Code length {} is not a multiple of the code size {}",
+                codes.len(),
+                code_size
+            );
+        }
+        Ok(codes.len() / code_size)
+    }
+
+    /// Trains on row-major `codes`. Indexes that need no training ignore it.
+    pub fn train(&mut self, codes: &[u8]) -> anyhow::Result<()> {
+        if self.is_trained() {
+            return Ok(());
+        }
+        let num_codes = self.check_codes(codes)?;
+
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        unsafe {
+            self.inner.pin_mut().train_index(codes, num_codes)?;
+        }
+
+        #[cfg(target_family = "wasm")]
+        self.inner()
+            .train_index(&js_sys::Uint8Array::from(codes), num_codes)
+            .map_err(|e| anyhow::anyhow!("Failed to train binary index: {:?}", e))?;
+
+        Ok(())
+    }
+
+    pub fn add_codes_with_ids(&mut self, codes: &[u8], ids: &[i64]) -> anyhow::Result<()> {
+        let num_codes = self.check_codes(codes)?;
+        if num_codes != ids.len() {
+            bail!(
+                "Number of codes ({}) and ids ({}) differ",
+                num_codes,
+                ids.len()
+            );
+        }
+        if ids.is_empty() {
+            return Ok(());
+        }
+
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        unsafe {
+            self.inner
+                .pin_mut()
+                .add_codes_with_ids(codes, num_codes, ids)?;
+        }
+
+        #[cfg(target_family = "wasm")]
+        self.inner()
+            .add_codes_with_ids(
+                &js_sys::Uint8Array::from(codes),
+                num_codes,
+                &js_sys::BigInt64Array::from(ids),
+            )
+            .map_err(|e| anyhow::anyhow!("Failed to add codes: {:?}", e))?;
+
+        Ok(())
+    }
+
+    /// Searches the `k` nearest codes of every row of `codes`. Results hold
+    /// `k` entries per query; missing neighbors have an index of `-1`.
+    pub fn search(&self, codes: &[u8], k: usize) -> anyhow::Result<FaissBinaryIndexSearchResult> {
+        let num_queries = self.check_codes(codes)?;
+
+        let result: FaissBinaryIndexSearchResult = {
+            #[cfg(any(target_family = "unix", target_family = "windows"))]
+            unsafe {
+                self.inner().search_codes(codes, k)?
+            }
+
+            #[cfg(target_family = "wasm")]
+            {
+                self.inner()
+                    .search_codes(&js_sys::Uint8Array::from(codes), k)
+                    .map_err(|e| anyhow::anyhow!("Failed to search codes: {:?}", e))?
+                    .into()
+            }
+        };
+
+        let expected_len = num_queries * k;
+        if result.distances.len() != expected_len || result.indexes.len() != expected_len {
+            bail!(
+                "FFI returned mismatched result length. Expected: {}, Got: (indexes: {}, distances: {})",
+                expected_len,
+                result.indexes.len(),
+                result.distances.len()
+            );
+        }
+        Ok(result)
+    }
+
+    pub fn remove_ids(&mut self, ids: &[i64]) -> anyhow::Result<usize> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        unsafe {
+            Ok(self.inner.pin_mut().remove_codes(ids)?)
+        }
+
+        #[cfg(target_family = "wasm")]
+        {
+            let removed = self
+                .inner()
+                .remove_codes(&js_sys::BigInt64Array::from(ids))
+                .map_err(|e| anyhow::anyhow!("Failed to remove codes: {:?}", e))?;
+            Ok(removed as usize)
+        }
+    }
+
+    pub fn clear(&mut self) -> anyhow::Result<()> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        unsafe {
+            Ok(self.inner.pin_mut().clear()?)
+        }
+
+        #[cfg(target_family = "wasm")]
+        {
+            self.inner()
+                .clear()
+                .map_err(|e| anyhow::anyhow!("Failed to clear binary index: {:?}", e))?;
+            Ok(())
+        }
+    }
+
+    pub fn serialize(&self) -> anyhow::Result<Vec<u8>> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        unsafe {
+            Ok(self.inner().serialize()?)
+        }
+
+        #[cfg(target_family = "wasm")]
+        {
+            let bytes = self
+                .inner()
+                .serialize()
+                .map_err(|e| anyhow::anyhow!("Failed to serialize binary index: {:?}", e))?;
+            Ok(bytes.to_vec())
+        }
+    }
+
+    /// Rebuilds an index from the output of [`FaissBinaryIndex::serialize`].
+    pub async fn deserialize(bytes: &[u8]) -> anyhow::Result<Self> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        let wrapper = unsafe { ailoy_faiss_sys::deserialize_binary_index(bytes)? };
+
+        #[cfg(target_family = "wasm")]
+        let wrapper = deserialize_faiss_binary_index(js_sys::Uint8Array::from(bytes))
+            .await
+            .map_err(|e| anyhow::anyhow!("Failed to deserialize binary index: {:?}", e))?;
+
+        Ok(Self { inner: wrapper })
+    }
+}
+
+/// Packs the sign bits of row-major `vectors` into binary codes: bit `j` of a
+/// row, stored in bit `j % 8` of byte `j / 8`, is set when component `j` is
+/// positive. Rows are padded with zero bits to a whole number of bytes.
+pub fn binary_quantize(vectors: &[f32], dimension: usize) -> Vec<u8> {
+    let code_size = dimension.div_ceil(8);
+    let mut codes = vec![0u8; vectors.len() / dimension * code_size];
+    for (vector, code) in vectors
+        .chunks_exact(dimension)
+        .zip(codes.chunks_exact_mut(code_size))
+    {
+        for (j, &value) in vector.iter().enumerate() {
+            if value > 0.0 {
+                code[j / 8] |= 1 << (j % 8);
+            }
+        }
+    }
+    codes
+}
+
+#[cfg(test)]
+mod tests {
+    use ailoy_macros::multi_platform_test;
+
+    use super::*;
+
+    #[multi_platform_test]
+    async fn faiss_serialize_roundtrip() -> anyhow::Result<()> {
+        let mut index = FaissIndexBuilder::new(3).build().await?;
+        index.add_vectors(&[1.0, 0.0, 0.0, 0.0, 1.0, 0.0])?;
+
+        let bytes = index.serialize()?;
+        let restored = FaissIndex::deserialize(&bytes).await?;
+        assert_eq!(restored.ntotal(), 2);
+        assert_eq!(restored.dimension(), 3);
+        assert_eq!(restored.get_by_ids(&[1])?.as_slice(), &[0.0, 1.0, 0.0]);
+        assert_eq!(restored.serialize()?, bytes);
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_search_arena_reuses_its_buffers() -> anyhow::Result<()> {
+        let mut index = FaissIndexBuilder::new(3).build().await?;
+        index.add_vectors(&[1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 0.0])?;
+        let queries = [1.0, 0.1, 0.0, 0.0, 0.1, 1.0];
+        let params = FaissSearchParams::default();
+
+        let mut arena = FaissSearchArena::new();
+        index.search_into(&queries, 3, None, &params, &mut arena)?;
+        let buffers = (arena.distances.as_ptr(), arena.indexes.as_ptr());
+        let capacities = (arena.distances.capacity(), arena.indexes.capacity());
+        assert_eq!(arena.get(1).1[0], 2);
+
+        // A batch of the same or a smaller shape is written into the same buffers
+        for (queries, k) in [(&queries[..], 3), (&queries[..3], 2)] {
+            index.search_into(queries, k, None, &params, &mut arena)?;
+            assert_eq!((arena.distances.as_ptr(), arena.indexes.as_ptr()), buffers);
+            assert_eq!(
+                (arena.distances.capacity(), arena.indexes.capacity()),
+                capacities
+            );
+        }
+        assert_eq!(arena.num_queries(), 1);
+        assert_eq!(arena.get(0).1, [0, 3]);
+
+        // Searches through the thread's arena leave their rows in it
+        SEARCH_ARENA.with_borrow_mut(|arena| {
+            index.search_into(&queries, 1, None, &params, arena)?;
+            assert_eq!(arena.num_queries(), 2);
+            assert_eq!(arena.get(1).1, [2]);
+            anyhow::Ok(())
+        })?;
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_binary_index_searches_by_hamming_distance() -> anyhow::Result<()> {
+        let vectors = [
+            [1.0, 1.0, 1.0, 1.0, -1.0, -1.0, -1.0, -1.0, 1.0],
+            [1.0, 1.0, 1.0, -1.0, -1.0, -1.0, -1.0, -1.0, 1.0],
+            [-1.0, -1.0, -1.0, -1.0, 1.0, 1.0, 1.0, 1.0, -1.0],
+        ];
+        let flattened: Vec<f32> = vectors.iter().flatten().copied().collect();
+        let codes = binary_quantize(&flattened, 9);
+        assert_eq!(codes, vec![0x0f, 0x01, 0x07, 0x01, 0xf0, 0x00]);
+
+        let mut index = FaissBinaryIndex::new(16, "IDMap2,BFlat").await?;
+        index.add_codes_with_ids(&codes, &[10, 20, 30])?;
+        assert_eq!(index.ntotal(), 3);
+
+        let result = index.search(&codes[..2], 2)?;
+        assert_eq!(result.indexes, vec![10, 20]);
+        assert_eq!(result.distances, vec![0, 1]);
+
+        assert_eq!(index.remove_ids(&[10])?, 1);
+        let restored = FaissBinaryIndex::deserialize(&index.serialize()?).await?;
+        let result = restored.search(&codes[..2], 3)?;
+        assert_eq!(result.indexes, vec![20, 30, -1]);
+        assert_eq!(result.distances[..2], [1, 9]);
+
+        assert!(FaissBinaryIndex::new(12, "BFlat").await.is_err());
+        Ok(())
+    }
+
+    /// Compares cold-start time of a heap-copied load against a memory-mapped one.
+    /// Run with `cargo test --release faiss_read_index_cold_start -- --ignored --nocapture`.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    #[tokio::test]
+    #[ignore]
+    async fn faiss_read_index_cold_start() -> anyhow::Result<()> {
+        use std::time::Instant;
+
+        const DIM: usize = 768;
+        const NUM_VECTORS: usize = 200_000;
+        const BATCH: usize = 10_000;
+
+        let path = std::env::temp_dir().join("ailoy_faiss_cold_start.index");
+        let filename = path.to_str().unwrap();
+
+        let mut index = FaissIndexBuilder::new(DIM as i32).build().await?;
+        for batch in 0..NUM_VECTORS / BATCH {
+            let vectors: Vec<f32> = (0..BATCH)
+                .flat_map(|i| {
+                    let seed = (batch * BATCH + i) as f32;
+                    (0..DIM).map(move |d| (seed * 0.37 + d as f32).sin())
+                })
+                .collect();
+            index.add_vectors(&vectors)?;
+        }
+        index.write_index(filename)?;
+        drop(index);
+
+        let query: Vec<f32> = (0..DIM).map(|d| (d as f32).cos()).collect();
+        let mut arena = FaissSearchArena::new();
+
+        let start = Instant::now();
+        let heap = FaissIndex::read_index(filename)?;
+        let heap_load = start.elapsed();
+        heap.search_into(&query, 10, None, &FaissSearchParams::default(), &mut arena)?;
+        let heap_first_query = start.elapsed();
+        drop(heap);
+
+        let start = Instant::now();
+        let mapped = FaissIndex::read_index_mmap(filename)?;
+        let mmap_load = start.elapsed();
+        mapped.search_into(&query, 10, None, &FaissSearchParams::default(), &mut arena)?;
+        let mmap_first_query = start.elapsed();
+        assert!(mapped.is_read_only());
+        assert_eq!(mapped.ntotal(), NUM_VECTORS as i64);
+        drop(mapped);
+
+        println!(
+            "heap: load {:?}, first query {:?} / mmap: load {:?}, first query {:?}",
+            heap_load, heap_first_query, mmap_load, mmap_first_query
+        );
+
+        std::fs::remove_file(&path)?;
+        Ok(())
+    }
+}
@@ -12,7 +12,8 @@ use crate::{
     ffi::py::cache_progress::PyCacheProgress as CacheProgress,
     knowledge::{Knowledge, KnowledgeConfig},
     model::{
-        DocumentPolyfill, EmbeddingModel, Grammar, KVCacheConfig, LangModel, LangModelInferConfig,
+        DocumentPolyfill, EmbeddingCacheMetrics, EmbeddingModel, Grammar, KVCacheConfig, LangModel,
+        LangModelInferConfig,
     },
     tool::{MCPClient, Tool},
     value::{
@@ -24,7 +25,8 @@ use crate::{
         },
     },
     vector_store::{
-        VectorStore, VectorStoreAddInput, VectorStoreGetResult, VectorStoreRetrieveResult,
+        ComputePoolMetrics, RetrieveBatchMetrics, VectorStore, VectorStoreAddInput,
+        VectorStoreGetResult, VectorStoreRetrieveResult,
     },
 };
 
@@ -34,8 +36,10 @@ fn ailoy_py(_py: Python<'_>, m: &Bound<PyModule>) -> PyResult<()> {
     m.add_class::<Agent>()?;
     m.add_class::<AgentConfig>()?;
     m.add_class::<CacheProgress>()?;
+    m.add_class::<ComputePoolMetrics>()?;
     m.add_class::<Document>()?;
     m.add_class::<DocumentPolyfill>()?;
+    m.add_class::<EmbeddingCacheMetrics>()?;
     m.add_class::<EmbeddingModel>()?;
     m.add_class::<FinishReason>()?;
     m.add_class::<Grammar>()?;
@@ -58,6 +62,7 @@ fn ailoy_py(_py: Python<'_>, m: &Bound<PyModule>) -> PyResult<()> {
     m.add_class::<PartDeltaFunction>()?;
     m.add_class::<PartFunction>()?;
     m.add_class::<PartImage>()?;
+    m.add_class::<RetrieveBatchMetrics>()?;
     m.add_class::<Tool>()?;
     m.add_class::<ToolDesc>()?;
     m.add_class::<VectorStore>()?;
@@ -14,6 +14,18 @@ extern "C" {
     #[wasm_bindgen(method, getter)]
     pub fn indexes(this: &JsFaissIndexSearchResult) -> js_sys::BigInt64Array;
 
+    #[wasm_bindgen(js_name = "FaissIndexRangeSearchResult")]
+    pub type JsFaissIndexRangeSearchResult;
+
+    #[wasm_bindgen(method, getter)]
+    pub fn lims(this: &JsFaissIndexRangeSearchResult) -> js_sys::BigInt64Array;
+
+    #[wasm_bindgen(method, getter)]
+    pub fn labels(this: &JsFaissIndexRangeSearchResult) -> js_sys::BigInt64Array;
+
+    #[wasm_bindgen(method, getter)]
+    pub fn distances(this: &JsFaissIndexRangeSearchResult) -> js_sys::Float32Array;
+
     #[wasm_bindgen(js_name = "FaissIndexInner")]
     pub type FaissIndexInner;
 
@@ -63,8 +75,49 @@ extern "C" {
         this: &FaissIndexInner,
         query_vectors: &js_sys::Float32Array,
         k: usize,
+        params: &JsValue,
+    ) -> Result<JsFaissIndexSearchResult, JsValue>;
+
+    #[wasm_bindgen(
+        method,
+        catch,
+        js_class = "FaissIndexInner",
+        js_name = "search_vectors_with_bitmap"
+    )]
+    pub fn search_vectors_with_bitmap(
+        this: &FaissIndexInner,
+        query_vectors: &js_sys::Float32Array,
+        k: usize,
+        id_bitmap: &js_sys::Uint8Array,
+        params: &JsValue,
+    ) -> Result<JsFaissIndexSearchResult, JsValue>;
+
+    #[wasm_bindgen(
+        method,
+        catch,
+        js_class = "FaissIndexInner",
+        js_name = "search_vectors_with_ids"
+    )]
+    pub fn search_vectors_with_ids(
+        this: &FaissIndexInner,
+        query_vectors: &js_sys::Float32Array,
+        k: usize,
+        ids: &js_sys::BigInt64Array,
+        params: &JsValue,
     ) -> Result<JsFaissIndexSearchResult, JsValue>;
 
+    #[wasm_bindgen(
+        method,
+        catch,
+        js_class = "FaissIndexInner",
+        js_name = "range_search_vectors"
+    )]
+    pub fn range_search_vectors(
+        this: &FaissIndexInner,
+        query_vectors: &js_sys::Float32Array,
+        radius: f32,
+    ) -> Result<JsFaissIndexRangeSearchResult, JsValue>;
+
     #[wasm_bindgen(method, catch, js_class = "FaissIndexInner", js_name = "get_by_ids")]
     pub fn get_by_ids(
         this: &FaissIndexInner,
@@ -85,6 +138,9 @@ extern "C" {
     #[wasm_bindgen(method, catch, js_class = "FaissIndexInner", js_name = "clear")]
     pub fn clear(this: &FaissIndexInner) -> Result<(), JsValue>;
 
+    #[wasm_bindgen(method, catch, js_class = "FaissIndexInner", js_name = "serialize")]
+    pub fn serialize(this: &FaissIndexInner) -> Result<js_sys::Uint8Array, JsValue>;
+
     #[wasm_bindgen(catch, js_name = "create_faiss_index")]
     pub async fn create_faiss_index(
         dimension: i32,
@@ -92,6 +148,108 @@ extern "C" {
         metric: String,
     ) -> Result<FaissIndexInner, JsValue>;
 
+    #[wasm_bindgen(catch, js_name = "deserialize_faiss_index")]
+    pub async fn deserialize_faiss_index(
+        bytes: js_sys::Uint8Array,
+    ) -> Result<FaissIndexInner, JsValue>;
+}
+
+#[wasm_bindgen(raw_module = "./shim_js/dist/index.js")]
+extern "C" {
+    //////////////////////////
+    /// Faiss Binary Index ///
+    //////////////////////////
+    #[wasm_bindgen(js_name = "FaissBinaryIndexSearchResult")]
+    pub type JsFaissBinaryIndexSearchResult;
+
+    #[wasm_bindgen(method, getter)]
+    pub fn distances(this: &JsFaissBinaryIndexSearchResult) -> js_sys::Int32Array;
+
+    #[wasm_bindgen(method, getter)]
+    pub fn indexes(this: &JsFaissBinaryIndexSearchResult) -> js_sys::BigInt64Array;
+
+    #[wasm_bindgen(js_name = "FaissBinaryIndexInner")]
+    pub type FaissBinaryIndexInner;
+
+    // Methods for FaissBinaryIndexInner
+    #[wasm_bindgen(method, js_class = "FaissBinaryIndexInner", js_name = "is_trained")]
+    pub fn is_trained(this: &FaissBinaryIndexInner) -> bool;
+
+    #[wasm_bindgen(method, js_class = "FaissBinaryIndexInner", js_name = "get_dimension")]
+    pub fn get_dimension(this: &FaissBinaryIndexInner) -> i32;
+
+    #[wasm_bindgen(method, js_class = "FaissBinaryIndexInner", js_name = "get_ntotal")]
+    pub fn get_ntotal(this: &FaissBinaryIndexInner) -> i64;
+
+    #[wasm_bindgen(
+        method,
+        catch,
+        js_class = "FaissBinaryIndexInner",
+        js_name = "train_index"
+    )]
+    pub fn train_index(
+        this: &FaissBinaryIndexInner,
+        training_codes: &js_sys::Uint8Array,
+        num_training_codes: usize,
+    ) -> Result<(), JsValue>;
+
+    #[wasm_bindgen(
+        method,
+        catch,
+        js_class = "FaissBinaryIndexInner",
+        js_name = "add_codes_with_ids"
+    )]
+    pub fn add_codes_with_ids(
+        this: &FaissBinaryIndexInner,
+        codes: &js_sys::Uint8Array,
+        num_codes: usize,
+        ids: &js_sys::BigInt64Array,
+    ) -> Result<(), JsValue>;
+
+    #[wasm_bindgen(
+        method,
+        catch,
+        js_class = "FaissBinaryIndexInner",
+        js_name = "search_codes"
+    )]
+    pub fn search_codes(
+        this: &FaissBinaryIndexInner,
+        codes: &js_sys::Uint8Array,
+        k: usize,
+    ) -> Result<JsFaissBinaryIndexSearchResult, JsValue>;
+
+    #[wasm_bindgen(
+        method,
+        catch,
+        js_class = "FaissBinaryIndexInner",
+        js_name = "remove_codes"
+    )]
+    pub fn remove_codes(
+        this: &FaissBinaryIndexInner,
+        ids: &js_sys::BigInt64Array,
+    ) -> Result<u32, JsValue>;
+
+    #[wasm_bindgen(method, catch, js_class = "FaissBinaryIndexInner", js_name = "clear")]
+    pub fn clear(this: &FaissBinaryIndexInner) -> Result<(), JsValue>;
+
+    #[wasm_bindgen(
+        method,
+        catch,
+        js_class = "FaissBinaryIndexInner",
+        js_name = "serialize"
+    )]
+    pub fn serialize(this: &FaissBinaryIndexInner) -> Result<js_sys::Uint8Array, JsValue>;
+
+    #[wasm_bindgen(catch, js_name = "create_faiss_binary_index")]
+    pub async fn create_faiss_binary_index(
+        dimension: i32,
+        description: String,
+    ) -> Result<FaissBinaryIndexInner, JsValue>;
+
+    #[wasm_bindgen(catch, js_name = "deserialize_faiss_binary_index")]
+    pub async fn deserialize_faiss_binary_index(
+        bytes: js_sys::Uint8Array,
+    ) -> Result<FaissBinaryIndexInner, JsValue>;
 }
 
 #[derive(Debug, Clone, Copy, PartialEq)]
@@ -157,14 +315,61 @@ impl TryFrom<String> for FaissMetricType {
     }
 }
 
+/// Per-call search knobs. Zero keeps the setting the index was built with;
+/// knobs that don't apply to the index type are ignored.
+#[derive(Debug, Clone, Copy, Default, PartialEq, serde::Serialize)]
+pub struct FaissSearchParams {
+    /// Number of inverted lists probed by IVF indexes.
+    pub nprobe: usize,
+    /// Candidate list size of HNSW indexes.
+    pub ef_search: usize,
+    /// Refine indexes re-rank `k * k_factor` candidates of the base index.
+    pub k_factor: f32,
+}
+
+impl FaissSearchParams {
+    /// Converts to the plain object the `FaissSearchParams` value_object expects.
+    pub fn to_js(&self) -> JsValue {
+        tsify::serde_wasm_bindgen::to_value(self).unwrap()
+    }
+}
+
+/// Hits of query `i` are `labels[lims[i]..lims[i + 1]]` with the matching
+/// `distances`, in no particular order.
 #[derive(Debug, Clone)]
-pub struct FaissIndexSearchResult {
+pub struct FaissIndexRangeSearchResult {
+    pub lims: Vec<usize>,
+    pub labels: Vec<i64>,
     pub distances: Vec<f32>,
+}
+
+impl From<JsFaissIndexRangeSearchResult> for FaissIndexRangeSearchResult {
+    fn from(value: JsFaissIndexRangeSearchResult) -> Self {
+        let lims = value
+            .lims()
+            .to_vec()
+            .into_iter()
+            .map(|lim| lim as usize)
+            .collect();
+        let labels = value.labels().to_vec();
+        let distances = value.distances().to_vec();
+        Self {
+            lims,
+            labels,
+            distances,
+        }
+    }
+}
+
+/// `k` Hamming nearest neighbors of every query, row by row.
+#[derive(Debug, Clone)]
+pub struct FaissBinaryIndexSearchResult {
+    pub distances: Vec<i32>,
     pub indexes: Vec<i64>,
 }
 
-impl From<JsFaissIndexSearchResult> for FaissIndexSearchResult {
-    fn from(value: JsFaissIndexSearchResult) -> Self {
+impl From<JsFaissBinaryIndexSearchResult> for FaissBinaryIndexSearchResult {
+    fn from(value: JsFaissBinaryIndexSearchResult) -> Self {
         let distances = value.distances().to_vec();
         let indexes = value.indexes().to_vec();
         Self { distances, indexes }
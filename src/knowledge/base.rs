@@ -1,17 +1,45 @@
 use std::sync::Arc;
 
 use ailoy_macros::{maybe_send_sync, multi_platform_async_trait};
+use futures::StreamExt as _;
 use serde::{Deserialize, Serialize};
+use strum::EnumString;
+use strum_macros::Display;
 
-use super::{custom_knowledge::CustomKnowledge, vector_store_knowledge::VectorStoreKnowledge};
+use super::{
+    custom_knowledge::CustomKnowledge, ingest::IngestConfig,
+    vector_store_knowledge::VectorStoreKnowledge,
+};
 use crate::{
+    boxed,
+    cache::CacheProgress,
     model::EmbeddingModel,
     to_value,
     tool::ToolBehavior,
+    utils::BoxStream,
     value::{Document, ToolDesc, Value},
-    vector_store::VectorStore,
+    vector_store::{VectorStore, VectorStoreSearchParams},
 };
 
+/// How a vector-store knowledge ranks documents for a query.
+#[derive(
+    Clone, Copy, Debug, Default, Serialize, Deserialize, PartialEq, Eq, Display, EnumString,
+)]
+#[cfg_attr(feature = "python", derive(ailoy_macros::PyStringEnum))]
+#[cfg_attr(feature = "nodejs", napi_derive::napi(string_enum))]
+#[cfg_attr(feature = "wasm", derive(tsify::Tsify))]
+#[cfg_attr(feature = "wasm", tsify(from_wasm_abi, into_wasm_abi))]
+pub enum KnowledgeRetrievalMode {
+    /// Nearest embeddings of the query.
+    #[default]
+    Dense,
+    /// Best BM25 scores of the query's terms. Needs a store with a lexical index.
+    Lexical,
+    /// Dense and lexical rankings merged by reciprocal-rank fusion. Needs a store
+    /// with a lexical index.
+    Hybrid,
+}
+
 #[derive(Clone, Debug, PartialEq, Serialize, Deserialize)]
 #[serde(rename_all = "camelCase")]
 #[cfg_attr(feature = "python", pyo3_stub_gen_derive::gen_stub_pyclass)]
@@ -25,11 +53,44 @@ use crate::{
 pub struct KnowledgeConfig {
     #[serde(skip_serializing_if = "Option::is_none")]
     pub top_k: Option<u32>,
+    /// If set, retrieves every document within this distance of the query
+    /// instead of a fixed number; `top_k` then caps the number of documents.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub radius: Option<f32>,
+    /// Number of inverted lists probed when the store uses an IVF index.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub nprobe: Option<u32>,
+    /// Candidate list size when the store uses an HNSW index.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub ef_search: Option<u32>,
+    /// Candidates re-ranked per document when the store uses a refine index.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub k_factor: Option<f32>,
+    /// Dense when unset. `radius` only applies to the dense ranking.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub mode: Option<KnowledgeRetrievalMode>,
 }
 
 impl Default for KnowledgeConfig {
     fn default() -> Self {
-        Self { top_k: Some(1) }
+        Self {
+            top_k: Some(1),
+            radius: None,
+            nprobe: None,
+            ef_search: None,
+            k_factor: None,
+            mode: None,
+        }
+    }
+}
+
+impl KnowledgeConfig {
+    pub fn search_params(&self) -> VectorStoreSearchParams {
+        VectorStoreSearchParams {
+            nprobe: self.nprobe,
+            ef_search: self.ef_search,
+            k_factor: self.k_factor,
+        }
     }
 }
 
@@ -154,6 +215,26 @@ impl Knowledge {
             inner: KnowledgeInner::Custom(knowledge),
         }
     }
+
+    /// Splits `documents` into chunks, embeds them and adds them to the vector
+    /// store. Progress counts documents; the last event carries the ids of the
+    /// stored chunks. Only vector-store knowledges can ingest documents.
+    pub fn ingest<'a>(
+        &self,
+        documents: Vec<Document>,
+        config: Option<IngestConfig>,
+    ) -> BoxStream<'a, anyhow::Result<CacheProgress<Vec<String>>>> {
+        match &self.inner {
+            KnowledgeInner::VectorStore(knowledge) => {
+                knowledge.ingest(documents, config.unwrap_or_default())
+            }
+            KnowledgeInner::Custom(_) => boxed!(futures::stream::once(async {
+                Err(anyhow::anyhow!(
+                    "A custom knowledge cannot ingest documents"
+                ))
+            })),
+        }
+    }
 }
 
 #[multi_platform_async_trait]
@@ -180,15 +261,35 @@ mod py {
     use pyo3_stub_gen_derive::*;
 
     use super::*;
-    use crate::{ffi::py::base::python_to_value, tool::Tool};
+    use crate::{
+        ffi::py::{
+            base::{await_future, python_to_value},
+            cache_progress::await_cache_result,
+        },
+        tool::Tool,
+    };
 
     #[gen_stub_pymethods]
     #[pymethods]
     impl KnowledgeConfig {
         #[new]
-        #[pyo3(signature = (top_k=None))]
-        fn __new__(top_k: Option<u32>) -> Self {
-            Self { top_k }
+        #[pyo3(signature = (top_k=None, radius=None, nprobe=None, ef_search=None, k_factor=None, mode=None))]
+        fn __new__(
+            top_k: Option<u32>,
+            radius: Option<f32>,
+            nprobe: Option<u32>,
+            ef_search: Option<u32>,
+            k_factor: Option<f32>,
+            mode: Option<KnowledgeRetrievalMode>,
+        ) -> Self {
+            Self {
+                top_k,
+                radius,
+                nprobe,
+                ef_search,
+                k_factor,
+                mode,
+            }
         }
 
         #[classmethod]
@@ -197,12 +298,35 @@ mod py {
             _cls: &Bound<'_, PyType>,
             config: &Bound<'_, PyDict>,
         ) -> PyResult<KnowledgeConfig> {
-            let top_k = config
-                .get_item("top_k")?
-                .and_then(|top_k| python_to_value(&top_k).ok())
-                .and_then(|top_k| top_k.as_unsigned())
-                .map(|top_k| top_k as u32);
-            Ok(KnowledgeConfig { top_k })
+            let get_unsigned = |key: &str| -> PyResult<Option<u32>> {
+                Ok(config
+                    .get_item(key)?
+                    .and_then(|value| python_to_value(&value).ok())
+                    .and_then(|value| value.as_unsigned())
+                    .map(|value| value as u32))
+            };
+            let get_float = |key: &str| -> PyResult<Option<f32>> {
+                Ok(config
+                    .get_item(key)?
+                    .and_then(|value| python_to_value(&value).ok())
+                    .and_then(|value| {
+                        value
+                            .as_float()
+                            .or_else(|| value.as_integer().map(|value| value as f64))
+                    })
+                    .map(|value| value as f32))
+            };
+            Ok(KnowledgeConfig {
+                top_k: get_unsigned("top_k")?,
+                radius: get_float("radius")?,
+                nprobe: get_unsigned("nprobe")?,
+                ef_search: get_unsigned("ef_search")?,
+                k_factor: get_float("k_factor")?,
+                mode: config
+                    .get_item("mode")?
+                    .and_then(|value| value.extract::<String>().ok())
+                    .and_then(|value| value.parse().ok()),
+            })
         }
     }
 
@@ -230,6 +354,52 @@ mod py {
                 .map_err(|e| PyRuntimeError::new_err(e.to_string()))
         }
 
+        #[gen_stub(override_return_type(
+            type_repr = "typing.Awaitable[builtins.list[builtins.str]]"
+        ))]
+        #[pyo3(name = "ingest", signature = (documents, chunk_size = None, chunk_overlap = None, batch_size = None, progress_callback = None))]
+        fn ingest_py<'a>(
+            &self,
+            py: Python<'a>,
+            documents: Vec<Document>,
+            chunk_size: Option<u32>,
+            chunk_overlap: Option<u32>,
+            batch_size: Option<u32>,
+            #[gen_stub(override_type(type_repr = "typing.Callable[[CacheProgress], None]"))]
+            progress_callback: Option<Py<PyAny>>,
+        ) -> PyResult<Bound<'a, PyAny>> {
+            let config = IngestConfig {
+                chunk_size,
+                chunk_overlap,
+                batch_size,
+            };
+            let strm = self.ingest(documents, Some(config));
+            pyo3_async_runtimes::tokio::future_into_py(
+                py,
+                await_cache_result(strm, progress_callback),
+            )
+        }
+
+        #[pyo3(name = "ingest_sync", signature = (documents, chunk_size = None, chunk_overlap = None, batch_size = None, progress_callback = None))]
+        fn ingest_sync_py(
+            &self,
+            py: Python<'_>,
+            documents: Vec<Document>,
+            chunk_size: Option<u32>,
+            chunk_overlap: Option<u32>,
+            batch_size: Option<u32>,
+            #[gen_stub(override_type(type_repr = "typing.Callable[[CacheProgress], None]"))]
+            progress_callback: Option<Py<PyAny>>,
+        ) -> PyResult<Vec<String>> {
+            let config = IngestConfig {
+                chunk_size,
+                chunk_overlap,
+                batch_size,
+            };
+            let strm = self.ingest(documents, Some(config));
+            await_future(py, await_cache_result(strm, progress_callback))
+        }
+
         #[pyo3(name = "as_tool")]
         pub fn as_tool(&self) -> Tool {
             let tool = KnowledgeTool::from(self.clone());
@@ -240,11 +410,24 @@ mod py {
 
 #[cfg(feature = "nodejs")]
 mod node {
-    use napi::bindgen_prelude::*;
+    use napi::{bindgen_prelude::*, threadsafe_function::ThreadsafeFunction};
     use napi_derive::napi;
 
     use super::*;
-    use crate::tool::Tool;
+    use crate::{
+        ffi::node::cache::{JsCacheProgress, await_cache_result},
+        tool::Tool,
+    };
+
+    #[derive(Default)]
+    #[napi(js_name = "IngestConfig", object, object_to_js = false)]
+    pub struct JSIngestConfig {
+        pub chunk_size: Option<u32>,
+        pub chunk_overlap: Option<u32>,
+        pub batch_size: Option<u32>,
+        pub progress_callback:
+            Option<ThreadsafeFunction<JsCacheProgress, (), JsCacheProgress, Status, false>>,
+    }
 
     #[napi]
     impl Knowledge {
@@ -264,6 +447,24 @@ mod node {
                 .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
         }
 
+        #[napi(js_name = "ingest")]
+        pub async fn ingest_js(
+            &self,
+            documents: Vec<Document>,
+            config: Option<JSIngestConfig>,
+        ) -> napi::Result<Vec<String>> {
+            let config = config.unwrap_or_default();
+            let strm = self.ingest(
+                documents,
+                Some(IngestConfig {
+                    chunk_size: config.chunk_size,
+                    chunk_overlap: config.chunk_overlap,
+                    batch_size: config.batch_size,
+                }),
+            );
+            await_cache_result(strm, config.progress_callback).await
+        }
+
         #[napi(js_name = "asTool")]
         pub fn as_tool(&self) -> Tool {
             let tool = KnowledgeTool::from(self.clone());
@@ -274,10 +475,54 @@ mod node {
 
 #[cfg(feature = "wasm")]
 mod wasm {
+    use js_sys::{Function, Reflect};
     use wasm_bindgen::prelude::*;
 
     use super::*;
-    use crate::tool::Tool;
+    use crate::{ffi::web::cache::await_cache_result, tool::Tool};
+
+    #[wasm_bindgen]
+    extern "C" {
+        #[derive(Clone)]
+        #[wasm_bindgen(
+            js_name = "IngestConfig",
+            typescript_type = "{chunkSize?: number; chunkOverlap?: number; batchSize?: number; progressCallback?: CacheProgressCallbackFn;}"
+        )]
+        pub type _JSIngestConfig;
+    }
+
+    #[derive(Default)]
+    pub struct JSIngestConfig {
+        pub config: IngestConfig,
+        pub progress_callback: Option<Function>,
+    }
+
+    impl TryFrom<_JSIngestConfig> for JSIngestConfig {
+        type Error = js_sys::Error;
+
+        fn try_from(value: _JSIngestConfig) -> Result<Self, Self::Error> {
+            let obj = value.obj;
+            let mut config = Self::default();
+            let get_unsigned = |key: &str| {
+                Reflect::get(&obj, &key.into())
+                    .ok()
+                    .and_then(|val| val.as_f64())
+                    .map(|f64| f64 as u32)
+            };
+
+            config.config.chunk_size = get_unsigned("chunkSize");
+            config.config.chunk_overlap = get_unsigned("chunkOverlap");
+            config.config.batch_size = get_unsigned("batchSize");
+
+            if let Ok(val) = Reflect::get(&obj, &"progressCallback".into())
+                && val.is_function()
+            {
+                config.progress_callback = Some(val.into());
+            }
+
+            Ok(config)
+        }
+    }
 
     #[wasm_bindgen]
     impl Knowledge {
@@ -297,6 +542,22 @@ mod wasm {
                 .map_err(|e| js_sys::Error::new(&e.to_string()))
         }
 
+        #[wasm_bindgen(js_name = "ingest")]
+        pub async fn ingest_js(
+            &self,
+            documents: Vec<Document>,
+            config: Option<_JSIngestConfig>,
+        ) -> Result<Vec<String>, js_sys::Error> {
+            let config: JSIngestConfig = match config {
+                Some(c) => c.try_into()?,
+                None => JSIngestConfig::default(),
+            };
+            let strm = self.ingest(documents, Some(config.config));
+            await_cache_result(strm, config.progress_callback)
+                .await
+                .map_err(|e| js_sys::Error::new(&e.to_string()))
+        }
+
         #[wasm_bindgen(js_name = "asTool")]
         pub fn as_tool(self) -> Tool {
             let tool = KnowledgeTool::from(self);
@@ -0,0 +1,290 @@
+//! Loads documents into a vector-store knowledge.
+//!
+//! Ingestion runs as a pipeline of four stages connected by bounded channels:
+//! documents are split into chunks, the chunks are tokenized, embedded a batch
+//! at a time, and added to the store in bulk. Each stage works on the next batch
+//! while the following one is busy, and a full channel pauses the stages before
+//! it, so memory stays bounded however large the corpus is. Natively,
+//! tokenization runs on the compute pool and inference on a blocking thread, so
+//! neither holds up the executor the other stages run on.
+
+use async_stream::try_stream;
+use futures::{SinkExt as _, StreamExt as _, channel::mpsc};
+use serde::{Deserialize, Serialize};
+
+use crate::{
+    boxed,
+    cache::CacheProgress,
+    model::EmbeddingModel,
+    utils::{BoxFuture, BoxStream},
+    value::{Document, Embedding, Value},
+    vector_store::{VectorStore, VectorStoreAddBatch, VectorStoreMetadata},
+};
+
+const DEFAULT_CHUNK_SIZE: u32 = 1000;
+const DEFAULT_CHUNK_OVERLAP: u32 = 100;
+const DEFAULT_BATCH_SIZE: u32 = 32;
+/// Batches a stage may run ahead of the next one.
+const CHANNEL_DEPTH: usize = 2;
+
+#[derive(Clone, Debug, Default, PartialEq, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+#[cfg_attr(feature = "wasm", derive(tsify::Tsify))]
+#[cfg_attr(feature = "wasm", tsify(from_wasm_abi, into_wasm_abi))]
+pub struct IngestConfig {
+    /// Longest chunk in characters. Chunks end at whitespace where possible.
+    /// Defaults to 1000.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub chunk_size: Option<u32>,
+    /// Characters shared by consecutive chunks of a document, so that a passage
+    /// cut by a chunk boundary is still found whole. Defaults to 100.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub chunk_overlap: Option<u32>,
+    /// Chunks embedded by one forward pass and added to the store at once.
+    /// Defaults to 32.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub batch_size: Option<u32>,
+}
+
+/// Splits `text` into trimmed pieces of at most `size` characters, each starting
+/// about `overlap` characters before the previous one ended. Pieces end and start
+/// at whitespace unless a single word fills more than half of a piece.
+pub(crate) fn chunk_text(text: &str, size: usize, overlap: usize) -> Vec<&str> {
+    let size = size.max(1);
+    let overlap = overlap.min(size / 2);
+    let bounds: Vec<usize> = text
+        .char_indices()
+        .map(|(i, _)| i)
+        .chain(std::iter::once(text.len()))
+        .collect();
+    let chars: Vec<char> = text.chars().collect();
+    let is_space = |i: usize| chars[i].is_whitespace();
+
+    let mut chunks = Vec::new();
+    let mut start = 0;
+    while start < chars.len() {
+        let mut end = (start + size).min(chars.len());
+        if end < chars.len() && !is_space(end) {
+            if let Some(space) = (start + size / 2..end).rev().find(|&i| is_space(i)) {
+                end = space;
+            }
+        }
+        let chunk = text[bounds[start]..bounds[end]].trim();
+        if !chunk.is_empty() {
+            chunks.push(chunk);
+        }
+        if end == chars.len() {
+            break;
+        }
+
+        // Back up by the overlap, then forward to the start of a word
+        let mut next = end.saturating_sub(overlap).max(start + 1);
+        if next < end && next > 0 && !is_space(next - 1) {
+            next = (next..end).find(|&i| is_space(i)).map_or(end, |i| i + 1);
+        }
+        start = next;
+    }
+    chunks
+}
+
+struct Chunk {
+    text: String,
+    metadata: VectorStoreMetadata,
+    /// Set on the last chunk of its document, to count finished documents.
+    ends_document: bool,
+}
+
+fn chunk_metadata(document: &Document, index: usize) -> VectorStoreMetadata {
+    let mut metadata = VectorStoreMetadata::new();
+    metadata.insert("document_id".to_owned(), Value::string(&document.id));
+    metadata.insert("chunk".to_owned(), Value::integer(index as i64));
+    if let Some(title) = &document.title {
+        metadata.insert("title".to_owned(), Value::string(title));
+    }
+    metadata
+}
+
+async fn tokenize(model: &EmbeddingModel, texts: Vec<String>) -> anyhow::Result<Vec<Vec<u32>>> {
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    {
+        let model = model.clone();
+        crate::vector_store::local::ComputePool::shared()
+            .run(move || model.tokenize_batch(texts))
+            .await?
+    }
+    #[cfg(target_family = "wasm")]
+    {
+        model.tokenize_batch(texts)
+    }
+}
+
+async fn embed(model: &EmbeddingModel, tokens: Vec<Vec<u32>>) -> anyhow::Result<Vec<Embedding>> {
+    // Native inference blocks until the forward pass is done, so it gets a thread
+    // of its own to let the other stages keep going meanwhile
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    {
+        let model = model.clone();
+        tokio::task::spawn_blocking(move || {
+            futures::executor::block_on(model.infer_tokens_batch(tokens))
+        })
+        .await?
+    }
+    #[cfg(target_family = "wasm")]
+    {
+        model.infer_tokens_batch(tokens).await
+    }
+}
+
+/// Chunks, embeds and stores `documents`. Progress counts documents; the last
+/// event carries the ids of the stored chunks.
+pub(crate) fn ingest<'a>(
+    mut store: VectorStore,
+    model: EmbeddingModel,
+    documents: Vec<Document>,
+    config: IngestConfig,
+) -> BoxStream<'a, anyhow::Result<CacheProgress<Vec<String>>>> {
+    let chunk_size = config.chunk_size.unwrap_or(DEFAULT_CHUNK_SIZE) as usize;
+    let chunk_overlap = config.chunk_overlap.unwrap_or(DEFAULT_CHUNK_OVERLAP) as usize;
+    let batch_size = config.batch_size.unwrap_or(DEFAULT_BATCH_SIZE).max(1) as usize;
+    let total = documents.len();
+
+    let (mut chunk_tx, mut chunk_rx) = mpsc::channel::<Vec<Chunk>>(CHANNEL_DEPTH);
+    let (mut token_tx, mut token_rx) = mpsc::channel::<(Vec<Chunk>, Vec<Vec<u32>>)>(CHANNEL_DEPTH);
+    let (mut embed_tx, mut embed_rx) = mpsc::channel::<(Vec<Chunk>, Vec<Embedding>)>(CHANNEL_DEPTH);
+    // Counts of finished documents, sent as chunks are stored
+    let (progress_tx, progress_rx) = mpsc::unbounded::<usize>();
+
+    let empty_tx = progress_tx.clone();
+    let chunker = async move {
+        let mut batch = Vec::with_capacity(batch_size);
+        for document in &documents {
+            let pieces = chunk_text(&document.text, chunk_size, chunk_overlap);
+            if pieces.is_empty() {
+                let _ = empty_tx.unbounded_send(1);
+            }
+            let num_pieces = pieces.len();
+            for (index, piece) in pieces.into_iter().enumerate() {
+                batch.push(Chunk {
+                    text: piece.to_owned(),
+                    metadata: chunk_metadata(document, index),
+                    ends_document: index + 1 == num_pieces,
+                });
+                if batch.len() == batch_size {
+                    let full = std::mem::replace(&mut batch, Vec::with_capacity(batch_size));
+                    chunk_tx.send(full).await?;
+                }
+            }
+        }
+        if !batch.is_empty() {
+            chunk_tx.send(batch).await?;
+        }
+        anyhow::Ok(())
+    };
+
+    let tokenizer_model = model.clone();
+    let tokenizer = async move {
+        while let Some(chunks) = chunk_rx.next().await {
+            let texts = chunks.iter().map(|chunk| chunk.text.clone()).collect();
+            let tokens = tokenize(&tokenizer_model, texts).await?;
+            token_tx.send((chunks, tokens)).await?;
+        }
+        anyhow::Ok(())
+    };
+
+    let embedder = async move {
+        while let Some((chunks, tokens)) = token_rx.next().await {
+            let embeddings = embed(&model, tokens).await?;
+            embed_tx.send((chunks, embeddings)).await?;
+        }
+        anyhow::Ok(())
+    };
+
+    let storer = async move {
+        let mut ids = Vec::new();
+        while let Some((chunks, embeddings)) = embed_rx.next().await {
+            let finished = chunks.iter().filter(|chunk| chunk.ends_document).count();
+            let (documents, metadatas) = chunks
+                .into_iter()
+                .map(|chunk| (chunk.text, Some(chunk.metadata)))
+                .unzip();
+            let batch = VectorStoreAddBatch {
+                embeddings: embeddings.try_into()?,
+                documents,
+                metadatas,
+            };
+            ids.extend(store.add_batch(batch).await?);
+            let _ = progress_tx.unbounded_send(finished);
+        }
+        anyhow::Ok(ids)
+    };
+
+    let pipeline: BoxFuture<'a, anyhow::Result<Vec<String>>> = Box::pin(async move {
+        let ((), (), (), ids) = futures::try_join!(chunker, tokenizer, embedder, storer)?;
+        Ok(ids)
+    });
+
+    enum Event {
+        Finished(usize),
+        Done(anyhow::Result<Vec<String>>),
+    }
+    let mut events = futures::stream::select(
+        progress_rx.map(Event::Finished),
+        futures::stream::once(pipeline).map(Event::Done),
+    );
+    boxed!(try_stream! {
+        let mut finished = 0;
+        while let Some(event) = events.next().await {
+            match event {
+                // The event completing the count is the one carrying the result
+                Event::Finished(count) => {
+                    finished += count;
+                    if finished < total {
+                        yield CacheProgress {
+                            comment: format!("{} of {} documents ingested", finished, total),
+                            current_task: finished,
+                            total_task: total,
+                            result: None,
+                        };
+                    }
+                }
+                Event::Done(result) => {
+                    yield CacheProgress {
+                        comment: format!("{} of {} documents ingested", total, total),
+                        current_task: total,
+                        total_task: total,
+                        result: Some(result?),
+                    };
+                    break;
+                }
+            }
+        }
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn chunk_text_splits_at_whitespace_with_overlap() {
+        let text = "alpha beta gamma delta epsilon zeta eta theta";
+        let chunks = chunk_text(text, 16, 6);
+        assert_eq!(
+            chunks,
+            vec![
+                "alpha beta gamma",
+                "gamma delta",
+                "delta epsilon",
+                // "epsilon" is longer than the overlap, so it isn't repeated
+                "zeta eta theta",
+            ]
+        );
+        assert!(chunks.iter().all(|chunk| chunk.chars().count() <= 16));
+
+        // Without overlap the chunks partition the words
+        assert_eq!(chunk_text(text, 16, 0).join(" "), text);
+        // A word longer than a chunk is cut, multi-byte characters stay whole
+        assert_eq!(chunk_text("ééééé", 2, 0), vec!["éé", "éé", "é"]);
+        assert!(chunk_text("  \n ", 4, 1).is_empty());
+    }
+}
@@ -52,7 +52,10 @@
 //!   Internally, it's unified abstraction that wraps either a [`VectorStoreKnowledge`] or a [`CustomKnowledge`] implementation.
 //! - [`KnowledgeBehavior`]: Trait defining how a knowledge source retrieves documents.
 //! - [`KnowledgeTool`]: Exposes a retriever as an LLM-callable tool.
-//! - [`KnowledgeConfig`]: Retrieval configuration (e.g., `top_k` results).
+//! - [`Knowledge::ingest`]: Chunks, embeds and stores documents in a vector-store
+//!   knowledge, configured by an [`IngestConfig`].
+//! - [`KnowledgeConfig`]: Retrieval configuration (e.g., `top_k` results, a distance `radius`,
+//!   or a dense, lexical or hybrid [`KnowledgeRetrievalMode`]).
 //!
 //! # Example
 //!
@@ -68,7 +71,7 @@
 //!
 //! // Retrieve relevant documents for a query
 //! let results = knowledge
-//!     .retrieve("What is Rust async?".into(), KnowledgeConfig { top_k: 3 })
+//!     .retrieve("What is Rust async?".into(), KnowledgeConfig { top_k: Some(3), ..Default::default() })
 //!     .await
 //!     .unwrap();
 //!
@@ -81,6 +84,10 @@
 //! - [`crate::vector_store::VectorStore`]: For building custom vector-based retrieval backends.
 pub(crate) mod base;
 pub(crate) mod custom_knowledge;
+pub(crate) mod ingest;
 pub(crate) mod vector_store_knowledge;
 
-pub use base::{Knowledge, KnowledgeBehavior, KnowledgeConfig, KnowledgeTool};
+pub use base::{
+    Knowledge, KnowledgeBehavior, KnowledgeConfig, KnowledgeRetrievalMode, KnowledgeTool,
+};
+pub use ingest::IngestConfig;
@@ -1,10 +1,17 @@
+use std::{collections::HashMap, sync::Arc};
+
 use ailoy_macros::multi_platform_async_trait;
 
-use super::base::{KnowledgeBehavior, KnowledgeConfig};
+use super::{
+    base::{KnowledgeBehavior, KnowledgeConfig, KnowledgeRetrievalMode},
+    ingest::{IngestConfig, ingest},
+};
 use crate::{
+    cache::CacheProgress,
     model::{EmbeddingModel, EmbeddingModelInference},
+    utils::BoxStream,
     value::Document,
-    vector_store::{VectorStore, VectorStoreRetrieveResult},
+    vector_store::{VectorStore, VectorStoreRetrieveHit},
 };
 
 #[derive(Debug, Clone)]
@@ -13,8 +20,8 @@ pub struct VectorStoreKnowledge {
     embedding_model: EmbeddingModel,
 }
 
-impl From<VectorStoreRetrieveResult> for Document {
-    fn from(value: VectorStoreRetrieveResult) -> Self {
+impl From<VectorStoreRetrieveHit> for Document {
+    fn from(value: VectorStoreRetrieveHit) -> Self {
         let title = if let Some(metadata) = &value.metadata
             && let Some(raw_title) = metadata.get("title")
         {
@@ -28,13 +35,45 @@ impl From<VectorStoreRetrieveResult> for Document {
             None
         };
         Self {
-            id: value.id,
+            id: value.id.to_string(),
             title,
-            text: value.document,
+            text: value.document.to_string(),
         }
     }
 }
 
+/// Damps the weight of the top ranks in reciprocal-rank fusion; 60 is the value
+/// of the original paper and works well across rankings of different scale.
+const RRF_K: f64 = 60.0;
+/// Each ranking contributes this many times `top_k` documents to the fusion.
+const FUSION_DEPTH_FACTOR: usize = 4;
+
+/// Merges rankings by reciprocal-rank fusion: a document scores `1 / (RRF_K + rank)`
+/// summed over the rankings it appears in, which needs no calibration between
+/// distances and BM25 scores. Returns the `top_k` best with that score as `distance`.
+fn reciprocal_rank_fusion(
+    rankings: Vec<Vec<VectorStoreRetrieveHit>>,
+    top_k: usize,
+) -> Vec<VectorStoreRetrieveHit> {
+    let mut fused: HashMap<Arc<str>, VectorStoreRetrieveHit> = HashMap::new();
+    for ranking in rankings {
+        for (rank, result) in ranking.into_iter().enumerate() {
+            let score = 1.0 / (RRF_K + rank as f64 + 1.0);
+            fused
+                .entry(result.id.clone())
+                .or_insert(VectorStoreRetrieveHit {
+                    distance: 0.0,
+                    ..result
+                })
+                .distance += score;
+        }
+    }
+    let mut fused: Vec<_> = fused.into_values().collect();
+    fused.sort_by(|a, b| b.distance.total_cmp(&a.distance).then(a.id.cmp(&b.id)));
+    fused.truncate(top_k);
+    fused
+}
+
 impl VectorStoreKnowledge {
     pub fn new(store: VectorStore, embedding_model: EmbeddingModel) -> Self {
         Self {
@@ -42,6 +81,48 @@ impl VectorStoreKnowledge {
             embedding_model: embedding_model,
         }
     }
+
+    /// Chunks, embeds and stores `documents`; see [`super::ingest`].
+    pub fn ingest<'a>(
+        &self,
+        documents: Vec<Document>,
+        config: IngestConfig,
+    ) -> BoxStream<'a, anyhow::Result<CacheProgress<Vec<String>>>> {
+        ingest(
+            self.store.clone(),
+            self.embedding_model.clone(),
+            documents,
+            config,
+        )
+    }
+
+    async fn retrieve_dense(
+        &self,
+        query: String,
+        top_k: Option<u32>,
+        config: &KnowledgeConfig,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        let query_embedding = self.embedding_model.infer(query).await?;
+        match config.radius {
+            Some(radius) => {
+                let mut results = self.store.retrieve_within(query_embedding, radius).await?;
+                if let Some(top_k) = top_k {
+                    results.truncate(top_k as usize);
+                }
+                Ok(results)
+            }
+            None => {
+                self.store
+                    .retrieve(
+                        query_embedding,
+                        top_k.unwrap_or_default() as usize,
+                        None,
+                        Some(config.search_params()),
+                    )
+                    .await
+            }
+        }
+    }
 }
 
 #[multi_platform_async_trait]
@@ -51,14 +132,24 @@ impl KnowledgeBehavior for VectorStoreKnowledge {
         query: String,
         config: KnowledgeConfig,
     ) -> anyhow::Result<Vec<Document>> {
-        let query_embedding = self.embedding_model.infer(query.into()).await?;
-        let results = self
-            .store
-            .retrieve(query_embedding, config.top_k.unwrap_or_default() as usize)
-            .await?
-            .into_iter()
-            .map(|res| res.into())
-            .collect::<Vec<_>>();
+        let top_k = config.top_k.unwrap_or_default() as usize;
+        let results = match config.mode.unwrap_or_default() {
+            KnowledgeRetrievalMode::Dense => {
+                self.retrieve_dense(query, config.top_k, &config).await?
+            }
+            KnowledgeRetrievalMode::Lexical => self.store.retrieve_lexical(query, top_k).await?,
+            KnowledgeRetrievalMode::Hybrid => {
+                let depth = top_k * FUSION_DEPTH_FACTOR;
+                let (dense, lexical) = futures::try_join!(
+                    self.retrieve_dense(query.clone(), Some(depth as u32), &config),
+                    self.store.retrieve_lexical(query, depth),
+                )?;
+                reciprocal_rank_fusion(vec![dense, lexical], top_k)
+            }
+        }
+        .into_iter()
+        .map(|res| res.into())
+        .collect::<Vec<_>>();
 
         Ok(results)
     }
@@ -84,7 +175,7 @@ mod tests {
     };
 
     async fn prepare_knowledge() -> anyhow::Result<Knowledge> {
-        let mut store = VectorStore::new_faiss(1024).await.unwrap();
+        let mut store = VectorStore::new_faiss(1024, None).await.unwrap();
         let embedding_model = EmbeddingModel::try_new_local("BAAI/bge-m3", None)
             .await
             .unwrap();
@@ -110,6 +201,70 @@ mod tests {
         Ok(knowledge)
     }
 
+    #[test]
+    fn reciprocal_rank_fusion_favors_documents_ranked_by_both() {
+        let result = |id: &str| VectorStoreRetrieveHit {
+            id: id.into(),
+            document: format!("doc {}", id).into(),
+            metadata: None,
+            distance: 0.5,
+        };
+        let dense = vec![result("a"), result("b"), result("c")];
+        let lexical = vec![result("d"), result("c"), result("a")];
+
+        let fused = reciprocal_rank_fusion(vec![dense, lexical], 3);
+        let ids: Vec<_> = fused.iter().map(|r| &*r.id).collect();
+        assert_eq!(ids, vec!["a", "c", "d"]);
+        assert_eq!(&*fused[1].document, "doc c");
+        assert!((fused[0].distance - (1.0 / 61.0 + 1.0 / 63.0)).abs() < 1e-12);
+    }
+
+    #[multi_platform_test]
+    async fn test_vectorstore_knowledge_ingest() -> anyhow::Result<()> {
+        let store = VectorStore::new_faiss(1024, None).await?;
+        let embedding_model = EmbeddingModel::try_new_local("BAAI/bge-m3", None).await?;
+        let knowledge = Knowledge::new_vector_store(store.clone(), embedding_model);
+
+        let documents = vec![
+            Document {
+                id: "ailoy".into(),
+                title: Some("Ailoy".into()),
+                text: "Ailoy is an awesome AI agent framework. ".repeat(8),
+            },
+            Document {
+                id: "empty".into(),
+                title: None,
+                text: "   ".into(),
+            },
+            Document {
+                id: "langchain".into(),
+                title: None,
+                text: "Langchain is a library".into(),
+            },
+        ];
+        let config = IngestConfig {
+            chunk_size: Some(100),
+            chunk_overlap: Some(20),
+            batch_size: Some(2),
+        };
+        let mut strm = knowledge.ingest(documents, Some(config));
+        let mut ids = None;
+        while let Some(progress) = strm.next().await {
+            let progress = progress?;
+            assert_eq!(progress.total_task, 3);
+            ids = progress.result;
+        }
+        let ids = ids.unwrap();
+        assert!(ids.len() > 2);
+        assert_eq!(store.count().await?, ids.len());
+
+        let results = knowledge
+            .retrieve("What is Ailoy?".into(), KnowledgeConfig::default())
+            .await?;
+        assert_eq!(results[0].title.as_deref(), Some("Ailoy"));
+        Ok(())
+    }
+
     #[multi_platform_test]
     async fn test_vectorstore_knowledge_with_agent() -> anyhow::Result<()> {
         let knowledge = prepare_knowledge().await?;
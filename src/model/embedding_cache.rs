@@ -0,0 +1,522 @@
+//! Content-addressed cache of the embeddings an [`EmbeddingModel`](super::EmbeddingModel)
+//! computed.
+//!
+//! Entries are keyed by the SHA-1 of the model name and the whitespace-normalized
+//! text, so a repeated query skips tokenization and inference entirely. Memory holds
+//! a bounded number of entries and evicts the least recently used one. Natively,
+//! evicted entries can spill to a file that is consulted after a memory miss. The
+//! entries still in memory are written to it when the cache is dropped, so a warm
+//! cache can be reused by the next process.
+
+use std::{
+    collections::{BTreeMap, HashMap},
+    sync::Mutex,
+};
+
+use serde::{Deserialize, Serialize};
+use sha1::{Digest, Sha1};
+
+use crate::value::Embedding;
+
+const DEFAULT_MAX_ENTRIES: u32 = 4096;
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+const DEFAULT_MAX_SPILL_MB: u32 = 256;
+
+#[derive(Clone, Debug, Default, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+#[cfg_attr(feature = "nodejs", napi_derive::napi(object))]
+#[cfg_attr(feature = "wasm", derive(tsify::Tsify))]
+#[cfg_attr(feature = "wasm", tsify(from_wasm_abi, into_wasm_abi))]
+pub struct EmbeddingCacheConfig {
+    /// Embeddings kept in memory; beyond it the least recently used one is
+    /// evicted. Defaults to 4096.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub max_entries: Option<u32>,
+    /// File that evicted embeddings spill to and that memory misses are looked
+    /// up in. It is reused across runs of the same model. Ignored on the web.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub spill_path: Option<String>,
+    /// The spill file starts over once it would grow past this many megabytes.
+    /// Defaults to 256.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub max_spill_mb: Option<u32>,
+}
+
+/// Lookups served by an embedding cache since it was enabled.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+#[cfg_attr(feature = "python", pyo3_stub_gen_derive::gen_stub_pyclass)]
+#[cfg_attr(feature = "python", pyo3::pyclass(module = "ailoy._core", get_all))]
+#[cfg_attr(feature = "nodejs", napi_derive::napi(object))]
+#[cfg_attr(feature = "wasm", derive(tsify::Tsify))]
+#[cfg_attr(feature = "wasm", tsify(into_wasm_abi))]
+pub struct EmbeddingCacheMetrics {
+    /// Lookups answered from memory.
+    pub hits: i64,
+    /// Lookups answered from the spill file.
+    pub spill_hits: i64,
+    /// Lookups that had to run the model.
+    pub misses: i64,
+    /// Entries evicted from memory.
+    pub evictions: i64,
+    /// Entries currently in memory.
+    pub entries: u32,
+}
+
+pub type CacheKey = [u8; 20];
+
+/// Collapses every run of whitespace into one space and trims the ends, so
+/// texts differing only in spacing share an entry.
+pub fn normalize_text(text: &str) -> String {
+    text.split_whitespace().collect::<Vec<_>>().join(" ")
+}
+
+#[derive(Debug, Default)]
+struct CacheState {
+    entries: HashMap<CacheKey, (Embedding, u64)>,
+    /// Keys by their last use, oldest first.
+    recency: BTreeMap<u64, CacheKey>,
+    tick: u64,
+    metrics: EmbeddingCacheMetrics,
+}
+
+impl CacheState {
+    fn touch(&mut self, key: &CacheKey) {
+        if let Some((_, last_use)) = self.entries.get_mut(key) {
+            self.recency.remove(last_use);
+            self.tick += 1;
+            *last_use = self.tick;
+            self.recency.insert(self.tick, *key);
+        }
+    }
+}
+
+#[derive(Debug)]
+pub struct EmbeddingCache {
+    model_name: String,
+    max_entries: usize,
+    state: Mutex<CacheState>,
+    /// Synchronizes itself, so that its file I/O runs without holding `state`.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    spill: Option<spill::SpillFile>,
+}
+
+impl EmbeddingCache {
+    pub fn new(
+        model_name: impl Into<String>,
+        config: &EmbeddingCacheConfig,
+    ) -> anyhow::Result<Self> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        let spill = match &config.spill_path {
+            Some(path) => {
+                let max_bytes = (config.max_spill_mb.unwrap_or(DEFAULT_MAX_SPILL_MB) as u64) << 20;
+                Some(spill::SpillFile::open(path, max_bytes)?)
+            }
+            None => None,
+        };
+        Ok(Self {
+            model_name: model_name.into(),
+            max_entries: config.max_entries.unwrap_or(DEFAULT_MAX_ENTRIES).max(1) as usize,
+            state: Mutex::new(CacheState::default()),
+            #[cfg(any(target_family = "unix", target_family = "windows"))]
+            spill,
+        })
+    }
+
+    /// Key of `text`, which should already be normalized.
+    pub fn key(&self, text: &str) -> CacheKey {
+        let mut hasher = Sha1::new();
+        hasher.update(self.model_name.as_bytes());
+        hasher.update([0]);
+        hasher.update(text.as_bytes());
+        hasher.finalize().into()
+    }
+
+    pub fn get(&self, key: &CacheKey) -> Option<Embedding> {
+        {
+            let mut state = self.state.lock().unwrap();
+            if let Some((embedding, _)) = state.entries.get(key) {
+                let embedding = embedding.clone();
+                state.touch(key);
+                state.metrics.hits += 1;
+                return Some(embedding);
+            }
+        }
+
+        // The spill file is read after the memory lock is released
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        if let Some(spill) = &self.spill
+            && let Some(embedding) = spill.get(key)
+        {
+            let evicted = {
+                let mut state = self.state.lock().unwrap();
+                state.metrics.spill_hits += 1;
+                self.insert_locked(&mut state, *key, embedding.clone())
+            };
+            self.spill(evicted);
+            return Some(embedding);
+        }
+
+        self.state.lock().unwrap().metrics.misses += 1;
+        None
+    }
+
+    pub fn insert(&self, key: CacheKey, embedding: Embedding) {
+        let evicted = {
+            let mut state = self.state.lock().unwrap();
+            self.insert_locked(&mut state, key, embedding)
+        };
+        self.spill(evicted);
+    }
+
+    /// Inserts `embedding` and returns the entries it pushed out of memory.
+    fn insert_locked(
+        &self,
+        state: &mut CacheState,
+        key: CacheKey,
+        embedding: Embedding,
+    ) -> Vec<(CacheKey, Embedding)> {
+        if state.entries.contains_key(&key) {
+            state.touch(&key);
+            return vec![];
+        }
+        state.tick += 1;
+        let tick = state.tick;
+        state.entries.insert(key, (embedding, tick));
+        state.recency.insert(tick, key);
+
+        let mut evicted = vec![];
+        while state.entries.len() > self.max_entries {
+            let (_, key) = state.recency.pop_first().unwrap();
+            let (embedding, _) = state.entries.remove(&key).unwrap();
+            state.metrics.evictions += 1;
+            evicted.push((key, embedding));
+        }
+        evicted
+    }
+
+    /// Writes evicted entries to the spill file, if there is one. Must be called
+    /// without holding `state`.
+    fn spill(&self, _evicted: Vec<(CacheKey, Embedding)>) {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        if let Some(spill) = &self.spill {
+            for (key, embedding) in &_evicted {
+                spill.put(key, embedding);
+            }
+        }
+    }
+
+    /// Writes every entry held in memory to the spill file, so that the next cache
+    /// opened on it starts warm. Entries already in the file are skipped.
+    pub fn flush(&self) {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        if let Some(spill) = &self.spill {
+            let entries: Vec<(CacheKey, Embedding)> = {
+                let state = self.state.lock().unwrap();
+                state
+                    .entries
+                    .iter()
+                    .map(|(key, (embedding, _))| (*key, embedding.clone()))
+                    .collect()
+            };
+            for (key, embedding) in &entries {
+                spill.put(key, embedding);
+            }
+        }
+    }
+
+    pub fn metrics(&self) -> EmbeddingCacheMetrics {
+        let state = self.state.lock().unwrap();
+        EmbeddingCacheMetrics {
+            entries: state.entries.len() as u32,
+            ..state.metrics
+        }
+    }
+}
+
+impl Drop for EmbeddingCache {
+    fn drop(&mut self) {
+        self.flush();
+    }
+}
+
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+mod spill {
+    //! Append-only file of `key | u32 dimension | dimension x f32` records, all
+    //! little-endian. The offsets of the records are indexed when it is opened.
+    //!
+    //! Only the index is locked. Records are read and written by offset after the
+    //! lock is released, so lookups and spills of other keys go on meanwhile.
+
+    use std::{
+        collections::HashMap,
+        fs::File,
+        io::{BufReader, Read},
+        sync::Mutex,
+    };
+
+    use anyhow::Context;
+
+    use super::CacheKey;
+    use crate::value::Embedding;
+
+    const HEADER_LEN: u64 = 24;
+
+    #[derive(Debug)]
+    struct SpillIndex {
+        offsets: HashMap<CacheKey, u64>,
+        len: u64,
+        /// Bumped whenever the file starts over, so that a write that raced with
+        /// it is not indexed.
+        generation: u64,
+    }
+
+    #[derive(Debug)]
+    pub struct SpillFile {
+        file: File,
+        index: Mutex<SpillIndex>,
+        max_bytes: u64,
+    }
+
+    #[cfg(target_family = "unix")]
+    fn read_at(file: &File, buf: &mut [u8], offset: u64) -> std::io::Result<()> {
+        std::os::unix::fs::FileExt::read_exact_at(file, buf, offset)
+    }
+
+    #[cfg(target_family = "unix")]
+    fn write_at(file: &File, buf: &[u8], offset: u64) -> std::io::Result<()> {
+        std::os::unix::fs::FileExt::write_all_at(file, buf, offset)
+    }
+
+    #[cfg(target_family = "windows")]
+    fn read_at(file: &File, mut buf: &mut [u8], mut offset: u64) -> std::io::Result<()> {
+        use std::os::windows::fs::FileExt;
+
+        while !buf.is_empty() {
+            match file.seek_read(buf, offset)? {
+                0 => return Err(std::io::ErrorKind::UnexpectedEof.into()),
+                n => {
+                    buf = &mut buf[n..];
+                    offset += n as u64;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    #[cfg(target_family = "windows")]
+    fn write_at(file: &File, mut buf: &[u8], mut offset: u64) -> std::io::Result<()> {
+        use std::os::windows::fs::FileExt;
+
+        while !buf.is_empty() {
+            match file.seek_write(buf, offset)? {
+                0 => return Err(std::io::ErrorKind::WriteZero.into()),
+                n => {
+                    buf = &buf[n..];
+                    offset += n as u64;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    impl SpillFile {
+        pub fn open(path: &str, max_bytes: u64) -> anyhow::Result<Self> {
+            let file = std::fs::OpenOptions::new()
+                .read(true)
+                .write(true)
+                .create(true)
+                .truncate(false)
+                .open(path)
+                .with_context(|| format!("Failed to open embedding spill file {}", path))?;
+
+            // Index the complete records; a record cut short by a crash is dropped
+            let mut offsets = HashMap::new();
+            let mut len = 0u64;
+            let mut reader = BufReader::new(&file);
+            let mut header = [0u8; HEADER_LEN as usize];
+            while reader.read_exact(&mut header).is_ok() {
+                let key: CacheKey = header[..20].try_into().unwrap();
+                let dimension = u32::from_le_bytes(header[20..].try_into().unwrap()) as u64;
+                let record_len = HEADER_LEN + dimension * 4;
+                if std::io::copy(&mut (&mut reader).take(dimension * 4), &mut std::io::sink())?
+                    != dimension * 4
+                {
+                    break;
+                }
+                offsets.insert(key, len);
+                len += record_len;
+            }
+            drop(reader);
+            file.set_len(len)
+                .context("Failed to truncate embedding spill file")?;
+
+            Ok(Self {
+                file,
+                index: Mutex::new(SpillIndex {
+                    offsets,
+                    len,
+                    generation: 0,
+                }),
+                max_bytes,
+            })
+        }
+
+        pub fn get(&self, key: &CacheKey) -> Option<Embedding> {
+            let offset = *self.index.lock().unwrap().offsets.get(key)?;
+            let result = (|| -> std::io::Result<Option<Vec<f32>>> {
+                let mut header = [0u8; HEADER_LEN as usize];
+                read_at(&self.file, &mut header, offset)?;
+                // The file may have started over since the offset was looked up
+                if header[..20] != key[..] {
+                    return Ok(None);
+                }
+                let dimension = u32::from_le_bytes(header[20..].try_into().unwrap()) as usize;
+                let mut bytes = vec![0u8; dimension * 4];
+                read_at(&self.file, &mut bytes, offset + HEADER_LEN)?;
+                Ok(Some(
+                    bytes
+                        .chunks_exact(4)
+                        .map(|chunk| f32::from_le_bytes(chunk.try_into().unwrap()))
+                        .collect(),
+                ))
+            })();
+            match result {
+                Ok(vector) => vector.map(Into::into),
+                Err(e) => {
+                    crate::warn!("Failed to read the embedding spill file: {}", e);
+                    None
+                }
+            }
+        }
+
+        /// Appends `embedding` unless `key` is already spilled. When the file would
+        /// outgrow its budget it starts over.
+        pub fn put(&self, key: &CacheKey, embedding: &Embedding) {
+            let vector = embedding.as_slice();
+            let mut record = Vec::with_capacity(HEADER_LEN as usize + vector.len() * 4);
+            record.extend_from_slice(key);
+            record.extend_from_slice(&(vector.len() as u32).to_le_bytes());
+            for value in vector {
+                record.extend_from_slice(&value.to_le_bytes());
+            }
+
+            // Reserve the record's place under the lock and write it after releasing it
+            let (offset, generation) = {
+                let mut index = self.index.lock().unwrap();
+                if index.offsets.contains_key(key) {
+                    return;
+                }
+                if index.len + record.len() as u64 > self.max_bytes {
+                    if let Err(e) = self.file.set_len(0) {
+                        crate::warn!("Failed to reset the embedding spill file: {}", e);
+                        return;
+                    }
+                    index.offsets.clear();
+                    index.len = 0;
+                    index.generation += 1;
+                }
+                let offset = index.len;
+                index.len += record.len() as u64;
+                (offset, index.generation)
+            };
+
+            match write_at(&self.file, &record, offset) {
+                Ok(()) => {
+                    let mut index = self.index.lock().unwrap();
+                    if index.generation == generation {
+                        index.offsets.insert(*key, offset);
+                    }
+                }
+                Err(e) => crate::warn!("Failed to write the embedding spill file: {}", e),
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn embedding(value: f32) -> Embedding {
+        vec![value, value + 1.0].into()
+    }
+
+    #[test]
+    fn embedding_cache_evicts_least_recently_used() {
+        let config = EmbeddingCacheConfig {
+            max_entries: Some(2),
+            ..Default::default()
+        };
+        let cache = EmbeddingCache::new("model", &config).unwrap();
+        let [a, b, c] = ["a", "b", "c"].map(|text| cache.key(text));
+        assert_ne!(a, EmbeddingCache::new("other", &config).unwrap().key("a"));
+
+        cache.insert(a, embedding(0.0));
+        cache.insert(b, embedding(1.0));
+        // Using `a` leaves `b` as the oldest entry
+        assert_eq!(cache.get(&a), Some(embedding(0.0)));
+        cache.insert(c, embedding(2.0));
+        assert_eq!(cache.get(&b), None);
+        assert_eq!(cache.get(&c), Some(embedding(2.0)));
+
+        assert_eq!(
+            cache.metrics(),
+            EmbeddingCacheMetrics {
+                hits: 2,
+                spill_hits: 0,
+                misses: 1,
+                evictions: 1,
+                entries: 2,
+            }
+        );
+        assert_eq!(normalize_text("  what is\n\tailoy? "), "what is ailoy?");
+    }
+
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    #[test]
+    fn embedding_cache_spills_evicted_entries() {
+        let path = std::env::temp_dir().join(format!("ailoy-spill-{}.bin", uuid::Uuid::new_v4()));
+        let config = EmbeddingCacheConfig {
+            max_entries: Some(1),
+            spill_path: Some(path.to_string_lossy().into_owned()),
+            ..Default::default()
+        };
+        {
+            let cache = EmbeddingCache::new("model", &config).unwrap();
+            cache.insert(cache.key("a"), embedding(0.0));
+            cache.insert(cache.key("b"), embedding(1.0));
+            assert_eq!(cache.get(&cache.key("a")), Some(embedding(0.0)));
+            assert_eq!(cache.metrics().spill_hits, 1);
+        }
+
+        // Both entries were spilled by now, and a new cache finds them
+        let cache = EmbeddingCache::new("model", &config).unwrap();
+        assert_eq!(cache.get(&cache.key("b")), Some(embedding(1.0)));
+        assert_eq!(cache.get(&cache.key("c")), None);
+        assert_eq!(cache.metrics().spill_hits, 1);
+        std::fs::remove_file(path).unwrap();
+    }
+
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    #[test]
+    fn embedding_cache_flushes_memory_on_drop() {
+        let path = std::env::temp_dir().join(format!("ailoy-spill-{}.bin", uuid::Uuid::new_v4()));
+        let config = EmbeddingCacheConfig {
+            spill_path: Some(path.to_string_lossy().into_owned()),
+            ..Default::default()
+        };
+        {
+            let cache = EmbeddingCache::new("model", &config).unwrap();
+            cache.insert(cache.key("a"), embedding(0.0));
+            assert_eq!(cache.metrics().evictions, 0);
+        }
+
+        // Nothing was evicted, yet the entry reached the spill file
+        let cache = EmbeddingCache::new("model", &config).unwrap();
+        assert_eq!(cache.get(&cache.key("a")), Some(embedding(0.0)));
+        assert_eq!(cache.metrics().spill_hits, 1);
+        drop(cache);
+        std::fs::remove_file(path).unwrap();
+    }
+}
@@ -1,6 +1,10 @@
+use std::sync::Arc;
+
 use ailoy_macros::{maybe_send_sync, multi_platform_async_trait};
 use futures::StreamExt as _;
 
+use super::embedding_cache::{EmbeddingCache, normalize_text};
+pub use super::embedding_cache::{EmbeddingCacheConfig, EmbeddingCacheMetrics};
 pub use super::local::LocalEmbeddingModelConfig;
 use super::local::local_embedding_model::LocalEmbeddingModel;
 use crate::{cache::CacheProgress, utils::BoxStream, value::Embedding};
@@ -9,6 +13,9 @@ use crate::{cache::CacheProgress, utils::BoxStream, value::Embedding};
 #[multi_platform_async_trait]
 pub trait EmbeddingModelInference {
     async fn infer(self: &Self, text: String) -> anyhow::Result<Embedding>;
+
+    /// Embeds `texts` together, in the order given.
+    async fn infer_batch(self: &Self, texts: Vec<String>) -> anyhow::Result<Vec<Embedding>>;
 }
 
 #[derive(Debug, Clone)]
@@ -23,18 +30,27 @@ enum EmbeddingModelInner {
 #[cfg_attr(feature = "wasm", wasm_bindgen::prelude::wasm_bindgen)]
 pub struct EmbeddingModel {
     inner: EmbeddingModelInner,
+    model_name: String,
+    /// Shared by clones, so every handle of a model benefits from its hits.
+    cache: Option<Arc<EmbeddingCache>>,
 }
 
 impl EmbeddingModel {
+    fn from_local(model_name: String, model: LocalEmbeddingModel) -> Self {
+        Self {
+            inner: EmbeddingModelInner::Local(model),
+            model_name,
+            cache: None,
+        }
+    }
+
     pub async fn try_new_local(
         model_name: impl Into<String>,
         config: Option<LocalEmbeddingModelConfig>,
     ) -> anyhow::Result<Self> {
-        Ok(Self {
-            inner: EmbeddingModelInner::Local(
-                LocalEmbeddingModel::try_new(model_name, config).await?,
-            ),
-        })
+        let model_name = model_name.into();
+        let model = LocalEmbeddingModel::try_new(model_name.clone(), config).await?;
+        Ok(Self::from_local(model_name, model))
     }
 
     pub async fn try_new_local_stream<'a>(
@@ -43,14 +59,14 @@ impl EmbeddingModel {
     ) -> BoxStream<'a, anyhow::Result<CacheProgress<Self>>> {
         let model_name = model_name.into();
         Box::pin(async_stream::try_stream! {
-            let mut strm = LocalEmbeddingModel::try_new_stream(model_name, config);
+            let mut strm = LocalEmbeddingModel::try_new_stream(model_name.clone(), config);
             while let Some(result) = strm.next().await {
                 let result = result?;
                 yield CacheProgress {
                     comment: result.comment,
                     current_task: result.current_task,
                     total_task: result.total_task,
-                    result: result.result.map(|v| EmbeddingModel{inner: EmbeddingModelInner::Local(v)}),
+                    result: result.result.map(|v| EmbeddingModel::from_local(model_name.clone(), v)),
                 };
             }
         })
@@ -65,14 +81,95 @@ impl EmbeddingModel {
     pub async fn remove(model: impl Into<String>) -> anyhow::Result<()> {
         LocalEmbeddingModel::remove(model).await
     }
+
+    /// Caches the embeddings this model computes, replacing any cache enabled
+    /// before. Texts are looked up with their whitespace collapsed, and texts
+    /// that miss are also embedded in that form.
+    pub fn enable_cache(&mut self, config: EmbeddingCacheConfig) -> anyhow::Result<()> {
+        self.cache = Some(Arc::new(EmbeddingCache::new(
+            self.model_name.clone(),
+            &config,
+        )?));
+        Ok(())
+    }
+
+    pub fn cache_metrics(&self) -> Option<EmbeddingCacheMetrics> {
+        self.cache.as_ref().map(|cache| cache.metrics())
+    }
+
+    async fn infer_uncached(&self, text: String) -> anyhow::Result<Embedding> {
+        match &self.inner {
+            EmbeddingModelInner::Local(model) => model.infer(text).await,
+        }
+    }
+
+    async fn infer_batch_uncached(&self, texts: Vec<String>) -> anyhow::Result<Vec<Embedding>> {
+        match &self.inner {
+            EmbeddingModelInner::Local(model) => model.infer_batch(texts).await,
+        }
+    }
+
+    /// Tokenizes `texts` the way the model does before embedding them, so that
+    /// tokenization can run apart from inference. See [`Self::infer_tokens_batch`].
+    pub(crate) fn tokenize_batch(&self, texts: Vec<String>) -> anyhow::Result<Vec<Vec<u32>>> {
+        match &self.inner {
+            EmbeddingModelInner::Local(model) => model.tokenize_batch(texts),
+        }
+    }
+
+    /// Embeds the output of [`Self::tokenize_batch`]. The cache is bypassed.
+    pub(crate) async fn infer_tokens_batch(
+        &self,
+        input_tokens: Vec<Vec<u32>>,
+    ) -> anyhow::Result<Vec<Embedding>> {
+        match &self.inner {
+            EmbeddingModelInner::Local(model) => model.infer_tokens_batch(input_tokens).await,
+        }
+    }
 }
 
 #[multi_platform_async_trait]
 impl EmbeddingModelInference for EmbeddingModel {
     async fn infer(&self, text: String) -> anyhow::Result<Embedding> {
-        match &self.inner {
-            EmbeddingModelInner::Local(model) => model.infer(text).await,
+        let Some(cache) = &self.cache else {
+            return self.infer_uncached(text).await;
+        };
+        let text = normalize_text(&text);
+        let key = cache.key(&text);
+        if let Some(embedding) = cache.get(&key) {
+            return Ok(embedding);
         }
+        let embedding = self.infer_uncached(text).await?;
+        cache.insert(key, embedding.clone());
+        Ok(embedding)
+    }
+
+    /// Embeds `texts` with one forward pass over the ones the cache, if any,
+    /// does not hold.
+    async fn infer_batch(&self, texts: Vec<String>) -> anyhow::Result<Vec<Embedding>> {
+        let Some(cache) = &self.cache else {
+            return self.infer_batch_uncached(texts).await;
+        };
+        let mut embeddings = Vec::with_capacity(texts.len());
+        let mut missing = Vec::new();
+        for text in texts {
+            let text = normalize_text(&text);
+            let key = cache.key(&text);
+            let embedding = cache.get(&key);
+            if embedding.is_none() {
+                missing.push((embeddings.len(), key, text));
+            }
+            embeddings.push(embedding);
+        }
+        if !missing.is_empty() {
+            let texts = missing.iter().map(|(_, _, text)| text.clone()).collect();
+            let computed = self.infer_batch_uncached(texts).await?;
+            for ((index, key, _), embedding) in missing.into_iter().zip(computed) {
+                cache.insert(key, embedding.clone());
+                embeddings[index] = Some(embedding);
+            }
+        }
+        Ok(embeddings.into_iter().map(Option::unwrap).collect())
     }
 }
 
@@ -89,58 +186,54 @@ mod py {
     impl EmbeddingModel {
         #[classmethod]
         #[gen_stub(override_return_type(type_repr = "typing.Awaitable[EmbeddingModel]"))]
-        #[pyo3(name = "new_local", signature = (model_name, device_id = None, validate_checksum = None, progress_callback = None))]
+        #[pyo3(name = "new_local", signature = (model_name, device_id = None, validate_checksum = None, batch_window_micros = None, max_batch_size = None, progress_callback = None))]
         fn new_local_py<'a>(
             _cls: &Bound<'a, PyType>,
             py: Python<'a>,
             model_name: String,
             device_id: Option<i32>,
             validate_checksum: Option<bool>,
+            batch_window_micros: Option<u32>,
+            max_batch_size: Option<u32>,
             #[gen_stub(override_type(type_repr = "typing.Callable[[CacheProgress], None]"))]
             progress_callback: Option<Py<PyAny>>,
         ) -> PyResult<Bound<'a, PyAny>> {
             let config = LocalEmbeddingModelConfig {
                 device_id,
                 validate_checksum,
+                batch_window_micros,
+                max_batch_size,
             };
-            let cache_strm = LocalEmbeddingModel::try_new_stream(model_name, Some(config));
+            let cache_strm = LocalEmbeddingModel::try_new_stream(model_name.clone(), Some(config));
             let fut = async move {
                 let inner = await_cache_result(cache_strm, progress_callback).await?;
-                Python::attach(|py| {
-                    Py::new(
-                        py,
-                        EmbeddingModel {
-                            inner: EmbeddingModelInner::Local(inner),
-                        },
-                    )
-                })
+                Python::attach(|py| Py::new(py, EmbeddingModel::from_local(model_name, inner)))
             };
             pyo3_async_runtimes::tokio::future_into_py(py, fut)
         }
 
         #[classmethod]
-        #[pyo3(name = "new_local_sync", signature = (model_name, device_id=None, validate_checksum = None, progress_callback = None))]
+        #[pyo3(name = "new_local_sync", signature = (model_name, device_id=None, validate_checksum = None, batch_window_micros = None, max_batch_size = None, progress_callback = None))]
         fn new_local_sync_py(
             _cls: &Bound<'_, PyType>,
             py: Python<'_>,
             model_name: String,
             device_id: Option<i32>,
             validate_checksum: Option<bool>,
+            batch_window_micros: Option<u32>,
+            max_batch_size: Option<u32>,
             #[gen_stub(override_type(type_repr = "typing.Callable[[CacheProgress], None]"))]
             progress_callback: Option<Py<PyAny>>,
         ) -> PyResult<Py<Self>> {
             let config = LocalEmbeddingModelConfig {
                 device_id,
                 validate_checksum,
+                batch_window_micros,
+                max_batch_size,
             };
-            let cache_strm = LocalEmbeddingModel::try_new_stream(model_name, Some(config));
+            let cache_strm = LocalEmbeddingModel::try_new_stream(model_name.clone(), Some(config));
             let inner = await_future(py, await_cache_result(cache_strm, progress_callback))?;
-            Py::new(
-                py,
-                EmbeddingModel {
-                    inner: EmbeddingModelInner::Local(inner),
-                },
-            )
+            Py::new(py, EmbeddingModel::from_local(model_name, inner))
         }
 
         #[classmethod]
@@ -169,18 +262,51 @@ mod py {
 
         #[pyo3(signature = (text))]
         async fn infer(&mut self, text: String) -> PyResult<Embedding> {
-            match &mut self.inner {
-                EmbeddingModelInner::Local(model) => model.infer(text).await,
-            }
-            .map_err(Into::into)
+            EmbeddingModelInference::infer(&*self, text)
+                .await
+                .map_err(Into::into)
         }
 
         #[pyo3(signature = (text))]
         fn infer_sync(&mut self, py: Python<'_>, text: String) -> PyResult<Embedding> {
-            let fut = match &mut self.inner {
-                EmbeddingModelInner::Local(model) => model.infer(text),
-            };
-            await_future(py, fut).map_err(Into::into)
+            await_future(py, EmbeddingModelInference::infer(&*self, text)).map_err(Into::into)
+        }
+
+        #[pyo3(signature = (texts))]
+        async fn infer_batch(&mut self, texts: Vec<String>) -> PyResult<Vec<Embedding>> {
+            EmbeddingModelInference::infer_batch(&*self, texts)
+                .await
+                .map_err(Into::into)
+        }
+
+        #[pyo3(signature = (texts))]
+        fn infer_batch_sync(
+            &mut self,
+            py: Python<'_>,
+            texts: Vec<String>,
+        ) -> PyResult<Vec<Embedding>> {
+            await_future(py, EmbeddingModelInference::infer_batch(&*self, texts))
+                .map_err(Into::into)
+        }
+
+        #[pyo3(name = "enable_cache", signature = (max_entries = None, spill_path = None, max_spill_mb = None))]
+        fn enable_cache_py(
+            &mut self,
+            max_entries: Option<u32>,
+            spill_path: Option<String>,
+            max_spill_mb: Option<u32>,
+        ) -> PyResult<()> {
+            self.enable_cache(EmbeddingCacheConfig {
+                max_entries,
+                spill_path,
+                max_spill_mb,
+            })
+            .map_err(Into::into)
+        }
+
+        #[pyo3(name = "cache_metrics")]
+        fn cache_metrics_py(&self) -> Option<EmbeddingCacheMetrics> {
+            self.cache_metrics()
         }
     }
 }
@@ -198,6 +324,8 @@ mod node {
     pub struct JSLocalEmbeddingModelConfig {
         pub device_id: Option<i32>,
         pub validate_checksum: Option<bool>,
+        pub batch_window_micros: Option<u32>,
+        pub max_batch_size: Option<u32>,
         pub progress_callback:
             Option<ThreadsafeFunction<JsCacheProgress, (), JsCacheProgress, Status, false>>,
     }
@@ -211,18 +339,18 @@ mod node {
         ) -> napi::Result<EmbeddingModel> {
             let config = config.unwrap_or_default();
             let cache_strm = LocalEmbeddingModel::try_new_stream(
-                model_name,
+                model_name.clone(),
                 Some(LocalEmbeddingModelConfig {
                     device_id: config.device_id,
                     validate_checksum: config.validate_checksum,
+                    batch_window_micros: config.batch_window_micros,
+                    max_batch_size: config.max_batch_size,
                 }),
             );
             let inner = await_cache_result(cache_strm, config.progress_callback)
                 .await
                 .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))?;
-            Ok(EmbeddingModel {
-                inner: EmbeddingModelInner::Local(inner),
-            })
+            Ok(EmbeddingModel::from_local(model_name, inner))
         }
 
         #[napi(js_name = "infer")]
@@ -232,6 +360,27 @@ mod node {
                 .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
         }
 
+        #[napi(js_name = "inferBatch")]
+        pub async fn infer_batch_js(&self, texts: Vec<String>) -> napi::Result<Vec<Embedding>> {
+            self.infer_batch(texts)
+                .await
+                .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
+        }
+
+        #[napi(js_name = "enableCache")]
+        pub fn enable_cache_js(
+            &mut self,
+            config: Option<EmbeddingCacheConfig>,
+        ) -> napi::Result<()> {
+            self.enable_cache(config.unwrap_or_default())
+                .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
+        }
+
+        #[napi(js_name = "cacheMetrics")]
+        pub fn cache_metrics_js(&self) -> Option<EmbeddingCacheMetrics> {
+            self.cache_metrics()
+        }
+
         #[napi(js_name = "download")]
         pub async fn download_js(
             model_name: String,
@@ -319,18 +468,17 @@ mod wasm {
                 None => JSLocalEmbeddingModelConfig::default(),
             };
             let cache_strm = LocalEmbeddingModel::try_new_stream(
-                model_name,
+                model_name.clone(),
                 Some(LocalEmbeddingModelConfig {
                     device_id: config.device_id,
                     validate_checksum: config.validate_checksum,
+                    ..Default::default()
                 }),
             );
             let inner = await_cache_result(cache_strm, config.progress_callback)
                 .await
                 .map_err(|e| js_sys::Error::new(&e.to_string()))?;
-            Ok(Self {
-                inner: EmbeddingModelInner::Local(inner),
-            })
+            Ok(Self::from_local(model_name, inner))
         }
 
         #[wasm_bindgen(js_name = "download")]
@@ -362,5 +510,34 @@ mod wasm {
                 .await
                 .map_err(|e| js_sys::Error::new(&e.to_string()))
         }
+
+        #[wasm_bindgen(js_name = inferBatch, unchecked_return_type = "Embedding[]")]
+        pub async fn infer_batch_js(
+            &mut self,
+            texts: Vec<String>,
+        ) -> Result<js_sys::Array, js_sys::Error> {
+            let embeddings = self
+                .infer_batch(texts)
+                .await
+                .map_err(|e| js_sys::Error::new(&e.to_string()))?;
+            Ok(embeddings
+                .into_iter()
+                .map(|embedding| JsValue::from(embedding))
+                .collect())
+        }
+
+        #[wasm_bindgen(js_name = "enableCache")]
+        pub fn enable_cache_js(
+            &mut self,
+            config: Option<EmbeddingCacheConfig>,
+        ) -> Result<(), js_sys::Error> {
+            self.enable_cache(config.unwrap_or_default())
+                .map_err(|e| js_sys::Error::new(&e.to_string()))
+        }
+
+        #[wasm_bindgen(js_name = "cacheMetrics")]
+        pub fn cache_metrics_js(&self) -> Option<EmbeddingCacheMetrics> {
+            self.cache_metrics()
+        }
     }
 }
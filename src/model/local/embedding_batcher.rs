@@ -0,0 +1,172 @@
+//! Coalesces concurrent embedding requests into batched `prefill` calls.
+//!
+//! A lone request leaves most of the device idle, while one forward pass over a
+//! batch costs little more than over its longest row. Requests are queued into
+//! buckets of similar token counts, so rows padded to a shared length waste at
+//! most about half of a batch. The first request of a bucket opens a deadline;
+//! everything arriving in the bucket before it passes, or until the bucket is
+//! full, is embedded together and the vectors are fanned back out.
+
+use std::{sync::Arc, time::Duration};
+
+use anyhow::{Context, anyhow};
+use tokio::sync::oneshot;
+
+use crate::utils::{BoxFuture, MicroBatcher};
+
+/// Embeds the token sequences of a batch in one call, returning one vector per
+/// sequence in order.
+pub type EmbedRunner =
+    Arc<dyn Fn(Vec<Vec<u32>>) -> BoxFuture<'static, anyhow::Result<Vec<Vec<f32>>>> + Send + Sync>;
+
+/// Sequences up to this length share the smallest bucket.
+const MIN_BUCKET_LENGTH: usize = 16;
+/// Padded tokens a batch may hold, which bounds the activations of long inputs.
+const MAX_BATCH_TOKENS: usize = 16384;
+
+/// Bucket `b` holds sequences longer than `2^(b-1)` and at most `2^b` tokens.
+fn bucket_of(length: usize) -> u32 {
+    length
+        .max(MIN_BUCKET_LENGTH)
+        .next_power_of_two()
+        .trailing_zeros()
+}
+
+struct PendingEmbedding {
+    tokens: Vec<u32>,
+    tx: oneshot::Sender<anyhow::Result<Vec<f32>>>,
+}
+
+pub struct EmbeddingBatcher {
+    max_batch_size: usize,
+    runner: EmbedRunner,
+    /// Requests queued by bucket, each flushed once its deadline passes.
+    buckets: Arc<MicroBatcher<u32, PendingEmbedding>>,
+}
+
+impl std::fmt::Debug for EmbeddingBatcher {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("EmbeddingBatcher")
+            .field("max_delay", &self.buckets.window())
+            .field("max_batch_size", &self.max_batch_size)
+            .finish_non_exhaustive()
+    }
+}
+
+impl EmbeddingBatcher {
+    pub fn new(max_delay: Duration, max_batch_size: usize, runner: EmbedRunner) -> Self {
+        Self {
+            max_batch_size: max_batch_size.max(1),
+            runner,
+            buckets: Arc::new(MicroBatcher::new(max_delay)),
+        }
+    }
+
+    fn capacity(&self, bucket: u32) -> usize {
+        (MAX_BATCH_TOKENS >> bucket).clamp(1, self.max_batch_size)
+    }
+
+    /// Queues `tokens` for the next batch of its bucket and waits for its vector.
+    pub async fn infer(self: &Arc<Self>, tokens: Vec<u32>) -> anyhow::Result<Vec<f32>> {
+        let bucket = bucket_of(tokens.len());
+        let (tx, rx) = oneshot::channel();
+        let batcher = self.clone();
+        self.buckets.push(
+            bucket,
+            PendingEmbedding { tokens, tx },
+            self.capacity(bucket),
+            move |batch| batcher.run(batch),
+        );
+        rx.await.context("Batched embedding was dropped")?
+    }
+
+    async fn run(self: Arc<Self>, batch: Vec<PendingEmbedding>) {
+        let (tokens, waiters): (Vec<_>, Vec<_>) = batch
+            .into_iter()
+            .map(|pending| (pending.tokens, pending.tx))
+            .unzip();
+        let num_rows = tokens.len();
+        match (self.runner)(tokens).await {
+            Ok(vectors) if vectors.len() == num_rows => {
+                for (tx, vector) in waiters.into_iter().zip(vectors) {
+                    let _ = tx.send(Ok(vector));
+                }
+            }
+            result => {
+                let message = match result {
+                    Ok(vectors) => format!(
+                        "Batched embedding returned {} vectors for {} inputs",
+                        vectors.len(),
+                        num_rows
+                    ),
+                    Err(e) => format!("{:#}", e),
+                };
+                for tx in waiters {
+                    let _ = tx.send(Err(anyhow!(message.clone())));
+                }
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    use super::*;
+
+    /// Embeds each sequence as `[its length, the batch size]` and counts the calls.
+    fn length_runner(calls: Arc<AtomicUsize>) -> EmbedRunner {
+        Arc::new(move |batch: Vec<Vec<u32>>| -> BoxFuture<'static, _> {
+            calls.fetch_add(1, Ordering::Relaxed);
+            Box::pin(async move {
+                let size = batch.len() as f32;
+                Ok(batch
+                    .into_iter()
+                    .map(|tokens| vec![tokens.len() as f32, size])
+                    .collect())
+            })
+        })
+    }
+
+    #[test]
+    fn embedding_buckets_bound_padding() {
+        assert_eq!(bucket_of(0), 4);
+        assert_eq!(bucket_of(16), 4);
+        assert_eq!(bucket_of(17), 5);
+        assert_eq!(bucket_of(32), 5);
+        assert_eq!(bucket_of(8192), 13);
+    }
+
+    #[tokio::test]
+    async fn embedding_batcher_groups_requests_by_length() -> anyhow::Result<()> {
+        let calls = Arc::new(AtomicUsize::new(0));
+        let batcher = Arc::new(EmbeddingBatcher::new(
+            Duration::from_millis(20),
+            4,
+            length_runner(calls.clone()),
+        ));
+
+        // Four short requests fill a batch before the deadline
+        let vectors =
+            futures::future::try_join_all((1..=4).map(|length| batcher.infer(vec![0; length])))
+                .await?;
+        for (i, vector) in vectors.iter().enumerate() {
+            assert_eq!(vector, &vec![(i + 1) as f32, 4.0]);
+        }
+        assert_eq!(calls.load(Ordering::Relaxed), 1);
+
+        // Requests of very different lengths land in separate batches, each
+        // flushed by its deadline
+        let (short, long) =
+            futures::future::try_join(batcher.infer(vec![0; 3]), batcher.infer(vec![0; 100]))
+                .await?;
+        assert_eq!(short, vec![3.0, 1.0]);
+        assert_eq!(long, vec![100.0, 1.0]);
+        assert_eq!(calls.load(Ordering::Relaxed), 3);
+
+        // A bucket of long sequences fills at its token budget
+        assert_eq!(batcher.capacity(bucket_of(8192)), 2);
+        Ok(())
+    }
+}
@@ -126,6 +126,49 @@ pub fn claim_files(
     })
 }
 
+/// Right-pads every row of `batch` with zeros to the longest one. Returns the
+/// `[batch, length]` tokens and attention mask, flattened, and the length.
+fn pad_batch(batch: &[&[u32]]) -> (Vec<i32>, Vec<i32>, usize) {
+    let length = batch.iter().map(|tokens| tokens.len()).max().unwrap_or(0);
+    let mut tokens = vec![0i32; batch.len() * length];
+    let mut mask = vec![0i32; batch.len() * length];
+    for (row, input) in batch.iter().enumerate() {
+        let offset = row * length;
+        for (dst, &token) in tokens[offset..].iter_mut().zip(input.iter()) {
+            *dst = token as i32;
+        }
+        mask[offset..offset + input.len()].fill(1);
+    }
+    (tokens, mask, length)
+}
+
+/// Splits the `[batch, ..., hidden]` output of `prefill` into one pooled vector
+/// per row: the first `hidden` values of the row, written by `convert` straight
+/// into the returned vector.
+fn pooled_rows<T>(
+    output: &[T],
+    batch: usize,
+    hidden: usize,
+    convert: impl Fn(&[T], &mut [f32]),
+) -> anyhow::Result<Vec<Vec<f32>>> {
+    if batch == 0 || output.len() % batch != 0 || output.len() / batch < hidden {
+        anyhow::bail!(
+            "Cannot split an output of {} values into {} rows of dimension {}",
+            output.len(),
+            batch,
+            hidden
+        );
+    }
+    Ok(output
+        .chunks_exact(output.len() / batch)
+        .map(|row| {
+            let mut pooled = vec![0f32; hidden];
+            convert(&row[..hidden], &mut pooled);
+            pooled
+        })
+        .collect())
+}
+
 #[cfg(any(target_family = "unix", target_family = "windows"))]
 mod native {
     use std::path::PathBuf;
@@ -235,18 +278,31 @@ mod native {
         }
 
         pub fn infer(&mut self, tokens: &[u32]) -> anyhow::Result<Vec<f32>> {
+            Ok(self.infer_batch(&[tokens])?.pop().unwrap())
+        }
+
+        /// Embeds every row of `batch` with one `prefill` call. Rows are padded to
+        /// the longest one and the padding is masked out.
+        pub fn infer_batch(&mut self, batch: &[&[u32]]) -> anyhow::Result<Vec<Vec<f32>>> {
+            if batch.is_empty() {
+                return Ok(Vec::new());
+            }
+            let (tokens, mask, length) = pad_batch(batch);
+            if length == 0 {
+                return Err(anyhow!("Cannot embed an empty token sequence"));
+            }
             let dtype_i32 = DLDataType {
                 code: DLDataTypeCode::kDLInt as u8,
                 bits: 32,
                 lanes: 1,
             };
+            let shape = [batch.len() as i64, length as i64];
 
-            let mut input = Tensor::empty(&[1, tokens.len() as i64], dtype_i32, self.device);
-            let tokens_i32: Vec<i32> = tokens.to_vec().into_iter().map(|v| v as i32).collect();
+            let mut input = Tensor::empty(&shape, dtype_i32, self.device);
             // SAFETY: `input` has the same amount of buffer with tokens
             unsafe {
                 let tokens_slice = std::slice::from_raw_parts(
-                    tokens_i32.as_ptr() as *const u8,
+                    tokens.as_ptr() as *const u8,
                     tokens.len() * std::mem::size_of::<i32>(),
                 );
                 input
@@ -254,14 +310,15 @@ mod native {
                     .map_err(|e| anyhow!("Failed to copy tokens from host to device: {:?}", e))?;
             }
 
-            let mut mask = Tensor::empty(&[1, tokens.len() as i64], dtype_i32, self.device);
-            // SAFETY: `mask` has the same amount of buffer with tokens
+            let mut mask_tensor = Tensor::empty(&shape, dtype_i32, self.device);
+            // SAFETY: `mask_tensor` has the same amount of buffer with mask
             unsafe {
-                let mask_i32 = std::slice::from_raw_parts(
-                    vec![1i32; tokens.len()].as_ptr() as *const u8,
-                    tokens.len() * std::mem::size_of::<i32>(),
+                let mask_slice = std::slice::from_raw_parts(
+                    mask.as_ptr() as *const u8,
+                    mask.len() * std::mem::size_of::<i32>(),
                 );
-                mask.copy_from_slice(mask_i32)
+                mask_tensor
+                    .copy_from_slice(mask_slice)
                     .map_err(|e| anyhow!("Failed to copy mask from host to device: {:?}", e))?;
             }
 
@@ -269,7 +326,7 @@ mod native {
                 .fprefill
                 .call_packed(&[
                     AnyView::from(&input),
-                    AnyView::from(&mask),
+                    AnyView::from(&mask_tensor),
                     AnyView::from(&self.params),
                 ])
                 .map_err(|e| anyhow!("Failed to call `prefill`: {:?}", e))?
@@ -287,41 +344,33 @@ mod native {
                 .copy_from(&logits)
                 .map_err(|e| anyhow!("Failed to copy from device to host: {:?}", e))?;
 
-            // Copy the dense vector only
-            let last_dim = logits_cpu
+            // Copy the dense vector of each row only
+            let hidden = logits_cpu
                 .shape()
                 .last()
                 .ok_or(anyhow!("last dim should be exist"))?
                 .clone() as usize;
-            let dense_vec = if logits_cpu.dtype().bits == 16 {
-                // Copy FP16
-                let mut buffer_u16: Vec<u16> = vec![0u16; last_dim];
-                unsafe {
-                    core::ptr::copy_nonoverlapping(
-                        logits_cpu.data_ptr() as *const u16,
-                        buffer_u16.as_mut_ptr(),
-                        last_dim,
-                    );
-                }
-                let buffer_f32: Vec<f32> = buffer_u16
-                    .into_iter()
-                    .map(|v| crate::utils::float16::f16_to_f32(v))
-                    .collect();
-                buffer_f32
+            let numel = logits_cpu.shape().iter().product::<i64>() as usize;
+            if logits_cpu.dtype().bits == 16 {
+                // SAFETY: `logits_cpu` is a host tensor of `numel` FP16 values
+                let output = unsafe {
+                    std::slice::from_raw_parts(logits_cpu.data_ptr() as *const u16, numel)
+                };
+                pooled_rows(
+                    output,
+                    batch.len(),
+                    hidden,
+                    crate::utils::float16::f16_to_f32_slice,
+                )
             } else {
-                // Copy FP32
-                let mut buffer: Vec<f32> = vec![0f32; last_dim];
-                unsafe {
-                    core::ptr::copy_nonoverlapping(
-                        logits_cpu.data_ptr() as *const f32,
-                        buffer.as_mut_ptr(),
-                        last_dim,
-                    );
-                }
-                buffer
-            };
-
-            Ok(dense_vec)
+                // SAFETY: `logits_cpu` is a host tensor of `numel` FP32 values
+                let output = unsafe {
+                    std::slice::from_raw_parts(logits_cpu.data_ptr() as *const f32, numel)
+                };
+                pooled_rows(output, batch.len(), hidden, |src, dst| {
+                    dst.copy_from_slice(src)
+                })
+            }
         }
     }
 
@@ -1108,71 +1157,85 @@ mod wasm {
 
     impl EmbeddingModelInferencer {
         pub async fn infer(&mut self, tokens: &[u32]) -> Result<Vec<f32>> {
-            self.tvm.begin_scope();
-
-            let input: tvmjs::Tensor = self.tvm.detach(self.tvm.empty(
-                u32_slice_to_js(&[1, tokens.len() as u32]),
-                "int32",
-                self.device.clone().into(),
-            ));
-            let tokens_i32: Vec<i32> = tokens.to_vec().into_iter().map(|v| v as i32).collect();
-            input.copy_from_i32array(tokens_i32.as_slice());
-            self.device.sync().await;
-
-            let mask: tvmjs::Tensor = self.tvm.detach(self.tvm.empty(
-                u32_slice_to_js(&[1, tokens.len() as u32]),
-                "int32",
-                self.device.clone().into(),
-            ));
-            let mask_i32 = vec![1i32; tokens.len()];
-            mask.copy_from_i32array(mask_i32.as_slice());
-            self.device.sync().await;
-
-            let logits: tvmjs::Tensor = self
-                .fprefill
-                .call3(&input, &mask, &self.params)
-                .map_err(|e| anyhow!("Failed to call `prefill`: {:?}", e))?
-                .into();
-            input.dispose();
-            mask.dispose();
-
-            let logits_cpu = self.tvm.empty(
-                u32_slice_to_js(logits.shape().as_slice()),
-                &logits.dtype(),
-                self.tvm.cpu(),
-            );
-            logits_cpu.copy_from_tensor(&logits);
-            self.device.sync().await;
-            logits.dispose();
+            Ok(self.infer_batch(&[tokens]).await?.pop().unwrap())
+        }
 
-            let logits_shape = logits_cpu.shape();
-            let hidden_size = logits_shape
-                .last()
-                .ok_or(anyhow!("last dim should be exist"))?
-                .clone();
-            let mut dense_shape = vec![1; logits_shape.len()];
-            dense_shape[logits_shape.len() - 1] = hidden_size;
-
-            // Copy the dense vector only
-            let logits_cpu = logits_cpu.view(u32_slice_to_js(&dense_shape), None, Some(0));
-            let dense_vec = if logits_cpu.dtype() == "float16" {
-                // Copy FP16
-                let buffer_u16: Vec<u16> = logits_cpu.to_u16array();
-                let buffer_f32: Vec<f32> = buffer_u16
-                    .into_iter()
-                    .map(|v| crate::utils::float16::f16_to_f32(v))
-                    .collect();
-                buffer_f32
-            } else {
-                // Copy FP32
-                let buffer: Vec<f32> = logits_cpu.to_f32array();
-                buffer
-            };
-            logits_cpu.dispose();
+        /// Embeds every row of `batch` with one `prefill` call. Rows are padded to
+        /// the longest one and the padding is masked out.
+        pub async fn infer_batch(&mut self, batch: &[&[u32]]) -> Result<Vec<Vec<f32>>> {
+            if batch.is_empty() {
+                return Ok(Vec::new());
+            }
+            let (tokens, mask, length) = pad_batch(batch);
+            if length == 0 {
+                return Err(anyhow!("Cannot embed an empty token sequence"));
+            }
+            let shape = [batch.len() as u32, length as u32];
 
+            // Everything allocated from here on is freed by `end_scope`, which must run
+            // however the pass ends
+            self.tvm.begin_scope();
+            let rows = async {
+                let input: tvmjs::Tensor = self.tvm.detach(self.tvm.empty(
+                    u32_slice_to_js(&shape),
+                    "int32",
+                    self.device.clone().into(),
+                ));
+                input.copy_from_i32array(tokens.as_slice());
+                self.device.sync().await;
+
+                let mask_tensor: tvmjs::Tensor = self.tvm.detach(self.tvm.empty(
+                    u32_slice_to_js(&shape),
+                    "int32",
+                    self.device.clone().into(),
+                ));
+                mask_tensor.copy_from_i32array(mask.as_slice());
+                self.device.sync().await;
+
+                let logits = self.fprefill.call3(&input, &mask_tensor, &self.params);
+                input.dispose();
+                mask_tensor.dispose();
+                let logits: tvmjs::Tensor = logits
+                    .map_err(|e| anyhow!("Failed to call `prefill`: {:?}", e))?
+                    .into();
+
+                let logits_cpu = self.tvm.empty(
+                    u32_slice_to_js(logits.shape().as_slice()),
+                    &logits.dtype(),
+                    self.tvm.cpu(),
+                );
+                logits_cpu.copy_from_tensor(&logits);
+                self.device.sync().await;
+                logits.dispose();
+
+                // Copy the dense vector of each row only
+                let hidden = logits_cpu
+                    .shape()
+                    .last()
+                    .ok_or(anyhow!("last dim should be exist"))?
+                    .clone() as usize;
+                let rows = if logits_cpu.dtype() == "float16" {
+                    pooled_rows(
+                        &logits_cpu.to_u16array(),
+                        batch.len(),
+                        hidden,
+                        crate::utils::float16::f16_to_f32_slice,
+                    )
+                } else {
+                    pooled_rows(
+                        &logits_cpu.to_f32array(),
+                        batch.len(),
+                        hidden,
+                        |src, dst| dst.copy_from_slice(src),
+                    )
+                };
+                logits_cpu.dispose();
+                rows
+            }
+            .await;
             self.tvm.end_scope();
 
-            Ok(dense_vec)
+            rows
         }
     }
 
@@ -1221,3 +1284,27 @@ mod wasm {
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn pad_batch_masks_out_padding() {
+        let (tokens, mask, length) = pad_batch(&[&[5, 6, 7], &[8]]);
+        assert_eq!(length, 3);
+        assert_eq!(tokens, vec![5, 6, 7, 8, 0, 0]);
+        assert_eq!(mask, vec![1, 1, 1, 1, 0, 0]);
+
+        // `[2, 3, 2]` output pooled to the first token of each row
+        let output = [1.0, 2.0, 0.0, 0.0, 0.0, 0.0, 3.0, 4.0, 0.0, 0.0, 0.0, 0.0];
+        let rows = pooled_rows(&output, 2, 2, |src, dst| dst.copy_from_slice(src)).unwrap();
+        assert_eq!(rows, vec![vec![1.0, 2.0], vec![3.0, 4.0]]);
+        assert!(pooled_rows(&output, 5, 2, |src, dst| dst.copy_from_slice(src)).is_err());
+
+        // FP16 rows are converted in bulk
+        let output: [u16; 4] = [0x3c00, 0xc000, 0x3800, 0x0000];
+        let rows = pooled_rows(&output, 2, 2, crate::utils::float16::f16_to_f32_slice).unwrap();
+        assert_eq!(rows, vec![vec![1.0, -2.0], vec![0.5, 0.0]]);
+    }
+}
@@ -1,9 +1,13 @@
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+use std::time::Duration;
 use std::{collections::HashMap, sync::Arc};
 
 use ailoy_macros::multi_platform_async_trait;
 use async_stream::try_stream;
 use futures::{StreamExt as _, lock::Mutex};
 
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+use super::embedding_batcher::{EmbedRunner, EmbeddingBatcher};
 use super::{
     super::embedding_model::EmbeddingModelInference, inferencer::EmbeddingModelInferencer,
     tokenizer::Tokenizer,
@@ -24,12 +28,25 @@ pub struct LocalEmbeddingModel {
     inferencer: Arc<Mutex<EmbeddingModelInferencer>>,
 
     do_normalize: bool,
+
+    /// Set when concurrent requests are batched.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    batcher: Option<Arc<EmbeddingBatcher>>,
 }
 
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+const DEFAULT_MAX_BATCH_SIZE: u32 = 32;
+
 #[derive(Clone, Debug, Default)]
 pub struct LocalEmbeddingModelConfig {
     pub device_id: Option<i32>,
     pub validate_checksum: Option<bool>,
+    /// Concurrent `infer` calls of similar lengths arriving within this many
+    /// microseconds of each other are embedded as one batch. Off when unset.
+    /// Ignored on the web.
+    pub batch_window_micros: Option<u32>,
+    /// Embeds a batch as soon as it holds this many texts. Defaults to 32.
+    pub max_batch_size: Option<u32>,
 }
 
 impl LocalEmbeddingModelConfig {
@@ -42,24 +59,42 @@ impl LocalEmbeddingModelConfig {
         self.validate_checksum = Some(validate_checksum);
         self
     }
+
+    pub fn with_batch_window_micros(mut self, batch_window_micros: u32) -> Self {
+        self.batch_window_micros = Some(batch_window_micros);
+        self
+    }
+
+    pub fn with_max_batch_size(mut self, max_batch_size: u32) -> Self {
+        self.max_batch_size = Some(max_batch_size);
+        self
+    }
 }
 
 #[multi_platform_async_trait]
 impl EmbeddingModelInference for LocalEmbeddingModel {
     async fn infer(&self, text: String) -> anyhow::Result<Embedding> {
-        let input_tokens = self.tokenizer.encode(&text, true).unwrap();
+        let input_tokens = self.tokenizer.encode(&text, true)?;
+
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        if let Some(batcher) = &self.batcher {
+            let embedding = batcher.infer(input_tokens).await?;
+            return Ok(self.finish(embedding));
+        }
+
         let mut inferencer = self.inferencer.lock().await;
 
         #[cfg(target_family = "wasm")]
-        let mut embedding = inferencer.infer(&input_tokens).await.unwrap();
+        let embedding = inferencer.infer(&input_tokens).await?;
         #[cfg(not(target_family = "wasm"))]
-        let mut embedding = inferencer.infer(&input_tokens)?;
+        let embedding = inferencer.infer(&input_tokens)?;
 
-        if self.do_normalize {
-            embedding = embedding.normalized();
-        }
+        Ok(self.finish(embedding))
+    }
 
-        Ok(embedding.into())
+    async fn infer_batch(&self, texts: Vec<String>) -> anyhow::Result<Vec<Embedding>> {
+        let input_tokens = self.tokenize_batch(texts)?;
+        self.infer_tokens_batch(input_tokens).await
     }
 }
 
@@ -114,6 +149,8 @@ impl<'this> TryFromCache<'this> for LocalEmbeddingModel {
                 tokenizer,
                 inferencer: Arc::new(Mutex::new(inferencer)),
                 do_normalize: true,
+                #[cfg(any(target_family = "unix", target_family = "windows"))]
+                batcher: None,
             })
         })
     }
@@ -144,9 +181,69 @@ impl LocalEmbeddingModel {
             ctx.insert("device_id".to_owned(), Value::integer(device_id.into()));
         };
         let strm = cache.try_create::<Self>(model, Some(ctx), config.validate_checksum);
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        let strm = strm.map(move |progress| {
+            progress.map(|mut progress| {
+                progress.result = progress.result.map(|model| model.with_batcher(&config));
+                progress
+            })
+        });
         boxed!(strm)
     }
 
+    /// Puts a scheduler in front of the inferencer if `config` asks for batching.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    fn with_batcher(mut self, config: &LocalEmbeddingModelConfig) -> Self {
+        let Some(window) = config.batch_window_micros else {
+            return self;
+        };
+        let inferencer = self.inferencer.clone();
+        let runner: EmbedRunner = Arc::new(move |batch: Vec<Vec<u32>>| -> BoxFuture<'static, _> {
+            let inferencer = inferencer.clone();
+            Box::pin(async move {
+                let batch = batch.iter().map(Vec::as_slice).collect::<Vec<_>>();
+                inferencer.lock().await.infer_batch(&batch)
+            })
+        });
+        let max_batch_size = config.max_batch_size.unwrap_or(DEFAULT_MAX_BATCH_SIZE);
+        self.batcher = Some(Arc::new(EmbeddingBatcher::new(
+            Duration::from_micros(window as u64),
+            max_batch_size as usize,
+            runner,
+        )));
+        self
+    }
+
+    pub fn tokenize_batch(&self, texts: Vec<String>) -> anyhow::Result<Vec<Vec<u32>>> {
+        self.tokenizer.encode_batch(texts, true)
+    }
+
+    /// Embeds sequences produced by [`Self::tokenize_batch`] with one forward pass.
+    pub async fn infer_tokens_batch(
+        &self,
+        input_tokens: Vec<Vec<u32>>,
+    ) -> anyhow::Result<Vec<Embedding>> {
+        let batch = input_tokens.iter().map(Vec::as_slice).collect::<Vec<_>>();
+        let mut inferencer = self.inferencer.lock().await;
+
+        #[cfg(target_family = "wasm")]
+        let embeddings = inferencer.infer_batch(&batch).await?;
+        #[cfg(not(target_family = "wasm"))]
+        let embeddings = inferencer.infer_batch(&batch)?;
+
+        Ok(embeddings
+            .into_iter()
+            .map(|embedding| self.finish(embedding))
+            .collect())
+    }
+
+    fn finish(&self, mut embedding: Vec<f32>) -> Embedding {
+        if self.do_normalize {
+            embedding.normalize();
+        }
+        embedding.into()
+    }
+
     pub fn download<'a>(
         model: impl Into<String>,
     ) -> BoxStream<'a, anyhow::Result<CacheProgress<()>>> {
@@ -225,4 +322,26 @@ mod tests {
         assert!(&query_embedding1 * &answer_embedding1 > &query_embedding1 * &answer_embedding2);
         assert!(&query_embedding2 * &answer_embedding1 < &query_embedding2 * &answer_embedding2);
     }
+
+    #[multi_platform_test]
+    async fn infer_batch_matches_infer() {
+        let model = LocalEmbeddingModel::try_new(
+            "BAAI/bge-m3",
+            Some(LocalEmbeddingModelConfig::default().with_validate_checksum(false)),
+        )
+        .await
+        .unwrap();
+
+        // Rows of different lengths, so the shorter one is padded
+        let texts = vec![
+            "What is BGE M3?".to_owned(),
+            "BM25 is a bag-of-words retrieval function that ranks a set of documents".to_owned(),
+        ];
+        let embeddings = model.infer_batch(texts.clone()).await.unwrap();
+        assert_eq!(embeddings.len(), 2);
+        for (text, embedding) in texts.into_iter().zip(embeddings) {
+            let expected = model.infer(text).await.unwrap();
+            assert!(&expected * &embedding > 0.99);
+        }
+    }
 }
@@ -1,4 +1,6 @@
 pub(crate) mod chat_template;
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub(crate) mod embedding_batcher;
 pub(crate) mod inferencer;
 pub(crate) mod kv_cache;
 pub(crate) mod local_embedding_model;
@@ -28,6 +28,22 @@ impl Tokenizer {
         Ok(encoded.get_ids().to_vec())
     }
 
+    /// Encodes `texts` at once, in parallel where threads are available.
+    pub fn encode_batch(
+        &self,
+        texts: Vec<String>,
+        add_special_tokens: bool,
+    ) -> anyhow::Result<Vec<Vec<u32>>> {
+        let encoded = self
+            .inner
+            .encode_batch(texts, add_special_tokens)
+            .map_err(|e| anyhow!("Tokenizer::encode_batch failed: {}", e))?;
+        Ok(encoded
+            .into_iter()
+            .map(|encoding| encoding.get_ids().to_vec())
+            .collect())
+    }
+
     pub fn decode(&self, ids: &[u32], skip_special_tokens: bool) -> anyhow::Result<String> {
         self.inner
             .decode(ids, skip_special_tokens)
@@ -1,11 +1,15 @@
 pub(crate) mod api;
 pub(crate) mod custom;
+pub(crate) mod embedding_cache;
 pub(crate) mod embedding_model;
 pub(crate) mod language_model;
 pub(crate) mod local;
 pub(crate) mod polyfill;
 
-pub use embedding_model::{EmbeddingModel, EmbeddingModelInference, LocalEmbeddingModelConfig};
+pub use embedding_model::{
+    EmbeddingCacheConfig, EmbeddingCacheMetrics, EmbeddingModel, EmbeddingModelInference,
+    LocalEmbeddingModelConfig,
+};
 pub use language_model::{
     Grammar, KVCacheConfig, LangModel, LangModelInferConfig, LangModelInference,
     LocalLangModelConfig, ThinkEffort,
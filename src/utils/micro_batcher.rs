@@ -0,0 +1,122 @@
+//! Queues of concurrent requests that are flushed as one batch.
+//!
+//! Requests are queued by key, and each key fills its own batches. The first
+//! request of a batch opens a window; the batch is flushed when the window
+//! closes, or right away once it holds as many requests as the caller allows.
+
+use std::{
+    collections::HashMap,
+    hash::Hash,
+    sync::{Arc, Mutex},
+    time::Duration,
+};
+
+struct Queue<T> {
+    /// Bumped whenever the queue is taken, so a window timer can tell whether the
+    /// batch it was started for was already flushed for being full.
+    generation: u64,
+    items: Vec<T>,
+}
+
+impl<T> Default for Queue<T> {
+    fn default() -> Self {
+        Self {
+            generation: 0,
+            items: Vec::new(),
+        }
+    }
+}
+
+impl<T> Queue<T> {
+    fn take(&mut self) -> Vec<T> {
+        self.generation += 1;
+        std::mem::take(&mut self.items)
+    }
+}
+
+pub struct MicroBatcher<K, T> {
+    window: Duration,
+    queues: Mutex<HashMap<K, Queue<T>>>,
+}
+
+impl<K, T> MicroBatcher<K, T>
+where
+    K: Eq + Hash + Clone + Send + 'static,
+    T: Send + 'static,
+{
+    pub fn new(window: Duration) -> Self {
+        Self {
+            window,
+            queues: Mutex::new(HashMap::new()),
+        }
+    }
+
+    pub fn window(&self) -> Duration {
+        self.window
+    }
+
+    /// Queues `item` under `key`, flushing the queue into `flush` once it holds
+    /// `capacity` items or once the window its first item opened closes.
+    ///
+    /// Batches are flushed on their own task, so that dropping the future of
+    /// one caller doesn't strand the others queued with it. `flush` is dropped
+    /// unused when the item joins a batch that another push flushes.
+    pub fn push<F, Fut>(self: &Arc<Self>, key: K, item: T, capacity: usize, flush: F)
+    where
+        F: FnOnce(Vec<T>) -> Fut + Send + 'static,
+        Fut: Future<Output = ()> + Send + 'static,
+    {
+        let mut queues = self.queues.lock().unwrap();
+        let queue = queues.entry(key.clone()).or_default();
+        queue.items.push(item);
+        if queue.items.len() >= capacity.max(1) {
+            let batch = queue.take();
+            tokio::spawn(flush(batch));
+        } else if queue.items.len() == 1 {
+            let generation = queue.generation;
+            let batcher = self.clone();
+            tokio::spawn(async move {
+                tokio::time::sleep(batcher.window).await;
+                let batch = {
+                    let mut queues = batcher.queues.lock().unwrap();
+                    let queue = queues.get_mut(&key).unwrap();
+                    if queue.generation != generation {
+                        return;
+                    }
+                    queue.take()
+                };
+                flush(batch).await;
+            });
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[tokio::test]
+    async fn micro_batcher_flushes_full_and_expired_queues() {
+        let batcher = Arc::new(MicroBatcher::new(Duration::from_millis(20)));
+        let (tx, mut rx) = tokio::sync::mpsc::unbounded_channel();
+        let push = |key: u32, item: u32| {
+            let tx = tx.clone();
+            batcher.push(key, item, 3, move |batch: Vec<u32>| async move {
+                tx.send((key, batch)).unwrap();
+            });
+        };
+
+        // A full queue is flushed right away, the other key waits for its window
+        push(0, 1);
+        push(1, 10);
+        push(0, 2);
+        push(0, 3);
+        assert_eq!(rx.recv().await, Some((0, vec![1, 2, 3])));
+        assert_eq!(rx.recv().await, Some((1, vec![10])));
+
+        // The timer of a flushed batch leaves the next batch of its key alone
+        push(0, 4);
+        assert_eq!(rx.recv().await, Some((0, vec![4])));
+        assert!(rx.try_recv().is_err());
+    }
+}
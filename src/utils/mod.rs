@@ -2,13 +2,18 @@ pub(crate) mod ellipsis;
 pub(crate) mod float;
 pub(crate) mod log;
 pub(crate) mod maybe_sync;
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub(crate) mod micro_batcher;
 pub(crate) mod normalize;
 pub(crate) mod random;
+pub(crate) mod simd;
 pub(crate) mod sleep;
 
 pub(crate) use ellipsis::*;
 pub(crate) use float::*;
 pub(crate) use maybe_sync::*;
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub(crate) use micro_batcher::MicroBatcher;
 pub(crate) use normalize::Normalize;
 pub(crate) use random::*;
 pub(crate) use sleep::*;
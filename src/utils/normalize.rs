@@ -1,13 +1,18 @@
-pub trait Normalize {
-    fn normalized(&self) -> Self;
+use super::simd;
+
+pub trait Normalize: Clone {
+    /// Scales `self` to unit length in place. A zero vector is left as is.
+    fn normalize(&mut self);
+
+    fn normalized(&self) -> Self {
+        let mut normalized = self.clone();
+        normalized.normalize();
+        normalized
+    }
 }
 
 impl Normalize for Vec<f32> {
-    fn normalized(&self) -> Self {
-        let magnitude = self.iter().map(|x| x * x).sum::<f32>().sqrt();
-        if magnitude == 0.0 {
-            return self.clone();
-        }
-        self.iter().map(|x| x / magnitude).collect()
+    fn normalize(&mut self) {
+        simd::normalize(self);
     }
 }
@@ -1,6 +1,6 @@
 use serde::{Deserialize, Serialize};
 
-use crate::utils::Normalize;
+use crate::utils::{Normalize, simd};
 
 #[derive(Clone, Debug, Serialize, Deserialize, PartialEq)]
 pub struct Embedding(Vec<f32>);
@@ -25,7 +25,7 @@ impl std::ops::Mul for &Embedding {
             panic!("Cannot dot-product two embeddings of different lengths");
         }
 
-        self.0.iter().zip(rhs.0.iter()).map(|(x, y)| x * y).sum()
+        simd::dot(&self.0, &rhs.0)
     }
 }
 
@@ -38,8 +38,8 @@ impl std::ops::Mul for Embedding {
 }
 
 impl Normalize for Embedding {
-    fn normalized(&self) -> Self {
-        Self(self.0.normalized())
+    fn normalize(&mut self) {
+        self.0.normalize();
     }
 }
 
@@ -47,6 +47,118 @@ impl Embedding {
     pub fn len(&self) -> usize {
         self.0.len()
     }
+
+    pub fn as_slice(&self) -> &[f32] {
+        &self.0
+    }
+
+    /// Squared Euclidean distance to `other`.
+    pub fn l2_distance_squared(&self, other: &Embedding) -> f32 {
+        if self.len() != other.len() {
+            panic!("Cannot compare two embeddings of different lengths");
+        }
+        simd::l2_distance_squared(&self.0, &other.0)
+    }
+}
+
+/// Embeddings of one dimension stored row by row in a single buffer, so that a
+/// batch reaches the index as one `&[f32]` without a copy or an allocation per row.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct EmbeddingBatch {
+    data: Vec<f32>,
+    dimension: usize,
+}
+
+impl EmbeddingBatch {
+    pub fn new(dimension: usize) -> Self {
+        Self::with_capacity(dimension, 0)
+    }
+
+    pub fn with_capacity(dimension: usize, rows: usize) -> Self {
+        Self {
+            data: Vec::with_capacity(dimension * rows),
+            dimension,
+        }
+    }
+
+    /// Wraps `data`, which holds whole rows of `dimension` values.
+    pub fn from_flat(dimension: usize, data: Vec<f32>) -> anyhow::Result<Self> {
+        let whole_rows = match dimension {
+            0 => data.is_empty(),
+            _ => data.len() % dimension == 0,
+        };
+        if !whole_rows {
+            anyhow::bail!(
+                "Cannot split {} values into rows of dimension {}",
+                data.len(),
+                dimension
+            );
+        }
+        Ok(Self { data, dimension })
+    }
+
+    /// Appends a row, which must have the batch's dimension.
+    pub fn push(&mut self, row: &[f32]) -> anyhow::Result<()> {
+        if row.len() != self.dimension {
+            anyhow::bail!(
+                "Embedding has dimension {}, expected {}",
+                row.len(),
+                self.dimension
+            );
+        }
+        self.data.extend_from_slice(row);
+        Ok(())
+    }
+
+    pub fn dimension(&self) -> usize {
+        self.dimension
+    }
+
+    /// Number of rows.
+    pub fn len(&self) -> usize {
+        self.data.len().checked_div(self.dimension).unwrap_or(0)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.data.is_empty()
+    }
+
+    /// Every row, back to back.
+    pub fn as_slice(&self) -> &[f32] {
+        &self.data
+    }
+
+    pub fn row(&self, index: usize) -> &[f32] {
+        &self.data[index * self.dimension..(index + 1) * self.dimension]
+    }
+
+    pub fn rows(&self) -> std::slice::ChunksExact<'_, f32> {
+        self.data.chunks_exact(self.dimension.max(1))
+    }
+
+    pub fn into_flat(self) -> Vec<f32> {
+        self.data
+    }
+}
+
+impl TryFrom<Vec<Embedding>> for EmbeddingBatch {
+    type Error = anyhow::Error;
+
+    /// Copies the embeddings into one buffer; they must share a dimension.
+    fn try_from(embeddings: Vec<Embedding>) -> anyhow::Result<Self> {
+        let dimension = embeddings.first().map_or(0, Embedding::len);
+        let mut batch = Self::with_capacity(dimension, embeddings.len());
+        for embedding in &embeddings {
+            batch.push(embedding.as_slice())?;
+        }
+        Ok(batch)
+    }
+}
+
+impl From<EmbeddingBatch> for Vec<Embedding> {
+    fn from(batch: EmbeddingBatch) -> Self {
+        batch.rows().map(|row| row.to_vec().into()).collect()
+    }
 }
 
 #[cfg(feature = "python")]
@@ -185,3 +297,33 @@ mod wasm {
         }
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn embedding_batch_keeps_rows_contiguous() -> anyhow::Result<()> {
+        let embeddings: Vec<Embedding> = vec![vec![1.0, 2.0].into(), vec![3.0, 4.0].into()];
+        let mut batch = EmbeddingBatch::try_from(embeddings.clone())?;
+        assert_eq!(batch.dimension(), 2);
+        assert_eq!(batch.len(), 2);
+        assert_eq!(batch.as_slice(), &[1.0, 2.0, 3.0, 4.0]);
+        assert_eq!(batch.row(1), &[3.0, 4.0]);
+
+        batch.push(&[5.0, 6.0])?;
+        assert!(batch.push(&[7.0]).is_err());
+        assert_eq!(batch.rows().count(), 3);
+        assert_eq!(Vec::<Embedding>::from(batch)[..2], embeddings);
+
+        assert!(EmbeddingBatch::from_flat(2, vec![1.0, 2.0, 3.0]).is_err());
+        let mixed: Vec<Embedding> = vec![vec![1.0].into(), vec![1.0, 2.0].into()];
+        assert!(EmbeddingBatch::try_from(mixed).is_err());
+
+        let empty = EmbeddingBatch::try_from(Vec::<Embedding>::new())?;
+        assert!(empty.is_empty());
+        assert_eq!(empty.len(), 0);
+        assert_eq!(empty.rows().count(), 0);
+        Ok(())
+    }
+}
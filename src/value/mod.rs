@@ -10,7 +10,7 @@ pub(crate) mod value;
 
 pub use delta::Delta;
 pub use document::Document;
-pub use embedding::Embedding;
+pub use embedding::{Embedding, EmbeddingBatch};
 pub use message::{FinishReason, Message, MessageDelta, MessageDeltaOutput, MessageOutput, Role};
 pub use part::{Part, PartDelta, PartDeltaFunction, PartFunction, PartImage, PartImageColorspace};
 pub use tool_desc::{ToolDesc, ToolDescBuilder};
@@ -1,3 +1,5 @@
+use std::sync::Arc;
+
 use ailoy_macros::multi_platform_async_trait;
 use anyhow::{Context, bail};
 use chromadb::{
@@ -8,10 +10,10 @@ use serde_json::{Map, Value as Json};
 use uuid::Uuid;
 
 use super::super::base::{
-    VectorStoreAddInput, VectorStoreBehavior, VectorStoreGetResult, VectorStoreMetadata,
-    VectorStoreRetrieveResult,
+    VectorStoreAddBatch, VectorStoreAddInput, VectorStoreBehavior, VectorStoreFilter,
+    VectorStoreGetResult, VectorStoreMetadata, VectorStoreRetrieveHit, VectorStoreSearchParams,
 };
-use crate::value::Embedding;
+use crate::value::{Embedding, EmbeddingBatch};
 
 type ChromaMetadata = Map<String, Json>;
 
@@ -31,6 +33,27 @@ fn from_chroma_metadata(metadata: &ChromaMetadata) -> VectorStoreMetadata {
     map
 }
 
+/// Builds a chroma `where` clause requiring every `(key, value)` pair of `filter`.
+fn into_chroma_where(filter: Option<VectorStoreFilter>) -> Option<Json> {
+    let mut clauses = filter?
+        .into_iter()
+        .map(|(key, val)| {
+            let mut clause = Map::new();
+            clause.insert(key, val.into());
+            Json::Object(clause)
+        })
+        .collect::<Vec<_>>();
+    match clauses.len() {
+        0 => None,
+        1 => clauses.pop(),
+        _ => {
+            let mut and = Map::new();
+            and.insert("$and".to_owned(), Json::Array(clauses));
+            Some(Json::Object(and))
+        }
+    }
+}
+
 const CHROMADB_DEFAULT_COLLECTION: &'static str = "default_collection";
 
 pub struct ChromaStore {
@@ -117,21 +140,20 @@ impl VectorStoreBehavior for ChromaStore {
         Ok(id)
     }
 
-    async fn add_vectors(
-        &mut self,
-        inputs: Vec<VectorStoreAddInput>,
-    ) -> anyhow::Result<Vec<String>> {
-        let ids: Vec<String> = (0..inputs.len())
+    async fn add_batch(&mut self, batch: VectorStoreAddBatch) -> anyhow::Result<Vec<String>> {
+        batch.validate()?;
+        let ids: Vec<String> = (0..batch.len())
             .map(|_| Uuid::new_v4().to_string())
             .collect();
-        let embeddings: Vec<Vec<f32>> = inputs.iter().map(|i| i.embedding.clone().into()).collect();
-        let documents: Vec<String> = inputs.iter().map(|i| i.document.clone()).collect();
+        // The Chroma client takes one `Vec<f32>` per row
+        let embeddings: Vec<Vec<f32>> = batch.embeddings.rows().map(<[f32]>::to_vec).collect();
         let metadatas: Option<Vec<Map<String, Json>>> =
-            if inputs.iter().any(|i| i.metadata.is_some()) {
+            if batch.metadatas.iter().any(Option::is_some) {
                 Some(
-                    inputs
+                    batch
+                        .metadatas
                         .iter()
-                        .map(|i| match &i.metadata {
+                        .map(|metadata| match metadata {
                             Some(map) => into_chroma_metadata(map),
                             _ => Map::new(),
                         })
@@ -143,7 +165,7 @@ impl VectorStoreBehavior for ChromaStore {
         let entry = CollectionEntries {
             ids: ids.iter().map(|id| id.as_str()).collect(),
             embeddings: Some(embeddings),
-            documents: Some(documents.iter().map(|d| d.as_str()).collect()),
+            documents: Some(batch.documents.iter().map(|d| d.as_str()).collect()),
             metadatas,
         };
         self.collection.upsert(entry, None).await?;
@@ -201,10 +223,14 @@ impl VectorStoreBehavior for ChromaStore {
         &self,
         query: Embedding,
         top_k: usize,
-    ) -> anyhow::Result<Vec<VectorStoreRetrieveResult>> {
+        filter: Option<VectorStoreFilter>,
+        // Chroma tunes its HNSW search per collection, not per query
+        _search_params: Option<VectorStoreSearchParams>,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
         let opts = QueryOptions {
             query_embeddings: Some(vec![query.into()]),
             n_results: Some(top_k),
+            where_metadata: into_chroma_where(filter),
             ..Default::default()
         };
         let QueryResult {
@@ -215,7 +241,7 @@ impl VectorStoreBehavior for ChromaStore {
             embeddings: _,
             ..
         } = self.collection.query(opts, None).await?;
-        let out: Vec<VectorStoreRetrieveResult> =
+        let out: Vec<VectorStoreRetrieveHit> =
             ids.get(0)
                 .and_then(|ids_vec| {
                     distances
@@ -234,10 +260,10 @@ impl VectorStoreBehavior for ChromaStore {
                             |inner_opt| inner_opt.clone().map(|inner| from_chroma_metadata(&inner)),
                         );
 
-                        Some(VectorStoreRetrieveResult {
-                            id,
-                            document,
-                            metadata,
+                        Some(VectorStoreRetrieveHit {
+                            id: id.into(),
+                            document: document.into(),
+                            metadata: metadata.map(Arc::new),
                             distance: distance as f64,
                         })
                     })
@@ -250,17 +276,15 @@ impl VectorStoreBehavior for ChromaStore {
 
     async fn batch_retrieve(
         &self,
-        query_embeddings: Vec<Embedding>,
+        query_embeddings: EmbeddingBatch,
         top_k: usize,
-    ) -> anyhow::Result<Vec<Vec<VectorStoreRetrieveResult>>> {
+        filter: Option<VectorStoreFilter>,
+        _search_params: Option<VectorStoreSearchParams>,
+    ) -> anyhow::Result<Vec<Vec<VectorStoreRetrieveHit>>> {
         let opts = QueryOptions {
-            query_embeddings: Some(
-                query_embeddings
-                    .into_iter()
-                    .map(|query| query.into())
-                    .collect(),
-            ),
+            query_embeddings: Some(query_embeddings.rows().map(<[f32]>::to_vec).collect()),
             n_results: Some(top_k),
+            where_metadata: into_chroma_where(filter),
             ..Default::default()
         };
         let QueryResult {
@@ -271,7 +295,7 @@ impl VectorStoreBehavior for ChromaStore {
             embeddings: _,
             ..
         } = self.collection.query(opts, None).await?;
-        let out: Vec<Vec<VectorStoreRetrieveResult>> = ids
+        let out: Vec<Vec<VectorStoreRetrieveHit>> = ids
             .iter()
             .enumerate()
             .filter_map(|(outer_index, ids_vec)| {
@@ -295,10 +319,10 @@ impl VectorStoreBehavior for ChromaStore {
                                         inner_opt.clone().map(|inner| from_chroma_metadata(&inner))
                                     });
 
-                                Some(VectorStoreRetrieveResult {
-                                    id: id_ref.clone(),
-                                    document,
-                                    metadata,
+                                Some(VectorStoreRetrieveHit {
+                                    id: id_ref.as_str().into(),
+                                    document: document.into(),
+                                    metadata: metadata.map(Arc::new),
                                     distance: distance as f64,
                                 })
                             })
@@ -310,6 +334,14 @@ impl VectorStoreBehavior for ChromaStore {
         Ok(out)
     }
 
+    async fn retrieve_within(
+        &self,
+        _query_embedding: Embedding,
+        _radius: f32,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        bail!("Range search is not supported by Chroma.")
+    }
+
     async fn remove_vector(&mut self, id: &str) -> anyhow::Result<()> {
         self.collection.delete(Some(vec![id]), None, None).await?;
         Ok(())
@@ -462,7 +494,7 @@ mod tests {
 
         // top_k=2
         let results = store
-            .retrieve(query_embeddings.get(0).cloned().unwrap(), 2)
+            .retrieve(query_embeddings.get(0).cloned().unwrap(), 2, None, None)
             .await?;
 
         assert_eq!(results.len(), 2);
@@ -476,7 +508,9 @@ mod tests {
         assert!(!retrieved_docs.contains(&"vector two-ish".to_owned()));
 
         // top_k=2
-        let batch_results = store.batch_retrieve(query_embeddings, 2).await?;
+        let batch_results = store
+            .batch_retrieve(query_embeddings.try_into()?, 2, None, None)
+            .await?;
 
         for (i, results) in batch_results.iter().enumerate() {
             assert_eq!(results.len(), 2);
@@ -1,14 +1,53 @@
-use std::{collections::HashMap, sync::Arc};
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+use std::time::Duration;
+use std::{collections::HashMap, path::Path, sync::Arc};
 
 use ailoy_macros::{maybe_send_sync, multi_platform_async_trait};
+use anyhow::bail;
 use futures::lock::Mutex;
 use serde::{Deserialize, Serialize};
-
-use super::{api::ChromaStore, local::FaissStore};
-use crate::value::{Embedding, Value};
+use tokio::sync::RwLock;
+
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+use super::local::{
+    BatchRunner, ComputePool, ComputePoolMetrics, DEFAULT_MAX_BATCH_SIZE, RetrieveBatchMetrics,
+    RetrieveBatcher,
+};
+use super::{
+    api::ChromaStore,
+    local::{FaissStore, FaissStoreConfig},
+};
+use crate::{
+    cache::filesystem,
+    utils::{BoxFuture, MaybeSend},
+    value::{Embedding, EmbeddingBatch, Value},
+};
 
 pub type VectorStoreMetadata = HashMap<String, Value>;
 
+/// Restricts retrieval to entries whose metadata equals every `(key, value)` pair.
+pub type VectorStoreFilter = HashMap<String, Value>;
+
+/// Per-query settings of approximate indexes, trading recall for latency without
+/// rebuilding the index. Unset fields keep the value the index was built with,
+/// and settings that don't apply to the index type are ignored, as they are by Chroma.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+#[cfg_attr(feature = "nodejs", napi_derive::napi(object))]
+#[cfg_attr(feature = "wasm", derive(tsify::Tsify))]
+#[cfg_attr(feature = "wasm", tsify(from_wasm_abi, into_wasm_abi))]
+pub struct VectorStoreSearchParams {
+    /// Number of inverted lists an IVF index probes.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub nprobe: Option<u32>,
+    /// Size of the candidate list an HNSW index explores.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub ef_search: Option<u32>,
+    /// A refine index re-ranks `top_k * k_factor` candidates of its base index.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub k_factor: Option<f32>,
+}
+
 #[derive(Debug, Serialize, Deserialize)]
 #[cfg_attr(feature = "python", pyo3_stub_gen_derive::gen_stub_pyclass)]
 #[cfg_attr(
@@ -28,6 +67,57 @@ pub struct VectorStoreAddInput {
     pub metadata: Option<VectorStoreMetadata>,
 }
 
+/// Entries added at once, with their embeddings in one contiguous buffer.
+/// Row `i` of `embeddings` belongs to `documents[i]` and `metadatas[i]`.
+#[derive(Debug, Default)]
+pub struct VectorStoreAddBatch {
+    pub embeddings: EmbeddingBatch,
+    pub documents: Vec<String>,
+    pub metadatas: Vec<Option<VectorStoreMetadata>>,
+}
+
+impl VectorStoreAddBatch {
+    pub fn len(&self) -> usize {
+        self.documents.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.documents.is_empty()
+    }
+
+    /// Checks that every document has one embedding and one metadata.
+    pub(crate) fn validate(&self) -> anyhow::Result<()> {
+        if self.embeddings.len() != self.len() || self.metadatas.len() != self.len() {
+            bail!(
+                "Batch has {} embeddings, {} documents and {} metadatas",
+                self.embeddings.len(),
+                self.documents.len(),
+                self.metadatas.len()
+            );
+        }
+        Ok(())
+    }
+}
+
+impl TryFrom<Vec<VectorStoreAddInput>> for VectorStoreAddBatch {
+    type Error = anyhow::Error;
+
+    fn try_from(inputs: Vec<VectorStoreAddInput>) -> anyhow::Result<Self> {
+        let dimension = inputs.first().map_or(0, |input| input.embedding.len());
+        let mut batch = Self {
+            embeddings: EmbeddingBatch::with_capacity(dimension, inputs.len()),
+            documents: Vec::with_capacity(inputs.len()),
+            metadatas: Vec::with_capacity(inputs.len()),
+        };
+        for input in inputs {
+            batch.embeddings.push(input.embedding.as_slice())?;
+            batch.documents.push(input.document);
+            batch.metadatas.push(input.metadata);
+        }
+        Ok(batch)
+    }
+}
+
 #[derive(Debug, Serialize, Deserialize)]
 #[cfg_attr(feature = "python", pyo3_stub_gen_derive::gen_stub_pyclass)]
 #[cfg_attr(
@@ -68,6 +158,28 @@ pub struct VectorStoreRetrieveResult {
     pub distance: f64,
 }
 
+/// A retrieved entry as the stores hand it out. The id, document and metadata are
+/// shared with the store rather than copied for every hit; they are turned into an
+/// owned [`VectorStoreRetrieveResult`] only where they cross into a binding.
+#[derive(Clone, Debug, PartialEq)]
+pub struct VectorStoreRetrieveHit {
+    pub id: Arc<str>,
+    pub document: Arc<str>,
+    pub metadata: Option<Arc<VectorStoreMetadata>>,
+    pub distance: f64,
+}
+
+impl From<VectorStoreRetrieveHit> for VectorStoreRetrieveResult {
+    fn from(hit: VectorStoreRetrieveHit) -> Self {
+        Self {
+            id: hit.id.to_string(),
+            document: hit.document.to_string(),
+            metadata: hit.metadata.map(Arc::unwrap_or_clone),
+            distance: hit.distance,
+        }
+    }
+}
+
 #[maybe_send_sync]
 #[multi_platform_async_trait]
 pub trait VectorStoreBehavior {
@@ -75,19 +187,34 @@ pub trait VectorStoreBehavior {
     async fn add_vectors(
         &mut self,
         inputs: Vec<VectorStoreAddInput>,
-    ) -> anyhow::Result<Vec<String>>;
+    ) -> anyhow::Result<Vec<String>> {
+        self.add_batch(inputs.try_into()?).await
+    }
+    /// Adds every entry of `batch`, returning their ids in order.
+    async fn add_batch(&mut self, batch: VectorStoreAddBatch) -> anyhow::Result<Vec<String>>;
     async fn get_by_id(&self, id: &str) -> anyhow::Result<Option<VectorStoreGetResult>>;
     async fn get_by_ids(&self, ids: &[&str]) -> anyhow::Result<Vec<VectorStoreGetResult>>;
     async fn retrieve(
         &self,
         query_embedding: Embedding,
         top_k: usize,
-    ) -> anyhow::Result<Vec<VectorStoreRetrieveResult>>;
+        filter: Option<VectorStoreFilter>,
+        search_params: Option<VectorStoreSearchParams>,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>>;
     async fn batch_retrieve(
         &self,
-        query_embeddings: Vec<Embedding>,
+        query_embeddings: EmbeddingBatch,
         top_k: usize,
-    ) -> anyhow::Result<Vec<Vec<VectorStoreRetrieveResult>>>;
+        filter: Option<VectorStoreFilter>,
+        search_params: Option<VectorStoreSearchParams>,
+    ) -> anyhow::Result<Vec<Vec<VectorStoreRetrieveHit>>>;
+    /// Returns every entry whose `distance` to the query is within `radius`, closest first.
+    /// For similarity metrics such as inner product, that means scoring above `radius`.
+    async fn retrieve_within(
+        &self,
+        query_embedding: Embedding,
+        radius: f32,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>>;
     async fn remove_vector(&mut self, id: &str) -> anyhow::Result<()>;
     async fn remove_vectors(&mut self, ids: &[&str]) -> anyhow::Result<()>;
     async fn clear(&mut self) -> anyhow::Result<()>;
@@ -97,10 +224,118 @@ pub trait VectorStoreBehavior {
 
 #[derive(Debug, Clone)]
 pub enum VectorStoreInner {
-    Faiss(Arc<Mutex<FaissStore>>),
+    Faiss(FaissHandle),
     Chroma(Arc<Mutex<ChromaStore>>),
 }
 
+/// A FAISS store and the compute pool its calls run on.
+///
+/// FAISS searches are const and thread-safe, so reads share the store and run in
+/// parallel on the pool; only adds, removals and saves take it exclusively.
+#[derive(Debug, Clone)]
+pub struct FaissHandle {
+    store: Arc<RwLock<FaissStore>>,
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    pool: Arc<ComputePool>,
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    batcher: Option<Arc<RetrieveBatcher>>,
+    /// Queries are checked against it before they join a batch, where one of the
+    /// wrong size would fail the search of every query batched with it.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    dimension: usize,
+}
+
+impl FaissHandle {
+    #[allow(unused_variables)]
+    fn new(store: FaissStore, config: &FaissStoreConfig) -> anyhow::Result<Self> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        let dimension = store.dimension();
+        #[allow(unused_mut)]
+        let mut handle = Self {
+            store: Arc::new(RwLock::new(store)),
+            #[cfg(any(target_family = "unix", target_family = "windows"))]
+            pool: match config.compute_threads {
+                Some(threads) => Arc::new(ComputePool::new(threads as usize)?),
+                None => ComputePool::shared(),
+            },
+            #[cfg(any(target_family = "unix", target_family = "windows"))]
+            batcher: None,
+            #[cfg(any(target_family = "unix", target_family = "windows"))]
+            dimension,
+        };
+
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        if let Some(window) = config.batch_window_micros {
+            let searcher = handle.clone();
+            let runner: BatchRunner = Arc::new(
+                move |queries: Vec<Embedding>,
+                      top_k: usize,
+                      search_params: Option<VectorStoreSearchParams>|
+                      -> BoxFuture<'static, _> {
+                    let searcher = searcher.clone();
+                    Box::pin(async move {
+                        let queries = EmbeddingBatch::try_from(queries)?;
+                        searcher
+                            .read(move |store| {
+                                store.batch_retrieve(queries, top_k, None, search_params)
+                            })
+                            .await
+                    })
+                },
+            );
+            let max_batch_size = config.max_batch_size.unwrap_or(DEFAULT_MAX_BATCH_SIZE);
+            handle.batcher = Some(Arc::new(RetrieveBatcher::new(
+                Duration::from_micros(window as u64),
+                max_batch_size as usize,
+                runner,
+            )));
+        }
+        Ok(handle)
+    }
+
+    /// Drives `f` to completion on the compute pool with the store shared among
+    /// readers, so FAISS never blocks an executor thread. The web has no threads to
+    /// offload to and runs `f` inline.
+    async fn read<T, F>(&self, f: F) -> anyhow::Result<T>
+    where
+        T: MaybeSend + 'static,
+        F: for<'a> FnOnce(&'a FaissStore) -> BoxFuture<'a, anyhow::Result<T>> + MaybeSend + 'static,
+    {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        {
+            let store = self.store.clone().read_owned().await;
+            self.pool
+                .run(move || futures::executor::block_on(f(&*store)))
+                .await?
+        }
+        #[cfg(target_family = "wasm")]
+        {
+            f(&*self.store.read().await).await
+        }
+    }
+
+    /// Like [`FaissHandle::read`], but with exclusive access to the store.
+    async fn write<T, F>(&self, f: F) -> anyhow::Result<T>
+    where
+        T: MaybeSend + 'static,
+        F: for<'a> FnOnce(&'a mut FaissStore) -> BoxFuture<'a, anyhow::Result<T>>
+            + MaybeSend
+            + 'static,
+    {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        {
+            let mut store = self.store.clone().write_owned().await;
+            self.pool
+                .run(move || futures::executor::block_on(f(&mut *store)))
+                .await?
+        }
+        #[cfg(target_family = "wasm")]
+        {
+            f(&mut *self.store.write().await).await
+        }
+    }
+}
+
 #[derive(Debug, Clone)]
 #[cfg_attr(feature = "python", pyo3_stub_gen_derive::gen_stub_pyclass)]
 #[cfg_attr(feature = "python", pyo3::pyclass(module = "ailoy._core"))]
@@ -111,10 +346,11 @@ pub struct VectorStore {
 }
 
 impl VectorStore {
-    pub async fn new_faiss(dim: u32) -> anyhow::Result<Self> {
-        let store = FaissStore::new(dim).await?;
+    pub async fn new_faiss(dim: u32, config: Option<FaissStoreConfig>) -> anyhow::Result<Self> {
+        let handle_config = config.clone().unwrap_or_default();
+        let store = FaissStore::new(dim, config).await?;
         Ok(Self {
-            inner: VectorStoreInner::Faiss(Arc::new(Mutex::new(store))),
+            inner: VectorStoreInner::Faiss(FaissHandle::new(store, &handle_config)?),
         })
     }
 
@@ -125,9 +361,59 @@ impl VectorStore {
         })
     }
 
+    /// Atomically writes the index, documents, metadata and id counter to `path`.
+    /// Only FAISS stores can be saved; Chroma persists on its server.
+    ///
+    /// A running background training is awaited first so the trained index is
+    /// saved. The wait does not hold the store, so reads and writes go on meanwhile.
+    pub async fn save(&self, path: impl AsRef<Path>) -> anyhow::Result<()> {
+        let bytes = match &self.inner {
+            VectorStoreInner::Faiss(faiss) => {
+                #[cfg(any(target_family = "unix", target_family = "windows"))]
+                {
+                    let training_finished = faiss.store.read().await.training_finished();
+                    if let Some(training_finished) = training_finished {
+                        training_finished.await;
+                    }
+                }
+                faiss
+                    .write(|store| {
+                        Box::pin(async move {
+                            store.wait_for_training().await?;
+                            store.to_bytes()
+                        })
+                    })
+                    .await?
+            }
+            VectorStoreInner::Chroma(_) => {
+                bail!("Chroma stores are persisted by the Chroma server")
+            }
+        };
+        filesystem::write_atomic(path, bytes, true).await
+    }
+
+    /// Opens a FAISS store written by [`VectorStore::save`].
+    ///
+    /// The index layout comes from the file; `config` only sets how the store
+    /// runs: `compute_threads`, `batch_window_micros` and `max_batch_size`.
+    ///
+    /// The whole file is read into memory. Stores stay writable after loading,
+    /// so there is no memory-mapped mode here; only a standalone index file can
+    /// be mapped, through `FaissIndex::read_index_mmap`.
+    pub async fn load(
+        path: impl AsRef<Path>,
+        config: Option<FaissStoreConfig>,
+    ) -> anyhow::Result<Self> {
+        let bytes = filesystem::read(path).await?;
+        let store = FaissStore::from_bytes(&bytes).await?;
+        Ok(Self {
+            inner: VectorStoreInner::Faiss(FaissHandle::new(store, &config.unwrap_or_default())?),
+        })
+    }
+
     pub async fn add_vector(&mut self, input: VectorStoreAddInput) -> anyhow::Result<String> {
         match &self.inner {
-            VectorStoreInner::Faiss(inner) => inner.lock().await.add_vector(input).await,
+            VectorStoreInner::Faiss(faiss) => faiss.write(|store| store.add_vector(input)).await,
             VectorStoreInner::Chroma(inner) => inner.lock().await.add_vector(input).await,
         }
     }
@@ -136,22 +422,40 @@ impl VectorStore {
         &mut self,
         inputs: Vec<VectorStoreAddInput>,
     ) -> anyhow::Result<Vec<String>> {
+        self.add_batch(inputs.try_into()?).await
+    }
+
+    /// Adds entries whose embeddings are already in one buffer, which reaches
+    /// the index without being copied row by row.
+    pub async fn add_batch(&mut self, batch: VectorStoreAddBatch) -> anyhow::Result<Vec<String>> {
         match &self.inner {
-            VectorStoreInner::Faiss(inner) => inner.lock().await.add_vectors(inputs).await,
-            VectorStoreInner::Chroma(inner) => inner.lock().await.add_vectors(inputs).await,
+            VectorStoreInner::Faiss(faiss) => faiss.write(|store| store.add_batch(batch)).await,
+            VectorStoreInner::Chroma(inner) => inner.lock().await.add_batch(batch).await,
         }
     }
 
     pub async fn get_by_id(&self, id: &str) -> anyhow::Result<Option<VectorStoreGetResult>> {
         match &self.inner {
-            VectorStoreInner::Faiss(inner) => inner.lock().await.get_by_id(id).await,
+            VectorStoreInner::Faiss(faiss) => {
+                let id = id.to_owned();
+                faiss
+                    .read(|store| Box::pin(async move { store.get_by_id(&id).await }))
+                    .await
+            }
             VectorStoreInner::Chroma(inner) => inner.lock().await.get_by_id(id).await,
         }
     }
 
     pub async fn get_by_ids(&self, ids: &[&str]) -> anyhow::Result<Vec<VectorStoreGetResult>> {
         match &self.inner {
-            VectorStoreInner::Faiss(inner) => inner.lock().await.get_by_ids(ids).await,
+            VectorStoreInner::Faiss(faiss) => {
+                let ids = owned_ids(ids);
+                faiss
+                    .read(|store| {
+                        Box::pin(async move { store.get_by_ids(&borrowed_ids(&ids)).await })
+                    })
+                    .await
+            }
             VectorStoreInner::Chroma(inner) => inner.lock().await.get_by_ids(ids).await,
         }
     }
@@ -160,76 +464,365 @@ impl VectorStore {
         &self,
         query_embedding: Embedding,
         top_k: usize,
-    ) -> anyhow::Result<Vec<VectorStoreRetrieveResult>> {
+        filter: Option<VectorStoreFilter>,
+        search_params: Option<VectorStoreSearchParams>,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
         match self.inner.clone() {
-            VectorStoreInner::Faiss(inner) => {
-                inner.lock().await.retrieve(query_embedding, top_k).await
+            VectorStoreInner::Faiss(faiss) => {
+                #[cfg(any(target_family = "unix", target_family = "windows"))]
+                if let (Some(batcher), None) = (&faiss.batcher, &filter) {
+                    if query_embedding.len() != faiss.dimension {
+                        bail!(
+                            "Query has dimension {}, expected {}",
+                            query_embedding.len(),
+                            faiss.dimension
+                        );
+                    }
+                    return batcher
+                        .retrieve(query_embedding, top_k, search_params)
+                        .await;
+                }
+                faiss
+                    .read(move |store| {
+                        store.retrieve(query_embedding, top_k, filter, search_params)
+                    })
+                    .await
             }
             VectorStoreInner::Chroma(inner) => {
-                inner.lock().await.retrieve(query_embedding, top_k).await
+                inner
+                    .lock()
+                    .await
+                    .retrieve(query_embedding, top_k, filter, search_params)
+                    .await
             }
         }
     }
 
     pub async fn batch_retrieve(
         &self,
-        query_embeddings: Vec<Embedding>,
+        query_embeddings: EmbeddingBatch,
         top_k: usize,
-    ) -> anyhow::Result<Vec<Vec<VectorStoreRetrieveResult>>> {
+        filter: Option<VectorStoreFilter>,
+        search_params: Option<VectorStoreSearchParams>,
+    ) -> anyhow::Result<Vec<Vec<VectorStoreRetrieveHit>>> {
         match &self.inner {
-            VectorStoreInner::Faiss(inner) => {
+            VectorStoreInner::Faiss(faiss) => {
+                faiss
+                    .read(move |store| {
+                        store.batch_retrieve(query_embeddings, top_k, filter, search_params)
+                    })
+                    .await
+            }
+            VectorStoreInner::Chroma(inner) => {
                 inner
                     .lock()
                     .await
-                    .batch_retrieve(query_embeddings, top_k)
+                    .batch_retrieve(query_embeddings, top_k, filter, search_params)
+                    .await
+            }
+        }
+    }
+
+    pub async fn retrieve_within(
+        &self,
+        query_embedding: Embedding,
+        radius: f32,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        match &self.inner {
+            VectorStoreInner::Faiss(faiss) => {
+                faiss
+                    .read(move |store| store.retrieve_within(query_embedding, radius))
                     .await
             }
             VectorStoreInner::Chroma(inner) => {
                 inner
                     .lock()
                     .await
-                    .batch_retrieve(query_embeddings, top_k)
+                    .retrieve_within(query_embedding, radius)
                     .await
             }
         }
     }
 
+    /// Ranks documents by their BM25 score for `query`, best first, with the score
+    /// as the `distance`. Only FAISS stores created with `lexical_index` support it.
+    pub async fn retrieve_lexical(
+        &self,
+        query: String,
+        top_k: usize,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        match &self.inner {
+            VectorStoreInner::Faiss(faiss) => {
+                faiss
+                    .read(move |store| {
+                        Box::pin(async move { store.retrieve_lexical(&query, top_k) })
+                    })
+                    .await
+            }
+            VectorStoreInner::Chroma(_) => {
+                bail!("Lexical retrieval is only supported by FAISS stores")
+            }
+        }
+    }
+
     pub async fn remove_vector(&mut self, id: &str) -> anyhow::Result<()> {
         match &self.inner {
-            VectorStoreInner::Faiss(inner) => inner.lock().await.remove_vector(id).await,
+            VectorStoreInner::Faiss(faiss) => {
+                let id = id.to_owned();
+                faiss
+                    .write(|store| Box::pin(async move { store.remove_vector(&id).await }))
+                    .await
+            }
             VectorStoreInner::Chroma(inner) => inner.lock().await.remove_vector(id).await,
         }
     }
 
     pub async fn remove_vectors(&mut self, ids: &[&str]) -> anyhow::Result<()> {
         match &self.inner {
-            VectorStoreInner::Faiss(inner) => inner.lock().await.remove_vectors(ids).await,
+            VectorStoreInner::Faiss(faiss) => {
+                let ids = owned_ids(ids);
+                faiss
+                    .write(|store| {
+                        Box::pin(async move { store.remove_vectors(&borrowed_ids(&ids)).await })
+                    })
+                    .await
+            }
             VectorStoreInner::Chroma(inner) => inner.lock().await.remove_vectors(ids).await,
         }
     }
 
     pub async fn clear(&mut self) -> anyhow::Result<()> {
         match &self.inner {
-            VectorStoreInner::Faiss(inner) => inner.lock().await.clear().await,
+            VectorStoreInner::Faiss(faiss) => faiss.write(|store| store.clear()).await,
             VectorStoreInner::Chroma(inner) => inner.lock().await.clear().await,
         }
     }
 
     pub async fn count(&self) -> anyhow::Result<usize> {
         match &self.inner {
-            VectorStoreInner::Faiss(inner) => inner.lock().await.count().await,
+            VectorStoreInner::Faiss(faiss) => faiss.store.read().await.count().await,
             VectorStoreInner::Chroma(inner) => inner.lock().await.count().await,
         }
     }
+
+    /// Why the last training run of a FAISS index failed, while the store still
+    /// serves from its flat staging index. Always `None` for Chroma.
+    pub async fn training_error(&self) -> anyhow::Result<Option<String>> {
+        match &self.inner {
+            VectorStoreInner::Faiss(faiss) => {
+                Ok(faiss.store.read().await.training_error().map(str::to_owned))
+            }
+            VectorStoreInner::Chroma(_) => Ok(None),
+        }
+    }
+
+    /// Load of the pool running this store's FAISS calls, or `None` for Chroma.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    pub fn compute_pool_metrics(&self) -> Option<ComputePoolMetrics> {
+        match &self.inner {
+            VectorStoreInner::Faiss(faiss) => Some(faiss.pool.metrics()),
+            VectorStoreInner::Chroma(_) => None,
+        }
+    }
+
+    /// Batch sizes and waits of retrieve batching, or `None` when it is off.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    pub fn retrieve_batch_metrics(&self) -> Option<RetrieveBatchMetrics> {
+        match &self.inner {
+            VectorStoreInner::Faiss(faiss) => {
+                faiss.batcher.as_ref().map(|batcher| batcher.metrics())
+            }
+            VectorStoreInner::Chroma(_) => None,
+        }
+    }
+}
+
+// Jobs on the compute pool must own their arguments.
+fn owned_ids(ids: &[&str]) -> Vec<String> {
+    ids.iter().map(|id| id.to_string()).collect()
+}
+
+fn borrowed_ids(ids: &[String]) -> Vec<&str> {
+    ids.iter().map(String::as_str).collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    #[tokio::test(flavor = "multi_thread")]
+    async fn vector_store_reads_run_alongside_writes() -> anyhow::Result<()> {
+        // Entry `i` lies on the unit circle at angle `i`, and its document is its id
+        let input = |i: usize| VectorStoreAddInput {
+            embedding: vec![(i as f32).cos(), (i as f32).sin(), 0.0].into(),
+            document: i.to_string(),
+            metadata: None,
+        };
+        let config = FaissStoreConfig {
+            compute_threads: Some(4),
+            ..Default::default()
+        };
+        let mut store = VectorStore::new_faiss(3, Some(config)).await?;
+        store.add_vectors((0..100).map(input).collect()).await?;
+
+        let mut writer = store.clone();
+        let writes = tokio::spawn(async move {
+            for i in 100..200 {
+                writer.add_vector(input(i)).await?;
+            }
+            anyhow::Ok(())
+        });
+        let reads = (0..200).map(|i| {
+            let store = store.clone();
+            tokio::spawn(async move {
+                let results = store.retrieve(input(i).embedding, 5, None, None).await?;
+                // Every hit is a whole entry: its document matches its id and
+                // its stored embedding, whatever writes landed meanwhile
+                for result in &results {
+                    assert_eq!(result.document, result.id);
+                    let entry = store.get_by_id(&result.id).await?.unwrap();
+                    assert_eq!(entry.document, *result.id);
+                }
+                assert!(results.windows(2).all(|w| w[0].distance <= w[1].distance));
+                anyhow::Ok(results.len())
+            })
+        });
+        for read in futures::future::join_all(reads).await {
+            assert_eq!(read??, 5);
+        }
+        writes.await??;
+
+        assert_eq!(store.count().await?, 200);
+        let results = store.retrieve(input(150).embedding, 1, None, None).await?;
+        assert_eq!(&*results[0].document, "150");
+        Ok(())
+    }
+
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    #[tokio::test]
+    async fn vector_store_batched_retrieve_rejects_wrong_dimension() -> anyhow::Result<()> {
+        let config = FaissStoreConfig {
+            batch_window_micros: Some(20_000),
+            ..Default::default()
+        };
+        let mut store = VectorStore::new_faiss(3, Some(config)).await?;
+        store
+            .add_vector(VectorStoreAddInput {
+                embedding: vec![1.0, 0.0, 0.0].into(),
+                document: "doc".to_owned(),
+                metadata: None,
+            })
+            .await?;
+
+        // The malformed query fails on its own instead of failing the batch it
+        // would have shared with the other caller
+        let (wrong, right) = futures::future::join(
+            store.retrieve(vec![1.0, 0.0].into(), 1, None, None),
+            store.retrieve(vec![1.0, 0.0, 0.0].into(), 1, None, None),
+        )
+        .await;
+        assert!(wrong.is_err());
+        assert_eq!(&*right?[0].document, "doc");
+        let metrics = store.retrieve_batch_metrics().unwrap();
+        assert_eq!(metrics.queries, 1);
+        Ok(())
+    }
+
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    #[tokio::test]
+    async fn vector_store_load_takes_runtime_config() -> anyhow::Result<()> {
+        let path = std::env::temp_dir().join(format!("ailoy-store-{}.bin", uuid::Uuid::new_v4()));
+        let mut store = VectorStore::new_faiss(3, None).await?;
+        store
+            .add_vector(VectorStoreAddInput {
+                embedding: vec![1.0, 0.0, 0.0].into(),
+                document: "doc".to_owned(),
+                metadata: None,
+            })
+            .await?;
+        store.save(&path).await?;
+
+        let config = FaissStoreConfig {
+            batch_window_micros: Some(100),
+            ..Default::default()
+        };
+        let loaded = VectorStore::load(&path, Some(config)).await?;
+        std::fs::remove_file(&path)?;
+        assert!(loaded.retrieve_batch_metrics().is_some());
+        let results = loaded
+            .retrieve(vec![1.0, 0.0, 0.0].into(), 1, None, None)
+            .await?;
+        assert_eq!(&*results[0].document, "doc");
+        Ok(())
+    }
+
+    /// Measures retrieve QPS of concurrent clients with 1, 2, 4, ... compute threads,
+    /// up to the core count. Reads share the store, so QPS should scale with threads.
+    /// Run with `cargo test --release vector_store_retrieve_qps -- --ignored --nocapture`.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    #[tokio::test(flavor = "multi_thread")]
+    #[ignore]
+    async fn vector_store_retrieve_qps() -> anyhow::Result<()> {
+        use std::time::Instant;
+
+        const DIM: usize = 256;
+        const NUM_VECTORS: usize = 50_000;
+        const NUM_QUERIES: usize = 2_000;
+
+        let embedding = |seed: usize| -> Embedding {
+            (0..DIM)
+                .map(|d| (seed as f32 * 0.37 + d as f32).sin())
+                .collect::<Vec<_>>()
+                .into()
+        };
+        let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+
+        let mut threads = 1;
+        while threads <= cores {
+            let config = FaissStoreConfig {
+                compute_threads: Some(threads as u32),
+                ..Default::default()
+            };
+            let mut store = VectorStore::new_faiss(DIM as u32, Some(config)).await?;
+            let inputs = (0..NUM_VECTORS)
+                .map(|i| VectorStoreAddInput {
+                    embedding: embedding(i),
+                    document: i.to_string(),
+                    metadata: None,
+                })
+                .collect();
+            store.add_vectors(inputs).await?;
+
+            let start = Instant::now();
+            let clients = (0..NUM_QUERIES).map(|i| {
+                let store = store.clone();
+                let query = embedding(NUM_VECTORS + i);
+                tokio::spawn(async move { store.retrieve(query, 10, None, None).await })
+            });
+            for client in futures::future::join_all(clients).await {
+                assert_eq!(client??.len(), 10);
+            }
+            let elapsed = start.elapsed();
+
+            println!(
+                "{:>3} threads: {:>8.0} QPS",
+                threads,
+                NUM_QUERIES as f64 / elapsed.as_secs_f64()
+            );
+            threads *= 2;
+        }
+        Ok(())
+    }
 }
 
 #[cfg(feature = "python")]
 mod py {
-    use pyo3::{prelude::*, types::PyType};
+    use pyo3::{exceptions::PyValueError, prelude::*, types::PyType};
     use pyo3_stub_gen_derive::*;
 
     use super::*;
-    use crate::ffi::py::base::await_future;
+    use crate::{ffi::py::base::await_future, vector_store::local::FaissStoreMetric};
 
     impl Into<VectorStoreAddInput> for Py<VectorStoreAddInput> {
         fn into(self) -> VectorStoreAddInput {
@@ -266,9 +859,35 @@ mod py {
     #[pymethods]
     impl VectorStore {
         #[classmethod]
-        #[pyo3(name = "new_faiss")]
-        fn new_faiss_py<'a>(_cls: &Bound<'a, PyType>, py: Python<'a>, dim: u32) -> PyResult<Self> {
-            await_future(py, VectorStore::new_faiss(dim))
+        #[pyo3(name = "new_faiss", signature = (dim, index_description = None, metric = None, training_samples = None, compute_threads = None, batch_window_micros = None, max_batch_size = None, shards = None, exact_rerank = None, binary_index = None, lexical_index = None))]
+        fn new_faiss_py<'a>(
+            _cls: &Bound<'a, PyType>,
+            py: Python<'a>,
+            dim: u32,
+            index_description: Option<String>,
+            metric: Option<FaissStoreMetric>,
+            training_samples: Option<u32>,
+            compute_threads: Option<u32>,
+            batch_window_micros: Option<u32>,
+            max_batch_size: Option<u32>,
+            shards: Option<u32>,
+            exact_rerank: Option<bool>,
+            binary_index: Option<String>,
+            lexical_index: Option<bool>,
+        ) -> PyResult<Self> {
+            let config = FaissStoreConfig {
+                index_description,
+                metric,
+                training_samples,
+                compute_threads,
+                batch_window_micros,
+                max_batch_size,
+                shards,
+                exact_rerank,
+                binary_index,
+                lexical_index,
+            };
+            await_future(py, VectorStore::new_faiss(dim, Some(config)))
         }
 
         #[classmethod]
@@ -282,6 +901,30 @@ mod py {
             await_future(py, VectorStore::new_chroma(url, collection_name))
         }
 
+        #[classmethod]
+        #[pyo3(name = "load", signature = (path, compute_threads = None, batch_window_micros = None, max_batch_size = None))]
+        fn load_py<'a>(
+            _cls: &Bound<'a, PyType>,
+            py: Python<'a>,
+            path: String,
+            compute_threads: Option<u32>,
+            batch_window_micros: Option<u32>,
+            max_batch_size: Option<u32>,
+        ) -> PyResult<Self> {
+            let config = FaissStoreConfig {
+                compute_threads,
+                batch_window_micros,
+                max_batch_size,
+                ..Default::default()
+            };
+            await_future(py, VectorStore::load(path, Some(config)))
+        }
+
+        #[pyo3(name = "save")]
+        fn save_py(&self, py: Python<'_>, path: String) -> PyResult<()> {
+            await_future(py, self.save(path))
+        }
+
         #[pyo3(name = "add_vector")]
         fn add_vector_py(
             &mut self,
@@ -331,34 +974,92 @@ mod py {
             .collect::<Vec<_>>())
         }
 
-        #[pyo3(name = "retrieve")]
+        #[pyo3(
+            name = "retrieve",
+            signature = (query_embedding, top_k, filter = None, nprobe = None, ef_search = None, k_factor = None)
+        )]
         fn retrieve_py(
             &self,
             py: Python<'_>,
             query_embedding: Embedding,
             top_k: usize,
+            filter: Option<VectorStoreFilter>,
+            nprobe: Option<u32>,
+            ef_search: Option<u32>,
+            k_factor: Option<f32>,
         ) -> PyResult<Vec<VectorStoreRetrieveResult>> {
-            Ok(await_future(py, self.retrieve(query_embedding, top_k))?
-                .into_iter()
-                .map(|result| result.into())
-                .collect::<Vec<_>>())
+            let search_params = VectorStoreSearchParams {
+                nprobe,
+                ef_search,
+                k_factor,
+            };
+            Ok(await_future(
+                py,
+                self.retrieve(query_embedding, top_k, filter, Some(search_params)),
+            )?
+            .into_iter()
+            .map(|result| result.into())
+            .collect::<Vec<_>>())
         }
 
-        #[pyo3(name = "batch_retrieve")]
+        #[pyo3(
+            name = "batch_retrieve",
+            signature = (query_embeddings, top_k, filter = None, nprobe = None, ef_search = None, k_factor = None)
+        )]
         fn batch_retrieve_py(
             &self,
             py: Python<'_>,
             query_embeddings: Vec<Embedding>,
             top_k: usize,
+            filter: Option<VectorStoreFilter>,
+            nprobe: Option<u32>,
+            ef_search: Option<u32>,
+            k_factor: Option<f32>,
         ) -> PyResult<Vec<Vec<VectorStoreRetrieveResult>>> {
+            let search_params = VectorStoreSearchParams {
+                nprobe,
+                ef_search,
+                k_factor,
+            };
+            let query_embeddings = EmbeddingBatch::try_from(query_embeddings)
+                .map_err(|e| PyValueError::new_err(e.to_string()))?;
+            Ok(await_future(
+                py,
+                self.batch_retrieve(query_embeddings, top_k, filter, Some(search_params)),
+            )?
+            .into_iter()
+            .map(|batch| batch.into_iter().map(|item| item.into()).collect())
+            .collect())
+        }
+
+        #[pyo3(name = "retrieve_within")]
+        fn retrieve_within_py(
+            &self,
+            py: Python<'_>,
+            query_embedding: Embedding,
+            radius: f32,
+        ) -> PyResult<Vec<VectorStoreRetrieveResult>> {
             Ok(
-                await_future(py, self.batch_retrieve(query_embeddings, top_k))?
+                await_future(py, self.retrieve_within(query_embedding, radius))?
                     .into_iter()
-                    .map(|batch| batch.into_iter().map(|item| item.into()).collect())
-                    .collect(),
+                    .map(|result| result.into())
+                    .collect::<Vec<_>>(),
             )
         }
 
+        #[pyo3(name = "retrieve_lexical")]
+        fn retrieve_lexical_py(
+            &self,
+            py: Python<'_>,
+            query: String,
+            top_k: usize,
+        ) -> PyResult<Vec<VectorStoreRetrieveResult>> {
+            Ok(await_future(py, self.retrieve_lexical(query, top_k))?
+                .into_iter()
+                .map(|result| result.into())
+                .collect::<Vec<_>>())
+        }
+
         #[pyo3(name = "remove_vector")]
         fn remove_vector_py(&mut self, py: Python<'_>, id: String) -> PyResult<()> {
             await_future(py, self.remove_vector(&id))
@@ -381,6 +1082,21 @@ mod py {
         fn count_py(&self, py: Python<'_>) -> PyResult<usize> {
             await_future(py, self.count())
         }
+
+        #[pyo3(name = "training_error")]
+        fn training_error_py(&self, py: Python<'_>) -> PyResult<Option<String>> {
+            await_future(py, self.training_error())
+        }
+
+        #[pyo3(name = "compute_pool_metrics")]
+        fn compute_pool_metrics_py(&self) -> Option<ComputePoolMetrics> {
+            self.compute_pool_metrics()
+        }
+
+        #[pyo3(name = "retrieve_batch_metrics")]
+        fn retrieve_batch_metrics_py(&self) -> Option<RetrieveBatchMetrics> {
+            self.retrieve_batch_metrics()
+        }
     }
 }
 
@@ -398,8 +1114,11 @@ mod node {
     #[napi]
     impl VectorStore {
         #[napi(js_name = "newFaiss")]
-        pub async fn new_faiss_js(dim: u32) -> napi::Result<Self> {
-            VectorStore::new_faiss(dim)
+        pub async fn new_faiss_js(
+            dim: u32,
+            config: Option<FaissStoreConfig>,
+        ) -> napi::Result<Self> {
+            VectorStore::new_faiss(dim, config)
                 .await
                 .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
         }
@@ -414,6 +1133,20 @@ mod node {
                 .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
         }
 
+        #[napi(js_name = "load")]
+        pub async fn load_js(path: String, config: Option<FaissStoreConfig>) -> napi::Result<Self> {
+            VectorStore::load(path, config)
+                .await
+                .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
+        }
+
+        #[napi(js_name = "save")]
+        pub async fn save_js(&self, path: String) -> napi::Result<()> {
+            self.save(path)
+                .await
+                .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
+        }
+
         #[napi(js_name = "addVector")]
         pub async unsafe fn add_vector_js(
             &mut self,
@@ -461,9 +1194,12 @@ mod node {
             &self,
             query_embedding: Embedding,
             top_k: u32,
+            #[napi(ts_arg_type = "VectorStoreMetadata")] filter: Option<VectorStoreFilter>,
+            search_params: Option<VectorStoreSearchParams>,
         ) -> napi::Result<Vec<VectorStoreRetrieveResult>> {
-            self.retrieve(query_embedding, top_k as usize)
+            self.retrieve(query_embedding, top_k as usize, filter, search_params)
                 .await
+                .map(|results| results.into_iter().map(Into::into).collect())
                 .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
         }
 
@@ -472,9 +1208,43 @@ mod node {
             &self,
             query_embeddings: Vec<Embedding>,
             top_k: u32,
+            #[napi(ts_arg_type = "VectorStoreMetadata")] filter: Option<VectorStoreFilter>,
+            search_params: Option<VectorStoreSearchParams>,
         ) -> napi::Result<Vec<Vec<VectorStoreRetrieveResult>>> {
-            self.batch_retrieve(query_embeddings, top_k as usize)
+            let query_embeddings = EmbeddingBatch::try_from(query_embeddings)
+                .map_err(|e| napi::Error::new(Status::InvalidArg, e.to_string()))?;
+            self.batch_retrieve(query_embeddings, top_k as usize, filter, search_params)
+                .await
+                .map(|batches| {
+                    batches
+                        .into_iter()
+                        .map(|results| results.into_iter().map(Into::into).collect())
+                        .collect()
+                })
+                .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
+        }
+
+        #[napi(js_name = "retrieveWithin")]
+        pub async fn retrieve_within_js(
+            &self,
+            query_embedding: Embedding,
+            radius: f64,
+        ) -> napi::Result<Vec<VectorStoreRetrieveResult>> {
+            self.retrieve_within(query_embedding, radius as f32)
+                .await
+                .map(|results| results.into_iter().map(Into::into).collect())
+                .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
+        }
+
+        #[napi(js_name = "retrieveLexical")]
+        pub async fn retrieve_lexical_js(
+            &self,
+            query: String,
+            top_k: u32,
+        ) -> napi::Result<Vec<VectorStoreRetrieveResult>> {
+            self.retrieve_lexical(query, top_k as usize)
                 .await
+                .map(|results| results.into_iter().map(Into::into).collect())
                 .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
         }
 
@@ -511,6 +1281,23 @@ mod node {
                 .map(|count| count as u32)
                 .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
         }
+
+        #[napi(js_name = "trainingError")]
+        pub async fn training_error_js(&self) -> napi::Result<Option<String>> {
+            self.training_error()
+                .await
+                .map_err(|e| napi::Error::new(Status::GenericFailure, e.to_string()))
+        }
+
+        #[napi(js_name = "computePoolMetrics")]
+        pub fn compute_pool_metrics_js(&self) -> Option<ComputePoolMetrics> {
+            self.compute_pool_metrics()
+        }
+
+        #[napi(js_name = "retrieveBatchMetrics")]
+        pub fn retrieve_batch_metrics_js(&self) -> Option<RetrieveBatchMetrics> {
+            self.retrieve_batch_metrics()
+        }
     }
 }
 
@@ -530,8 +1317,11 @@ mod wasm {
     #[wasm_bindgen]
     impl VectorStore {
         #[wasm_bindgen(js_name = "newFaiss")]
-        pub async fn new_faiss_js(dim: u32) -> Result<Self, js_sys::Error> {
-            VectorStore::new_faiss(dim)
+        pub async fn new_faiss_js(
+            dim: u32,
+            config: Option<FaissStoreConfig>,
+        ) -> Result<Self, js_sys::Error> {
+            VectorStore::new_faiss(dim, config)
                 .await
                 .map_err(|e| js_sys::Error::new(&e.to_string()))
         }
@@ -546,6 +1336,23 @@ mod wasm {
                 .map_err(|e| js_sys::Error::new(&e.to_string()))
         }
 
+        #[wasm_bindgen(js_name = "load")]
+        pub async fn load_js(
+            path: String,
+            config: Option<FaissStoreConfig>,
+        ) -> Result<Self, js_sys::Error> {
+            VectorStore::load(path, config)
+                .await
+                .map_err(|e| js_sys::Error::new(&e.to_string()))
+        }
+
+        #[wasm_bindgen(js_name = "save")]
+        pub async fn save_js(&self, path: String) -> Result<(), js_sys::Error> {
+            self.save(path)
+                .await
+                .map_err(|e| js_sys::Error::new(&e.to_string()))
+        }
+
         #[wasm_bindgen(js_name = "addVector")]
         pub async fn add_vector_js(
             &mut self,
@@ -596,9 +1403,39 @@ mod wasm {
             &self,
             query_embedding: Embedding,
             top_k: usize,
+            #[wasm_bindgen(unchecked_param_type = "VectorStoreMetadata | undefined")]
+            filter: JsValue,
+            search_params: Option<VectorStoreSearchParams>,
         ) -> Result<Vec<VectorStoreRetrieveResult>, js_sys::Error> {
-            self.retrieve(query_embedding, top_k)
+            let filter: Option<VectorStoreFilter> = serde_wasm_bindgen::from_value(filter)
+                .map_err(|e| js_sys::Error::new(&e.to_string()))?;
+            self.retrieve(query_embedding, top_k, filter, search_params)
                 .await
+                .map(|results| results.into_iter().map(Into::into).collect())
+                .map_err(|e| js_sys::Error::new(&e.to_string()))
+        }
+
+        #[wasm_bindgen(js_name = "retrieveWithin")]
+        pub async fn retrieve_within_js(
+            &self,
+            query_embedding: Embedding,
+            radius: f32,
+        ) -> Result<Vec<VectorStoreRetrieveResult>, js_sys::Error> {
+            self.retrieve_within(query_embedding, radius)
+                .await
+                .map(|results| results.into_iter().map(Into::into).collect())
+                .map_err(|e| js_sys::Error::new(&e.to_string()))
+        }
+
+        #[wasm_bindgen(js_name = "retrieveLexical")]
+        pub async fn retrieve_lexical_js(
+            &self,
+            query: String,
+            top_k: usize,
+        ) -> Result<Vec<VectorStoreRetrieveResult>, js_sys::Error> {
+            self.retrieve_lexical(query, top_k)
+                .await
+                .map(|results| results.into_iter().map(Into::into).collect())
                 .map_err(|e| js_sys::Error::new(&e.to_string()))
         }
 
@@ -634,5 +1471,12 @@ mod wasm {
                 .await
                 .map_err(|e| js_sys::Error::new(&e.to_string()))
         }
+
+        #[wasm_bindgen(js_name = "trainingError")]
+        pub async fn training_error_js(&self) -> Result<Option<String>, js_sys::Error> {
+            self.training_error()
+                .await
+                .map_err(|e| js_sys::Error::new(&e.to_string()))
+        }
     }
 }
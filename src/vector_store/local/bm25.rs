@@ -0,0 +1,673 @@
+//! In-process BM25 index over the documents of a [`FaissStore`](super::FaissStore).
+//!
+//! Documents are numbered in insertion order, so indexing one only appends to the
+//! posting lists of its terms. Every list is split into blocks of [`BLOCK_SIZE`]
+//! postings whose document-number gaps and term frequencies are varint-encoded;
+//! only the block still being filled is kept unencoded. Removed documents are
+//! skipped at query time and dropped from the lists once they make up half of
+//! the index.
+//!
+//! Queries are evaluated document-at-a-time with MaxScore: the lists whose
+//! combined score bound cannot lift a document into the current top `k` stop
+//! producing candidates and are only probed for documents the other lists
+//! produce, skipping whole blocks by their last document.
+
+use std::{
+    cmp::{Ordering, Reverse},
+    collections::{BinaryHeap, HashMap},
+};
+
+const BLOCK_SIZE: usize = 128;
+const K1: f32 = 1.2;
+const B: f32 = 0.75;
+/// Removed documents tolerated before they are worth compacting away.
+const MIN_COMPACTION: usize = 1024;
+
+/// Characters that join the parts of identifiers such as `ERR-404`, `v1.2.3`
+/// or `snake_case`.
+const JOINERS: [char; 4] = ['-', '_', '.', '/'];
+
+/// Lowercases `text` into `buffer`, so that terms don't allocate one by one.
+fn lowercase_into<'b>(buffer: &'b mut String, text: &str) -> &'b str {
+    buffer.clear();
+    if text.is_ascii() {
+        buffer.push_str(text);
+        buffer.make_ascii_lowercase();
+    } else {
+        buffer.extend(text.chars().flat_map(char::to_lowercase));
+    }
+    buffer
+}
+
+/// Calls `f` with every lowercase alphanumeric term of `text`. An identifier
+/// whose parts are joined by [`JOINERS`] is also kept whole, so exact codes and
+/// SKUs match as one term while their parts still match on their own.
+pub fn for_each_term(text: &str, mut f: impl FnMut(&str)) {
+    let mut buffer = String::new();
+    for word in text.split(|c: char| !c.is_alphanumeric() && !JOINERS.contains(&c)) {
+        let word = word.trim_matches(JOINERS);
+        if word.is_empty() {
+            continue;
+        }
+        // A trimmed word only holds joiners between non-empty parts
+        if word.contains(JOINERS) {
+            f(lowercase_into(&mut buffer, word));
+        }
+        for part in word.split(JOINERS).filter(|part| !part.is_empty()) {
+            f(lowercase_into(&mut buffer, part));
+        }
+    }
+}
+
+fn put_varint(out: &mut Vec<u8>, mut value: u32) {
+    while value >= 0x80 {
+        out.push(value as u8 | 0x80);
+        value >>= 7;
+    }
+    out.push(value as u8);
+}
+
+fn get_varint(bytes: &[u8], pos: &mut usize) -> u32 {
+    let mut value = 0u32;
+    let mut shift = 0;
+    loop {
+        let byte = bytes[*pos];
+        *pos += 1;
+        value |= ((byte & 0x7f) as u32) << shift;
+        if byte < 0x80 {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+struct BlockInfo {
+    /// Last document of the block.
+    last_doc: u32,
+    /// Start of the block in [`PostingList::bytes`].
+    offset: usize,
+}
+
+#[derive(Default)]
+struct PostingList {
+    bytes: Vec<u8>,
+    blocks: Vec<BlockInfo>,
+    /// Postings of the block being filled.
+    tail_docs: Vec<u32>,
+    tail_freqs: Vec<u32>,
+    /// Number of live documents holding the term.
+    doc_freq: u32,
+    /// Highest term frequency and shortest document over every posting, which
+    /// bound the score the term can contribute.
+    max_freq: u32,
+    min_len: u32,
+}
+
+impl PostingList {
+    fn push(&mut self, doc: u32, freq: u32, len: u32) {
+        if self.max_freq == 0 {
+            self.min_len = len;
+        }
+        self.tail_docs.push(doc);
+        self.tail_freqs.push(freq);
+        self.doc_freq += 1;
+        self.max_freq = self.max_freq.max(freq);
+        self.min_len = self.min_len.min(len);
+        if self.tail_docs.len() == BLOCK_SIZE {
+            self.flush();
+        }
+    }
+
+    fn flush(&mut self) {
+        let offset = self.bytes.len();
+        let mut prev = self.blocks.last().map_or(0, |block| block.last_doc);
+        for (&doc, &freq) in self.tail_docs.iter().zip(&self.tail_freqs) {
+            put_varint(&mut self.bytes, doc - prev);
+            put_varint(&mut self.bytes, freq);
+            prev = doc;
+        }
+        self.blocks.push(BlockInfo {
+            last_doc: prev,
+            offset,
+        });
+        self.tail_docs.clear();
+        self.tail_freqs.clear();
+    }
+
+    fn decode_block(&self, block: usize, docs: &mut Vec<u32>, freqs: &mut Vec<u32>) {
+        docs.clear();
+        freqs.clear();
+        let end = self
+            .blocks
+            .get(block + 1)
+            .map_or(self.bytes.len(), |next| next.offset);
+        let mut prev = if block == 0 {
+            0
+        } else {
+            self.blocks[block - 1].last_doc
+        };
+        let mut pos = self.blocks[block].offset;
+        while pos < end {
+            prev += get_varint(&self.bytes, &mut pos);
+            docs.push(prev);
+            freqs.push(get_varint(&self.bytes, &mut pos));
+        }
+    }
+
+    /// Every posting in document order.
+    fn postings(&self) -> Vec<(u32, u32)> {
+        let mut postings = Vec::new();
+        let (mut docs, mut freqs) = (Vec::new(), Vec::new());
+        for block in 0..self.blocks.len() {
+            self.decode_block(block, &mut docs, &mut freqs);
+            postings.extend(docs.iter().copied().zip(freqs.iter().copied()));
+        }
+        postings.extend(
+            self.tail_docs
+                .iter()
+                .copied()
+                .zip(self.tail_freqs.iter().copied()),
+        );
+        postings
+    }
+}
+
+/// Reads one posting list forward, a block at a time.
+struct Cursor<'a> {
+    list: &'a PostingList,
+    idf: f32,
+    /// Highest score a document can take from this term.
+    bound: f32,
+    /// Block being read; `list.blocks.len()` is the unencoded tail.
+    block: usize,
+    docs: Vec<u32>,
+    freqs: Vec<u32>,
+    pos: usize,
+}
+
+impl<'a> Cursor<'a> {
+    fn new(list: &'a PostingList, idf: f32, bound: f32) -> Self {
+        let mut cursor = Self {
+            list,
+            idf,
+            bound,
+            block: 0,
+            docs: Vec::with_capacity(BLOCK_SIZE),
+            freqs: Vec::with_capacity(BLOCK_SIZE),
+            pos: 0,
+        };
+        cursor.load(0);
+        cursor
+    }
+
+    fn load(&mut self, block: usize) {
+        self.block = block;
+        self.pos = 0;
+        if block < self.list.blocks.len() {
+            self.list
+                .decode_block(block, &mut self.docs, &mut self.freqs);
+        }
+    }
+
+    fn current(&self) -> (&[u32], &[u32]) {
+        match self.block.cmp(&self.list.blocks.len()) {
+            Ordering::Less => (&self.docs, &self.freqs),
+            Ordering::Equal => (&self.list.tail_docs, &self.list.tail_freqs),
+            Ordering::Greater => (&[], &[]),
+        }
+    }
+
+    /// Current document, or `u32::MAX` once the list is exhausted.
+    fn doc(&self) -> u32 {
+        self.current().0.get(self.pos).copied().unwrap_or(u32::MAX)
+    }
+
+    fn freq(&self) -> u32 {
+        self.current().1[self.pos]
+    }
+
+    fn next(&mut self) {
+        self.pos += 1;
+        if self.pos >= self.current().0.len() && self.block <= self.list.blocks.len() {
+            self.load(self.block + 1);
+        }
+    }
+
+    /// Moves to the first document at or after `target`.
+    fn seek(&mut self, target: u32) {
+        if self.doc() >= target {
+            return;
+        }
+        let blocks = &self.list.blocks;
+        if self.block < blocks.len() && blocks[self.block].last_doc < target {
+            let skipped = blocks[self.block + 1..].partition_point(|block| block.last_doc < target);
+            self.load(self.block + 1 + skipped);
+        }
+        let docs = self.current().0;
+        let (skipped, len) = (
+            docs[self.pos..].partition_point(|&doc| doc < target),
+            docs.len(),
+        );
+        self.pos += skipped;
+        if self.pos >= len && self.block <= self.list.blocks.len() {
+            self.load(self.block + 1);
+        }
+    }
+}
+
+/// A scored document; orders worse hits first, so a min-heap of hits keeps the
+/// worst of the current top `k` on top. Ties go to the earlier document.
+#[derive(Clone, Copy, PartialEq)]
+struct Hit {
+    score: f32,
+    doc: u32,
+}
+
+impl Eq for Hit {}
+
+impl Ord for Hit {
+    fn cmp(&self, other: &Self) -> Ordering {
+        self.score
+            .total_cmp(&other.score)
+            .then(other.doc.cmp(&self.doc))
+    }
+}
+
+impl PartialOrd for Hit {
+    fn partial_cmp(&self, other: &Self) -> Option<Ordering> {
+        Some(self.cmp(other))
+    }
+}
+
+#[derive(Default)]
+pub struct Bm25Index {
+    terms: HashMap<String, u32>,
+    postings: Vec<PostingList>,
+    /// External id of every document number.
+    doc_ids: Vec<i64>,
+    /// Length in terms of every document number.
+    doc_lens: Vec<u32>,
+    live: Vec<bool>,
+    numbers: HashMap<i64, u32>,
+    /// Total length of the live documents.
+    total_len: u64,
+    num_removed: usize,
+}
+
+impl std::fmt::Debug for Bm25Index {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("Bm25Index")
+            .field("terms", &self.terms.len())
+            .field("documents", &self.numbers.len())
+            .finish_non_exhaustive()
+    }
+}
+
+impl Bm25Index {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Ids of the known terms of `text`, sorted and without duplicates.
+    fn term_ids(&self, text: &str) -> Vec<u32> {
+        let mut terms = Vec::new();
+        for_each_term(text, |term| terms.extend(self.terms.get(term)));
+        terms.sort_unstable();
+        terms.dedup();
+        terms
+    }
+
+    /// Indexes `document` under `id`. An id that is already indexed keeps its
+    /// first document.
+    pub fn insert(&mut self, id: i64, document: &str) {
+        if self.numbers.contains_key(&id) {
+            return;
+        }
+        let mut terms = Vec::new();
+        for_each_term(document, |term| {
+            let term = match self.terms.get(term) {
+                Some(&term) => term,
+                None => {
+                    let next_term = self.postings.len() as u32;
+                    self.terms.insert(term.to_owned(), next_term);
+                    self.postings.push(PostingList::default());
+                    next_term
+                }
+            };
+            terms.push(term);
+        });
+        let len = terms.len() as u32;
+        let doc = self.doc_ids.len() as u32;
+        self.doc_ids.push(id);
+        self.doc_lens.push(len);
+        self.live.push(true);
+        self.numbers.insert(id, doc);
+        self.total_len += len as u64;
+
+        // Equal terms are adjacent once sorted; each run is one posting
+        terms.sort_unstable();
+        for run in terms.chunk_by(|a, b| a == b) {
+            self.postings[run[0] as usize].push(doc, run.len() as u32, len);
+        }
+    }
+
+    /// Removes `id`, which must have been indexed with `document`.
+    pub fn remove(&mut self, id: i64, document: &str) {
+        let Some(doc) = self.numbers.remove(&id) else {
+            return;
+        };
+        self.live[doc as usize] = false;
+        self.total_len -= self.doc_lens[doc as usize] as u64;
+        self.num_removed += 1;
+        for term in self.term_ids(document) {
+            let list = &mut self.postings[term as usize];
+            list.doc_freq = list.doc_freq.saturating_sub(1);
+        }
+        if self.num_removed >= MIN_COMPACTION && self.num_removed * 2 >= self.doc_ids.len() {
+            self.compact();
+        }
+    }
+
+    pub fn clear(&mut self) {
+        *self = Self::default();
+    }
+
+    /// Renumbers the live documents and rewrites every posting list without the
+    /// removed ones.
+    fn compact(&mut self) {
+        let mut renumbered = vec![u32::MAX; self.doc_ids.len()];
+        let mut doc_ids = Vec::with_capacity(self.numbers.len());
+        let mut doc_lens = Vec::with_capacity(self.numbers.len());
+        for (doc, (&id, &len)) in self.doc_ids.iter().zip(&self.doc_lens).enumerate() {
+            if self.live[doc] {
+                renumbered[doc] = doc_ids.len() as u32;
+                self.numbers.insert(id, doc_ids.len() as u32);
+                doc_ids.push(id);
+                doc_lens.push(len);
+            }
+        }
+
+        let mut terms = HashMap::with_capacity(self.terms.len());
+        let mut postings = Vec::with_capacity(self.postings.len());
+        for (term, id) in std::mem::take(&mut self.terms) {
+            let mut list = PostingList::default();
+            for (doc, freq) in self.postings[id as usize].postings() {
+                let doc = renumbered[doc as usize];
+                if doc != u32::MAX {
+                    list.push(doc, freq, doc_lens[doc as usize]);
+                }
+            }
+            if list.doc_freq > 0 {
+                terms.insert(term, postings.len() as u32);
+                postings.push(list);
+            }
+        }
+
+        self.terms = terms;
+        self.postings = postings;
+        self.live = vec![true; doc_ids.len()];
+        self.doc_ids = doc_ids;
+        self.doc_lens = doc_lens;
+        self.num_removed = 0;
+    }
+
+    /// Returns the ids of the `top_k` documents scoring highest for `query` with
+    /// their BM25 scores, best first.
+    pub fn search(&self, query: &str, top_k: usize) -> Vec<(i64, f32)> {
+        let num_docs = self.numbers.len();
+        if top_k == 0 || num_docs == 0 || self.total_len == 0 {
+            return vec![];
+        }
+        let avg_len = self.total_len as f32 / num_docs as f32;
+        let weight = |freq: u32, len: u32| -> f32 {
+            let freq = freq as f32;
+            freq * (K1 + 1.0) / (freq + K1 * (1.0 - B + B * len as f32 / avg_len))
+        };
+
+        let mut cursors: Vec<Cursor> = self
+            .term_ids(query)
+            .into_iter()
+            .map(|term| &self.postings[term as usize])
+            .filter(|list| list.doc_freq > 0)
+            .map(|list| {
+                let doc_freq = list.doc_freq as f32;
+                let idf = (1.0 + (num_docs as f32 - doc_freq + 0.5) / (doc_freq + 0.5)).ln();
+                Cursor::new(list, idf, idf * weight(list.max_freq, list.min_len))
+            })
+            .collect();
+        // `bounds[i]` bounds the score of a document found only in lists `..=i`
+        cursors.sort_by(|a, b| a.bound.total_cmp(&b.bound));
+        let bounds: Vec<f32> = cursors
+            .iter()
+            .scan(0.0, |sum, cursor| {
+                *sum += cursor.bound;
+                Some(*sum)
+            })
+            .collect();
+
+        let mut heap: BinaryHeap<Reverse<Hit>> = BinaryHeap::with_capacity(top_k + 1);
+        let mut threshold = f32::NEG_INFINITY;
+        // Lists before `first_essential` only score candidates of the others
+        let mut first_essential = 0;
+        while first_essential < cursors.len() {
+            let doc = cursors[first_essential..]
+                .iter()
+                .map(Cursor::doc)
+                .min()
+                .unwrap();
+            if doc == u32::MAX {
+                break;
+            }
+            let live = self.live[doc as usize];
+            let len = self.doc_lens[doc as usize];
+            let mut score = 0.0;
+            for cursor in &mut cursors[first_essential..] {
+                if cursor.doc() == doc {
+                    if live {
+                        score += cursor.idf * weight(cursor.freq(), len);
+                    }
+                    cursor.next();
+                }
+            }
+            if !live {
+                continue;
+            }
+            for i in (0..first_essential).rev() {
+                if score + bounds[i] <= threshold {
+                    break;
+                }
+                let cursor = &mut cursors[i];
+                cursor.seek(doc);
+                if cursor.doc() == doc {
+                    score += cursor.idf * weight(cursor.freq(), len);
+                }
+            }
+
+            let hit = Hit { score, doc };
+            if heap.len() < top_k {
+                heap.push(Reverse(hit));
+            } else if hit > heap.peek().unwrap().0 {
+                heap.pop();
+                heap.push(Reverse(hit));
+            } else {
+                continue;
+            }
+            if heap.len() == top_k {
+                threshold = heap.peek().unwrap().0.score;
+                while first_essential < cursors.len() && bounds[first_essential] <= threshold {
+                    first_essential += 1;
+                }
+            }
+        }
+
+        heap.into_sorted_vec()
+            .into_iter()
+            .map(|Reverse(hit)| (self.doc_ids[hit.doc as usize], hit.score))
+            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::collections::HashSet;
+
+    use super::*;
+
+    fn tokenize(text: &str) -> Vec<String> {
+        let mut terms = Vec::new();
+        for_each_term(text, |term| terms.push(term.to_owned()));
+        terms
+    }
+
+    /// Scores every live document against every query term.
+    fn exhaustive_search(index: &Bm25Index, query: &str, top_k: usize) -> Vec<(i64, f32)> {
+        let num_docs = index.numbers.len() as f32;
+        let avg_len = index.total_len as f32 / num_docs;
+        let mut scores: HashMap<u32, f32> = HashMap::new();
+        for term in tokenize(query).into_iter().collect::<HashSet<_>>() {
+            let Some(&term) = index.terms.get(&term) else {
+                continue;
+            };
+            let list = &index.postings[term as usize];
+            let doc_freq = list.doc_freq as f32;
+            let idf = (1.0 + (num_docs - doc_freq + 0.5) / (doc_freq + 0.5)).ln();
+            for (doc, freq) in list.postings() {
+                if !index.live[doc as usize] {
+                    continue;
+                }
+                let (freq, len) = (freq as f32, index.doc_lens[doc as usize] as f32);
+                *scores.entry(doc).or_default() +=
+                    idf * freq * (K1 + 1.0) / (freq + K1 * (1.0 - B + B * len / avg_len));
+            }
+        }
+        let mut hits: Vec<(i64, f32)> = scores
+            .into_iter()
+            .map(|(doc, score)| (index.doc_ids[doc as usize], score))
+            .collect();
+        hits.sort_by(|a, b| b.1.total_cmp(&a.1));
+        hits.truncate(top_k);
+        hits
+    }
+
+    #[test]
+    fn bm25_tokenize_keeps_identifiers_whole() {
+        assert_eq!(
+            tokenize("Error ERR-404: see v1.2, snake_case."),
+            vec![
+                "error",
+                "err-404",
+                "err",
+                "404",
+                "see",
+                "v1.2",
+                "v1",
+                "2",
+                "snake_case",
+                "snake",
+                "case"
+            ]
+        );
+    }
+
+    #[test]
+    fn bm25_ranks_exact_identifiers_first() {
+        let mut index = Bm25Index::new();
+        index.insert(10, "The pump failed with error E-1042 after restart");
+        index.insert(11, "Error E-1043 means the pump is overheating");
+        index.insert(12, "Restart the pump to clear most errors");
+        index.insert(13, "Unrelated text about gardening");
+
+        let hits = index.search("what does E-1042 mean", 2);
+        assert_eq!(hits[0].0, 10);
+        assert!(hits[0].1 > hits[1].1);
+        assert!(index.search("gardening", 5).iter().all(|hit| hit.0 == 13));
+        assert!(index.search("nothing matches", 5).is_empty());
+
+        index.remove(10, "The pump failed with error E-1042 after restart");
+        assert!(index.search("E-1042", 5).iter().all(|hit| hit.0 != 10));
+        assert_eq!(index.numbers.len(), 3);
+    }
+
+    #[test]
+    fn bm25_max_score_matches_exhaustive_search() {
+        // Zipf-like vocabulary so that some lists span many blocks
+        let mut seed = 7u64;
+        let mut random = move || {
+            seed = seed
+                .wrapping_mul(6364136223846793005)
+                .wrapping_add(1442695040888963407);
+            (seed >> 33) as usize
+        };
+        let mut documents = Vec::new();
+        let mut index = Bm25Index::new();
+        for id in 0..3000 {
+            let len = 5 + random() % 30;
+            let document = (0..len)
+                .map(|_| format!("w{}", (random() % 400) * (random() % 400) / 400))
+                .collect::<Vec<_>>()
+                .join(" ");
+            index.insert(id, &document);
+            documents.push(document);
+        }
+        // Enough removals to trigger a compaction, and a few more afterwards
+        for id in (0..3000).filter(|id| id % 3 != 0) {
+            index.remove(id, &documents[id as usize]);
+        }
+        assert!(index.num_removed < MIN_COMPACTION);
+        assert_eq!(index.numbers.len(), 1000);
+
+        for query in ["w0 w1", "w3 w57 w120", "w0 w2 w9 w200 w399", "w350"] {
+            for top_k in [1, 10, 100] {
+                let hits = index.search(query, top_k);
+                let expected = exhaustive_search(&index, query, top_k);
+                assert_eq!(hits.len(), expected.len());
+                for (hit, expected) in hits.iter().zip(&expected) {
+                    assert!((hit.1 - expected.1).abs() < 1e-4);
+                }
+            }
+        }
+
+        index.clear();
+        assert!(index.search("w0", 10).is_empty());
+    }
+
+    /// Indexing throughput and query latency over a million short documents.
+    /// Run with `cargo test --release bm25_million_documents -- --ignored --nocapture`.
+    #[test]
+    #[ignore]
+    fn bm25_million_documents() {
+        use std::time::Instant;
+
+        const NUM_DOCS: usize = 1_000_000;
+        const NUM_QUERIES: usize = 1_000;
+
+        let mut seed = 11u64;
+        let mut random = move || {
+            seed = seed
+                .wrapping_mul(6364136223846793005)
+                .wrapping_add(1442695040888963407);
+            (seed >> 33) as usize
+        };
+        let mut word = move || format!("w{}", (random() % 5000) * (random() % 5000) / 5000);
+
+        let mut index = Bm25Index::new();
+        let start = Instant::now();
+        for id in 0..NUM_DOCS {
+            let document = (0..40).map(|_| word()).collect::<Vec<_>>().join(" ");
+            index.insert(id as i64, &document);
+        }
+        println!("indexed {} documents in {:.1?}", NUM_DOCS, start.elapsed());
+
+        let queries: Vec<String> = (0..NUM_QUERIES)
+            .map(|_| (0..4).map(|_| word()).collect::<Vec<_>>().join(" "))
+            .collect();
+        let start = Instant::now();
+        for query in &queries {
+            assert!(index.search(query, 10).len() <= 10);
+        }
+        println!(
+            "{:.0} queries per second",
+            NUM_QUERIES as f64 / start.elapsed().as_secs_f64()
+        );
+    }
+}
@@ -0,0 +1,176 @@
+//! Worker threads that run FAISS calls off the async executor.
+//!
+//! FAISS searches and index updates are CPU-bound and can take milliseconds to
+//! seconds; running them inline would stall every other task scheduled on the same
+//! executor thread. Jobs are queued to a fixed set of threads instead and their
+//! results are awaited through a oneshot channel.
+
+use std::{
+    panic::AssertUnwindSafe,
+    sync::{
+        Arc, Mutex, OnceLock,
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        mpsc,
+    },
+};
+
+use anyhow::{Context, anyhow};
+use serde::{Deserialize, Serialize};
+
+/// Snapshot of the load of a compute pool.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+#[cfg_attr(feature = "python", pyo3_stub_gen_derive::gen_stub_pyclass)]
+#[cfg_attr(feature = "python", pyo3::pyclass(module = "ailoy._core", get_all))]
+#[cfg_attr(feature = "nodejs", napi_derive::napi(object))]
+pub struct ComputePoolMetrics {
+    /// Number of worker threads.
+    pub threads: u32,
+    /// Jobs waiting for a free worker.
+    pub queued: u32,
+    /// Jobs currently running.
+    pub running: u32,
+    /// Jobs finished since the pool was created, including failed ones.
+    pub completed: i64,
+}
+
+#[derive(Debug, Default)]
+struct PoolStats {
+    queued: AtomicUsize,
+    running: AtomicUsize,
+    completed: AtomicU64,
+}
+
+type Job = Box<dyn FnOnce() + Send>;
+
+#[derive(Debug)]
+pub struct ComputePool {
+    sender: mpsc::Sender<Job>,
+    stats: Arc<PoolStats>,
+    threads: usize,
+}
+
+impl ComputePool {
+    pub fn new(threads: usize) -> anyhow::Result<Self> {
+        let threads = threads.max(1);
+        let (sender, receiver) = mpsc::channel::<Job>();
+        let receiver = Arc::new(Mutex::new(receiver));
+        for i in 0..threads {
+            let receiver = receiver.clone();
+            std::thread::Builder::new()
+                .name(format!("ailoy-faiss-{}", i))
+                .spawn(move || {
+                    loop {
+                        // The lock is released before the job runs
+                        let job = receiver.lock().unwrap().recv();
+                        match job {
+                            Ok(job) => job(),
+                            // Every sender is gone: the pool was dropped
+                            Err(_) => break,
+                        }
+                    }
+                })
+                .context("Failed to spawn compute pool thread")?;
+        }
+        Ok(Self {
+            sender,
+            stats: Arc::new(PoolStats::default()),
+            threads,
+        })
+    }
+
+    /// Pool shared by stores that don't ask for their own. FAISS already
+    /// parallelizes large calls internally, so it takes half of the cores to leave
+    /// room for those threads and the async executor.
+    pub fn shared() -> Arc<Self> {
+        static SHARED: OnceLock<Arc<ComputePool>> = OnceLock::new();
+        SHARED
+            .get_or_init(|| {
+                let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+                Arc::new(Self::new(cores.div_ceil(2)).expect("Failed to create compute pool"))
+            })
+            .clone()
+    }
+
+    /// Runs `f` on a worker thread and waits for its result without blocking the
+    /// executor. `f` runs inside the caller's tokio runtime context, if any, so it
+    /// may spawn tasks.
+    ///
+    /// `f` still runs to completion when the returned future is dropped.
+    pub async fn run<T, F>(&self, f: F) -> anyhow::Result<T>
+    where
+        F: FnOnce() -> T + Send + 'static,
+        T: Send + 'static,
+    {
+        let (tx, rx) = tokio::sync::oneshot::channel();
+        let runtime = tokio::runtime::Handle::try_current().ok();
+        let stats = self.stats.clone();
+        let job: Job = Box::new(move || {
+            stats.queued.fetch_sub(1, Ordering::Relaxed);
+            stats.running.fetch_add(1, Ordering::Relaxed);
+            let _entered = runtime.as_ref().map(|runtime| runtime.enter());
+            // Keep the worker alive if `f` panics; the caller sees a closed channel
+            let result = std::panic::catch_unwind(AssertUnwindSafe(f));
+            stats.running.fetch_sub(1, Ordering::Relaxed);
+            stats.completed.fetch_add(1, Ordering::Relaxed);
+            if let Ok(result) = result {
+                let _ = tx.send(result);
+            }
+        });
+
+        self.stats.queued.fetch_add(1, Ordering::Relaxed);
+        if self.sender.send(job).is_err() {
+            self.stats.queued.fetch_sub(1, Ordering::Relaxed);
+            return Err(anyhow!("Compute pool is shut down"));
+        }
+        rx.await.context("Compute pool job panicked")
+    }
+
+    pub fn metrics(&self) -> ComputePoolMetrics {
+        ComputePoolMetrics {
+            threads: self.threads as u32,
+            queued: self.stats.queued.load(Ordering::Relaxed) as u32,
+            running: self.stats.running.load(Ordering::Relaxed) as u32,
+            completed: self.stats.completed.load(Ordering::Relaxed) as i64,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::utils::sleep;
+
+    #[tokio::test]
+    async fn compute_pool_runs_jobs_and_counts_them() {
+        let pool = Arc::new(ComputePool::new(1).unwrap());
+        assert_eq!(pool.run(|| 1 + 1).await.unwrap(), 2);
+
+        // Occupy the only worker so the next job has to queue
+        let (release_tx, release_rx) = std::sync::mpsc::channel::<()>();
+        let blocked = tokio::spawn({
+            let pool = pool.clone();
+            async move { pool.run(move || release_rx.recv().unwrap()).await }
+        });
+        let queued = tokio::spawn({
+            let pool = pool.clone();
+            async move { pool.run(|| 3).await }
+        });
+        while pool.metrics().running == 0 || pool.metrics().queued == 0 {
+            sleep(1).await;
+        }
+
+        release_tx.send(()).unwrap();
+        blocked.await.unwrap().unwrap();
+        assert_eq!(queued.await.unwrap().unwrap(), 3);
+
+        assert!(pool.run(|| panic!("boom")).await.is_err());
+        assert_eq!(pool.run(|| 4).await.unwrap(), 4);
+
+        let metrics = pool.metrics();
+        assert_eq!(metrics.threads, 1);
+        assert_eq!(metrics.queued, 0);
+        assert_eq!(metrics.running, 0);
+        assert_eq!(metrics.completed, 5);
+    }
+}
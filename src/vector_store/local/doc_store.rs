@@ -0,0 +1,154 @@
+//! Documents and metadata of a [`FaissStore`](super::FaissStore), keyed by its ids.
+//!
+//! The index allocates ids sequentially, so entries sit in a slab indexed by id
+//! instead of a map keyed by their decimal strings. Each entry keeps its id string,
+//! text and metadata behind `Arc`s, so retrievals hand out shared views of them
+//! instead of copying them for every hit.
+
+use std::sync::Arc;
+
+use anyhow::bail;
+
+use super::super::base::VectorStoreMetadata;
+
+pub struct DocEntry {
+    /// Decimal form of the id, as the store reports it.
+    pub id: Arc<str>,
+    pub document: Arc<str>,
+    pub metadata: Option<Arc<VectorStoreMetadata>>,
+}
+
+#[derive(Default)]
+pub struct DocStore {
+    slots: Vec<Option<DocEntry>>,
+    len: usize,
+}
+
+impl DocStore {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn with_capacity(documents: usize) -> Self {
+        Self {
+            slots: Vec::with_capacity(documents),
+            ..Self::default()
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    pub fn get(&self, id: i64) -> Option<&DocEntry> {
+        self.slots.get(usize::try_from(id).ok()?)?.as_ref()
+    }
+
+    pub fn contains(&self, id: i64) -> bool {
+        self.get(id).is_some()
+    }
+
+    /// Ids of every stored document in ascending order.
+    pub fn ids(&self) -> impl Iterator<Item = i64> + '_ {
+        self.slots
+            .iter()
+            .enumerate()
+            .filter(|(_, slot)| slot.is_some())
+            .map(|(id, _)| id as i64)
+    }
+
+    pub fn document(&self, id: i64) -> Option<&str> {
+        Some(&self.get(id)?.document)
+    }
+
+    /// The metadata of `id`, if it is stored and has some.
+    pub fn metadata(&self, id: i64) -> Option<&VectorStoreMetadata> {
+        self.get(id)?.metadata.as_deref()
+    }
+
+    /// Stores `document` and `metadata` under `id`, replacing what it held.
+    pub fn insert(
+        &mut self,
+        id: i64,
+        document: &str,
+        metadata: Option<VectorStoreMetadata>,
+    ) -> anyhow::Result<()> {
+        let Ok(index) = usize::try_from(id) else {
+            bail!("Document id {} is negative", id);
+        };
+        self.remove(id);
+        if index >= self.slots.len() {
+            self.slots.resize_with(index + 1, || None);
+        }
+        self.slots[index] = Some(DocEntry {
+            id: id.to_string().into(),
+            document: document.into(),
+            metadata: metadata.map(Arc::new),
+        });
+        self.len += 1;
+        Ok(())
+    }
+
+    /// Drops the document of `id`. Returns whether it was stored.
+    pub fn remove(&mut self, id: i64) -> bool {
+        let removed = usize::try_from(id)
+            .ok()
+            .and_then(|index| self.slots.get_mut(index))
+            .and_then(Option::take)
+            .is_some();
+        if removed {
+            self.len -= 1;
+        }
+        removed
+    }
+
+    pub fn clear(&mut self) {
+        *self = Self::default();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use serde_json::{from_value, json};
+
+    use super::*;
+
+    #[test]
+    fn doc_store_keeps_entries_by_id() -> anyhow::Result<()> {
+        let source = |name: &str| -> Option<VectorStoreMetadata> {
+            Some(from_value(json!({ "source": name })).unwrap())
+        };
+        let mut docs = DocStore::new();
+        docs.insert(0, "first", source("a"))?;
+        docs.insert(2, "third", None)?;
+        docs.insert(3, "fourth", source("b"))?;
+        assert!(docs.insert(-1, "negative", None).is_err());
+
+        assert_eq!(docs.len(), 3);
+        assert_eq!(docs.ids().collect::<Vec<_>>(), vec![0, 2, 3]);
+        assert_eq!(docs.document(3), Some("fourth"));
+        assert_eq!(docs.document(1), None);
+        assert_eq!(docs.metadata(2), None);
+        assert_eq!(docs.metadata(3), source("b").as_ref());
+        assert_eq!(&*docs.get(3).unwrap().id, "3");
+
+        // Replacing keeps a single entry for the id
+        docs.insert(2, "third again", None)?;
+        assert_eq!(docs.len(), 3);
+        assert_eq!(docs.document(2), Some("third again"));
+
+        assert!(docs.remove(0));
+        assert!(!docs.remove(0));
+        assert!(!docs.contains(0));
+        assert_eq!(docs.len(), 2);
+
+        docs.clear();
+        assert!(docs.is_empty());
+        assert_eq!(docs.ids().count(), 0);
+        Ok(())
+    }
+}
@@ -1,122 +1,803 @@
-use std::collections::HashMap;
-
 use ailoy_macros::multi_platform_async_trait;
+use anyhow::{Context, bail};
+use serde::{Deserialize, Serialize};
+use strum::EnumString;
+use strum_macros::Display;
 
-use super::super::base::{
-    VectorStoreAddInput, VectorStoreBehavior, VectorStoreGetResult, VectorStoreMetadata,
-    VectorStoreRetrieveResult,
+use super::{
+    super::base::{
+        VectorStoreAddBatch, VectorStoreAddInput, VectorStoreBehavior, VectorStoreFilter,
+        VectorStoreGetResult, VectorStoreMetadata, VectorStoreRetrieveHit, VectorStoreSearchParams,
+    },
+    bm25::Bm25Index,
+    doc_store::DocStore,
+    full_precision::FullPrecisionVectors,
+    metadata_index::MetadataIndex,
+    shards::FaissShards,
+    snapshot,
 };
 use crate::{
-    ffi::faiss_wrap::{FaissIndex, FaissIndexBuilder},
-    value::Embedding,
+    ffi::faiss_wrap::{
+        FaissBinaryIndex, FaissIdSelector, FaissIndex, FaissMetricType, FaissSearchParams,
+        SEARCH_ARENA, binary_quantize,
+    },
+    utils::simd,
+    value::{Embedding, EmbeddingBatch},
 };
 
-struct DocEntry {
-    pub document: String,
-    pub metadata: Option<VectorStoreMetadata>,
+/// Distance used to compare embeddings.
+#[derive(
+    Clone, Copy, Debug, Default, Serialize, Deserialize, PartialEq, Eq, Display, EnumString,
+)]
+#[cfg_attr(feature = "python", derive(ailoy_macros::PyStringEnum))]
+#[cfg_attr(feature = "nodejs", napi_derive::napi(string_enum))]
+#[cfg_attr(feature = "wasm", derive(tsify::Tsify))]
+#[cfg_attr(feature = "wasm", tsify(from_wasm_abi, into_wasm_abi))]
+pub enum FaissStoreMetric {
+    /// Squared euclidean distance; smaller is closer.
+    #[default]
+    L2,
+    /// Dot product; larger is closer. Use with normalized embeddings for cosine similarity.
+    InnerProduct,
+}
+
+impl From<FaissStoreMetric> for FaissMetricType {
+    fn from(value: FaissStoreMetric) -> Self {
+        match value {
+            FaissStoreMetric::L2 => FaissMetricType::L2,
+            FaissStoreMetric::InnerProduct => FaissMetricType::InnerProduct,
+        }
+    }
+}
+
+impl From<VectorStoreSearchParams> for FaissSearchParams {
+    fn from(value: VectorStoreSearchParams) -> Self {
+        // Zero keeps the index's own setting
+        FaissSearchParams {
+            nprobe: value.nprobe.unwrap_or_default() as usize,
+            ef_search: value.ef_search.unwrap_or_default() as usize,
+            k_factor: value.k_factor.unwrap_or_default(),
+        }
+    }
+}
+
+#[derive(Clone, Debug, Default, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+#[cfg_attr(feature = "nodejs", napi_derive::napi(object))]
+#[cfg_attr(feature = "wasm", derive(tsify::Tsify))]
+#[cfg_attr(feature = "wasm", tsify(from_wasm_abi, into_wasm_abi))]
+pub struct FaissStoreConfig {
+    /// FAISS index factory string such as `"Flat"`, `"IVF1024,Flat"`, `"HNSW32"`,
+    /// `"IVF1024,PQ16"` or `"SQ8"`. Defaults to `"Flat"`.
+    ///
+    /// Indexes that need training (IVF, PQ, ...) serve from a flat staging index
+    /// until `training_samples` vectors were added, then get trained in the
+    /// background and replace it. HNSW indexes do not support removal.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub index_description: Option<String>,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub metric: Option<FaissStoreMetric>,
+    /// Number of vectors to collect before training the index. Defaults to 10000;
+    /// IVF indexes want at least `39 * nlist`. A failed training run doubles it
+    /// before the next attempt.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub training_samples: Option<u32>,
+    /// Threads of a compute pool dedicated to this store's FAISS calls. Unset
+    /// stores share one pool sized to half of the cores. Ignored on the web.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub compute_threads: Option<u32>,
+    /// Unfiltered retrieve calls arriving within this many microseconds of each
+    /// other are searched as one batch, which makes flat search several times
+    /// cheaper per query. Off when unset. Ignored on the web.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub batch_window_micros: Option<u32>,
+    /// Searches a batch as soon as it holds this many queries. Defaults to 64.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub max_batch_size: Option<u32>,
+    /// Splits the store into this many independent indexes, which entries are
+    /// spread over round-robin. Queries search every shard in parallel and merge
+    /// the results. Defaults to 1.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub shards: Option<u32>,
+    /// Keeps full-precision embeddings beside the index so that a compressed
+    /// index such as `"SQ8"`, `"SQfp16"` or `"PQ32"` only serves the candidate
+    /// pass. Searches fetch `top_k * k_factor` candidates (4 unless the search
+    /// params set `k_factor`) and re-rank them exactly, and `get_by_ids` returns
+    /// the original embeddings. The embeddings are kept in a temporary file, or in
+    /// memory on the web.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub exact_rerank: Option<bool>,
+    /// FAISS binary index factory string such as `"BFlat"`, `"BIVF1024"` or
+    /// `"BHNSW32"`. When set, the sign bits of every embedding are also kept in
+    /// this index, and unfiltered searches take their `top_k * k_factor`
+    /// candidates (10 unless the search params set `k_factor`) by Hamming
+    /// distance before re-scoring them with the float embeddings. A binary index
+    /// that needs training serves once `training_samples` vectors were added.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub binary_index: Option<String>,
+    /// Also keeps a BM25 index over the documents, which serves
+    /// `retrieve_lexical` and the lexical and hybrid modes of knowledge
+    /// retrieval. It is updated on every add and removal, and rebuilt from the
+    /// documents when a saved store is loaded.
+    #[serde(skip_serializing_if = "Option::is_none")]
+    pub lexical_index: Option<bool>,
+}
+
+impl FaissStoreConfig {
+    /// Wraps the description with `IDMap2` unless the index keeps its own ids (IVF)
+    /// or the caller already chose an id map.
+    fn resolved_description(&self) -> String {
+        let description = self.index_description.as_deref().unwrap_or("Flat").trim();
+        if description.starts_with("IDMap") || description.contains("IVF") {
+            description.to_owned()
+        } else {
+            format!("IDMap2,{}", description)
+        }
+    }
+
+    /// Same rule as [`Self::resolved_description`], for the binary index.
+    fn resolved_binary_description(&self) -> Option<String> {
+        let description = self.binary_index.as_deref()?.trim();
+        if description.starts_with("IDMap") || description.contains("IVF") {
+            Some(description.to_owned())
+        } else {
+            Some(format!("IDMap2,{}", description))
+        }
+    }
+
+    fn resolved_shards(&self) -> usize {
+        self.shards.unwrap_or(1).max(1) as usize
+    }
+
+    fn resolved_training_samples(&self) -> usize {
+        self.training_samples
+            .unwrap_or(DEFAULT_TRAINING_SAMPLES)
+            .max(1) as usize
+    }
+}
+
+const DEFAULT_TRAINING_SAMPLES: u32 = 10_000;
+pub(crate) const DEFAULT_MAX_BATCH_SIZE: u32 = 64;
+const DEFAULT_RERANK_FACTOR: f32 = 4.0;
+const DEFAULT_BINARY_RERANK_FACTOR: f32 = 10.0;
+
+/// Ids a filtered search is allowed to return.
+enum IdSelection {
+    All,
+    Nothing,
+    Bitmap(Vec<u8>),
+    Ids(Vec<i64>),
+}
+
+impl IdSelection {
+    fn as_selector(&self) -> Option<FaissIdSelector<'_>> {
+        match self {
+            IdSelection::Bitmap(bitmap) => Some(FaissIdSelector::Bitmap(bitmap)),
+            IdSelection::Ids(ids) => Some(FaissIdSelector::Ids(ids)),
+            IdSelection::All | IdSelection::Nothing => None,
+        }
+    }
+}
+
+/// Untrained index waiting for enough vectors to be trained on.
+struct PendingIndex {
+    /// Taken out while training runs.
+    target: Option<FaissShards>,
+    training_samples: usize,
+    /// Why the last training run failed, if it did.
+    error: Option<String>,
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    training: Option<tokio::task::JoinHandle<(FaissShards, anyhow::Result<()>)>>,
+    /// Turns true once the run in `training` is over, for waiters that do not
+    /// hold the store.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    training_done: Option<tokio::sync::watch::Receiver<bool>>,
 }
-type DocStore = HashMap<String, DocEntry>;
 
 pub struct FaissStore {
-    index: FaissIndex,
+    /// Serves every read. Until `pending` is trained this is a flat staging index.
+    index: FaissShards,
+    pending: Option<PendingIndex>,
     doc_store: DocStore,
+    metadata_index: MetadataIndex,
+    /// Exact embeddings re-ranking the candidates of a compressed index.
+    full_precision: Option<FullPrecisionVectors>,
+    binary: Option<BinaryCandidates>,
+    lexical: Option<Bm25Index>,
+}
+
+/// Sign-bit codes of the embeddings, searched by Hamming distance as the
+/// candidate pass of unfiltered searches.
+struct BinaryCandidates {
+    index: FaissBinaryIndex,
+    /// Vectors to collect before training an index that needs it.
+    training_samples: usize,
+}
+
+/// Number of candidates to fetch for `top_k` results that get re-ranked.
+fn rerank_candidates(
+    top_k: usize,
+    search_params: &VectorStoreSearchParams,
+    default_factor: f32,
+) -> usize {
+    let factor = search_params
+        .k_factor
+        .filter(|factor| *factor >= 1.0)
+        .unwrap_or(default_factor);
+    (top_k as f32 * factor).ceil() as usize
+}
+
+/// Exact distance between two embeddings under the index's metric.
+fn exact_distance(a: &[f32], b: &[f32], metric: FaissMetricType) -> f32 {
+    if metric == FaissMetricType::InnerProduct {
+        simd::dot(a, b)
+    } else {
+        simd::l2_distance_squared(a, b)
+    }
 }
 
 impl FaissStore {
-    pub async fn new(dim: u32) -> anyhow::Result<Self> {
-        // use only default type("IdMap2,Flat", InnerProduct) Index for now
-        let index = FaissIndexBuilder::new(dim as i32).build().await.unwrap();
+    pub async fn new(dim: u32, config: Option<FaissStoreConfig>) -> anyhow::Result<Self> {
+        let config = config.unwrap_or_default();
+        let metric = config.metric.unwrap_or_default().into();
+        let num_shards = config.resolved_shards();
+        let index =
+            FaissShards::new(dim, &config.resolved_description(), metric, num_shards).await?;
+        let full_precision = if config.exact_rerank.unwrap_or(false) {
+            Some(FullPrecisionVectors::new(dim as usize)?)
+        } else {
+            None
+        };
+        let binary = match config.resolved_binary_description() {
+            Some(description) => Some(BinaryCandidates {
+                // Codes are padded to whole bytes
+                index: FaissBinaryIndex::new((dim as i32 + 7) / 8 * 8, &description).await?,
+                training_samples: config.resolved_training_samples(),
+            }),
+            None => None,
+        };
+        let lexical = config.lexical_index.unwrap_or(false).then(Bm25Index::new);
+        if index.is_trained() {
+            return Ok(Self {
+                index,
+                pending: None,
+                doc_store: DocStore::new(),
+                metadata_index: MetadataIndex::new(),
+                full_precision,
+                binary,
+                lexical,
+            });
+        }
+
+        let staging = FaissShards::new(dim, "IDMap2,Flat", metric, num_shards).await?;
         Ok(Self {
-            index,
-            doc_store: HashMap::new(),
+            index: staging,
+            pending: Some(PendingIndex {
+                target: Some(index),
+                training_samples: config.resolved_training_samples(),
+                error: None,
+                #[cfg(any(target_family = "unix", target_family = "windows"))]
+                training: None,
+                #[cfg(any(target_family = "unix", target_family = "windows"))]
+                training_done: None,
+            }),
+            doc_store: DocStore::new(),
+            metadata_index: MetadataIndex::new(),
+            full_precision,
+            binary,
+            lexical,
         })
     }
-}
 
-#[multi_platform_async_trait]
-impl VectorStoreBehavior for FaissStore {
-    async fn add_vector(&mut self, input: VectorStoreAddInput) -> anyhow::Result<String> {
-        let ids: Vec<String> = self.index.add_vectors(&[input.embedding.into()]).unwrap();
-        let id = ids.iter().next().unwrap().clone();
-        self.doc_store.insert(
-            id.clone(),
-            DocEntry {
-                document: input.document,
-                metadata: input.metadata,
-            },
-        );
-        Ok(id)
+    pub fn dimension(&self) -> usize {
+        self.index.dimension() as usize
+    }
+
+    /// Waits for a background training run to finish and swaps in the trained index.
+    ///
+    /// A store that has not collected enough samples yet keeps its staging index,
+    /// which [`FaissStore::to_bytes`] persists along with the untrained target.
+    pub async fn wait_for_training(&mut self) -> anyhow::Result<()> {
+        self.poll_training(true).await
+    }
+
+    /// Swaps in the trained index if training finished, or once it does when `wait` is set.
+    async fn poll_training(&mut self, wait: bool) -> anyhow::Result<()> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        {
+            let Some(pending) = self.pending.as_mut() else {
+                return Ok(());
+            };
+            let Some(handle) = pending
+                .training
+                .take_if(|handle| wait || handle.is_finished())
+            else {
+                return Ok(());
+            };
+            pending.training_done = None;
+            let (target, result) = handle.await.context("Index training task failed")?;
+            self.finish_training(target, result)?;
+        }
+        #[cfg(target_family = "wasm")]
+        let _ = wait;
+        Ok(())
     }
 
-    async fn add_vectors(
+    /// Why the last training run failed, while the store is still staging.
+    pub fn training_error(&self) -> Option<&str> {
+        self.pending.as_ref()?.error.as_deref()
+    }
+
+    /// Resolves once the training run in flight is over, without borrowing the
+    /// store meanwhile. The trained index is swapped in by the next call that
+    /// polls training, such as [`FaissStore::wait_for_training`].
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    pub fn training_finished(&self) -> Option<impl Future<Output = ()> + Send + 'static> {
+        let mut done = self.pending.as_ref()?.training_done.clone()?;
+        Some(async move {
+            let _ = done.wait_for(|done| *done).await;
+        })
+    }
+
+    /// Starts training the pending index once enough vectors are staged.
+    fn maybe_start_training(&mut self) -> anyhow::Result<()> {
+        let Some(training_samples) = self
+            .pending
+            .as_ref()
+            .filter(|pending| pending.target.is_some())
+            .map(|pending| pending.training_samples)
+        else {
+            return Ok(());
+        };
+        if self.doc_store.len() < training_samples {
+            return Ok(());
+        }
+
+        let sample_ids: Vec<i64> = self.doc_store.ids().take(training_samples).collect();
+        let sample = self.index.get_by_ids(&sample_ids)?.into_flat();
+        let mut target = self.pending.as_mut().unwrap().target.take().unwrap();
+
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        {
+            // Training runs k-means over the whole sample; keep it off the async runtime
+            // while reads and writes keep going to the staging index.
+            let (done, training_done) = tokio::sync::watch::channel(false);
+            let pending = self.pending.as_mut().unwrap();
+            pending.training = Some(tokio::task::spawn_blocking(move || {
+                let result = target.train(&sample);
+                done.send_replace(true);
+                (target, result)
+            }));
+            pending.training_done = Some(training_done);
+            Ok(())
+        }
+
+        #[cfg(target_family = "wasm")]
+        {
+            let result = target.train(&sample);
+            self.finish_training(target, result)
+        }
+    }
+
+    /// Trains the binary index once enough vectors were added and fills it with
+    /// the codes of every stored embedding.
+    fn maybe_train_binary(&mut self) -> anyhow::Result<()> {
+        let Some(binary) = self.binary.as_ref() else {
+            return Ok(());
+        };
+        if binary.index.is_trained() || self.doc_store.len() < binary.training_samples {
+            return Ok(());
+        }
+
+        let ids: Vec<i64> = self.doc_store.ids().collect();
+        let dimension = self.index.dimension() as usize;
+        let mut vectors = vec![0f32; ids.len() * dimension];
+        self.embeddings_into(&ids, &mut vectors)?;
+        let codes = binary_quantize(&vectors, dimension);
+
+        let binary = self.binary.as_mut().unwrap();
+        let sample_len = binary.training_samples * binary.index.code_size();
+        binary.index.train(&codes[..sample_len])?;
+        binary.index.add_codes_with_ids(&codes, &ids)
+    }
+
+    /// The binary index, once it can serve searches.
+    fn trained_binary_index(&self) -> Option<&FaissBinaryIndex> {
+        self.binary
+            .as_ref()
+            .map(|binary| &binary.index)
+            .filter(|index| index.is_trained())
+    }
+
+    fn remove_codes(&mut self, ids: &[i64]) -> anyhow::Result<()> {
+        let Some(binary) = self.binary.as_mut() else {
+            return Ok(());
+        };
+        if !binary.index.is_trained() {
+            return Ok(());
+        }
+        binary.index.remove_ids(ids)?;
+        Ok(())
+    }
+
+    /// Moves every staged vector into the trained `target` and makes it the serving index.
+    fn finish_training(
         &mut self,
-        inputs: Vec<VectorStoreAddInput>,
-    ) -> anyhow::Result<Vec<String>> {
-        let (embeddings, entries): (Vec<Embedding>, Vec<DocEntry>) = inputs
-            .into_iter()
-            .map(|input| {
-                (
-                    input.embedding,
-                    DocEntry {
-                        document: input.document,
-                        metadata: input.metadata,
-                    },
-                )
-            })
-            .unzip();
-        let ids: Vec<String> = self
-            .index
-            .add_vectors(
-                embeddings
-                    .into_iter()
-                    .map(|emb| emb.into())
-                    .collect::<Vec<_>>()
-                    .as_slice(),
-            )
-            .unwrap();
-        self.doc_store
-            .extend(ids.iter().cloned().zip(entries.into_iter()));
-        Ok(ids)
+        mut target: FaissShards,
+        result: anyhow::Result<()>,
+    ) -> anyhow::Result<()> {
+        let moved = result.and_then(|_| {
+            let ids: Vec<i64> = self.doc_store.ids().collect();
+            let vectors = self.index.get_by_ids(&ids)?;
+            target.add_vectors_with_ids(vectors.as_slice(), &ids)
+        });
+        if let Err(e) = moved {
+            // Keep serving from the staging index. Retrying on every later add
+            // would rerun k-means each time, so wait for twice the samples.
+            let pending = self.pending.as_mut().unwrap();
+            pending.training_samples = pending.training_samples.saturating_mul(2);
+            crate::warn!(
+                "Failed to train the index, staying on the flat index until {} vectors: {}",
+                pending.training_samples,
+                e
+            );
+            pending.error = Some(format!("{:#}", e));
+            target.clear()?;
+            pending.target = Some(target);
+            return Ok(());
+        }
+
+        target.restore_id_counter(self.index.current_id_counter());
+        self.index = target;
+        self.pending = None;
+        Ok(())
     }
 
-    async fn get_by_id(&self, id: &str) -> anyhow::Result<Option<VectorStoreGetResult>> {
-        if !self.doc_store.contains_key(&id.to_string()) {
-            return Ok(None);
+    /// Encodes the index, documents, metadata, id counter and full-precision
+    /// embeddings into one snapshot. A store that is still staging also keeps
+    /// its untrained target and training threshold, and trains after loading
+    /// just as it would have here. Fails while a training run is in flight;
+    /// call [`FaissStore::wait_for_training`] first.
+    pub fn to_bytes(&self) -> anyhow::Result<Vec<u8>> {
+        let staging = match &self.pending {
+            Some(pending) => {
+                let Some(target) = pending.target.as_ref() else {
+                    bail!("The index is training; wait for it to finish before saving");
+                };
+                Some((pending.training_samples, target.serialize()?))
+            }
+            None => None,
+        };
+        let indexes = self.index.serialize()?;
+        let ids: Vec<i64> = self.doc_store.ids().collect();
+        let entries = ids.iter().map(|&id| {
+            let document = self.doc_store.document(id).unwrap_or_default();
+            (id, document, self.doc_store.metadata(id))
+        });
+        let vectors = match &self.full_precision {
+            Some(full_precision) => {
+                let mut vectors = vec![0f32; ids.len() * full_precision.dimension()];
+                full_precision.get_into(&ids, &mut vectors)?;
+                Some((full_precision.dimension(), vectors))
+            }
+            None => None,
+        };
+        let binary_index = match &self.binary {
+            Some(binary) => Some((binary.training_samples, binary.index.serialize()?)),
+            None => None,
+        };
+        snapshot::encode(
+            self.index.current_id_counter(),
+            &indexes,
+            entries,
+            vectors
+                .as_ref()
+                .map(|(dimension, vectors)| (*dimension, vectors.as_slice())),
+            binary_index
+                .as_ref()
+                .map(|(training_samples, index)| (*training_samples, index.as_slice())),
+            self.lexical.is_some(),
+            staging
+                .as_ref()
+                .map(|(training_samples, targets)| (*training_samples, targets.as_slice())),
+        )
+    }
+
+    /// Restores a store from the output of [`FaissStore::to_bytes`].
+    pub async fn from_bytes(bytes: &[u8]) -> anyhow::Result<Self> {
+        let snapshot = snapshot::decode(bytes)?;
+        let mut shards = Vec::with_capacity(snapshot.indexes.len());
+        for index in snapshot.indexes {
+            shards.push(FaissIndex::deserialize(index).await?);
         }
+        let index = FaissShards::from_indexes(shards, snapshot.next_id)?;
+        let full_precision = match snapshot.vectors {
+            Some((dimension, vectors)) => {
+                let ids: Vec<i64> = snapshot.entries.iter().map(|entry| entry.id).collect();
+                let mut full_precision = FullPrecisionVectors::new(dimension)?;
+                full_precision.insert(&ids, &vectors)?;
+                Some(full_precision)
+            }
+            None => None,
+        };
+        let binary = match snapshot.binary_index {
+            Some((training_samples, bytes)) => Some(BinaryCandidates {
+                index: FaissBinaryIndex::deserialize(bytes).await?,
+                training_samples,
+            }),
+            None => None,
+        };
+        let pending = match snapshot.staging {
+            Some((training_samples, targets)) => {
+                let mut shards = Vec::with_capacity(targets.len());
+                for target in targets {
+                    shards.push(FaissIndex::deserialize(target).await?);
+                }
+                Some(PendingIndex {
+                    target: Some(FaissShards::from_indexes(shards, 0)?),
+                    training_samples,
+                    error: None,
+                    #[cfg(any(target_family = "unix", target_family = "windows"))]
+                    training: None,
+                    #[cfg(any(target_family = "unix", target_family = "windows"))]
+                    training_done: None,
+                })
+            }
+            None => None,
+        };
 
-        let embeddings: Vec<Vec<f32>> = self.index.get_by_ids(&[id]).unwrap();
-        let embedding = embeddings.into_iter().next().unwrap();
-        let doc_entry = self.doc_store.get(&id.to_string()).unwrap();
-        Ok(Some(VectorStoreGetResult {
-            id: id.to_string(),
-            document: doc_entry.document.clone(),
-            metadata: doc_entry.metadata.clone(),
-            embedding: embedding.into(),
-        }))
+        let mut store = Self {
+            index,
+            pending,
+            doc_store: DocStore::with_capacity(snapshot.entries.len()),
+            metadata_index: MetadataIndex::new(),
+            full_precision,
+            binary,
+            lexical: snapshot.lexical.then(Bm25Index::new),
+        };
+        for entry in snapshot.entries {
+            store.insert_entry(entry.id, &entry.document, entry.metadata)?;
+        }
+        Ok(store)
     }
 
-    async fn get_by_ids(&self, ids: &[&str]) -> anyhow::Result<Vec<VectorStoreGetResult>> {
-        // filter ids to only those that exist in doc_store
-        let filtered_ids: Vec<_> = ids
+    fn insert_entry(
+        &mut self,
+        id: i64,
+        document: &str,
+        metadata: Option<VectorStoreMetadata>,
+    ) -> anyhow::Result<()> {
+        if let Some(metadata) = &metadata {
+            self.metadata_index.insert(id, metadata);
+        }
+        if let Some(lexical) = self.lexical.as_mut() {
+            lexical.insert(id, document);
+        }
+        self.doc_store.insert(id, document, metadata)
+    }
+
+    fn remove_entry(&mut self, id: i64) {
+        let Some(document) = self.doc_store.document(id) else {
+            return;
+        };
+        if let Some(lexical) = self.lexical.as_mut() {
+            lexical.remove(id, document);
+        }
+        if let Some(metadata) = self.doc_store.metadata(id) {
+            self.metadata_index.remove(id, metadata);
+        }
+        if let Some(full_precision) = self.full_precision.as_mut() {
+            full_precision.remove(&[id]);
+        }
+        self.doc_store.remove(id);
+    }
+
+    /// Numeric ids of the stored documents among `ids`, in their order. Ids that
+    /// are not the decimal form of a stored id are skipped.
+    fn stored_ids(&self, ids: &[&str]) -> Vec<i64> {
+        ids.iter()
+            .filter_map(|id| id.parse::<i64>().ok())
+            .filter(|&id| self.doc_store.contains(id))
+            .collect()
+    }
+
+    /// Resolves `filter` to the set of ids a search may return, using the metadata index.
+    fn select_ids(&self, filter: Option<&VectorStoreFilter>) -> IdSelection {
+        let Some(filter) = filter.filter(|filter| !filter.is_empty()) else {
+            return IdSelection::All;
+        };
+        let ids = self.metadata_index.matching_ids(filter);
+        let Some(&max_id) = ids.last() else {
+            return IdSelection::Nothing;
+        };
+
+        // A bitmap costs one bit per id up to the largest match, while FAISS'
+        // IDSelectorBatch hashes every id; use whichever is smaller.
+        let bitmap_len = max_id as usize / 8 + 1;
+        if bitmap_len <= ids.len() * 8 {
+            let mut bitmap = vec![0u8; bitmap_len];
+            for id in ids {
+                bitmap[id as usize / 8] |= 1 << (id % 8);
+            }
+            IdSelection::Bitmap(bitmap)
+        } else {
+            IdSelection::Ids(ids)
+        }
+    }
+
+    /// Number of candidates to fetch from the index for `top_k` results.
+    fn num_candidates(&self, top_k: usize, search_params: &VectorStoreSearchParams) -> usize {
+        if self.full_precision.is_none() {
+            return top_k;
+        }
+        rerank_candidates(top_k, search_params, DEFAULT_RERANK_FACTOR)
+    }
+
+    /// Writes the embeddings of `ids` into `out`, exact ones when the store keeps
+    /// them and the index's reconstruction otherwise.
+    fn embeddings_into(&self, ids: &[i64], out: &mut [f32]) -> anyhow::Result<()> {
+        match &self.full_precision {
+            Some(full_precision) => full_precision.get_into(ids, out),
+            None => self.index.get_by_ids_into(ids, out),
+        }
+    }
+
+    /// Distances from `query` to the embeddings of `labels`, skipping the padding
+    /// labels of a short result.
+    fn exact_distances(
+        &self,
+        query: &[f32],
+        labels: &[i64],
+    ) -> anyhow::Result<(Vec<f32>, Vec<i64>)> {
+        let labels: Vec<i64> = labels
             .iter()
-            .filter(|&&id| self.doc_store.contains_key(id))
-            .cloned()
+            .copied()
+            .filter(|&id| match &self.full_precision {
+                Some(full_precision) => full_precision.contains(id),
+                None => self.doc_store.contains(id),
+            })
             .collect();
+        let dimension = self.index.dimension() as usize;
+        let mut vectors = vec![0f32; labels.len() * dimension];
+        self.embeddings_into(&labels, &mut vectors)?;
+        let metric = self.index.metric_type();
+        let distances = vectors
+            .chunks_exact(dimension)
+            .map(|vector| exact_distance(query, vector, metric))
+            .collect();
+        Ok((distances, labels))
+    }
+
+    /// Re-ranks the candidates of one query by their exact distances and keeps the
+    /// `top_k` closest. Without full-precision embeddings the index's ranking is kept.
+    fn rank_results(
+        &self,
+        query: &[f32],
+        distances: &[f32],
+        labels: &[i64],
+        top_k: usize,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        if self.full_precision.is_none() {
+            return Ok(self.collect_results(distances, labels));
+        }
+        self.rerank(query, labels, top_k)
+    }
 
-        let embeddings: Vec<Vec<f32>> = self.index.get_by_ids(&filtered_ids).unwrap();
+    /// Ranks `labels` by their exact distances to `query` and keeps the `top_k`
+    /// closest.
+    fn rerank(
+        &self,
+        query: &[f32],
+        labels: &[i64],
+        top_k: usize,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        let (distances, labels) = self.exact_distances(query, labels)?;
+        let mut ranked: Vec<(f32, i64)> = distances.into_iter().zip(labels).collect();
+        if self.index.metric_type() == FaissMetricType::InnerProduct {
+            ranked.sort_by(|a, b| b.0.total_cmp(&a.0));
+        } else {
+            ranked.sort_by(|a, b| a.0.total_cmp(&b.0));
+        }
+        ranked.truncate(top_k);
+        let (distances, labels): (Vec<f32>, Vec<i64>) = ranked.into_iter().unzip();
+        Ok(self.collect_results(&distances, &labels))
+    }
 
-        Ok(ids
+    /// Ranks the documents by their BM25 score for `query` and keeps the `top_k`
+    /// best. The score is reported as the `distance`, so larger is closer.
+    pub fn retrieve_lexical(
+        &self,
+        query: &str,
+        top_k: usize,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        let lexical = self
+            .lexical
+            .as_ref()
+            .context("FaissStore has no lexical index; create it with `lexical_index`")?;
+        let (labels, scores): (Vec<i64>, Vec<f32>) =
+            lexical.search(query, top_k).into_iter().unzip();
+        Ok(self.collect_results(&scores, &labels))
+    }
+
+    fn collect_results(&self, distances: &[f32], indexes: &[i64]) -> Vec<VectorStoreRetrieveHit> {
+        indexes
             .iter()
-            .zip(embeddings.into_iter())
-            .filter_map(|(id, embedding)| {
-                self.doc_store
-                    .get(&id.to_string())
-                    .map(|doc_entry| VectorStoreGetResult {
-                        id: id.to_string(),
-                        document: doc_entry.document.clone(),
-                        metadata: doc_entry.metadata.clone(),
-                        embedding: embedding.into(),
-                    })
+            .zip(distances.iter())
+            .filter_map(|(&id, &distance)| {
+                let entry = self.doc_store.get(id)?;
+                Some(VectorStoreRetrieveHit {
+                    id: entry.id.clone(),
+                    document: entry.document.clone(),
+                    metadata: entry.metadata.clone(),
+                    distance: distance as f64,
+                })
+            })
+            .collect()
+    }
+}
+
+#[multi_platform_async_trait]
+impl VectorStoreBehavior for FaissStore {
+    async fn add_vector(&mut self, input: VectorStoreAddInput) -> anyhow::Result<String> {
+        let ids = self.add_vectors(vec![input]).await?;
+        Ok(ids.into_iter().next().unwrap())
+    }
+
+    async fn add_batch(&mut self, batch: VectorStoreAddBatch) -> anyhow::Result<Vec<String>> {
+        batch.validate()?;
+        let dimension = self.index.dimension() as usize;
+        if !batch.is_empty() && batch.embeddings.dimension() != dimension {
+            bail!(
+                "Embedding has dimension {}, expected {}",
+                batch.embeddings.dimension(),
+                dimension
+            );
+        }
+        let VectorStoreAddBatch {
+            embeddings,
+            documents,
+            metadatas,
+        } = batch;
+        let vectors = embeddings.as_slice();
+        self.poll_training(false).await?;
+        let ids = self.index.add_vectors(vectors)?;
+        if let Some(full_precision) = self.full_precision.as_mut() {
+            full_precision.insert(&ids, vectors)?;
+        }
+        if let Some(binary) = self.binary.as_mut()
+            && binary.index.is_trained()
+        {
+            let codes = binary_quantize(vectors, dimension);
+            binary.index.add_codes_with_ids(&codes, &ids)?;
+        }
+        for ((&id, document), metadata) in ids.iter().zip(documents).zip(metadatas) {
+            self.insert_entry(id, &document, metadata)?;
+        }
+        self.maybe_start_training()?;
+        self.maybe_train_binary()?;
+        Ok(ids.iter().map(i64::to_string).collect())
+    }
+
+    async fn get_by_id(&self, id: &str) -> anyhow::Result<Option<VectorStoreGetResult>> {
+        Ok(self.get_by_ids(&[id]).await?.into_iter().next())
+    }
+
+    async fn get_by_ids(&self, ids: &[&str]) -> anyhow::Result<Vec<VectorStoreGetResult>> {
+        let found_ids = self.stored_ids(ids);
+
+        // One batched reconstruction into a single buffer instead of one FFI call per id
+        let dimension = self.index.dimension() as usize;
+        let mut embeddings = vec![0f32; found_ids.len() * dimension];
+        self.embeddings_into(&found_ids, &mut embeddings)?;
+
+        Ok(found_ids
+            .into_iter()
+            .zip(embeddings.chunks_exact(dimension))
+            .map(|(id, embedding)| VectorStoreGetResult {
+                id: id.to_string(),
+                document: self.doc_store.document(id).unwrap_or_default().to_owned(),
+                metadata: self.doc_store.metadata(id).cloned(),
+                embedding: embedding.to_vec().into(),
             })
             .collect())
     }
@@ -125,97 +806,176 @@ impl VectorStoreBehavior for FaissStore {
         &self,
         query_embedding: Embedding,
         top_k: usize,
-    ) -> anyhow::Result<Vec<VectorStoreRetrieveResult>> {
-        let index_results = self.index.search(&[query_embedding.into()], top_k).unwrap();
-        let index_result = index_results.into_iter().next().unwrap();
+        filter: Option<VectorStoreFilter>,
+        search_params: Option<VectorStoreSearchParams>,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        let selection = self.select_ids(filter.as_ref());
+        if let IdSelection::Nothing = selection {
+            return Ok(vec![]);
+        }
 
-        Ok(index_result
-            .indexes
-            .into_iter()
-            .zip(index_result.distances.into_iter())
-            .filter_map(|(id_i64, distance)| {
-                let id = id_i64.to_string();
-                self.doc_store
-                    .get(&id)
-                    .map(|doc_entry| VectorStoreRetrieveResult {
-                        id,
-                        document: doc_entry.document.clone(),
-                        metadata: doc_entry.metadata.clone(),
-                        distance: distance as f64,
-                    })
-            })
-            .collect::<Vec<_>>())
+        let query: Vec<f32> = query_embedding.into();
+        let search_params = search_params.unwrap_or_default();
+        if let IdSelection::All = selection
+            && let Some(binary_index) = self.trained_binary_index()
+        {
+            let num_candidates =
+                rerank_candidates(top_k, &search_params, DEFAULT_BINARY_RERANK_FACTOR);
+            let codes = binary_quantize(&query, query.len());
+            let candidates = binary_index.search(&codes, num_candidates)?;
+            return self.rerank(&query, &candidates.indexes, top_k);
+        }
+
+        let num_candidates = self.num_candidates(top_k, &search_params);
+        let params = search_params.into();
+        SEARCH_ARENA.with_borrow_mut(|arena| {
+            self.index.search_into(
+                &query,
+                num_candidates,
+                selection.as_selector(),
+                &params,
+                arena,
+            )?;
+            match arena.iter().next() {
+                Some((distances, indexes)) => self.rank_results(&query, distances, indexes, top_k),
+                None => Ok(vec![]),
+            }
+        })
     }
 
     async fn batch_retrieve(
         &self,
-        query_embeddings: Vec<Embedding>,
+        query_embeddings: EmbeddingBatch,
         top_k: usize,
-    ) -> anyhow::Result<Vec<Vec<VectorStoreRetrieveResult>>> {
-        let index_results = self
-            .index
-            .search(
-                query_embeddings
-                    .into_iter()
-                    .map(|query| query.into())
-                    .collect::<Vec<_>>()
-                    .as_slice(),
-                top_k,
-            )
-            .unwrap();
+        filter: Option<VectorStoreFilter>,
+        search_params: Option<VectorStoreSearchParams>,
+    ) -> anyhow::Result<Vec<Vec<VectorStoreRetrieveHit>>> {
+        let num_queries = query_embeddings.len();
+        let dimension = self.index.dimension() as usize;
+        if num_queries > 0 && query_embeddings.dimension() != dimension {
+            bail!(
+                "Query has dimension {}, expected {}",
+                query_embeddings.dimension(),
+                dimension
+            );
+        }
+        let selection = self.select_ids(filter.as_ref());
+        if let IdSelection::Nothing = selection {
+            return Ok((0..num_queries).map(|_| vec![]).collect());
+        }
 
-        Ok(index_results
-            .into_iter()
-            .map(|index_result| {
-                index_result
-                    .indexes
+        let queries = query_embeddings.as_slice();
+        let search_params = search_params.unwrap_or_default();
+        if let IdSelection::All = selection
+            && let Some(binary_index) = self.trained_binary_index()
+        {
+            let num_candidates =
+                rerank_candidates(top_k, &search_params, DEFAULT_BINARY_RERANK_FACTOR);
+            if num_candidates == 0 {
+                return Ok((0..num_queries).map(|_| vec![]).collect());
+            }
+            let codes = binary_quantize(queries, dimension);
+            let candidates = binary_index.search(&codes, num_candidates)?;
+            return candidates
+                .indexes
+                .chunks_exact(num_candidates)
+                .zip(queries.chunks_exact(dimension))
+                .map(|(labels, query)| self.rerank(query, labels, top_k))
+                .collect();
+        }
+
+        let num_candidates = self.num_candidates(top_k, &search_params);
+        let params = search_params.into();
+        SEARCH_ARENA.with_borrow_mut(|arena| {
+            self.index.search_into(
+                queries,
+                num_candidates,
+                selection.as_selector(),
+                &params,
+                arena,
+            )?;
+            let mut results = arena
+                .iter()
+                .zip(queries.chunks_exact(dimension))
+                .map(|((distances, indexes), query)| {
+                    self.rank_results(query, distances, indexes, top_k)
+                })
+                .collect::<anyhow::Result<Vec<_>>>()?;
+            // `top_k == 0` yields no rows from the arena; keep one (empty) row per query
+            results.resize_with(num_queries, Vec::new);
+            Ok(results)
+        })
+    }
+
+    async fn retrieve_within(
+        &self,
+        query_embedding: Embedding,
+        radius: f32,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        let query: Vec<f32> = query_embedding.into();
+        let result = self.index.range_search(&query, radius)?;
+        let mut results = match &self.full_precision {
+            // Hits of the compressed index are re-checked against the exact radius
+            Some(_) => {
+                let (distances, labels) = self.exact_distances(&query, &result.labels)?;
+                let inner_product = self.index.metric_type() == FaissMetricType::InnerProduct;
+                let (distances, labels): (Vec<f32>, Vec<i64>) = distances
                     .into_iter()
-                    .zip(index_result.distances.into_iter())
-                    .filter_map(|(id_i64, distance)| {
-                        let id = id_i64.to_string();
-                        self.doc_store
-                            .get(&id)
-                            .map(|doc_entry| VectorStoreRetrieveResult {
-                                id,
-                                document: doc_entry.document.clone(),
-                                metadata: doc_entry.metadata.clone(),
-                                distance: distance as f64,
-                            })
+                    .zip(labels)
+                    .filter(|(distance, _)| {
+                        if inner_product {
+                            *distance >= radius
+                        } else {
+                            *distance <= radius
+                        }
                     })
-                    .collect::<Vec<_>>()
-            })
-            .collect::<Vec<_>>())
+                    .unzip();
+                self.collect_results(&distances, &labels)
+            }
+            None => self.collect_results(&result.distances, &result.labels),
+        };
+        if self.index.metric_type() == FaissMetricType::InnerProduct {
+            results.sort_by(|a, b| b.distance.total_cmp(&a.distance));
+        } else {
+            results.sort_by(|a, b| a.distance.total_cmp(&b.distance));
+        }
+        Ok(results)
     }
 
     async fn remove_vector(&mut self, id: &str) -> anyhow::Result<()> {
-        if !self.doc_store.contains_key(&id.to_string()) {
-            return Ok(());
-        }
-
-        self.index.remove_vectors(&[id]).unwrap();
-        self.doc_store.remove(id);
-        Ok(())
+        self.remove_vectors(&[id]).await
     }
 
     async fn remove_vectors(&mut self, ids: &[&str]) -> anyhow::Result<()> {
-        // filter ids to only those that exist in doc_store
-        let filtered_ids: Vec<_> = ids
-            .iter()
-            .filter(|&&id| self.doc_store.contains_key(id))
-            .cloned()
-            .collect();
+        let filtered_ids = self.stored_ids(ids);
+        if filtered_ids.is_empty() {
+            return Ok(());
+        }
 
-        self.index.remove_vectors(&filtered_ids).unwrap();
+        self.poll_training(false).await?;
+        self.index.remove_vectors(&filtered_ids)?;
+        self.remove_codes(&filtered_ids)?;
         for id in filtered_ids {
-            self.doc_store.remove(id);
+            self.remove_entry(id);
         }
 
         Ok(())
     }
 
     async fn clear(&mut self) -> anyhow::Result<()> {
-        self.index.clear().unwrap();
+        self.poll_training(true).await?;
+        self.index.clear()?;
+        if let Some(full_precision) = self.full_precision.as_mut() {
+            full_precision.clear()?;
+        }
+        if let Some(binary) = self.binary.as_mut() {
+            binary.index.clear()?;
+        }
+        if let Some(lexical) = self.lexical.as_mut() {
+            lexical.clear();
+        }
         self.doc_store.clear();
+        self.metadata_index.clear();
         Ok(())
     }
 
@@ -226,6 +986,8 @@ impl VectorStoreBehavior for FaissStore {
 
 #[cfg(test)]
 mod tests {
+    use std::sync::Arc;
+
     use ailoy_macros::multi_platform_test;
     use anyhow::Ok;
     use serde_json::{from_value, json};
@@ -233,7 +995,20 @@ mod tests {
     use super::*;
 
     async fn setup_test_store() -> anyhow::Result<FaissStore> {
-        Ok(FaissStore::new(3).await.unwrap())
+        Ok(FaissStore::new(3, None).await.unwrap())
+    }
+
+    fn circle_inputs(range: std::ops::Range<usize>) -> Vec<VectorStoreAddInput> {
+        range
+            .map(|i| {
+                let angle = i as f32 * 0.1;
+                VectorStoreAddInput {
+                    embedding: vec![angle.cos(), angle.sin(), 0.0].into(),
+                    document: format!("doc{}", i),
+                    metadata: None,
+                }
+            })
+            .collect()
     }
 
     #[multi_platform_test]
@@ -302,6 +1077,53 @@ mod tests {
         assert_eq!(res[1].document, "doc2");
         assert_eq!(res[1].embedding, vec![2.0, 2.0, 2.0].into());
 
+        // unknown ids are skipped without shifting the embeddings of the others
+        let res = store
+            .get_by_ids(&[added_ids[1].as_str(), "-1", added_ids[0].as_str()])
+            .await?;
+        assert_eq!(res.len(), 2);
+        assert_eq!(res[0].document, "doc2");
+        assert_eq!(res[0].embedding, vec![2.0, 2.0, 2.0].into());
+        assert_eq!(res[1].document, "doc1");
+        assert_eq!(res[1].embedding, vec![1.0, 1.0, 1.0].into());
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_add_batch_from_contiguous_rows() -> anyhow::Result<()> {
+        let mut store = setup_test_store().await?;
+
+        let batch = VectorStoreAddBatch {
+            embeddings: EmbeddingBatch::from_flat(3, vec![1.0, 0.0, 0.0, 0.0, 1.0, 0.0])?,
+            documents: vec!["x".to_owned(), "y".to_owned()],
+            metadatas: vec![None, Some(from_value(json!({"axis": "y"})).unwrap())],
+        };
+        let ids = store.add_batch(batch).await?;
+        let res = store.get_by_id(&ids[1]).await?.unwrap();
+        assert_eq!(res.document, "y");
+        assert_eq!(res.embedding, vec![0.0, 1.0, 0.0].into());
+
+        // rows that don't match the documents or the index are rejected
+        let missing_row = VectorStoreAddBatch {
+            embeddings: EmbeddingBatch::from_flat(3, vec![1.0, 0.0, 0.0])?,
+            documents: vec!["a".to_owned(), "b".to_owned()],
+            metadatas: vec![None, None],
+        };
+        assert!(store.add_batch(missing_row).await.is_err());
+        let wrong_dimension = VectorStoreAddBatch {
+            embeddings: EmbeddingBatch::from_flat(2, vec![1.0, 0.0])?,
+            documents: vec!["a".to_owned()],
+            metadatas: vec![None],
+        };
+        assert!(store.add_batch(wrong_dimension).await.is_err());
+        assert_eq!(store.count().await?, 2);
+
+        let queries = EmbeddingBatch::from_flat(3, vec![0.0, 0.9, 0.0, 0.9, 0.0, 0.0])?;
+        let results = store.batch_retrieve(queries, 1, None, None).await?;
+        assert_eq!(&*results[0][0].document, "y");
+        assert_eq!(&*results[1][0].document, "x");
+
         Ok(())
     }
 
@@ -336,12 +1158,12 @@ mod tests {
 
         // top_k=2
         let results = store
-            .retrieve(query_embeddings.get(0).cloned().unwrap(), 2)
+            .retrieve(query_embeddings.get(0).cloned().unwrap(), 2, None, None)
             .await?;
 
         assert_eq!(results.len(), 2);
 
-        let retrieved_docs: Vec<_> = results.iter().map(|r| r.document.clone()).collect();
+        let retrieved_docs: Vec<_> = results.iter().map(|r| r.document.to_string()).collect();
         // should exist
         assert!(retrieved_docs.contains(&"vector one".to_owned()));
         assert!(retrieved_docs.contains(&"vector one-ish".to_owned()));
@@ -350,11 +1172,13 @@ mod tests {
         assert!(!retrieved_docs.contains(&"vector two-ish".to_owned()));
 
         // top_k=2
-        let batch_results = store.batch_retrieve(query_embeddings, 2).await?;
+        let batch_results = store
+            .batch_retrieve(query_embeddings.try_into()?, 2, None, None)
+            .await?;
 
         for (i, results) in batch_results.iter().enumerate() {
             assert_eq!(results.len(), 2);
-            let retrieved_docs: Vec<_> = results.iter().map(|r| r.document.clone()).collect();
+            let retrieved_docs: Vec<_> = results.iter().map(|r| r.document.to_string()).collect();
             if i == 0 {
                 // should exist
                 assert!(retrieved_docs.contains(&"vector one".to_owned()));
@@ -375,6 +1199,749 @@ mod tests {
         Ok(())
     }
 
+    #[multi_platform_test]
+    async fn faiss_retrieve_with_metadata_filter() -> anyhow::Result<()> {
+        let mut store = setup_test_store().await?;
+        let inputs = (0..6)
+            .map(|i| VectorStoreAddInput {
+                embedding: vec![1.0 + i as f32 * 0.01, 0.0, 0.0].into(),
+                document: format!("doc{}", i),
+                metadata: Some(
+                    from_value(json!({"source": if i % 2 == 0 { "even" } else { "odd" }})).unwrap(),
+                ),
+            })
+            .collect::<Vec<_>>();
+        store.add_vectors(inputs).await?;
+
+        let filter: VectorStoreFilter = from_value(json!({"source": "odd"})).unwrap();
+        let results = store
+            .retrieve(vec![1.0, 0.0, 0.0].into(), 3, Some(filter.clone()), None)
+            .await?;
+        // every odd document is returned even though even ones are closer
+        assert_eq!(results.len(), 3);
+        for result in results.iter() {
+            assert_eq!(result.metadata.as_deref(), Some(&filter));
+        }
+
+        let filter: VectorStoreFilter = from_value(json!({"source": "none"})).unwrap();
+        let results = store
+            .batch_retrieve(
+                EmbeddingBatch::from_flat(3, vec![1.0, 0.0, 0.0])?,
+                3,
+                Some(filter),
+                None,
+            )
+            .await?;
+        assert_eq!(results.len(), 1);
+        assert!(results[0].is_empty());
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_retrieve_shares_the_stored_entries() -> anyhow::Result<()> {
+        let mut store = setup_test_store().await?;
+        let metadata: VectorStoreMetadata = from_value(json!({"source": "a"})).unwrap();
+        let id = store
+            .add_vector(VectorStoreAddInput {
+                embedding: vec![1.0, 0.0, 0.0].into(),
+                document: "doc".to_owned(),
+                metadata: Some(metadata.clone()),
+            })
+            .await?;
+        let entry = store.doc_store.get(id.parse()?).unwrap();
+
+        // Every hit points at the stored id, text and metadata instead of copies
+        let query: Embedding = vec![1.0, 0.0, 0.0].into();
+        let results = store.retrieve(query.clone(), 1, None, None).await?;
+        let batch_results = store
+            .batch_retrieve(
+                EmbeddingBatch::from_flat(3, vec![1.0, 0.0, 0.0])?,
+                1,
+                None,
+                None,
+            )
+            .await?;
+        let within_results = store.retrieve_within(query, 0.5).await?;
+        for result in [&results[0], &batch_results[0][0], &within_results[0]] {
+            assert!(Arc::ptr_eq(&result.id, &entry.id));
+            assert!(Arc::ptr_eq(&result.document, &entry.document));
+            assert!(Arc::ptr_eq(
+                result.metadata.as_ref().unwrap(),
+                entry.metadata.as_ref().unwrap()
+            ));
+        }
+        assert_eq!(results[0].metadata.as_deref(), Some(&metadata));
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_retrieve_within_radius() -> anyhow::Result<()> {
+        let mut store = setup_test_store().await?;
+        let inputs = [0.0, 0.5, 1.0, 2.0]
+            .into_iter()
+            .map(|x| VectorStoreAddInput {
+                embedding: vec![x, 0.0, 0.0].into(),
+                document: format!("doc at {}", x),
+                metadata: None,
+            })
+            .collect::<Vec<_>>();
+        store.add_vectors(inputs).await?;
+
+        // radius is compared against squared L2 distances: 0.0, 0.25, 1.0, 4.0
+        let results = store
+            .retrieve_within(vec![0.0, 0.0, 0.0].into(), 1.5)
+            .await?;
+        let docs: Vec<_> = results.iter().map(|r| &*r.document).collect();
+        assert_eq!(docs, vec!["doc at 0", "doc at 0.5", "doc at 1"]);
+
+        let results = store
+            .retrieve_within(vec![10.0, 0.0, 0.0].into(), 1.5)
+            .await?;
+        assert!(results.is_empty());
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_snapshot_roundtrip() -> anyhow::Result<()> {
+        let mut store = setup_test_store().await?;
+        let inputs = (0..3)
+            .map(|i| VectorStoreAddInput {
+                embedding: vec![i as f32, 0.0, 0.0].into(),
+                document: format!("doc{}", i),
+                metadata: Some(from_value(json!({"index": i})).unwrap()),
+            })
+            .collect::<Vec<_>>();
+        let ids = store.add_vectors(inputs).await?;
+        store.remove_vector(&ids[2]).await?;
+
+        let mut restored = FaissStore::from_bytes(&store.to_bytes()?).await?;
+        assert_eq!(restored.count().await?, 2);
+        let entry = restored.get_by_id(&ids[1]).await?.unwrap();
+        assert_eq!(entry.document, "doc1");
+        assert_eq!(entry.embedding, vec![1.0, 0.0, 0.0].into());
+
+        // removed ids are not handed out again
+        let new_id = restored
+            .add_vector(VectorStoreAddInput {
+                embedding: vec![0.0, 1.0, 0.0].into(),
+                document: "new".to_owned(),
+                metadata: None,
+            })
+            .await?;
+        assert_eq!(new_id, "3");
+
+        let filter: VectorStoreFilter = from_value(json!({"index": 1})).unwrap();
+        let results = restored
+            .retrieve(vec![0.0, 0.0, 0.0].into(), 3, Some(filter), None)
+            .await?;
+        assert_eq!(results.len(), 1);
+        assert_eq!(&*results[0].id, ids[1]);
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_sharded_store_merges_shards() -> anyhow::Result<()> {
+        let config = FaissStoreConfig {
+            shards: Some(3),
+            ..Default::default()
+        };
+        let mut store = FaissStore::new(3, Some(config)).await?;
+        let mut inputs = circle_inputs(0..30);
+        for (i, input) in inputs.iter_mut().enumerate() {
+            input.metadata = Some(from_value(json!({"even": i % 2 == 0})).unwrap());
+        }
+        let ids = store.add_vectors(inputs).await?;
+        assert_eq!(store.index.num_shards(), 3);
+        assert_eq!(store.count().await?, 30);
+
+        // the nearest neighbors of doc10 live on different shards
+        let query: Embedding = vec![1.0f32.cos(), 1.0f32.sin(), 0.0].into();
+        let results = store.retrieve(query.clone(), 3, None, None).await?;
+        let docs: Vec<_> = results.iter().map(|r| &*r.document).collect();
+        assert_eq!(docs[0], "doc10");
+        assert!(docs[1..].contains(&"doc9") && docs[1..].contains(&"doc11"));
+
+        let filter: VectorStoreFilter = from_value(json!({"even": false})).unwrap();
+        let results = store.retrieve(query.clone(), 2, Some(filter), None).await?;
+        assert!(
+            results
+                .iter()
+                .all(|r| &*r.document == "doc9" || &*r.document == "doc11")
+        );
+
+        store
+            .remove_vectors(&[ids[9].as_str(), ids[11].as_str()])
+            .await?;
+        let restored = FaissStore::from_bytes(&store.to_bytes()?).await?;
+        assert_eq!(restored.index.num_shards(), 3);
+        assert_eq!(restored.count().await?, 28);
+        let results = restored.retrieve(query, 3, None, None).await?;
+        let docs: Vec<_> = results.iter().map(|r| &*r.document).collect();
+        assert_eq!(docs[0], "doc10");
+        assert!(!docs.contains(&"doc9") && !docs.contains(&"doc11"));
+        let entry = restored.get_by_id(&ids[20]).await?.unwrap();
+        assert_eq!(entry.document, "doc20");
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_exact_rerank_scores_full_precision_vectors() -> anyhow::Result<()> {
+        let config = FaissStoreConfig {
+            index_description: Some("SQ8".to_owned()),
+            training_samples: Some(50),
+            exact_rerank: Some(true),
+            ..Default::default()
+        };
+        let mut store = FaissStore::new(3, Some(config)).await?;
+        let inputs = circle_inputs(0..60);
+        let embeddings: Vec<Embedding> =
+            inputs.iter().map(|input| input.embedding.clone()).collect();
+        let ids = store.add_vectors(inputs).await?;
+        store.wait_for_training().await?;
+        assert!(store.pending.is_none());
+
+        // distances come from the original embeddings rather than the 8-bit codes
+        let exact_distance = |i: usize| {
+            let angle = i as f32 * 0.1;
+            ((angle.cos() - 1.0).powi(2) + angle.sin().powi(2)) as f64
+        };
+        let results = store
+            .retrieve(vec![1.0, 0.0, 0.0].into(), 3, None, None)
+            .await?;
+        let docs: Vec<_> = results.iter().map(|r| &*r.document).collect();
+        assert_eq!(docs[0], "doc0");
+        for result in results.iter() {
+            let i: usize = result.document["doc".len()..].parse()?;
+            assert!((result.distance - exact_distance(i)).abs() < 1e-6);
+        }
+        assert_eq!(
+            store.get_by_id(&ids[7]).await?.unwrap().embedding,
+            embeddings[7]
+        );
+
+        store.remove_vector(&ids[0]).await?;
+        let restored = FaissStore::from_bytes(&store.to_bytes()?).await?;
+        assert_eq!(
+            restored.get_by_id(&ids[7]).await?.unwrap().embedding,
+            embeddings[7]
+        );
+        let results = restored
+            .retrieve(vec![1.0, 0.0, 0.0].into(), 1, None, None)
+            .await?;
+        assert_eq!(&*results[0].document, "doc1");
+        assert!((results[0].distance - exact_distance(1)).abs() < 1e-6);
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_binary_candidates_are_rescored() -> anyhow::Result<()> {
+        let config = FaissStoreConfig {
+            binary_index: Some("BFlat".to_owned()),
+            ..Default::default()
+        };
+        let mut store = FaissStore::new(3, Some(config)).await?;
+        let ids = store.add_vectors(circle_inputs(0..60)).await?;
+        assert_eq!(store.trained_binary_index().unwrap().ntotal(), 60);
+
+        // doc0 shares the query's sign bits with 12 others and wins on its float
+        // distance once all of them are candidates
+        let search_params = VectorStoreSearchParams {
+            k_factor: Some(20.0),
+            ..Default::default()
+        };
+        let results = store
+            .retrieve(vec![1.0, -0.01, 0.0].into(), 1, None, Some(search_params))
+            .await?;
+        assert_eq!(&*results[0].document, "doc0");
+        assert!((results[0].distance - 0.0001).abs() < 1e-6);
+        let results = store
+            .batch_retrieve(
+                EmbeddingBatch::from_flat(3, vec![1.0, -0.01, 0.0])?,
+                1,
+                None,
+                Some(search_params),
+            )
+            .await?;
+        assert_eq!(&*results[0][0].document, "doc0");
+
+        store.remove_vector(&ids[0]).await?;
+        assert_eq!(store.trained_binary_index().unwrap().ntotal(), 59);
+        let restored = FaissStore::from_bytes(&store.to_bytes()?).await?;
+        assert_eq!(restored.trained_binary_index().unwrap().ntotal(), 59);
+        let results = restored
+            .retrieve(vec![1.0, -0.01, 0.0].into(), 3, None, None)
+            .await?;
+        assert!(results.iter().all(|r| &*r.document != "doc0"));
+
+        // an IVF binary index is trained once enough vectors were added
+        let config = FaissStoreConfig {
+            binary_index: Some("BIVF2".to_owned()),
+            training_samples: Some(40),
+            ..Default::default()
+        };
+        let mut store = FaissStore::new(3, Some(config)).await?;
+        store.add_vectors(circle_inputs(0..30)).await?;
+        assert!(store.trained_binary_index().is_none());
+        store.add_vectors(circle_inputs(30..60)).await?;
+        assert_eq!(store.trained_binary_index().unwrap().ntotal(), 60);
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_lexical_index_follows_the_documents() -> anyhow::Result<()> {
+        let config = FaissStoreConfig {
+            lexical_index: Some(true),
+            ..Default::default()
+        };
+        let mut store = FaissStore::new(3, Some(config)).await?;
+        let ids = store
+            .add_vectors(
+                [
+                    "Reset code SKU-7731 restores defaults",
+                    "SKU-7732 is a cable",
+                ]
+                .into_iter()
+                .map(|document| VectorStoreAddInput {
+                    embedding: vec![0.0, 0.0, 0.0].into(),
+                    document: document.to_owned(),
+                    metadata: None,
+                })
+                .collect(),
+            )
+            .await?;
+
+        let results = store.retrieve_lexical("sku-7731", 2)?;
+        assert_eq!(&*results[0].id, ids[0]);
+        assert!(results[0].distance > 0.0);
+
+        store.remove_vector(&ids[0]).await?;
+        let restored = FaissStore::from_bytes(&store.to_bytes()?).await?;
+        let results = restored.retrieve_lexical("sku-7731", 2)?;
+        assert!(results.iter().all(|r| &*r.id != ids[0]));
+        assert_eq!(&*restored.retrieve_lexical("cable", 2)?[0].id, ids[1]);
+
+        assert!(
+            setup_test_store()
+                .await?
+                .retrieve_lexical("cable", 2)
+                .is_err()
+        );
+        Ok(())
+    }
+
+    /// Compares index size and recall@10 of compressed indexes, with and without
+    /// exact re-ranking, against a flat index on clustered data. Re-ranked SQ
+    /// indexes should keep the recall of the flat index at a fraction of its size.
+    /// Run with `cargo test --release faiss_compressed_recall -- --ignored --nocapture`.
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    #[tokio::test]
+    #[ignore]
+    async fn faiss_compressed_recall() -> anyhow::Result<()> {
+        use std::collections::HashSet;
+
+        const DIM: usize = 128;
+        const NUM_VECTORS: usize = 20_000;
+        const NUM_QUERIES: usize = 200;
+        const TOP_K: usize = 10;
+
+        // xorshift keeps the data identical across runs
+        let mut state = 0x2545_f491_4f6c_dd1du64;
+        let mut uniform = move || {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            (state >> 40) as f32 / (1u64 << 24) as f32 - 0.5
+        };
+        let centers: Vec<Vec<f32>> = (0..64)
+            .map(|_| (0..DIM).map(|_| uniform()).collect())
+            .collect();
+        let mut sample = |i: usize| -> Vec<f32> {
+            centers[i % centers.len()]
+                .iter()
+                .map(|center| center + 0.3 * uniform())
+                .collect()
+        };
+        let vectors: Vec<Vec<f32>> = (0..NUM_VECTORS).map(&mut sample).collect();
+        let mut queries = EmbeddingBatch::with_capacity(DIM, NUM_QUERIES);
+        for i in 0..NUM_QUERIES {
+            queries.push(&sample(i))?;
+        }
+        let inputs = || {
+            vectors
+                .iter()
+                .enumerate()
+                .map(|(i, vector)| VectorStoreAddInput {
+                    embedding: vector.clone().into(),
+                    document: i.to_string(),
+                    metadata: None,
+                })
+                .collect::<Vec<_>>()
+        };
+        let index_bytes = |store: &FaissStore| -> anyhow::Result<usize> {
+            Ok(store.index.serialize()?.iter().map(Vec::len).sum())
+        };
+
+        let mut flat = FaissStore::new(DIM as u32, None).await?;
+        flat.add_vectors(inputs()).await?;
+        let truth: Vec<HashSet<String>> = flat
+            .batch_retrieve(queries.clone(), TOP_K, None, None)
+            .await?
+            .into_iter()
+            .map(|results| {
+                results
+                    .into_iter()
+                    .map(|r| r.document.to_string())
+                    .collect()
+            })
+            .collect();
+        let flat_bytes = index_bytes(&flat)?;
+        println!(
+            "{:<8} {:<7} {:>12} {:>10}",
+            "index", "rerank", "bytes", "recall@10"
+        );
+        println!("{:<8} {:<7} {:>12} {:>10.3}", "Flat", "-", flat_bytes, 1.0);
+
+        for description in ["SQfp16", "SQ8", "PQ32"] {
+            for exact_rerank in [false, true] {
+                let config = FaissStoreConfig {
+                    index_description: Some(description.to_owned()),
+                    training_samples: Some(NUM_VECTORS as u32),
+                    exact_rerank: Some(exact_rerank),
+                    ..Default::default()
+                };
+                let mut store = FaissStore::new(DIM as u32, Some(config)).await?;
+                store.add_vectors(inputs()).await?;
+                store.wait_for_training().await?;
+
+                let results = store
+                    .batch_retrieve(queries.clone(), TOP_K, None, None)
+                    .await?;
+                let hits: usize = results
+                    .iter()
+                    .zip(truth.iter())
+                    .map(|(results, truth)| {
+                        results
+                            .iter()
+                            .filter(|r| truth.contains(&*r.document))
+                            .count()
+                    })
+                    .sum();
+                let recall = hits as f64 / (NUM_QUERIES * TOP_K) as f64;
+                let bytes = index_bytes(&store)?;
+                println!(
+                    "{:<8} {:<7} {:>12} {:>10.3}  ({:.1}x smaller)",
+                    description,
+                    exact_rerank,
+                    bytes,
+                    recall,
+                    flat_bytes as f64 / bytes as f64
+                );
+                if exact_rerank && description.starts_with("SQ") {
+                    assert!(recall >= 0.95, "{} recall@10 is {}", description, recall);
+                }
+            }
+        }
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_ivf_index_trains_on_training_samples() -> anyhow::Result<()> {
+        let config = FaissStoreConfig {
+            index_description: Some("IVF4,Flat".to_owned()),
+            metric: Some(FaissStoreMetric::InnerProduct),
+            training_samples: Some(200),
+            ..Default::default()
+        };
+        let mut store = FaissStore::new(3, Some(config)).await?;
+        let ids = store.add_vectors(circle_inputs(0..200)).await?;
+        store.wait_for_training().await?;
+        assert!(store.pending.is_none());
+        assert_eq!(store.count().await?, 200);
+
+        let entry = store.get_by_id(&ids[10]).await?.unwrap();
+        assert_eq!(entry.document, "doc10");
+
+        store.remove_vector(&ids[0]).await?;
+        assert_eq!(store.count().await?, 199);
+        assert!(store.get_by_id(&ids[0]).await?.is_none());
+
+        // larger inner products come first
+        let results = store
+            .retrieve(vec![1.0, 0.0, 0.0].into(), 3, None, None)
+            .await?;
+        assert!(!results.is_empty());
+        assert!(results.windows(2).all(|w| w[0].distance >= w[1].distance));
+
+        // probing every inverted list makes the search exhaustive
+        let search_params = VectorStoreSearchParams {
+            nprobe: Some(4),
+            ..Default::default()
+        };
+        let results = store
+            .retrieve(vec![1.0, 0.0, 0.0].into(), 1, None, Some(search_params))
+            .await?;
+        assert_eq!(&*results[0].document, "doc63");
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_ivf_index_stages_until_training_samples() -> anyhow::Result<()> {
+        let config = FaissStoreConfig {
+            index_description: Some("IVF4,Flat".to_owned()),
+            metric: None,
+            training_samples: Some(160),
+            ..Default::default()
+        };
+        let mut store = FaissStore::new(3, Some(config)).await?;
+
+        // below the threshold vectors land in the flat staging index and stay searchable
+        let ids = store.add_vectors(circle_inputs(0..100)).await?;
+        assert!(store.pending.is_some());
+        let results = store
+            .retrieve(vec![1.0, 0.0, 0.0].into(), 1, None, None)
+            .await?;
+        assert_eq!(&*results[0].id, ids[0]);
+
+        store.remove_vector(&ids[1]).await?;
+        store.add_vectors(circle_inputs(100..200)).await?;
+        store.wait_for_training().await?;
+        assert!(store.pending.is_none());
+        assert!(store.index.is_trained());
+        assert_eq!(store.count().await?, 199);
+        assert!(store.get_by_id(&ids[1]).await?.is_none());
+        assert_eq!(store.get_by_id(&ids[50]).await?.unwrap().document, "doc50");
+
+        // ids keep counting from where the staging index stopped
+        let new_ids = store.add_vectors(circle_inputs(0..1)).await?;
+        assert_eq!(new_ids, vec!["200".to_owned()]);
+
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_failed_training_backs_off_and_reports_the_error() -> anyhow::Result<()> {
+        // k-means refuses to train 64 inverted lists on fewer vectors than that
+        let config = FaissStoreConfig {
+            index_description: Some("IVF64,Flat".to_owned()),
+            training_samples: Some(16),
+            ..Default::default()
+        };
+        let mut store = FaissStore::new(3, Some(config)).await?;
+        store.add_vectors(circle_inputs(0..16)).await?;
+        store.wait_for_training().await?;
+        assert!(store.training_error().is_some());
+        assert_eq!(store.pending.as_ref().unwrap().training_samples, 32);
+
+        // adds below the doubled threshold stay on the staging index without retrying
+        store.add_vectors(circle_inputs(16..31)).await?;
+        assert!(store.pending.as_ref().unwrap().target.is_some());
+        assert_eq!(store.count().await?, 31);
+
+        // the retry on 32 vectors fails again, the one on 64 trains
+        store.add_vectors(circle_inputs(31..32)).await?;
+        store.wait_for_training().await?;
+        assert_eq!(store.pending.as_ref().unwrap().training_samples, 64);
+        store.add_vectors(circle_inputs(32..64)).await?;
+        store.wait_for_training().await?;
+        assert!(store.pending.is_none());
+        assert!(store.training_error().is_none());
+        assert_eq!(store.count().await?, 64);
+
+        Ok(())
+    }
+
+    /// Uniform vectors from a fixed xorshift stream, so recall is the same every run.
+    fn uniform_vectors(count: usize, dim: usize, seed: u64) -> Vec<Vec<f32>> {
+        let mut state = seed;
+        (0..count)
+            .map(|_| {
+                (0..dim)
+                    .map(|_| {
+                        state ^= state << 13;
+                        state ^= state >> 7;
+                        state ^= state << 17;
+                        (state >> 40) as f32 / (1u64 << 24) as f32 - 0.5
+                    })
+                    .collect()
+            })
+            .collect()
+    }
+
+    /// Stores `vectors` in a new store with `config`, training it if it needs to.
+    async fn store_with(
+        vectors: &[Vec<f32>],
+        config: FaissStoreConfig,
+    ) -> anyhow::Result<FaissStore> {
+        let config = FaissStoreConfig {
+            training_samples: Some(vectors.len() as u32),
+            ..config
+        };
+        let mut store = FaissStore::new(vectors[0].len() as u32, Some(config)).await?;
+        let inputs = vectors
+            .iter()
+            .map(|vector| VectorStoreAddInput {
+                embedding: vector.clone().into(),
+                document: String::new(),
+                metadata: None,
+            })
+            .collect();
+        store.add_vectors(inputs).await?;
+        store.wait_for_training().await?;
+        Ok(store)
+    }
+
+    /// Share of the exact top-`top_k` ids of `queries` that `store` finds.
+    async fn recall(
+        store: &FaissStore,
+        exact: &FaissStore,
+        queries: &[Vec<f32>],
+        top_k: usize,
+        search_params: VectorStoreSearchParams,
+    ) -> anyhow::Result<f32> {
+        let mut found = 0;
+        for query in queries {
+            let expected = exact
+                .retrieve(query.clone().into(), top_k, None, None)
+                .await?;
+            let actual = store
+                .retrieve(query.clone().into(), top_k, None, Some(search_params))
+                .await?;
+            found += expected
+                .iter()
+                .filter(|e| actual.iter().any(|a| a.id == e.id))
+                .count();
+        }
+        Ok(found as f32 / (queries.len() * top_k) as f32)
+    }
+
+    #[multi_platform_test]
+    async fn faiss_ef_search_trades_hnsw_recall() -> anyhow::Result<()> {
+        let vectors = uniform_vectors(2000, 32, 0x2545_f491_4f6c_dd1d);
+        let queries = uniform_vectors(50, 32, 0x9e37_79b9_7f4a_7c15);
+        let exact = store_with(&vectors, FaissStoreConfig::default()).await?;
+        let hnsw = store_with(
+            &vectors,
+            FaissStoreConfig {
+                index_description: Some("HNSW4".to_owned()),
+                ..Default::default()
+            },
+        )
+        .await?;
+
+        // A one-entry candidate list gets stuck in a sparse graph; a wide one
+        // explores enough of it to find nearly every true neighbor
+        let narrow = VectorStoreSearchParams {
+            ef_search: Some(1),
+            ..Default::default()
+        };
+        let wide = VectorStoreSearchParams {
+            ef_search: Some(256),
+            ..Default::default()
+        };
+        let narrow_recall = recall(&hnsw, &exact, &queries, 1, narrow).await?;
+        let wide_recall = recall(&hnsw, &exact, &queries, 1, wide).await?;
+        assert!(
+            wide_recall >= 0.9,
+            "recall {} with efSearch 256",
+            wide_recall
+        );
+        assert!(
+            narrow_recall < wide_recall,
+            "recall {} with efSearch 1, {} with 256",
+            narrow_recall,
+            wide_recall
+        );
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_k_factor_widens_refine_candidates() -> anyhow::Result<()> {
+        let vectors = uniform_vectors(2000, 32, 0x2545_f491_4f6c_dd1d);
+        let queries = uniform_vectors(50, 32, 0x9e37_79b9_7f4a_7c15);
+        let exact = store_with(&vectors, FaissStoreConfig::default()).await?;
+        let refine = store_with(
+            &vectors,
+            FaissStoreConfig {
+                index_description: Some("PQ8x4,RFlat".to_owned()),
+                ..Default::default()
+            },
+        )
+        .await?;
+
+        // With a factor of 1 the exact refinement only reorders the coarse PQ
+        // hits; a larger factor lets it pick the true neighbors among more of them
+        let coarse = VectorStoreSearchParams {
+            k_factor: Some(1.0),
+            ..Default::default()
+        };
+        let wide = VectorStoreSearchParams {
+            k_factor: Some(200.0),
+            ..Default::default()
+        };
+        let coarse_recall = recall(&refine, &exact, &queries, 5, coarse).await?;
+        let wide_recall = recall(&refine, &exact, &queries, 5, wide).await?;
+        assert!(
+            wide_recall >= 0.95,
+            "recall {} with k_factor 200",
+            wide_recall
+        );
+        assert!(
+            coarse_recall < wide_recall,
+            "recall {} with k_factor 1, {} with 200",
+            coarse_recall,
+            wide_recall
+        );
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_staging_store_trains_after_loading() -> anyhow::Result<()> {
+        let config = FaissStoreConfig {
+            index_description: Some("IVF4,Flat".to_owned()),
+            metric: Some(FaissStoreMetric::InnerProduct),
+            training_samples: Some(160),
+            binary_index: Some("BIVF2".to_owned()),
+            ..Default::default()
+        };
+        let mut store = FaissStore::new(3, Some(config)).await?;
+        let ids = store.add_vectors(circle_inputs(0..100)).await?;
+        assert!(store.pending.is_some());
+
+        let mut restored = FaissStore::from_bytes(&store.to_bytes()?).await?;
+        let pending = restored.pending.as_ref().unwrap();
+        assert_eq!(pending.training_samples, 160);
+        assert_eq!(restored.binary.as_ref().unwrap().training_samples, 160);
+        assert_eq!(restored.count().await?, 100);
+
+        // the saved target and thresholds pick up where the original store stopped
+        restored.add_vectors(circle_inputs(100..200)).await?;
+        restored.wait_for_training().await?;
+        assert!(restored.pending.is_none());
+        assert!(restored.index.is_trained());
+        assert_eq!(restored.index.metric_type(), FaissMetricType::InnerProduct);
+        assert!(restored.trained_binary_index().is_some());
+        assert_eq!(restored.count().await?, 200);
+        assert_eq!(
+            restored.get_by_id(&ids[50]).await?.unwrap().document,
+            "doc50"
+        );
+
+        // the trained store has nothing left to stage
+        let trained = FaissStore::from_bytes(&restored.to_bytes()?).await?;
+        assert!(trained.pending.is_none());
+        assert!(trained.index.is_trained());
+
+        Ok(())
+    }
+
     #[multi_platform_test]
     async fn faiss_remove_vector() -> anyhow::Result<()> {
         let mut store = setup_test_store().await?;
@@ -0,0 +1,249 @@
+//! Full-precision copy of the embeddings of a store whose index is compressed.
+//!
+//! Natively the rows live in a temporary file removed on drop and are fetched
+//! with positioned reads, so only the pages of recently re-ranked candidates take
+//! memory (as page cache) while the compressed index stays the resident part of
+//! the store. The web has no such file and keeps the rows in memory.
+
+use std::collections::HashMap;
+
+use anyhow::{Context, bail};
+
+/// Fixed-size rows indexed by id. Rows of removed ids are reused by later inserts.
+pub struct FullPrecisionVectors {
+    dimension: usize,
+    slots: HashMap<i64, usize>,
+    free_slots: Vec<usize>,
+    num_slots: usize,
+    backing: Backing,
+}
+
+enum Backing {
+    #[allow(dead_code)]
+    Memory(Vec<f32>),
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    File(SideFile),
+}
+
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+struct SideFile {
+    file: std::fs::File,
+    path: std::path::PathBuf,
+}
+
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+impl SideFile {
+    fn create() -> anyhow::Result<Self> {
+        let path = std::env::temp_dir().join(format!("ailoy-vectors-{}.f32", uuid::Uuid::new_v4()));
+        let file = std::fs::OpenOptions::new()
+            .read(true)
+            .write(true)
+            .create_new(true)
+            .open(&path)
+            .with_context(|| format!("Failed to create {}", path.display()))?;
+        Ok(Self { file, path })
+    }
+
+    #[cfg(target_family = "unix")]
+    fn write_at(&self, bytes: &[u8], offset: u64) -> std::io::Result<()> {
+        std::os::unix::fs::FileExt::write_all_at(&self.file, bytes, offset)
+    }
+
+    #[cfg(target_family = "unix")]
+    fn read_at(&self, bytes: &mut [u8], offset: u64) -> std::io::Result<()> {
+        std::os::unix::fs::FileExt::read_exact_at(&self.file, bytes, offset)
+    }
+
+    #[cfg(target_family = "windows")]
+    fn write_at(&self, mut bytes: &[u8], mut offset: u64) -> std::io::Result<()> {
+        while !bytes.is_empty() {
+            let written = std::os::windows::fs::FileExt::seek_write(&self.file, bytes, offset)?;
+            bytes = &bytes[written..];
+            offset += written as u64;
+        }
+        Ok(())
+    }
+
+    #[cfg(target_family = "windows")]
+    fn read_at(&self, mut bytes: &mut [u8], mut offset: u64) -> std::io::Result<()> {
+        while !bytes.is_empty() {
+            let read = std::os::windows::fs::FileExt::seek_read(&self.file, bytes, offset)?;
+            if read == 0 {
+                return Err(std::io::ErrorKind::UnexpectedEof.into());
+            }
+            bytes = &mut bytes[read..];
+            offset += read as u64;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+impl Drop for SideFile {
+    fn drop(&mut self) {
+        let _ = std::fs::remove_file(&self.path);
+    }
+}
+
+impl FullPrecisionVectors {
+    pub fn new(dimension: usize) -> anyhow::Result<Self> {
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        let backing = Backing::File(SideFile::create()?);
+        #[cfg(target_family = "wasm")]
+        let backing = Backing::Memory(Vec::new());
+
+        Ok(Self {
+            dimension,
+            slots: HashMap::new(),
+            free_slots: Vec::new(),
+            num_slots: 0,
+            backing,
+        })
+    }
+
+    pub fn dimension(&self) -> usize {
+        self.dimension
+    }
+
+    pub fn len(&self) -> usize {
+        self.slots.len()
+    }
+
+    pub fn contains(&self, id: i64) -> bool {
+        self.slots.contains_key(&id)
+    }
+
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    fn row_bytes(&self) -> u64 {
+        (self.dimension * size_of::<f32>()) as u64
+    }
+
+    /// Stores the row-major `vectors` under `ids`, replacing rows the ids already had.
+    pub fn insert(&mut self, ids: &[i64], vectors: &[f32]) -> anyhow::Result<()> {
+        if vectors.len() != ids.len() * self.dimension {
+            bail!(
+                "{} values do not make {} vectors of dimension {}",
+                vectors.len(),
+                ids.len(),
+                self.dimension
+            );
+        }
+        for (&id, vector) in ids.iter().zip(vectors.chunks_exact(self.dimension.max(1))) {
+            let slot = match self.slots.get(&id) {
+                Some(&slot) => slot,
+                None => {
+                    let slot = self.free_slots.pop().unwrap_or_else(|| {
+                        self.num_slots += 1;
+                        self.num_slots - 1
+                    });
+                    self.slots.insert(id, slot);
+                    slot
+                }
+            };
+            self.write_row(slot, vector)?;
+        }
+        Ok(())
+    }
+
+    fn write_row(&mut self, slot: usize, vector: &[f32]) -> anyhow::Result<()> {
+        let dimension = self.dimension;
+        match &mut self.backing {
+            Backing::Memory(rows) => {
+                let end = (slot + 1) * dimension;
+                if rows.len() < end {
+                    rows.resize(end, 0.0);
+                }
+                rows[slot * dimension..end].copy_from_slice(vector);
+            }
+            #[cfg(any(target_family = "unix", target_family = "windows"))]
+            Backing::File(file) => {
+                let bytes: Vec<u8> = vector.iter().flat_map(|v| v.to_le_bytes()).collect();
+                file.write_at(&bytes, slot as u64 * bytes.len() as u64)
+                    .context("Failed to write full-precision vector")?;
+            }
+        }
+        Ok(())
+    }
+
+    pub fn remove(&mut self, ids: &[i64]) {
+        for id in ids {
+            if let Some(slot) = self.slots.remove(id) {
+                self.free_slots.push(slot);
+            }
+        }
+    }
+
+    pub fn clear(&mut self) -> anyhow::Result<()> {
+        self.slots.clear();
+        self.free_slots.clear();
+        self.num_slots = 0;
+        match &mut self.backing {
+            Backing::Memory(rows) => rows.clear(),
+            #[cfg(any(target_family = "unix", target_family = "windows"))]
+            Backing::File(file) => file
+                .file
+                .set_len(0)
+                .context("Failed to truncate full-precision vectors")?,
+        }
+        Ok(())
+    }
+
+    /// Writes the rows of `ids` into `out`, which must hold `ids.len() * dimension`
+    /// elements. Fails if any id has no row.
+    pub fn get_into(&self, ids: &[i64], out: &mut [f32]) -> anyhow::Result<()> {
+        let dimension = self.dimension;
+        if out.len() != ids.len() * dimension {
+            bail!(
+                "Output buffer holds {} elements, expected {}",
+                out.len(),
+                ids.len() * dimension
+            );
+        }
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        let mut bytes = vec![0u8; self.row_bytes() as usize];
+        for (&id, row) in ids.iter().zip(out.chunks_exact_mut(dimension)) {
+            let slot = *self
+                .slots
+                .get(&id)
+                .with_context(|| format!("No full-precision vector for id {}", id))?;
+            match &self.backing {
+                Backing::Memory(rows) => {
+                    row.copy_from_slice(&rows[slot * dimension..(slot + 1) * dimension])
+                }
+                #[cfg(any(target_family = "unix", target_family = "windows"))]
+                Backing::File(file) => {
+                    file.read_at(&mut bytes, slot as u64 * self.row_bytes())
+                        .context("Failed to read full-precision vector")?;
+                    for (value, chunk) in row.iter_mut().zip(bytes.chunks_exact(4)) {
+                        *value = f32::from_le_bytes(chunk.try_into().unwrap());
+                    }
+                }
+            }
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn full_precision_vectors_reuse_removed_rows() -> anyhow::Result<()> {
+        let mut vectors = FullPrecisionVectors::new(2)?;
+        vectors.insert(&[3, 5], &[1.0, 2.0, 3.0, 4.0])?;
+        vectors.remove(&[3]);
+        vectors.insert(&[8], &[5.0, 6.0])?;
+        assert_eq!(vectors.len(), 2);
+        assert_eq!(vectors.num_slots, 2);
+
+        let mut out = vec![0.0; 4];
+        vectors.get_into(&[8, 5], &mut out)?;
+        assert_eq!(out, vec![5.0, 6.0, 3.0, 4.0]);
+        assert!(vectors.get_into(&[3], &mut out[..2]).is_err());
+
+        vectors.clear()?;
+        assert_eq!(vectors.len(), 0);
+        Ok(())
+    }
+}
@@ -0,0 +1,109 @@
+use std::collections::{BTreeSet, HashMap};
+
+use super::super::base::{VectorStoreFilter, VectorStoreMetadata};
+use crate::value::Value;
+
+/// Inverted index from metadata `(key, value)` pairs to the ids holding them.
+///
+/// Values are keyed by their canonical JSON text, so `1` stored as an unsigned or
+/// a signed integer matches either way.
+#[derive(Debug, Default)]
+pub struct MetadataIndex {
+    postings: HashMap<String, HashMap<String, BTreeSet<i64>>>,
+}
+
+fn value_key(value: &Value) -> String {
+    serde_json::to_string(value).unwrap_or_default()
+}
+
+impl MetadataIndex {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn insert(&mut self, id: i64, metadata: &VectorStoreMetadata) {
+        for (key, value) in metadata.iter() {
+            self.postings
+                .entry(key.clone())
+                .or_default()
+                .entry(value_key(value))
+                .or_default()
+                .insert(id);
+        }
+    }
+
+    pub fn remove(&mut self, id: i64, metadata: &VectorStoreMetadata) {
+        for (key, value) in metadata.iter() {
+            let Some(values) = self.postings.get_mut(key) else {
+                continue;
+            };
+            let value_key = value_key(value);
+            if let Some(ids) = values.get_mut(&value_key) {
+                ids.remove(&id);
+                if ids.is_empty() {
+                    values.remove(&value_key);
+                }
+            }
+            if values.is_empty() {
+                self.postings.remove(key);
+            }
+        }
+    }
+
+    pub fn clear(&mut self) {
+        self.postings.clear();
+    }
+
+    /// Returns the ids matching every `(key, value)` pair of `filter` in ascending order.
+    pub fn matching_ids(&self, filter: &VectorStoreFilter) -> Vec<i64> {
+        let mut postings = Vec::with_capacity(filter.len());
+        for (key, value) in filter.iter() {
+            match self
+                .postings
+                .get(key)
+                .and_then(|values| values.get(&value_key(value)))
+            {
+                Some(ids) => postings.push(ids),
+                None => return vec![],
+            }
+        }
+        // Walk the shortest posting list and probe the others
+        postings.sort_by_key(|ids| ids.len());
+        let Some((shortest, rest)) = postings.split_first() else {
+            return vec![];
+        };
+        shortest
+            .iter()
+            .filter(|id| rest.iter().all(|ids| ids.contains(id)))
+            .cloned()
+            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use serde_json::{from_value, json};
+
+    use super::*;
+
+    #[test]
+    fn metadata_index_matches_all_pairs() {
+        let mut index = MetadataIndex::new();
+        index.insert(0, &from_value(json!({"source": "a", "page": 1})).unwrap());
+        index.insert(1, &from_value(json!({"source": "b", "page": 1})).unwrap());
+        index.insert(2, &from_value(json!({"source": "a", "page": 2})).unwrap());
+
+        let filter: VectorStoreFilter = from_value(json!({"source": "a"})).unwrap();
+        assert_eq!(index.matching_ids(&filter), vec![0, 2]);
+
+        let filter: VectorStoreFilter = from_value(json!({"source": "a", "page": 1})).unwrap();
+        assert_eq!(index.matching_ids(&filter), vec![0]);
+
+        let filter: VectorStoreFilter = from_value(json!({"source": "c"})).unwrap();
+        assert!(index.matching_ids(&filter).is_empty());
+
+        index.remove(0, &from_value(json!({"source": "a", "page": 1})).unwrap());
+        let filter: VectorStoreFilter = from_value(json!({"page": 1})).unwrap();
+        assert_eq!(index.matching_ids(&filter), vec![1]);
+    }
+}
@@ -1,3 +1,17 @@
+pub(crate) mod bm25;
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub(crate) mod compute_pool;
+pub(crate) mod doc_store;
 pub(crate) mod faiss;
+pub(crate) mod full_precision;
+pub(crate) mod metadata_index;
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub(crate) mod retrieve_batcher;
+pub(crate) mod shards;
+pub(crate) mod snapshot;
 
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub(crate) use compute_pool::*;
 pub(crate) use faiss::*;
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub(crate) use retrieve_batcher::*;
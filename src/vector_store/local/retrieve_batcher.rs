@@ -0,0 +1,249 @@
+//! Coalesces concurrent single-query retrievals into batched FAISS searches.
+//!
+//! A lone query turns a flat search into a matrix-vector product, while a batch
+//! of them becomes one GEMM that is several times cheaper per query. The first
+//! query of a batch opens a window; everything arriving before it closes, or until
+//! the batch is full, is searched together and the results are fanned back out.
+
+use std::{
+    sync::{Arc, Mutex},
+    time::{Duration, Instant},
+};
+
+use anyhow::{Context, anyhow};
+use serde::{Deserialize, Serialize};
+use tokio::sync::oneshot;
+
+use super::super::base::{VectorStoreRetrieveHit, VectorStoreSearchParams};
+use crate::{
+    utils::{BoxFuture, MicroBatcher},
+    value::Embedding,
+};
+
+/// Searches `queries` for their `top_k` nearest entries in one call.
+pub type BatchRunner = Arc<
+    dyn Fn(
+            Vec<Embedding>,
+            usize,
+            Option<VectorStoreSearchParams>,
+        ) -> BoxFuture<'static, anyhow::Result<Vec<Vec<VectorStoreRetrieveHit>>>>
+        + Send
+        + Sync,
+>;
+
+/// Batch sizes and queueing delays achieved by retrieve batching.
+///
+/// Histograms are log2-bucketed: bucket `i` counts samples from `2^i` to
+/// `2^(i+1) - 1`, and bucket 0 also counts zeros.
+#[derive(Clone, Debug, Default, PartialEq, Serialize, Deserialize)]
+#[serde(rename_all = "camelCase")]
+#[cfg_attr(feature = "python", pyo3_stub_gen_derive::gen_stub_pyclass)]
+#[cfg_attr(feature = "python", pyo3::pyclass(module = "ailoy._core", get_all))]
+#[cfg_attr(feature = "nodejs", napi_derive::napi(object))]
+pub struct RetrieveBatchMetrics {
+    /// Number of batches searched.
+    pub batches: i64,
+    /// Number of retrieve calls served by those batches.
+    pub queries: i64,
+    /// Histogram of queries per batch.
+    pub batch_sizes: Vec<i64>,
+    /// Histogram of microseconds a query waited for its batch to be searched.
+    pub wait_micros: Vec<i64>,
+}
+
+impl RetrieveBatchMetrics {
+    fn record(&mut self, batch: &[PendingRetrieve], now: Instant) {
+        self.batches += 1;
+        self.queries += batch.len() as i64;
+        increment(&mut self.batch_sizes, batch.len() as u64);
+        for pending in batch {
+            let waited = now.saturating_duration_since(pending.enqueued);
+            increment(&mut self.wait_micros, waited.as_micros() as u64);
+        }
+    }
+}
+
+fn increment(histogram: &mut Vec<i64>, value: u64) {
+    let bucket = value.max(1).ilog2() as usize;
+    if histogram.len() <= bucket {
+        histogram.resize(bucket + 1, 0);
+    }
+    histogram[bucket] += 1;
+}
+
+struct PendingRetrieve {
+    query: Embedding,
+    top_k: usize,
+    search_params: Option<VectorStoreSearchParams>,
+    enqueued: Instant,
+    tx: oneshot::Sender<anyhow::Result<Vec<VectorStoreRetrieveHit>>>,
+}
+
+pub struct RetrieveBatcher {
+    max_batch_size: usize,
+    runner: BatchRunner,
+    /// Every query shares one queue; search params are told apart when it runs.
+    queue: Arc<MicroBatcher<(), PendingRetrieve>>,
+    metrics: Mutex<RetrieveBatchMetrics>,
+}
+
+impl std::fmt::Debug for RetrieveBatcher {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("RetrieveBatcher")
+            .field("window", &self.queue.window())
+            .field("max_batch_size", &self.max_batch_size)
+            .finish_non_exhaustive()
+    }
+}
+
+impl RetrieveBatcher {
+    pub fn new(window: Duration, max_batch_size: usize, runner: BatchRunner) -> Self {
+        Self {
+            max_batch_size: max_batch_size.max(1),
+            runner,
+            queue: Arc::new(MicroBatcher::new(window)),
+            metrics: Mutex::new(RetrieveBatchMetrics::default()),
+        }
+    }
+
+    /// Queues the query for the next batch and waits for its results.
+    pub async fn retrieve(
+        self: &Arc<Self>,
+        query: Embedding,
+        top_k: usize,
+        search_params: Option<VectorStoreSearchParams>,
+    ) -> anyhow::Result<Vec<VectorStoreRetrieveHit>> {
+        let (tx, rx) = oneshot::channel();
+        let pending = PendingRetrieve {
+            query,
+            top_k,
+            search_params,
+            enqueued: Instant::now(),
+            tx,
+        };
+        let batcher = self.clone();
+        self.queue
+            .push((), pending, self.max_batch_size, move |batch| {
+                batcher.run(batch)
+            });
+        rx.await.context("Batched retrieve was dropped")?
+    }
+
+    pub fn metrics(&self) -> RetrieveBatchMetrics {
+        self.metrics.lock().unwrap().clone()
+    }
+
+    async fn run(self: Arc<Self>, mut batch: Vec<PendingRetrieve>) {
+        self.metrics.lock().unwrap().record(&batch, Instant::now());
+
+        // Queries only share a search when their search params agree; smaller
+        // `top_k`s are served by truncating the largest one
+        while let Some(search_params) = batch.first().map(|pending| pending.search_params) {
+            let (group, rest): (Vec<_>, Vec<_>) = batch
+                .into_iter()
+                .partition(|pending| pending.search_params == search_params);
+            batch = rest;
+
+            let top_k = group.iter().map(|pending| pending.top_k).max().unwrap();
+            let (queries, waiters): (Vec<_>, Vec<_>) = group
+                .into_iter()
+                .map(|pending| (pending.query, (pending.top_k, pending.tx)))
+                .unzip();
+            match (self.runner)(queries, top_k, search_params).await {
+                Ok(results) => {
+                    for ((top_k, tx), mut results) in waiters.into_iter().zip(results) {
+                        results.truncate(top_k);
+                        let _ = tx.send(Ok(results));
+                    }
+                }
+                Err(e) => {
+                    let message = format!("{:#}", e);
+                    for (_, tx) in waiters {
+                        let _ = tx.send(Err(anyhow!(message.clone())));
+                    }
+                }
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::sync::atomic::{AtomicUsize, Ordering};
+
+    use super::*;
+
+    /// Returns one result per query whose distance is the query's first component,
+    /// repeated `top_k` times, and counts the calls.
+    fn echo_runner(calls: Arc<AtomicUsize>) -> BatchRunner {
+        Arc::new(
+            move |queries: Vec<Embedding>,
+                  top_k: usize,
+                  _: Option<VectorStoreSearchParams>|
+                  -> BoxFuture<'static, _> {
+                calls.fetch_add(1, Ordering::Relaxed);
+                Box::pin(async move {
+                    Ok(queries
+                        .into_iter()
+                        .map(|query| {
+                            let first = Into::<Vec<f32>>::into(query)[0] as f64;
+                            (0..top_k)
+                                .map(|i| VectorStoreRetrieveHit {
+                                    id: i.to_string().into(),
+                                    document: "".into(),
+                                    metadata: None,
+                                    distance: first,
+                                })
+                                .collect()
+                        })
+                        .collect())
+                })
+            },
+        )
+    }
+
+    #[tokio::test]
+    async fn retrieve_batcher_coalesces_concurrent_queries() -> anyhow::Result<()> {
+        let calls = Arc::new(AtomicUsize::new(0));
+        let batcher = Arc::new(RetrieveBatcher::new(
+            Duration::from_millis(20),
+            4,
+            echo_runner(calls.clone()),
+        ));
+
+        // Four queries fill a batch before the window closes
+        let results = futures::future::try_join_all(
+            (0..4).map(|i| batcher.retrieve(vec![i as f32].into(), i + 1, None)),
+        )
+        .await?;
+        for (i, results) in results.iter().enumerate() {
+            assert_eq!(results.len(), i + 1);
+            assert!(results.iter().all(|r| r.distance == i as f64));
+        }
+        assert_eq!(calls.load(Ordering::Relaxed), 1);
+
+        // A lone query is searched once the window closes
+        let results = batcher.retrieve(vec![7.0].into(), 2, None).await?;
+        assert_eq!(results.len(), 2);
+        assert_eq!(calls.load(Ordering::Relaxed), 2);
+
+        // Differing search params split a batch into separate searches
+        let params = VectorStoreSearchParams {
+            nprobe: Some(8),
+            ..Default::default()
+        };
+        futures::future::try_join(
+            batcher.retrieve(vec![0.0].into(), 1, None),
+            batcher.retrieve(vec![1.0].into(), 1, Some(params)),
+        )
+        .await?;
+        assert_eq!(calls.load(Ordering::Relaxed), 4);
+
+        let metrics = batcher.metrics();
+        assert_eq!(metrics.batches, 3);
+        assert_eq!(metrics.queries, 7);
+        assert_eq!(metrics.batch_sizes, vec![1, 1, 1]);
+        assert_eq!(metrics.wait_micros.iter().sum::<i64>(), 7);
+        Ok(())
+    }
+}
@@ -0,0 +1,516 @@
+//! A FAISS index split into independent shards.
+//!
+//! Ids are allocated here and routed to shard `id % n`; since ids are sequential
+//! this spreads inserts round-robin. Searches run on every shard in parallel on
+//! a persistent pool of shard threads, and the per-shard top-k lists are merged
+//! with a k-way heap. A single shard adds no overhead over a plain [`FaissIndex`].
+
+use std::{cell::RefCell, cmp::Ordering, collections::BinaryHeap};
+
+use anyhow::bail;
+
+use crate::{
+    ffi::faiss_wrap::{
+        FaissIdSelector, FaissIndex, FaissIndexBuilder, FaissIndexRangeSearchResult,
+        FaissMetricType, FaissSearchArena, FaissSearchParams,
+    },
+    value::EmbeddingBatch,
+};
+
+pub struct FaissShards {
+    shards: Vec<FaissIndex>,
+    next_id: i64,
+}
+
+/// Runs `f` on every shard with its slot, in parallel on the shard pool.
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+fn for_each_shard<S: Sync, A: Send>(
+    shards: &[S],
+    slots: &mut [A],
+    f: impl Fn(&S, &mut A) -> anyhow::Result<()> + Send + Sync,
+) -> anyhow::Result<()> {
+    use rayon::prelude::*;
+
+    shard_pool().install(|| {
+        shards
+            .par_iter()
+            .zip(slots.par_iter_mut())
+            .try_for_each(|(shard, slot)| f(shard, slot))
+    })
+}
+
+/// The web has no threads to fan out to and searches the shards in turn.
+#[cfg(target_family = "wasm")]
+fn for_each_shard<S, A>(
+    shards: &[S],
+    slots: &mut [A],
+    f: impl Fn(&S, &mut A) -> anyhow::Result<()>,
+) -> anyhow::Result<()> {
+    shards
+        .iter()
+        .zip(slots.iter_mut())
+        .try_for_each(|(shard, slot)| f(shard, slot))
+}
+
+/// Threads shared by every sharded index, one per core. They are kept apart from
+/// the compute pool, whose worker waits for the shards of its query meanwhile.
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+fn shard_pool() -> &'static rayon::ThreadPool {
+    static POOL: std::sync::OnceLock<rayon::ThreadPool> = std::sync::OnceLock::new();
+    POOL.get_or_init(|| {
+        rayon::ThreadPoolBuilder::new()
+            .thread_name(|i| format!("ailoy-shard-{}", i))
+            .build()
+            .expect("Failed to create shard pool")
+    })
+}
+
+thread_local! {
+    // Per-shard results of the searches on this thread, kept between searches so
+    // that the shards' output buffers are not allocated anew for every query.
+    static SHARD_ARENAS: RefCell<Vec<FaissSearchArena>> = const { RefCell::new(Vec::new()) };
+}
+
+/// Candidate of the k-way merge; the heap pops the closest one first.
+struct Head {
+    /// Distance oriented so that larger is closer.
+    score: f32,
+    shard: usize,
+    rank: usize,
+}
+
+impl PartialEq for Head {
+    fn eq(&self, other: &Self) -> bool {
+        self.cmp(other) == Ordering::Equal
+    }
+}
+
+impl Eq for Head {}
+
+impl PartialOrd for Head {
+    fn partial_cmp(&self, other: &Self) -> Option<Ordering> {
+        Some(self.cmp(other))
+    }
+}
+
+impl Ord for Head {
+    fn cmp(&self, other: &Self) -> Ordering {
+        // Ties go to the lower shard so merges are deterministic
+        self.score
+            .total_cmp(&other.score)
+            .then_with(|| other.shard.cmp(&self.shard))
+    }
+}
+
+impl FaissShards {
+    pub async fn new(
+        dim: u32,
+        description: &str,
+        metric: FaissMetricType,
+        num_shards: usize,
+    ) -> anyhow::Result<Self> {
+        let mut shards = Vec::with_capacity(num_shards.max(1));
+        for _ in 0..num_shards.max(1) {
+            shards.push(
+                FaissIndexBuilder::new(dim as i32)
+                    .description(description)
+                    .metric(metric)
+                    .build()
+                    .await?,
+            );
+        }
+        Ok(Self { shards, next_id: 0 })
+    }
+
+    pub fn from_indexes(shards: Vec<FaissIndex>, next_id: i64) -> anyhow::Result<Self> {
+        if shards.is_empty() {
+            bail!("A sharded index needs at least one shard");
+        }
+        Ok(Self { shards, next_id })
+    }
+
+    pub fn num_shards(&self) -> usize {
+        self.shards.len()
+    }
+
+    fn shard_of(&self, id: i64) -> usize {
+        id.rem_euclid(self.shards.len() as i64) as usize
+    }
+
+    pub fn is_trained(&self) -> bool {
+        self.shards.iter().all(|shard| shard.is_trained())
+    }
+
+    pub fn ntotal(&self) -> i64 {
+        self.shards.iter().map(|shard| shard.ntotal()).sum()
+    }
+
+    pub fn dimension(&self) -> i32 {
+        self.shards[0].dimension()
+    }
+
+    pub fn metric_type(&self) -> FaissMetricType {
+        self.shards[0].metric_type()
+    }
+
+    pub fn current_id_counter(&self) -> i64 {
+        self.next_id
+    }
+
+    pub fn restore_id_counter(&mut self, next_id: i64) {
+        self.next_id = next_id;
+    }
+
+    /// Trains the first shard and copies it into the others, so they share one
+    /// quantizer layout for the cost of a single k-means run. An index that needs
+    /// training holds no vectors before it, so the copies start out empty.
+    ///
+    /// The web cannot deserialize without awaiting, so there every shard trains
+    /// on the same sample, which the fixed k-means seed turns into the same layout.
+    pub fn train(&mut self, training_vectors: &[f32]) -> anyhow::Result<()> {
+        let (first, others) = self.shards.split_first_mut().unwrap();
+        first.train(training_vectors)?;
+        if others.is_empty() {
+            return Ok(());
+        }
+
+        #[cfg(any(target_family = "unix", target_family = "windows"))]
+        {
+            let trained = first.serialize()?;
+            for shard in others.iter_mut().filter(|shard| !shard.is_trained()) {
+                *shard = FaissIndex::deserialize_blocking(&trained)?;
+            }
+            Ok(())
+        }
+
+        #[cfg(target_family = "wasm")]
+        {
+            others
+                .iter_mut()
+                .try_for_each(|shard| shard.train(training_vectors))
+        }
+    }
+
+    /// Adds the row-major `vectors` under newly allocated ids.
+    pub fn add_vectors(&mut self, vectors: &[f32]) -> anyhow::Result<Vec<i64>> {
+        let num_vectors = vectors.len() / self.dimension() as usize;
+        let ids: Vec<i64> = (self.next_id..self.next_id + num_vectors as i64).collect();
+        self.add_vectors_with_ids(vectors, &ids)?;
+        self.next_id += num_vectors as i64;
+        Ok(ids)
+    }
+
+    /// Adds vectors under ids allocated elsewhere. The id counter is left untouched.
+    pub fn add_vectors_with_ids(&mut self, vectors: &[f32], ids: &[i64]) -> anyhow::Result<()> {
+        if self.shards.len() == 1 {
+            return self.shards[0].add_vectors_with_ids(vectors, ids);
+        }
+        let dimension = self.dimension() as usize;
+        if vectors.len() != ids.len() * dimension {
+            bail!(
+                "{} values do not make {} vectors of dimension {}",
+                vectors.len(),
+                ids.len(),
+                dimension
+            );
+        }
+
+        let mut routed = vec![(vec![], vec![]); self.shards.len()];
+        for (vector, &id) in vectors.chunks_exact(dimension).zip(ids) {
+            let (shard_vectors, shard_ids) = &mut routed[self.shard_of(id)];
+            shard_vectors.extend_from_slice(vector);
+            shard_ids.push(id);
+        }
+        for (shard, (shard_vectors, shard_ids)) in self.shards.iter_mut().zip(routed) {
+            shard.add_vectors_with_ids(&shard_vectors, &shard_ids)?;
+        }
+        Ok(())
+    }
+
+    /// Searches every shard and merges their results into `arena`, as
+    /// [`FaissIndex::search_into`] would for a single index holding everything.
+    pub fn search_into(
+        &self,
+        query_vectors: &[f32],
+        k: usize,
+        selector: Option<FaissIdSelector<'_>>,
+        params: &FaissSearchParams,
+        arena: &mut FaissSearchArena,
+    ) -> anyhow::Result<()> {
+        if self.shards.len() == 1 {
+            return self.shards[0].search_into(query_vectors, k, selector, params, arena);
+        }
+
+        SHARD_ARENAS.with_borrow_mut(|shard_arenas| {
+            if shard_arenas.len() < self.shards.len() {
+                shard_arenas.resize_with(self.shards.len(), FaissSearchArena::new);
+            }
+            let shard_arenas = &mut shard_arenas[..self.shards.len()];
+            for_each_shard(&self.shards, shard_arenas, |shard, shard_arena| {
+                shard.search_into(query_vectors, k, selector, params, shard_arena)
+            })?;
+            self.merge(shard_arenas, k, arena);
+            Ok(())
+        })
+    }
+
+    /// Merges the per-shard top-`k` lists of every query into `arena`.
+    fn merge(&self, shard_arenas: &[FaissSearchArena], k: usize, arena: &mut FaissSearchArena) {
+        let num_queries = shard_arenas[0].num_queries();
+        let larger_is_closer = self.metric_type() == FaissMetricType::InnerProduct;
+        let (distances, indexes) = arena.prepare(num_queries, k);
+        let mut heap = BinaryHeap::with_capacity(shard_arenas.len());
+        for query in 0..num_queries {
+            let rows: Vec<_> = shard_arenas.iter().map(|arena| arena.get(query)).collect();
+            let score = |shard: usize, rank: usize| {
+                let distance = rows[shard].0[rank];
+                if larger_is_closer {
+                    distance
+                } else {
+                    -distance
+                }
+            };
+
+            heap.clear();
+            for (shard, (_, labels)) in rows.iter().enumerate() {
+                if labels.first().is_some_and(|&label| label >= 0) {
+                    heap.push(Head {
+                        score: score(shard, 0),
+                        shard,
+                        rank: 0,
+                    });
+                }
+            }
+
+            let out = query * k..(query + 1) * k;
+            let (out_distances, out_indexes) = (&mut distances[out.clone()], &mut indexes[out]);
+            for slot in 0..k {
+                let Some(Head { shard, rank, .. }) = heap.pop() else {
+                    out_distances[slot..].fill(f32::NAN);
+                    out_indexes[slot..].fill(-1);
+                    break;
+                };
+                let (shard_distances, shard_labels) = rows[shard];
+                out_distances[slot] = shard_distances[rank];
+                out_indexes[slot] = shard_labels[rank];
+                // Missing neighbors (-1) only ever trail a shard's list
+                if rank + 1 < k && shard_labels[rank + 1] >= 0 {
+                    heap.push(Head {
+                        score: score(shard, rank + 1),
+                        shard,
+                        rank: rank + 1,
+                    });
+                }
+            }
+        }
+    }
+
+    /// Concatenates the range search results of every shard, query by query.
+    pub fn range_search(
+        &self,
+        query_vectors: &[f32],
+        radius: f32,
+    ) -> anyhow::Result<FaissIndexRangeSearchResult> {
+        if self.shards.len() == 1 {
+            return self.shards[0].range_search(query_vectors, radius);
+        }
+
+        let mut results: Vec<_> = self.shards.iter().map(|_| None).collect();
+        for_each_shard(&self.shards, &mut results, |shard, result| {
+            *result = Some(shard.range_search(query_vectors, radius)?);
+            Ok(())
+        })?;
+        let results: Vec<_> = results.into_iter().flatten().collect();
+
+        let num_queries = results[0].lims.len() - 1;
+        let mut merged = FaissIndexRangeSearchResult {
+            lims: vec![0],
+            labels: vec![],
+            distances: vec![],
+        };
+        for query in 0..num_queries {
+            for result in &results {
+                let range = result.lims[query]..result.lims[query + 1];
+                merged
+                    .labels
+                    .extend_from_slice(&result.labels[range.clone()]);
+                merged.distances.extend_from_slice(&result.distances[range]);
+            }
+            merged.lims.push(merged.labels.len());
+        }
+        Ok(merged)
+    }
+
+    /// Writes the vectors of `ids` row by row into `out`, gathering them shard by shard.
+    pub fn get_by_ids_into(&self, ids: &[i64], out: &mut [f32]) -> anyhow::Result<()> {
+        if self.shards.len() == 1 {
+            return self.shards[0].get_by_ids_into(ids, out);
+        }
+        let dimension = self.dimension() as usize;
+        if out.len() != ids.len() * dimension {
+            bail!(
+                "Output buffer holds {} elements, expected {}",
+                out.len(),
+                ids.len() * dimension
+            );
+        }
+
+        let mut routed = vec![(vec![], vec![]); self.shards.len()];
+        for (row, &id) in ids.iter().enumerate() {
+            let (shard_rows, shard_ids) = &mut routed[self.shard_of(id)];
+            shard_rows.push(row);
+            shard_ids.push(id);
+        }
+        for (shard, (shard_rows, shard_ids)) in self.shards.iter().zip(routed) {
+            let mut vectors = vec![0f32; shard_ids.len() * dimension];
+            shard.get_by_ids_into(&shard_ids, &mut vectors)?;
+            for (row, vector) in shard_rows.into_iter().zip(vectors.chunks_exact(dimension)) {
+                out[row * dimension..(row + 1) * dimension].copy_from_slice(vector);
+            }
+        }
+        Ok(())
+    }
+
+    /// Assumes every id is in the index, like [`FaissIndex::get_by_ids`].
+    pub fn get_by_ids(&self, ids: &[i64]) -> anyhow::Result<EmbeddingBatch> {
+        let dimension = self.dimension() as usize;
+        let mut flat = vec![0f32; ids.len() * dimension];
+        self.get_by_ids_into(ids, &mut flat)?;
+        EmbeddingBatch::from_flat(dimension, flat)
+    }
+
+    pub fn remove_vectors(&mut self, ids: &[i64]) -> anyhow::Result<usize> {
+        if self.shards.len() == 1 {
+            return self.shards[0].remove_vectors(ids);
+        }
+        let mut routed = vec![vec![]; self.shards.len()];
+        for &id in ids {
+            routed[self.shard_of(id)].push(id);
+        }
+        let mut removed = 0;
+        for (shard, shard_ids) in self.shards.iter_mut().zip(routed) {
+            if !shard_ids.is_empty() {
+                removed += shard.remove_vectors(&shard_ids)?;
+            }
+        }
+        Ok(removed)
+    }
+
+    pub fn clear(&mut self) -> anyhow::Result<()> {
+        for shard in self.shards.iter_mut() {
+            shard.clear()?;
+        }
+        Ok(())
+    }
+
+    /// Serializes each shard on its own, in shard order.
+    pub fn serialize(&self) -> anyhow::Result<Vec<Vec<u8>>> {
+        self.shards.iter().map(|shard| shard.serialize()).collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use ailoy_macros::multi_platform_test;
+
+    use super::*;
+
+    fn circle(range: std::ops::Range<usize>) -> Vec<f32> {
+        range
+            .flat_map(|i| {
+                let angle = i as f32 * 0.1;
+                [angle.cos(), angle.sin(), 0.0]
+            })
+            .collect()
+    }
+
+    #[cfg(any(target_family = "unix", target_family = "windows"))]
+    #[test]
+    fn faiss_shards_are_searched_concurrently() {
+        use std::{
+            sync::atomic::{AtomicUsize, Ordering},
+            time::{Duration, Instant},
+        };
+
+        let n = shard_pool().current_num_threads().min(4);
+        if n < 2 {
+            return;
+        }
+
+        // Every shard waits until all of them have started, which only happens
+        // when they run at the same time
+        let started = AtomicUsize::new(0);
+        let shards = vec![(); n];
+        let mut met = vec![false; n];
+        for_each_shard(&shards, &mut met, |_, met| {
+            started.fetch_add(1, Ordering::SeqCst);
+            let deadline = Instant::now() + Duration::from_secs(1);
+            while started.load(Ordering::SeqCst) < n && Instant::now() < deadline {
+                std::hint::spin_loop();
+            }
+            *met = started.load(Ordering::SeqCst) == n;
+            Ok(())
+        })
+        .unwrap();
+        assert!(met.iter().all(|met| *met));
+    }
+
+    #[multi_platform_test]
+    async fn faiss_shards_match_a_single_index() -> anyhow::Result<()> {
+        for metric in [FaissMetricType::L2, FaissMetricType::InnerProduct] {
+            let mut single = FaissShards::new(3, "IDMap2,Flat", metric, 1).await?;
+            let mut sharded = FaissShards::new(3, "IDMap2,Flat", metric, 4).await?;
+            let ids = single.add_vectors(&circle(0..50))?;
+            assert_eq!(sharded.add_vectors(&circle(0..50))?, ids);
+            assert_eq!(sharded.ntotal(), 50);
+            assert_eq!(sharded.shards[1].ntotal(), 13);
+
+            let queries = circle(60..63);
+            let params = FaissSearchParams::default();
+            let (mut expected, mut actual) = (FaissSearchArena::new(), FaissSearchArena::new());
+            single.search_into(&queries, 5, None, &params, &mut expected)?;
+            sharded.search_into(&queries, 5, None, &params, &mut actual)?;
+            assert_eq!(actual.num_queries(), 3);
+            for query in 0..3 {
+                assert_eq!(actual.get(query).1, expected.get(query).1);
+            }
+            // The shards searched into this thread's arenas, which later searches reuse
+            SHARD_ARENAS.with_borrow(|arenas| assert_eq!(arenas.len(), 4));
+
+            // Fewer matches than k leave trailing -1s, as a single index does
+            let allowed = [3i64, 6];
+            let selector = Some(FaissIdSelector::Ids(&allowed));
+            sharded.search_into(&queries[..3], 4, selector, &params, &mut actual)?;
+            assert_eq!(actual.get(0).1[2..], [-1, -1]);
+
+            let mut vectors = vec![0f32; 6];
+            sharded.get_by_ids_into(&[7, 2], &mut vectors)?;
+            assert_eq!(vectors, [circle(7..8), circle(2..3)].concat());
+
+            assert_eq!(sharded.remove_vectors(&[1, 2, 3])?, 3);
+            assert_eq!(sharded.ntotal(), 47);
+        }
+        Ok(())
+    }
+
+    #[multi_platform_test]
+    async fn faiss_shards_share_one_trained_quantizer() -> anyhow::Result<()> {
+        let mut sharded = FaissShards::new(3, "IVF4,Flat", FaissMetricType::L2, 3).await?;
+        assert!(!sharded.is_trained());
+        sharded.train(&circle(0..200))?;
+        assert!(sharded.is_trained());
+        let trained = sharded.serialize()?;
+        assert!(trained.iter().all(|shard| shard == &trained[0]));
+
+        let ids = sharded.add_vectors(&circle(0..30))?;
+        assert_eq!(sharded.ntotal(), 30);
+        let params = FaissSearchParams {
+            nprobe: 4,
+            ..Default::default()
+        };
+        let mut arena = FaissSearchArena::new();
+        sharded.search_into(&circle(7..8), 1, None, &params, &mut arena)?;
+        assert_eq!(arena.get(0).1, [ids[7]]);
+        Ok(())
+    }
+}
@@ -0,0 +1,387 @@
+//! Versioned on-disk format of a [`FaissStore`](super::FaissStore).
+//!
+//! All integers are little-endian. Documents and metadata are stored column by
+//! column, each as `n + 1` offsets followed by the concatenated payloads.
+//!
+//! | field      | layout                                                   |
+//! |------------|----------------------------------------------------------|
+//! | magic      | `b"AILOYVS\0"`                                           |
+//! | version    | `u32`                                                    |
+//! | flags      | `u32`, the optional sections that follow                 |
+//! | next id    | `i64`                                                    |
+//! | shards `s` | `u32`                                                    |
+//! | indexes    | `s` x (`u64` length + serialized FAISS index)            |
+//! | count `n`  | `u64`                                                    |
+//! | ids        | `n` x `i64`                                              |
+//! | documents  | `n + 1` x `u64` offsets + UTF-8 text                     |
+//! | metadata   | `n + 1` x `u64` offsets + JSON objects (empty when none) |
+//!
+//! followed by the optional sections, in the order of their flags:
+//!
+//! | flag              | section                                                |
+//! |-------------------|--------------------------------------------------------|
+//! | `HAS_VECTORS`     | `u32` dimension + `n` x dimension `f32`, order of ids  |
+//! | `HAS_BINARY`      | `u64` training samples + `u64` length + binary index   |
+//! | `HAS_LEXICAL`     | none; the documents get a BM25 index on load           |
+//! | `HAS_STAGING`     | `u64` training samples + `u32` shards + untrained      |
+//! |                   | indexes as above; the indexes above are staging ones   |
+
+use anyhow::{Context, bail};
+
+use super::super::base::VectorStoreMetadata;
+
+const MAGIC: &[u8; 8] = b"AILOYVS\0";
+const VERSION: u32 = 1;
+
+/// Full-precision vectors of the entries follow the metadata.
+const HAS_VECTORS: u32 = 1 << 0;
+/// The binary index of the candidate pass follows.
+const HAS_BINARY: u32 = 1 << 1;
+/// The store keeps a BM25 index over its documents.
+const HAS_LEXICAL: u32 = 1 << 2;
+/// The store still collects vectors to train its index on, which follows untrained.
+const HAS_STAGING: u32 = 1 << 3;
+const KNOWN_FLAGS: u32 = HAS_VECTORS | HAS_BINARY | HAS_LEXICAL | HAS_STAGING;
+
+pub struct SnapshotEntry {
+    pub id: i64,
+    pub document: String,
+    pub metadata: Option<VectorStoreMetadata>,
+}
+
+pub struct Snapshot<'a> {
+    pub next_id: i64,
+    /// One serialized index per shard.
+    pub indexes: Vec<&'a [u8]>,
+    pub entries: Vec<SnapshotEntry>,
+    /// Full-precision embeddings of the entries, row by row, with their dimension.
+    pub vectors: Option<(usize, Vec<f32>)>,
+    /// Serialized binary index of the candidate pass, with its training threshold.
+    pub binary_index: Option<(usize, &'a [u8])>,
+    /// Whether the store keeps a BM25 index, which is rebuilt from the documents.
+    pub lexical: bool,
+    /// Untrained target shards of a store that is still staging, with its
+    /// training threshold. `indexes` are the flat staging shards then.
+    pub staging: Option<(usize, Vec<&'a [u8]>)>,
+}
+
+fn put_offsets(out: &mut Vec<u8>, offsets: &[u64]) {
+    for offset in offsets {
+        out.extend_from_slice(&offset.to_le_bytes());
+    }
+}
+
+fn put_indexes(out: &mut Vec<u8>, indexes: &[Vec<u8>]) {
+    out.extend_from_slice(&(indexes.len() as u32).to_le_bytes());
+    for index in indexes {
+        out.extend_from_slice(&(index.len() as u64).to_le_bytes());
+        out.extend_from_slice(index);
+    }
+}
+
+pub fn encode<'a>(
+    next_id: i64,
+    indexes: &[Vec<u8>],
+    entries: impl ExactSizeIterator<Item = (i64, &'a str, Option<&'a VectorStoreMetadata>)>,
+    vectors: Option<(usize, &[f32])>,
+    binary_index: Option<(usize, &[u8])>,
+    lexical: bool,
+    staging: Option<(usize, &[Vec<u8>])>,
+) -> anyhow::Result<Vec<u8>> {
+    let count = entries.len();
+    if let Some((dimension, vectors)) = vectors
+        && vectors.len() != count * dimension
+    {
+        bail!(
+            "Snapshot has {} entries but {} vector elements",
+            count,
+            vectors.len()
+        );
+    }
+    let mut ids = Vec::with_capacity(count);
+    let mut document_offsets = Vec::with_capacity(count + 1);
+    let mut documents = Vec::new();
+    let mut metadata_offsets = Vec::with_capacity(count + 1);
+    let mut metadata = Vec::new();
+
+    document_offsets.push(0);
+    metadata_offsets.push(0);
+    for (id, document, entry_metadata) in entries {
+        ids.push(id);
+        documents.extend_from_slice(document.as_bytes());
+        document_offsets.push(documents.len() as u64);
+        if let Some(entry_metadata) = entry_metadata {
+            serde_json::to_writer(&mut metadata, entry_metadata)
+                .context("Failed to encode metadata")?;
+        }
+        metadata_offsets.push(metadata.len() as u64);
+    }
+
+    let mut flags = 0;
+    if vectors.is_some() {
+        flags |= HAS_VECTORS;
+    }
+    if binary_index.is_some() {
+        flags |= HAS_BINARY;
+    }
+    if lexical {
+        flags |= HAS_LEXICAL;
+    }
+    if staging.is_some() {
+        flags |= HAS_STAGING;
+    }
+
+    let indexes_len = |indexes: &[Vec<u8>]| -> usize {
+        4 + indexes.iter().map(|index| 8 + index.len()).sum::<usize>()
+    };
+    let vectors_len = vectors.map_or(0, |(_, vectors)| 4 + vectors.len() * 4);
+    let binary_len = binary_index.map_or(0, |(_, index)| 16 + index.len());
+    let staging_len = staging.map_or(0, |(_, indexes)| 8 + indexes_len(indexes));
+    let mut out = Vec::with_capacity(
+        MAGIC.len()
+            + 24
+            + indexes_len(indexes)
+            + count * 24
+            + documents.len()
+            + metadata.len()
+            + vectors_len
+            + binary_len
+            + staging_len,
+    );
+    out.extend_from_slice(MAGIC);
+    out.extend_from_slice(&VERSION.to_le_bytes());
+    out.extend_from_slice(&flags.to_le_bytes());
+    out.extend_from_slice(&next_id.to_le_bytes());
+    put_indexes(&mut out, indexes);
+    out.extend_from_slice(&(count as u64).to_le_bytes());
+    for id in ids {
+        out.extend_from_slice(&id.to_le_bytes());
+    }
+    put_offsets(&mut out, &document_offsets);
+    out.extend_from_slice(&documents);
+    put_offsets(&mut out, &metadata_offsets);
+    out.extend_from_slice(&metadata);
+    if let Some((dimension, vectors)) = vectors {
+        out.extend_from_slice(&(dimension as u32).to_le_bytes());
+        for value in vectors {
+            out.extend_from_slice(&value.to_le_bytes());
+        }
+    }
+    if let Some((training_samples, binary_index)) = binary_index {
+        out.extend_from_slice(&(training_samples as u64).to_le_bytes());
+        out.extend_from_slice(&(binary_index.len() as u64).to_le_bytes());
+        out.extend_from_slice(binary_index);
+    }
+    if let Some((training_samples, targets)) = staging {
+        out.extend_from_slice(&(training_samples as u64).to_le_bytes());
+        put_indexes(&mut out, targets);
+    }
+    Ok(out)
+}
+
+struct Reader<'a> {
+    bytes: &'a [u8],
+}
+
+impl<'a> Reader<'a> {
+    fn take(&mut self, len: usize) -> anyhow::Result<&'a [u8]> {
+        if self.bytes.len() < len {
+            bail!("Snapshot is truncated");
+        }
+        let (head, tail) = self.bytes.split_at(len);
+        self.bytes = tail;
+        Ok(head)
+    }
+
+    fn u32(&mut self) -> anyhow::Result<u32> {
+        Ok(u32::from_le_bytes(self.take(4)?.try_into().unwrap()))
+    }
+
+    fn u64(&mut self) -> anyhow::Result<u64> {
+        Ok(u64::from_le_bytes(self.take(8)?.try_into().unwrap()))
+    }
+
+    fn i64(&mut self) -> anyhow::Result<i64> {
+        Ok(i64::from_le_bytes(self.take(8)?.try_into().unwrap()))
+    }
+
+    /// Reads a shard count followed by that many length-prefixed indexes.
+    fn indexes(&mut self) -> anyhow::Result<Vec<&'a [u8]>> {
+        let num_shards = self.u32()?;
+        (0..num_shards)
+            .map(|_| {
+                let len = self.u64()? as usize;
+                self.take(len)
+            })
+            .collect()
+    }
+
+    /// Reads a column of `count` payloads prefixed with `count + 1` offsets.
+    fn column(&mut self, count: usize) -> anyhow::Result<Vec<&'a [u8]>> {
+        let offsets = (0..=count)
+            .map(|_| Ok(self.u64()? as usize))
+            .collect::<anyhow::Result<Vec<_>>>()?;
+        let data = self.take(offsets[count])?;
+        offsets
+            .windows(2)
+            .map(|range| {
+                data.get(range[0]..range[1])
+                    .context("Snapshot has invalid offsets")
+            })
+            .collect()
+    }
+}
+
+pub fn decode(bytes: &[u8]) -> anyhow::Result<Snapshot<'_>> {
+    let mut reader = Reader { bytes };
+    if reader.take(MAGIC.len()).ok() != Some(MAGIC.as_slice()) {
+        bail!("Not a vector store snapshot");
+    }
+    let version = reader.u32()?;
+    if version != VERSION {
+        bail!("Unsupported snapshot version: {}", version);
+    }
+    let flags = reader.u32()?;
+    if flags & !KNOWN_FLAGS != 0 {
+        bail!("Snapshot has unknown sections: {:#x}", flags & !KNOWN_FLAGS);
+    }
+
+    let next_id = reader.i64()?;
+    let indexes = reader.indexes()?;
+
+    let count = reader.u64()? as usize;
+    let ids = (0..count)
+        .map(|_| reader.i64())
+        .collect::<anyhow::Result<Vec<_>>>()?;
+    let documents = reader.column(count)?;
+    let metadata = reader.column(count)?;
+    let vectors = if flags & HAS_VECTORS == 0 {
+        None
+    } else {
+        let dimension = reader.u32()? as usize;
+        let len = count
+            .checked_mul(dimension * 4)
+            .context("Snapshot has invalid vectors")?;
+        let bytes = reader.take(len)?;
+        let vectors = bytes
+            .chunks_exact(4)
+            .map(|chunk| f32::from_le_bytes(chunk.try_into().unwrap()))
+            .collect();
+        Some((dimension, vectors))
+    };
+    let binary_index = if flags & HAS_BINARY == 0 {
+        None
+    } else {
+        let training_samples = reader.u64()? as usize;
+        let len = reader.u64()? as usize;
+        Some((training_samples, reader.take(len)?))
+    };
+    let lexical = flags & HAS_LEXICAL != 0;
+    let staging = if flags & HAS_STAGING == 0 {
+        None
+    } else {
+        let training_samples = reader.u64()? as usize;
+        Some((training_samples, reader.indexes()?))
+    };
+    if !reader.bytes.is_empty() {
+        bail!("Snapshot has trailing bytes");
+    }
+
+    let entries = ids
+        .into_iter()
+        .zip(documents)
+        .zip(metadata)
+        .map(|((id, document), metadata)| {
+            Ok(SnapshotEntry {
+                id,
+                document: String::from_utf8(document.to_vec())
+                    .context("Snapshot document is not UTF-8")?,
+                metadata: if metadata.is_empty() {
+                    None
+                } else {
+                    Some(serde_json::from_slice(metadata).context("Failed to decode metadata")?)
+                },
+            })
+        })
+        .collect::<anyhow::Result<Vec<_>>>()?;
+
+    Ok(Snapshot {
+        next_id,
+        indexes,
+        entries,
+        vectors,
+        binary_index,
+        lexical,
+        staging,
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use serde_json::{from_value, json};
+
+    use super::*;
+
+    #[test]
+    fn snapshot_roundtrip() {
+        let metadata: VectorStoreMetadata = from_value(json!({"source": "a", "page": 3})).unwrap();
+        let entries = vec![(3, "three", Some(&metadata)), (7, "", None)];
+        let indexes = vec![b"first".to_vec(), b"second".to_vec()];
+        let targets = vec![b"untrained".to_vec(), b"".to_vec()];
+        let vectors = [1.0, 2.0, 3.0, 4.0];
+        let bytes = encode(
+            8,
+            &indexes,
+            entries.into_iter(),
+            Some((2, vectors.as_slice())),
+            Some((40, b"binary".as_slice())),
+            true,
+            Some((160, &targets)),
+        )
+        .unwrap();
+
+        let snapshot = decode(&bytes).unwrap();
+        assert_eq!(snapshot.next_id, 8);
+        assert_eq!(
+            snapshot.indexes,
+            vec![b"first".as_slice(), b"second".as_slice()]
+        );
+        assert_eq!(snapshot.entries.len(), 2);
+        assert_eq!(snapshot.entries[0].id, 3);
+        assert_eq!(snapshot.entries[0].document, "three");
+        assert_eq!(snapshot.entries[0].metadata, Some(metadata));
+        assert_eq!(snapshot.entries[1].id, 7);
+        assert_eq!(snapshot.entries[1].document, "");
+        assert_eq!(snapshot.entries[1].metadata, None);
+        assert_eq!(snapshot.vectors, Some((2, vectors.to_vec())));
+        assert_eq!(snapshot.binary_index, Some((40, b"binary".as_slice())));
+        assert!(snapshot.lexical);
+        assert_eq!(
+            snapshot.staging,
+            Some((160, vec![b"untrained".as_slice(), b"".as_slice()]))
+        );
+
+        assert!(decode(&bytes[..bytes.len() - 1]).is_err());
+    }
+
+    #[test]
+    fn snapshot_skips_absent_sections() {
+        let indexes = vec![b"index".to_vec()];
+        let bytes = encode(0, &indexes, std::iter::empty(), None, None, false, None).unwrap();
+
+        let snapshot = decode(&bytes).unwrap();
+        assert_eq!(snapshot.indexes, vec![b"index".as_slice()]);
+        assert!(snapshot.entries.is_empty());
+        assert!(snapshot.vectors.is_none());
+        assert!(snapshot.binary_index.is_none());
+        assert!(!snapshot.lexical);
+        assert!(snapshot.staging.is_none());
+
+        let mut unknown = bytes.clone();
+        unknown[MAGIC.len() + 4] = 0x80;
+        assert!(decode(&unknown).is_err());
+        let mut newer = bytes;
+        newer[MAGIC.len()] = 2;
+        assert!(decode(&newer).is_err());
+    }
+}
@@ -3,6 +3,12 @@ pub(crate) mod base;
 pub(crate) mod local;
 
 pub use base::{
-    VectorStore, VectorStoreAddInput, VectorStoreBehavior, VectorStoreGetResult,
-    VectorStoreMetadata, VectorStoreRetrieveResult,
+    VectorStore, VectorStoreAddBatch, VectorStoreAddInput, VectorStoreBehavior, VectorStoreFilter,
+    VectorStoreGetResult, VectorStoreMetadata, VectorStoreRetrieveHit, VectorStoreRetrieveResult,
+    VectorStoreSearchParams,
 };
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub use local::compute_pool::ComputePoolMetrics;
+pub use local::faiss::{FaissStoreConfig, FaissStoreMetric};
+#[cfg(any(target_family = "unix", target_family = "windows"))]
+pub use local::retrieve_batcher::RetrieveBatchMetrics;